@@ -0,0 +1,224 @@
+#include "bench.h"
+#include "alu.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_REPETITIONS 10
+#define DEFAULT_WARMUP 2
+#define MICRO_OPS (1u << 22)
+
+// ALU functions benchmarked through a common binary signature
+// (alu_right_shift is declared in alu.h but has no definition)
+typedef struct {
+    const char *name;
+    sword_t (*fn)(CPU *cpu, sword_t a, sword_t b);
+} AluBenchmark;
+
+static sword_t bench_alu_not(CPU *cpu, sword_t a, sword_t b) {
+    (void)b;
+    return alu_not(cpu, a);
+}
+
+static sword_t bench_alu_shl(CPU *cpu, sword_t a, sword_t b) {
+    return alu_shl(cpu, a, b & 31);
+}
+
+static sword_t bench_alu_shr(CPU *cpu, sword_t a, sword_t b) {
+    return alu_shr(cpu, a, b & 31);
+}
+
+static const AluBenchmark alu_benchmarks[] = {
+    {"alu_add", alu_add}, {"alu_subtract", alu_subtract}, {"alu_mul", alu_mul},
+    {"alu_div", alu_div}, {"alu_and", alu_and}, {"alu_or", alu_or},
+    {"alu_xor", alu_xor}, {"alu_not", bench_alu_not}, {"alu_shl", bench_alu_shl},
+    {"alu_shr", bench_alu_shr}, {"alu_eq", alu_eq}, {"alu_neq", alu_neq},
+    {"alu_gt", alu_gt}, {"alu_lt", alu_lt}, {"alu_ge", alu_ge}, {"alu_le", alu_le},
+};
+
+static volatile uint32_t sink;
+
+// Monotonic wall clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Nearest-rank percentile of a sorted sample
+static double percentile(const double *sorted, int n, double p) {
+    int rank = (int)(p * n + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+// Time one guest workload; returns retired instructions per run
+static uint64_t run_workload(const CPU *pristine, const Workload *workload, int warmup, int repetitions,
+                             double *times) {
+    CPU *cpu = malloc(sizeof(CPU));
+    uint64_t instructions = 0;
+    if (!cpu) {
+        return 0;
+    }
+
+    for (int rep = -warmup; rep < repetitions; rep++) {
+        *cpu = *pristine;
+        workload->build(cpu);
+
+        double start = now_seconds();
+        while (!cpu->halted) {
+            step_cpu(cpu);
+        }
+        double elapsed = now_seconds() - start;
+
+        if (rep >= 0) {
+            times[rep] = elapsed;
+        }
+        instructions = cpu->perf_counters[PERF_INSTRUCTIONS];
+    }
+
+    free(cpu);
+    return instructions;
+}
+
+// Time one ALU function over MICRO_OPS calls
+static double run_alu(CPU *cpu, const AluBenchmark *benchmark) {
+    uint32_t acc = 0;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < MICRO_OPS; i++) {
+        acc += (uint32_t)benchmark->fn(cpu, (int32_t)(i * 2654435761u), (int32_t)(i | 1));
+    }
+    double elapsed = now_seconds() - start;
+    sink = acc;
+    return elapsed;
+}
+
+static double run_read_memory(CPU *cpu) {
+    uint32_t acc = 0;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < MICRO_OPS; i++) {
+        acc += read_memory(cpu->memory, (i * sizeof(uint32_t)) & (MEMORY_SIZE - sizeof(uint32_t)));
+    }
+    double elapsed = now_seconds() - start;
+    sink = acc;
+    return elapsed;
+}
+
+static double run_write_memory(CPU *cpu) {
+    double start = now_seconds();
+    for (uint32_t i = 0; i < MICRO_OPS; i++) {
+        write_memory(cpu->memory, (i * sizeof(uint32_t)) & (MEMORY_SIZE - sizeof(uint32_t)), i);
+    }
+    return now_seconds() - start;
+}
+
+// Write one microbenchmark result from per-repetition times
+static void write_micro(FILE *out, const char *name, double *times, int repetitions, bool last) {
+    qsort(times, repetitions, sizeof(double), compare_doubles);
+    double median = 1e9 * percentile(times, repetitions, 0.5) / MICRO_OPS;
+
+    fprintf(stderr, "micro    %-16s %6.2f ns/op\n", name, median);
+    fprintf(out, "    {\"name\": \"%s\", \"ops\": %u, \"median_ns_per_op\": %.4f, \"p99_ns_per_op\": %.4f}%s\n",
+            name, MICRO_OPS, median, 1e9 * percentile(times, repetitions, 0.99) / MICRO_OPS, last ? "" : ",");
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-o results.json] [--reps N] [--warmup N]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    int repetitions = DEFAULT_REPETITIONS;
+    int warmup = DEFAULT_WARMUP;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (repetitions < 1 || warmup < 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    double *times = malloc(sizeof(double) * repetitions);
+    CPU *pristine = malloc(sizeof(CPU));
+    if (!out || !times || !pristine) {
+        fprintf(stderr, "Error: Cannot set up benchmark output\n");
+        return EXIT_FAILURE;
+    }
+    reset_cpu(pristine);     // Silent, so stdout holds only the JSON
+
+    fprintf(out, "{\n  \"repetitions\": %d,\n  \"warmup\": %d,\n  \"workloads\": [\n", repetitions, warmup);
+    for (int w = 0; w < bench_workload_count; w++) {
+        const Workload *workload = &bench_workloads[w];
+        fprintf(stderr, "workload %-12s", workload->name);
+
+        uint64_t instructions = run_workload(pristine, workload, warmup, repetitions, times);
+        qsort(times, repetitions, sizeof(double), compare_doubles);
+        double median = percentile(times, repetitions, 0.5);
+        double mips = instructions / median / 1e6;
+
+        fprintf(stderr, " %8.2f MIPS\n", mips);
+        fprintf(out, "    {\"name\": \"%s\", \"instructions\": %llu, \"median_ms\": %.4f, \"p99_ms\": %.4f, "
+                     "\"mips\": %.3f}%s\n",
+                workload->name, (unsigned long long)instructions, 1e3 * median,
+                1e3 * percentile(times, repetitions, 0.99), mips, w + 1 < bench_workload_count ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"micro\": [\n");
+
+    CPU *cpu = malloc(sizeof(CPU));
+    if (!cpu) {
+        return EXIT_FAILURE;
+    }
+    *cpu = *pristine;
+    int alu_count = sizeof(alu_benchmarks) / sizeof(alu_benchmarks[0]);
+    for (int m = 0; m < alu_count; m++) {
+        for (int rep = -warmup; rep < repetitions; rep++) {
+            double elapsed = run_alu(cpu, &alu_benchmarks[m]);
+            if (rep >= 0) {
+                times[rep] = elapsed;
+            }
+        }
+        write_micro(out, alu_benchmarks[m].name, times, repetitions, false);
+    }
+    for (int rep = -warmup; rep < repetitions; rep++) {
+        double elapsed = run_read_memory(cpu);
+        if (rep >= 0) {
+            times[rep] = elapsed;
+        }
+    }
+    write_micro(out, "read_memory", times, repetitions, false);
+    for (int rep = -warmup; rep < repetitions; rep++) {
+        double elapsed = run_write_memory(cpu);
+        if (rep >= 0) {
+            times[rep] = elapsed;
+        }
+    }
+    write_micro(out, "write_memory", times, repetitions, true);
+    fprintf(out, "  ]\n}\n");
+
+    if (output) {
+        fclose(out);
+    }
+    free(cpu);
+    free(pristine);
+    free(times);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,15 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "cpu.h"
+
+// A guest benchmark program
+typedef struct {
+    const char *name;
+    void (*build)(CPU *cpu);    // Writes the data page and code into memory
+} Workload;
+
+extern const Workload bench_workloads[];
+extern const int bench_workload_count;
+
+#endif // BENCH_H
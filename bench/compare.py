@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Compare benchmark results against a stored baseline and flag regressions.
+
+Usage: compare.py BASELINE.json RESULTS.json [--threshold 0.10]
+
+A workload regresses when its median time grows by more than the threshold;
+a microbenchmark regresses when its median ns/op grows by more than the
+threshold. Exits with status 1 if anything regressed.
+"""
+import json
+import os
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def compare(kind, baseline, current, key, unit, threshold):
+    base = {entry["name"]: entry for entry in baseline.get(kind, [])}
+    regressions = 0
+    for entry in current.get(kind, []):
+        name = entry["name"]
+        if name not in base:
+            print(f"  {name:<18} {entry[key]:>12.4f} {unit:<6} (new)")
+            continue
+        old, new = base[name][key], entry[key]
+        change = (new - old) / old if old else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -threshold:
+            flag = "  improved"
+        print(f"  {name:<18} {old:>12.4f} -> {new:>12.4f} {unit:<6} {change:+7.1%}{flag}")
+    return regressions
+
+
+def main(argv):
+    threshold = 0.10
+    args = []
+    i = 1
+    while i < len(argv):
+        if argv[i] == "--threshold" and i + 1 < len(argv):
+            threshold = float(argv[i + 1])
+            i += 2
+        else:
+            args.append(argv[i])
+            i += 1
+    if len(args) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    baseline_path, results_path = args
+    if not os.path.exists(baseline_path):
+        print(f"No baseline at {baseline_path}; run 'make bench-baseline' to store one.")
+        return 0
+
+    baseline, current = load(baseline_path), load(results_path)
+    print(f"Workloads (median ms, threshold {threshold:.0%}):")
+    regressions = compare("workloads", baseline, current, "median_ms", "ms", threshold)
+    print(f"Microbenchmarks (median ns/op, threshold {threshold:.0%}):")
+    regressions += compare("micro", baseline, current, "median_ns_per_op", "ns/op", threshold)
+
+    if regressions:
+        print(f"{regressions} regression(s) against {baseline_path}")
+        return 1
+    print("No regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
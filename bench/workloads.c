@@ -0,0 +1,322 @@
+#include "bench.h"
+#include "instructions.h"
+#include <string.h>
+
+// Data page layout shared by the workloads
+#define DATA_ONE 0x00           // Constant 1
+#define DATA_COUNT 0x04         // Iteration count
+#define DATA_TARGET_A 0x08      // Jump/call targets
+#define DATA_TARGET_B 0x0C
+#define DATA_ARG 0x10
+#define DATA_CONST_A 0x14
+#define DATA_CONST_B 0x18
+#define DATA_BUFFER 0x40        // Streaming source, 16 words
+#define DATA_COPY 0x80          // Streaming destination, 16 words
+#define STREAM_WORDS 16
+
+// Appends instructions at the code cursor
+typedef struct {
+    CPU *cpu;
+    uint32_t pc;
+} Builder;
+
+static void begin(Builder *builder, CPU *cpu) {
+    builder->cpu = cpu;
+    builder->pc = CODE_START;
+    write_memory(cpu->memory, DATA_ONE, 1);
+}
+
+static void emit(Builder *builder, Opcode opcode, uint8_t a, uint8_t b, uint8_t c) {
+    write_memory(builder->cpu->memory, builder->pc, encode_instruction(opcode, a, b, c));
+    builder->pc += sizeof(uint32_t);
+}
+
+static void set_word(Builder *builder, uint32_t address, uint32_t value) {
+    write_memory(builder->cpu->memory, address, value);
+}
+
+static void set_double(Builder *builder, uint32_t address, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    set_word(builder, address, (uint32_t)bits);
+    set_word(builder, address + sizeof(uint32_t), (uint32_t)(bits >> 32));
+}
+
+// factorial(12) called from a loop, recursing through CALL/PUSH/POP/RET
+static void build_factorial(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 20000);
+    set_word(&b, DATA_ARG, 12);
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 5, DATA_COUNT, 0);
+    emit(&b, LOAD, 6, DATA_TARGET_A, 0);
+    emit(&b, LOAD, 4, DATA_TARGET_B, 0);
+    uint32_t loop = b.pc;
+    emit(&b, LOAD, 1, DATA_ARG, 0);
+    emit(&b, CALL, 6, 0, 0);
+    emit(&b, SUB, 5, 5, 0);
+    emit(&b, JNZ, 4, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    uint32_t factorial = b.pc;
+    emit(&b, SUB, 3, 1, 0);             // Zero when n == 1
+    emit(&b, LOAD, 7, DATA_CONST_A, 0);
+    emit(&b, JZ, 7, 0, 0);
+    emit(&b, PUSH, 1, 0, 0);
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, CALL, 6, 0, 0);
+    emit(&b, POP, 1, 0, 0);
+    emit(&b, MUL, 2, 2, 1);
+    emit(&b, RET, 0, 0, 0);
+    uint32_t base_case = b.pc;
+    emit(&b, LOAD, 2, DATA_ONE, 0);
+    emit(&b, RET, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, factorial);
+    set_word(&b, DATA_TARGET_B, loop);
+    set_word(&b, DATA_CONST_A, base_case);
+}
+
+// Straight-line ALU work in a counted loop
+static void build_arith(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 300000);
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    uint32_t loop = b.pc;
+    emit(&b, ADD, 2, 2, 0);
+    emit(&b, MUL, 3, 2, 2);
+    emit(&b, XOR, 4, 3, 2);
+    emit(&b, SHL, 5, 4, 1);
+    emit(&b, SHR, 6, 5, 3);
+    emit(&b, AND, 4, 6, 3);
+    emit(&b, OR, 5, 4, 2);
+    emit(&b, DIV, 6, 5, 0);
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+}
+
+// The arith chain on four lanes at a time
+static void build_vector_arith(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 300000);
+    set_word(&b, DATA_CONST_A, DATA_BUFFER);
+    for (uint32_t i = 0; i < VECTOR_LANES; i++) {
+        set_word(&b, DATA_BUFFER + i * sizeof(uint32_t), i + 1);
+    }
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 2, DATA_CONST_A, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    emit(&b, VLOAD, 0, 2, 0);
+    emit(&b, VSPLAT, 1, 0, 0);
+    uint32_t loop = b.pc;
+    emit(&b, VADD, 2, 2, 1);
+    emit(&b, VMUL, 3, 2, 2);
+    emit(&b, VXOR, 4, 3, 2);
+    emit(&b, VADD, 5, 4, 0);
+    emit(&b, VSHUF, 6, 5, 0x1B);
+    emit(&b, VAND, 4, 6, 3);
+    emit(&b, VOR, 5, 4, 2);
+    emit(&b, VCMPGT, 6, 5, 0);
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+}
+
+// Rotate-multiply hashing with bitset counting, one instruction per bit operation
+static void build_bit_hash(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 300000);
+    set_word(&b, DATA_CONST_A, 0x9E3779B1);
+    set_word(&b, DATA_CONST_B, 0x0A03);    // BEXT field: start 3, length 10
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 2, DATA_CONST_A, 0);
+    emit(&b, LOAD, 6, DATA_CONST_B, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    uint32_t loop = b.pc;
+    emit(&b, XOR, 3, 3, 1);
+    emit(&b, ROL, 3, 3, 13);
+    emit(&b, MUL, 3, 3, 2);
+    emit(&b, BSWAP, 4, 3, 0);
+    emit(&b, POPCNT, 5, 4, 0);
+    emit(&b, CTZ, 4, 3, 0);
+    emit(&b, BEXT, 5, 3, 6);
+    emit(&b, BINS, 3, 5, 6);
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+}
+
+// Double-precision recurrence x = 0.75x + 0.5 with a divide, square root and conversions
+static void build_fp_arith(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 300000);
+    set_word(&b, DATA_CONST_A, DATA_BUFFER);
+    set_word(&b, DATA_CONST_B, DATA_BUFFER + sizeof(double));
+    set_double(&b, DATA_BUFFER, 0.75);
+    set_double(&b, DATA_BUFFER + sizeof(double), 0.5);
+
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 2, DATA_CONST_A, 0);
+    emit(&b, LOAD, 3, DATA_CONST_B, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    emit(&b, FLDD, 3, 2, 0);
+    uint32_t loop = b.pc;
+    emit(&b, FLDD, 1, 3, 0);
+    emit(&b, FMADDD, 1, 0, 3);          // F1 = x * 0.75 + 0.5
+    emit(&b, FADDD, 0, 1, 2);           // x = F1 + 0 (F2 stays 0)
+    emit(&b, FDIVD, 4, 3, 0);
+    emit(&b, FSQRTD, 5, 0, 0);
+    emit(&b, FADDD, 6, 4, 5);
+    emit(&b, FCMPD, 5, 0, 4);
+    emit(&b, FCVTWD, 6, 6, 0);
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+}
+
+// Unrolled word-by-word copy between two data page buffers
+static void build_stream(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 100000);
+    for (uint32_t i = 0; i < STREAM_WORDS; i++) {
+        set_word(&b, DATA_BUFFER + i * sizeof(uint32_t), 0x01010101u * i);
+    }
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    uint32_t loop = b.pc;
+    for (uint32_t i = 0; i < STREAM_WORDS; i++) {
+        emit(&b, LOAD, 2 + i % 4, DATA_BUFFER + i * sizeof(uint32_t), 0);
+        emit(&b, STORE, 2 + i % 4, DATA_COPY + i * sizeof(uint32_t), 0);
+    }
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+}
+
+// The stream copy done with one MEMCPY per iteration
+static void build_bulk_copy(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 100000);
+    set_word(&b, DATA_CONST_A, DATA_COPY);
+    set_word(&b, DATA_CONST_B, DATA_BUFFER);
+    set_word(&b, DATA_ARG, STREAM_WORDS * sizeof(uint32_t));
+    for (uint32_t i = 0; i < STREAM_WORDS; i++) {
+        set_word(&b, DATA_BUFFER + i * sizeof(uint32_t), 0x01010101u * i);
+    }
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 2, DATA_CONST_A, 0);
+    emit(&b, LOAD, 3, DATA_CONST_B, 0);
+    emit(&b, LOAD, 4, DATA_ARG, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    uint32_t loop = b.pc;
+    emit(&b, MEMCPY, 2, 3, 4);
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+}
+
+// Many calls to a tiny leaf function
+static void build_calls(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 150000);
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 6, DATA_TARGET_A, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_B, 0);
+    uint32_t loop = b.pc;
+    for (int i = 0; i < 4; i++) {
+        emit(&b, CALL, 6, 0, 0);
+    }
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    uint32_t leaf = b.pc;
+    emit(&b, PUSH, 2, 0, 0);
+    emit(&b, ADD, 2, 2, 0);
+    emit(&b, POP, 2, 0, 0);
+    emit(&b, RET, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, leaf);
+    set_word(&b, DATA_TARGET_B, loop);
+}
+
+// Data-dependent branches driven by an LCG
+static void build_branchy(CPU *cpu) {
+    Builder b;
+    begin(&b, cpu);
+    set_word(&b, DATA_COUNT, 350000);
+    set_word(&b, DATA_CONST_A, 1103515245u);
+    set_word(&b, DATA_CONST_B, 12345u);
+
+    emit(&b, LOAD, 0, DATA_ONE, 0);
+    emit(&b, LOAD, 1, DATA_COUNT, 0);
+    emit(&b, LOAD, 3, DATA_CONST_A, 0);
+    emit(&b, LOAD, 4, DATA_CONST_B, 0);
+    emit(&b, LOAD, 6, DATA_TARGET_B, 0);
+    emit(&b, LOAD, 7, DATA_TARGET_A, 0);
+    uint32_t loop = b.pc;
+    emit(&b, MUL, 2, 2, 3);
+    emit(&b, ADD, 2, 2, 4);
+    emit(&b, SHR, 5, 2, 16);
+    emit(&b, AND, 5, 5, 0);             // Zero flag from the sampled bit
+    emit(&b, JZ, 6, 0, 0);
+    emit(&b, XOR, 5, 5, 2);
+    emit(&b, ADD, 5, 5, 0);
+    uint32_t skip = b.pc;
+    emit(&b, SUB, 1, 1, 0);
+    emit(&b, JNZ, 7, 0, 0);
+    emit(&b, HALT, 0, 0, 0);
+
+    set_word(&b, DATA_TARGET_A, loop);
+    set_word(&b, DATA_TARGET_B, skip);
+}
+
+const Workload bench_workloads[] = {
+    {"factorial", build_factorial},
+    {"arith", build_arith},
+    {"vector_arith", build_vector_arith},
+    {"bit_hash", build_bit_hash},
+    {"fp_arith", build_fp_arith},
+    {"stream", build_stream},
+    {"bulk_copy", build_bulk_copy},
+    {"calls", build_calls},
+    {"branchy", build_branchy},
+};
+
+const int bench_workload_count = sizeof(bench_workloads) / sizeof(bench_workloads[0]);
@@ -6,7 +6,7 @@
 #include <stddef.h>
 #include "cpu.h" // Include CPU structure for flag updates
 
-// ALU Function Prototypes
+// ALU Function Prototypes; operands and results are WORD_SIZE-bit words (see word.h)
 
 /**
  * Performs addition and updates the CPU flags.
@@ -15,7 +15,7 @@
  * @param b - Second operand.
  * @return Result of addition.
  */
-int32_t alu_add(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_add(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs subtraction and updates the CPU flags.
@@ -24,7 +24,7 @@ int32_t alu_add(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return Result of subtraction.
  */
-int32_t alu_subtract(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_subtract(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs multiplication and updates the CPU flags.
@@ -33,7 +33,7 @@ int32_t alu_subtract(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return Result of multiplication.
  */
-int32_t alu_mul(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_mul(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs division and updates the CPU flags.
@@ -42,7 +42,7 @@ int32_t alu_mul(CPU *cpu, int32_t a, int32_t b);
  * @param b - Divisor.
  * @return Result of division.
  */
-int32_t alu_div(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_div(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs bitwise AND operation and updates the CPU flags.
@@ -51,7 +51,7 @@ int32_t alu_div(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return Result of bitwise AND.
  */
-int32_t alu_and(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_and(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs bitwise OR operation and updates the CPU flags.
@@ -60,7 +60,7 @@ int32_t alu_and(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return Result of bitwise OR.
  */
-int32_t alu_or(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_or(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs bitwise XOR operation and updates the CPU flags.
@@ -69,7 +69,7 @@ int32_t alu_or(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return Result of bitwise XOR.
  */
-int32_t alu_xor(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_xor(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs bitwise NOT operation and updates the CPU flags.
@@ -77,7 +77,7 @@ int32_t alu_xor(CPU *cpu, int32_t a, int32_t b);
  * @param a - Operand.
  * @return Result of bitwise NOT.
  */
-int32_t alu_not(CPU *cpu, int32_t a);
+sword_t alu_not(CPU *cpu, sword_t a);
 
 /**
  * Performs left shift operation and updates the CPU flags.
@@ -86,7 +86,7 @@ int32_t alu_not(CPU *cpu, int32_t a);
  * @param shift - Number of positions to shift.
  * @return Result of left shift.
  */
-int32_t alu_shl(CPU *cpu, int32_t a, int32_t shift);
+sword_t alu_shl(CPU *cpu, sword_t a, sword_t shift);
 
 /**
  * Performs right shift operation and updates the CPU flags.
@@ -95,7 +95,7 @@ int32_t alu_shl(CPU *cpu, int32_t a, int32_t shift);
  * @param shift - Number of positions to shift.
  * @return Result of right shift.
  */
-int32_t alu_shr(CPU *cpu, int32_t a, int32_t shift);
+sword_t alu_shr(CPU *cpu, sword_t a, sword_t shift);
 
 /**
  * Compares two values for equality and updates the CPU flags.
@@ -104,7 +104,7 @@ int32_t alu_shr(CPU *cpu, int32_t a, int32_t shift);
  * @param b - Second operand.
  * @return 1 if equal, 0 otherwise.
  */
-int32_t alu_eq(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_eq(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Compares two values for inequality and updates the CPU flags.
@@ -113,7 +113,7 @@ int32_t alu_eq(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return 1 if not equal, 0 otherwise.
  */
-int32_t alu_neq(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_neq(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Checks if the first operand is greater than the second.
@@ -122,7 +122,7 @@ int32_t alu_neq(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return 1 if a > b, 0 otherwise.
  */
-int32_t alu_gt(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_gt(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Checks if the first operand is less than the second.
@@ -131,7 +131,7 @@ int32_t alu_gt(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return 1 if a < b, 0 otherwise.
  */
-int32_t alu_lt(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_lt(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Checks if the first operand is greater than or equal to the second.
@@ -140,7 +140,7 @@ int32_t alu_lt(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return 1 if a >= b, 0 otherwise.
  */
-int32_t alu_ge(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_ge(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Checks if the first operand is less than or equal to the second.
@@ -149,7 +149,7 @@ int32_t alu_ge(CPU *cpu, int32_t a, int32_t b);
  * @param b - Second operand.
  * @return 1 if a <= b, 0 otherwise.
  */
-int32_t alu_le(CPU *cpu, int32_t a, int32_t b);
+sword_t alu_le(CPU *cpu, sword_t a, sword_t b);
 
 /**
  * Performs right shift operation and updates the CPU flags.
@@ -158,7 +158,86 @@ int32_t alu_le(CPU *cpu, int32_t a, int32_t b);
  * @param shift - Number of positions to shift.
  * @return Result of right shift.
  */
-int32_t alu_right_shift(CPU *cpu, int32_t a, uint8_t shift);
+sword_t alu_right_shift(CPU *cpu, sword_t a, uint8_t shift);
+
+// Bit Manipulation Operations
+
+/**
+ * Counts leading zero bits and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @return Number of leading zeros; WORD_SIZE when a is 0.
+ */
+sword_t alu_clz(CPU *cpu, sword_t a);
+
+/**
+ * Counts trailing zero bits and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @return Number of trailing zeros; WORD_SIZE when a is 0.
+ */
+sword_t alu_ctz(CPU *cpu, sword_t a);
+
+/**
+ * Counts set bits and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @return Number of set bits.
+ */
+sword_t alu_popcnt(CPU *cpu, sword_t a);
+
+/**
+ * Rotates left and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @param shift - Number of positions to rotate, modulo WORD_SIZE.
+ * @return Result of rotation.
+ */
+sword_t alu_rol(CPU *cpu, sword_t a, sword_t shift);
+
+/**
+ * Rotates right and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @param shift - Number of positions to rotate, modulo WORD_SIZE.
+ * @return Result of rotation.
+ */
+sword_t alu_ror(CPU *cpu, sword_t a, sword_t shift);
+
+/**
+ * Extracts a bit field and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @param control - Start bit in bits 0-7, length in bits 8-15.
+ * @return The field, right-aligned.
+ */
+sword_t alu_bext(CPU *cpu, sword_t a, sword_t control);
+
+/**
+ * Inserts a bit field and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param original - Value receiving the field.
+ * @param field - Right-aligned field bits.
+ * @param control - Start bit in bits 0-7, length in bits 8-15.
+ * @return original with the field replaced.
+ */
+sword_t alu_bins(CPU *cpu, sword_t original, sword_t field, sword_t control);
+
+/**
+ * Reverses the bit order and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @return a with bit i moved to bit WORD_SIZE - 1 - i.
+ */
+sword_t alu_brev(CPU *cpu, sword_t a);
+
+/**
+ * Reverses the byte order and updates the CPU flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param a - Operand.
+ * @return a with its bytes swapped end for end.
+ */
+sword_t alu_bswap(CPU *cpu, sword_t a);
 
 // Atomic Bit-Level Operations
 
@@ -200,6 +279,20 @@ bool ripple_carry_adder(const bool *a, const bool *b, bool *result, size_t size)
  */
 uint8_t count_leading_zeros(uint32_t x);
 
+/**
+ * Count trailing zeros in a 32-bit integer
+ * @param x - Input number
+ * @return Number of trailing zero bits
+ */
+uint8_t count_trailing_zeros(uint32_t x);
+
+/**
+ * Count set bits in a 32-bit integer
+ * @param x - Input number
+ * @return Number of one bits
+ */
+uint8_t population_count(uint32_t x);
+
 /**
  * Perform bit reversal of a 32-bit integer
  * @param x - Input number
@@ -207,6 +300,13 @@ uint8_t count_leading_zeros(uint32_t x);
  */
 uint32_t bit_reverse(uint32_t x);
 
+/**
+ * Reverse the byte order of a 32-bit integer
+ * @param x - Input number
+ * @return Number with bytes in reverse order
+ */
+uint32_t byte_swap(uint32_t x);
+
 /**
  * Check if a number is a power of 2
  * @param x - Input number
@@ -0,0 +1,120 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// Ahead-of-time translation turns a flat image into C with one function per
+// basic block. Guest registers live in C locals inside a block, and ALU work
+// goes through the same alu_* routines the interpreter calls, so flags and
+// halting match exactly. Build the output as a shared library:
+//
+//     cpu_simulator --translate prog.bin prog.c
+//     cc -O2 -shared -fPIC -I include -o prog.so prog.c
+//     cpu_simulator --native prog.so prog.bin
+//
+// The library is only accepted for the image and word size it was made from.
+// Blocks end at control transfers and stores, and stop short of instructions
+// the translator leaves to the interpreter (vector, FP, SYSCALL, MMU,
+// interrupt and bulk memory instructions); run_native steps those, and any
+// PC without a block, through step_cpu.
+
+#define NATIVE_FORMAT 1
+#define NATIVE_MAX_BLOCK 64     // Guest instructions per block
+
+/**
+ * A translated block: runs its instructions against the CPU and returns the
+ * PC to continue at. perf_counters are updated as the interpreter would.
+ */
+typedef uint32_t (*NativeBlock)(CPU *cpu);
+
+// Exported by a translated library as native_header
+typedef struct {
+    uint32_t format;            // NATIVE_FORMAT
+    uint32_t word_size;         // WORD_SIZE of the engine it was made for
+    uint64_t image_hash;        // image_hash of the source image
+    uint32_t image_size;
+    uint32_t code_start;        // Translated range [code_start, code_end)
+    uint32_t code_end;
+    uint32_t block_count;       // Entries in native_blocks
+} NativeHeader;
+
+// Exported by a translated library as the native_blocks array
+typedef struct {
+    uint32_t address;           // Guest address of the first instruction
+    uint16_t instructions;      // Guest instructions in the block
+    uint16_t bytes;             // Bytes of guest code covered
+    NativeBlock run;
+} NativeBlockEntry;
+
+// A loaded translation, looked up by address / 2
+typedef struct {
+    void *library;              // dlopen handle
+    uint32_t code_start;
+    uint32_t code_end;
+    NativeBlock blocks[INSTRUCTION_SLOTS];
+    uint16_t lengths[INSTRUCTION_SLOTS];   // Guest instructions per block
+    uint16_t sizes[INSTRUCTION_SLOTS];     // Bytes per block
+
+    // Statistics
+    uint64_t blocks_run;
+    uint64_t native_instructions;
+    uint64_t interpreted_instructions;
+    uint32_t invalidated;       // Blocks dropped after their code was written
+} NativeImage;
+
+// Function Prototypes
+
+/**
+ * Hashes an image's bytes (64-bit FNV-1a), identifying the image a
+ * translation was made from.
+ * @param memory - Image bytes.
+ * @param size - Number of bytes.
+ * @return The hash.
+ */
+uint64_t image_hash(const uint8_t *memory, uint32_t size);
+
+/**
+ * Translates a flat binary image to C source for a native library.
+ * @param image_file - Image to translate.
+ * @param output_file - C file to write.
+ * @return 0 on success, -1 on error.
+ */
+int translate_image(const char *image_file, const char *output_file);
+
+/**
+ * Loads a translated library and checks it against the loaded image.
+ * @param native - Translation to fill in.
+ * @param library - Path of the shared library.
+ * @param cpu - CPU holding the image.
+ * @param image_size - Size of the loaded image in bytes.
+ * @return 0 on success, -1 if it cannot be loaded or belongs to another
+ *         image or word size.
+ */
+int load_native_image(NativeImage *native, const char *library, const CPU *cpu, uint32_t image_size);
+
+/**
+ * Runs the CPU with translated blocks, stepping the interpreter wherever no
+ * block applies: at PCs without one, while paging or tracing, and when an
+ * interrupt could fall inside the block. Blocks whose code is written are
+ * dropped, so self-modifying code falls back to the interpreter.
+ * @param native - Loaded translation.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_instructions - Stop after this many instructions.
+ */
+void run_native(NativeImage *native, CPU *cpu, uint64_t max_instructions);
+
+/**
+ * Prints how much of the run executed natively.
+ * @param native - Translation after run_native.
+ */
+void display_native(const NativeImage *native);
+
+/**
+ * Unloads a translated library.
+ * @param native - Loaded translation.
+ */
+void close_native_image(NativeImage *native);
+
+#endif // AOT_H
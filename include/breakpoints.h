@@ -0,0 +1,160 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+#define BREAKPOINT_PAGE_SIZE 256
+#define BREAKPOINT_PAGE_COUNT (MEMORY_SIZE / BREAKPOINT_PAGE_SIZE)
+#define BREAKPOINT_SLOTS INSTRUCTION_SLOTS
+#define MAX_BREAKPOINTS 64
+#define MAX_WATCHPOINTS 16
+#define CONDITION_CODE_SIZE 64
+#define CONDITION_STACK_SIZE 16
+
+#if BREAKPOINT_PAGE_COUNT > 32
+#error "CPU watch_pages is 32 bits wide; raise BREAKPOINT_PAGE_SIZE"
+#endif
+
+// Condition bytecode: a stack machine over WORD_SIZE-bit values
+typedef enum {
+    COND_END = 0,
+    COND_CONST,         // Followed by a 32-bit little-endian value, sign-extended
+    COND_REGISTER,      // Followed by the register number
+    COND_PC,
+    COND_SP,
+    COND_MEMORY,        // Replaces an address with the word stored there
+    COND_ADD,
+    COND_SUB,
+    COND_BIT_AND,
+    COND_EQ,
+    COND_NE,
+    COND_LT,            // Signed comparisons
+    COND_GT,
+    COND_LE,
+    COND_GE,
+    COND_AND,
+    COND_OR,
+    COND_NOT,
+    COND_NEGATE
+} ConditionOp;
+
+// A compiled condition; an empty program is always true
+typedef struct {
+    uint8_t code[CONDITION_CODE_SIZE];
+    int length;
+} Condition;
+
+typedef struct {
+    uint32_t address;
+    Condition condition;
+    uint64_t hits;
+} Breakpoint;
+
+// Write watchpoint over [address, address + length)
+typedef struct {
+    uint32_t address;
+    uint32_t length;
+    Condition condition;
+    uint64_t hits;
+} Watchpoint;
+
+// Why run_with_breakpoints returned
+typedef enum {
+    STOP_NONE,          // Halted or instruction limit reached
+    STOP_BREAKPOINT,
+    STOP_WATCHPOINT
+} StopReason;
+
+// Breakpoints are looked up through a page mask and a per-instruction bitmap,
+// so unmarked pages cost one bit test and conditions run only on a hit.
+// Watchpoints mark CPU watch_pages, which only the store paths test.
+typedef struct {
+    uint32_t break_pages;
+    uint32_t break_slots[BREAKPOINT_SLOTS / 32];
+    Breakpoint breakpoints[MAX_BREAKPOINTS];
+    int breakpoint_count;
+
+    uint32_t watch_pages;
+    Watchpoint watchpoints[MAX_WATCHPOINTS];
+    int watchpoint_count;
+
+    int hit_index;              // Breakpoint or watchpoint that stopped the run
+    uint32_t hit_address;       // Breakpoint PC or watched address
+} BreakpointEngine;
+
+// Function Prototypes
+
+/**
+ * Initializes an engine with no breakpoints or watchpoints.
+ * @param engine - Pointer to the BreakpointEngine structure.
+ */
+void init_breakpoints(BreakpointEngine *engine);
+
+/**
+ * Compiles a condition such as "R1 == 5 && mem[0x300] > 10".
+ * Operands are numbers, R0-R7, PC, SP and mem[expr]; operators are
+ * + - & == != < > <= >= && || ! and parentheses.
+ * @param text - Condition source; NULL or empty means always true.
+ * @param condition - Receives the bytecode.
+ * @return 0 on success, -1 on a syntax error.
+ */
+int compile_condition(const char *text, Condition *condition);
+
+/**
+ * Evaluates a compiled condition against the CPU.
+ * @param condition - Compiled condition.
+ * @param cpu - Pointer to the CPU structure.
+ * @return True if the condition holds.
+ */
+bool evaluate_condition(const Condition *condition, const CPU *cpu);
+
+/**
+ * Adds a breakpoint, replacing the condition of an existing one at the same address.
+ * @param engine - Pointer to the BreakpointEngine structure.
+ * @param address - Instruction address.
+ * @param condition - Condition source, or NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int add_breakpoint(BreakpointEngine *engine, uint32_t address, const char *condition);
+
+/**
+ * Removes the breakpoint at an address.
+ * @param engine - Pointer to the BreakpointEngine structure.
+ * @param address - Instruction address.
+ * @return 0 if it existed, -1 otherwise.
+ */
+int remove_breakpoint(BreakpointEngine *engine, uint32_t address);
+
+/**
+ * Adds a write watchpoint, replacing the condition of an identical one.
+ * @param engine - Pointer to the BreakpointEngine structure.
+ * @param address - First watched byte.
+ * @param length - Number of watched bytes.
+ * @param condition - Condition source, or NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int add_watchpoint(BreakpointEngine *engine, uint32_t address, uint32_t length, const char *condition);
+
+/**
+ * Removes a write watchpoint.
+ * @param engine - Pointer to the BreakpointEngine structure.
+ * @param address - First watched byte.
+ * @param length - Number of watched bytes.
+ * @return 0 if it existed, -1 otherwise.
+ */
+int remove_watchpoint(BreakpointEngine *engine, uint32_t address, uint32_t length);
+
+/**
+ * Runs the CPU until a breakpoint or watchpoint with a true condition hits.
+ * A breakpoint stops before its instruction executes; the instruction at the
+ * starting PC is never reported. Without any points this is the plain loop.
+ * @param engine - Pointer to the BreakpointEngine structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_instructions - Stop after this many instructions.
+ * @return The reason the run stopped.
+ */
+StopReason run_with_breakpoints(BreakpointEngine *engine, CPU *cpu, uint64_t max_instructions);
+
+#endif // BREAKPOINTS_H
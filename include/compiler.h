@@ -0,0 +1,36 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+// Compiler from a C subset to image assembler source (image_assembler.h).
+// Source is lexed and parsed to a syntax tree per function, translated to
+// SSA form (ir.h) as it is walked, optimized, and given registers by a
+// linear scan before assembly is written.
+//
+// The subset: int, long, short, signed and unsigned (all one signed machine
+// word), char (unsigned byte), void, pointers and one-dimensional arrays;
+// if, while, do, for, break, continue and return; every C operator except
+// the member operators, with << and >> taking constant shift counts. Calls
+// take at most five arguments. printf (format plus two arguments), putchar,
+// puts, malloc, free, strlen, memcpy and memset become SYSCALLs unless the
+// file defines them. Preprocessor lines are skipped.
+//
+// Memory: the data page holds the scratch word at address 0 that indirect
+// accesses pass through, scalar globals, spill slots and a constant pool.
+// Arrays, strings and other globals follow the code. Locals that are
+// arrays or have their address taken live in a frame each call allocates
+// with SYSCALL malloc and frees on return.
+//
+// Calls: arguments in R1-R5, result in R1. Every register is caller-saved.
+// The output is for the word size of the engine that compiled it.
+
+// Function Prototypes
+
+/**
+ * Compiles a C source file to assembly for --assemble.
+ * @param c_file - C source to compile.
+ * @param asm_file - Assembly file to write.
+ * @return 0 on success, -1 after reporting the first error.
+ */
+int compile_c_file(const char *c_file, const char *asm_file);
+
+#endif // COMPILER_H
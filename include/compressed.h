@@ -0,0 +1,68 @@
+#ifndef COMPRESSED_H
+#define COMPRESSED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Compressed instructions are 15-bit forms of common instructions, packed
+// two to a word whose top two bits are set; no 32-bit opcode reaches 0xC0,
+// so a fetch tells the formats apart from the aligned word alone. The first
+// instruction (bits 0-14) is at the word's address and the second (bits
+// 15-29) two bytes later; either may be a branch target. Each expands to
+// the 32-bit instruction with the same effect:
+//
+//     C.NOP             NOP                 bits 14-11 opcode
+//     C.MOV rd, rs      MOV rd, rs          bits 10-8 rd, bits 7-5 rs
+//     C.ADDI rd, imm    ADDI rd, rd, imm    bits 10-8 rd, bits 7-0 imm (-128..127)
+//     C.PUSH r          PUSH r              bits 10-8 r
+//     C.POP r           POP r
+//     C.RET             RET
+//     C.CALL r          CALL r
+//     C.BRA off         BRA off             bits 10-0 off / 2 (-2048..2046)
+//     C.BZ off          BZ off
+//     C.BNZ off         BNZ off
+//
+// Branch offsets are relative to the branch's own address in both formats.
+// The image assembler compresses eligible instructions automatically.
+
+#define COMPRESSED_PAIR_TAG 0xC0000000u
+#define COMPRESSED_MASK 0x7FFFu
+#define COMPRESSED_SHIFT 15         // Position of the second instruction
+
+// Function Prototypes
+
+/**
+ * Tests whether a word holds a pair of compressed instructions.
+ * @param word - Aligned instruction word.
+ * @return True for a compressed pair.
+ */
+static inline bool is_compressed_pair(uint32_t word) {
+    return (word & COMPRESSED_PAIR_TAG) == COMPRESSED_PAIR_TAG;
+}
+
+/**
+ * Expands a compressed instruction to its 32-bit form.
+ * @param half - The 15-bit compressed instruction.
+ * @return The 32-bit instruction; undefined compressed opcodes expand to
+ *         opcode 0xFF, which the CPU rejects as invalid.
+ */
+uint32_t expand_compressed(uint32_t half);
+
+/**
+ * Finds the compressed form of a 32-bit instruction.
+ * @param raw - The 32-bit instruction, with any branch offset relative to
+ *              the address it will occupy.
+ * @param half - Receives the 15-bit compressed instruction.
+ * @return True if raw has a compressed form that expands back to it exactly.
+ */
+bool compress_instruction(uint32_t raw, uint32_t *half);
+
+/**
+ * Packs two compressed instructions into one word.
+ * @param first - Instruction at the word's address.
+ * @param second - Instruction two bytes later.
+ * @return The pair word.
+ */
+uint32_t pack_compressed(uint32_t first, uint32_t second);
+
+#endif // COMPRESSED_H
@@ -3,10 +3,25 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "word.h"
 
 #define REGISTER_COUNT 8
+#define VECTOR_REGISTER_COUNT 8
+#define VECTOR_LANES 4     // 32-bit lanes per 128-bit vector register
+#define FP_REGISTER_COUNT 8
 #define MEMORY_SIZE 4096
-#define WORD_SIZE 32
+#define CODE_START 0x100    // Execution starts here; below is the data page
+#define HEAP_START 0x200    // Lowest heap address for SYSCALL malloc
+#define HEAP_END 0xE00      // The top 512 bytes are left to the stack
+#define IO_PAGE_SIZE 16     // Granularity of the memory-mapped device map
+#define IO_PAGE_COUNT (MEMORY_SIZE / IO_PAGE_SIZE)
+#define INSTRUCTION_SLOTS (MEMORY_SIZE / 2)    // Instructions start on 2-byte boundaries
+#define DECODE_PAGE_SIZE (MEMORY_SIZE / 32)    // Granularity of decoded_pages
+
+struct InterruptController;
+struct MMIOBus;
+struct HostCalls;
+struct MMU;
 
 // CPU Flags
 typedef enum {
@@ -39,6 +54,24 @@ typedef enum {
     FLAG_INTERRUPT = 15          // Interrupt flag
 } CPUFlags;
 
+// Performance counters readable by the guest through RDPERF
+typedef enum {
+    PERF_INSTRUCTIONS = 0,       // Retired instructions
+    PERF_CYCLES = 1,             // Cycles, only advanced by the timing model
+    PERF_BRANCHES = 2,           // Jumps, branches, CALL and RET
+    PERF_LOADS = 3,              // LOAD, POP and RET memory reads
+    PERF_STORES = 4,             // STORE, PUSH and CALL memory writes
+    PERF_CACHE_MISSES = 5,       // I- and D-cache misses, timing model only
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+// How FPU instructions compute their results (see fpu.h)
+typedef enum {
+    FPU_HOST,                    // Host FPU; flags read lazily from fenv
+    FPU_SOFT,                    // Bit-exact software floating point
+    FPU_CHECK                    // Both, halting on the first mismatch
+} FPUMode;
+
 // Instruction Opcodes
 typedef enum {
     // Arithmetic Operations
@@ -71,7 +104,17 @@ typedef enum {
 // CPU Structure with Enhanced Design
 typedef struct {
     // General Purpose Registers
-    int32_t registers[REGISTER_COUNT];  // R0-R7 registers
+    sword_t registers[REGISTER_COUNT];  // R0-R7 registers, WORD_SIZE bits wide
+
+    // Vector Registers
+    int32_t vectors[VECTOR_REGISTER_COUNT][VECTOR_LANES];   // V0-V7
+
+    // Floating-point registers F0-F7; singles use the low 32 bits. fp_flags
+    // holds the accrued FPUFlag bits, which in FPU_HOST mode may still be
+    // pending in the host fenv until fpu_flags folds them in
+    uint64_t fp_registers[FP_REGISTER_COUNT];
+    uint32_t fp_flags;
+    FPUMode fpu_mode;
 
     // Special Purpose Registers
     uint32_t program_counter;  // Program Counter
@@ -83,12 +126,54 @@ typedef struct {
     // Memory
     uint8_t memory[MEMORY_SIZE];  // Main memory
 
-    // Instruction Register
+    // Instruction Register: the 32-bit form of the executing instruction,
+    // and its length in memory (2 if it was compressed, otherwise 4)
     uint32_t instruction_register;
+    uint32_t instruction_length;
+
+    // Decode cache indexed by address / 2: the 32-bit form of each fetched
+    // instruction, with compressed pairs expanded once. decoded_length is 0
+    // for empty slots, and decoded_pages has a bit per DECODE_PAGE_SIZE bytes
+    // holding filled slots so stores elsewhere skip invalidation
+    uint32_t decoded[INSTRUCTION_SLOTS];
+    uint8_t decoded_length[INSTRUCTION_SLOTS];
+    uint32_t decoded_pages;
 
     // Halt Flag
     bool halted;
 
+    // Per-instruction printf tracing in execute_instruction
+    bool trace_execution;
+
+    // Performance counters, indexed by PerfCounter
+    uint64_t perf_counters[PERF_COUNTER_COUNT];
+
+    // Memory range written by the last step (store_size is 0 if none)
+    uint32_t store_address;
+    uint32_t store_size;
+
+    // Pages holding write watchpoints; a store into one sets watch_hit
+    uint32_t watch_pages;
+    bool watch_hit;
+
+    // Interrupt controller, or NULL; step_cpu calls it once
+    // perf_counters[PERF_INSTRUCTIONS] reaches next_event
+    struct InterruptController *interrupts;
+    uint64_t next_event;
+
+    // Memory-mapped devices: io_pages holds a device number per IO page,
+    // 0 for RAM, and is fixed once the bus is attached
+    struct MMIOBus *bus;
+    uint8_t io_pages[IO_PAGE_COUNT];
+
+    // Native runtime routines for SYSCALL, or NULL
+    struct HostCalls *host_calls;
+
+    // Memory management unit, or NULL; paging is set while it translates
+    // addresses, and load_word, store_word and fetch_instruction test it
+    struct MMU *mmu;
+    bool paging;
+
     // Integer Mode
     enum {
         MODE_SIGNED,
@@ -99,16 +184,14 @@ typedef struct {
 // Function prototypes
 
 /**
- * Initializes the CPU structure.
- * - Clears all registers.
- * - Sets PC to the start of the code segment.
- * - Sets SP to the top of the stack segment.
- * - Sets heap_pointer to the start of the heap.
+ * Initializes the CPU structure with reset_cpu and prints the
+ * "CPU Initialized" banner that precedes a run's output.
  */
 void init_cpu(CPU *cpu);
 
 /**
- * Resets the CPU state.
+ * Resets the CPU state without printing, for tools whose stdout is a
+ * report or data (benchmarks, translation, measurement runs).
  * - Clears all registers.
  * - Resets PC and SP to their initial values.
  * - Clears the memory array.
@@ -119,7 +202,7 @@ void reset_cpu(CPU *cpu);
  * Displays the current state of the CPU.
  * - Prints registers, flags, and PC.
  */
-// void display_cpu_state(const CPU *cpu);
+void display_cpu_state(const CPU *cpu);
 
 /**
  * Executes the fetch-decode-execute loop.
@@ -129,8 +212,20 @@ void reset_cpu(CPU *cpu);
  */
 void run_cpu(CPU *cpu);
 
+/**
+ * Fetches the instruction at the Program Counter through the decode cache.
+ * - Stores its 32-bit form in the instruction register and advances PC by
+ *   its length, 2 for a compressed instruction and 4 otherwise.
+ * - Halts the CPU if PC is outside the code segment or misaligned.
+ * - Uses physical addresses; step_cpu fetches through the MMU instead
+ *   while paging is enabled.
+ */
+uint32_t fetch_instruction(CPU *cpu);
 
-int compile_c_file(const char *c_file);
-
+/**
+ * Fetches, decodes and executes a single instruction.
+ * - Does nothing if the CPU is already halted.
+ */
+void step_cpu(CPU *cpu);
 
 #endif // CPU_H
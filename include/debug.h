@@ -32,4 +32,30 @@ void display_memory_state(const CPU *cpu, uint32_t start, uint32_t end, char for
  */
 void display_instruction_debug(const Instruction *instruction);
 
+/**
+ * Returns the assembly mnemonic of an opcode.
+ * @param opcode - Opcode value.
+ * @return Mnemonic, or NULL if the opcode is not defined.
+ */
+const char *opcode_name(uint32_t opcode);
+
+/**
+ * Returns the operand kinds of an opcode, one character per operand:
+ * R register, V vector register, F floating-point register, I immediate,
+ * S signed immediate, M [address], and L branch target, an address that
+ * is encoded as an offset filling all three fields.
+ * @param opcode - Opcode value.
+ * @return Kind string, empty for opcodes without operands.
+ */
+const char *opcode_operands(uint32_t opcode);
+
+/**
+ * Disassembles a 32-bit binary instruction into assembly text.
+ * @param raw - The 32-bit binary instruction, or a compressed one expanded.
+ * @param address - Address of the instruction, to resolve branch targets.
+ * @param buffer - Output buffer for the text.
+ * @param size - Size of the output buffer.
+ */
+void disassemble_instruction(uint32_t raw, uint32_t address, char *buffer, size_t size);
+
 #endif // DEBUG_H
@@ -0,0 +1,57 @@
+#ifndef DECODE_FILE_H
+#define DECODE_FILE_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// A decode file keeps the decode cache of an image between runs, so a new
+// process starts with every instruction an earlier run fetched already
+// decoded. It holds a header followed by the decoded and decoded_length
+// arrays exactly as the CPU stores them, and is mapped rather than parsed.
+// The header names the image by size and image_hash; a file made for any
+// other image, or by a build with a different memory size, is ignored and
+// rewritten. Saving keeps only entries whose instruction word still matches
+// the image as loaded, so code the program rewrote is never carried over.
+
+#define DECODE_FILE_VERSION 1
+
+// State of the decode file for one run
+typedef struct {
+    const char *path;
+    uint64_t image_hash;
+    uint32_t image_size;
+    uint8_t image[MEMORY_SIZE];     // Memory as loaded
+    uint32_t loaded;                // Entries installed from the file
+    uint32_t saved;                 // Entries written back, 0 if unchanged
+} DecodeFile;
+
+// Function Prototypes
+
+/**
+ * Maps a decode file and, if it was made for the loaded image, installs its
+ * entries in the CPU's decode cache. A missing or mismatched file is not an
+ * error; the run starts cold and save_decode_file replaces it.
+ * @param file - Decode file state to initialize.
+ * @param path - Path of the decode file.
+ * @param cpu - CPU with the image loaded.
+ * @param image_size - Size of the loaded image in bytes.
+ */
+void open_decode_file(DecodeFile *file, const char *path, CPU *cpu, uint32_t image_size);
+
+/**
+ * Writes the CPU's decode cache back to the decode file, dropping entries
+ * for instruction words changed since the image was loaded. The file is
+ * replaced atomically, and left alone if the run decoded nothing new.
+ * @param file - Decode file state from open_decode_file.
+ * @param cpu - CPU after the run.
+ * @return 0 on success, -1 on error.
+ */
+int save_decode_file(DecodeFile *file, const CPU *cpu);
+
+/**
+ * Prints how many entries were loaded and saved.
+ * @param file - Decode file state.
+ */
+void display_decode_file(const DecodeFile *file);
+
+#endif // DECODE_FILE_H
@@ -0,0 +1,115 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "cpu.h"
+#include "mmio.h"
+
+// Standard device map in the data page, one IO page each
+#define TIMER_DEVICE_BASE 0xA0
+#define RNG_DEVICE_BASE 0xB0
+#define BLOCK_DEVICE_BASE 0xC0
+#define CONSOLE_DEVICE_BASE 0xD0
+
+// Timer registers, driving the interrupt controller's timers
+#define TIMER_REG_SELECT 0x0    // Timer addressed by the other registers
+#define TIMER_REG_PERIOD 0x4    // Write arms the selected timer (0 disarms); read returns the period
+#define TIMER_REG_LINE 0x8      // Interrupt line used by the next PERIOD write
+#define TIMER_REG_FIRED 0xC     // Read: expiries of the selected timer (low 32 bits)
+
+// Random number generator registers
+#define RNG_REG_VALUE 0x0       // Read: next 32-bit value
+#define RNG_REG_SEED 0x4        // Write: reseed
+
+// Block device registers; transfers complete synchronously
+#define BLOCK_REG_SECTOR 0x0
+#define BLOCK_REG_ADDRESS 0x4   // Guest buffer of BLOCK_SECTOR_SIZE bytes
+#define BLOCK_REG_COMMAND 0x8   // Write BLOCK_READ or BLOCK_WRITE
+#define BLOCK_REG_STATUS 0xC    // Read: 0 after success, 1 after a failed transfer
+#define BLOCK_SECTOR_SIZE 64
+#define BLOCK_READ 1
+#define BLOCK_WRITE 2
+
+// Console registers; output is buffered and written in large batches
+#define CONSOLE_REG_DATA 0x0    // Write: append the low byte
+#define CONSOLE_REG_NUMBER 0x4  // Write: append the signed decimal value
+#define CONSOLE_REG_FLUSH 0x8   // Write: flush the buffer now
+#define CONSOLE_REG_PENDING 0xC // Read: bytes waiting in the buffer
+#define CONSOLE_BUFFER_SIZE 65536
+
+#define RNG_DEFAULT_SEED 0x2545F4914F6CDD1DULL
+
+typedef struct {
+    uint32_t selected;
+    uint32_t line;
+} TimerDevice;
+
+typedef struct {
+    uint64_t state;
+} RngDevice;
+
+// A disk image accessed in BLOCK_SECTOR_SIZE sectors
+typedef struct {
+    FILE *file;
+    uint32_t sector;
+    uint32_t address;
+    uint32_t status;
+    uint64_t transfers;
+} BlockDevice;
+
+// Guest output, flushed with one write() when full, on FLUSH and at halt.
+// Each CPU owns its buffer and descriptor, so no locking is needed.
+typedef struct {
+    int fd;
+    bool close_fd;              // fd was opened for this console
+    uint32_t length;
+    uint64_t bytes;
+    uint64_t flushes;
+    char buffer[CONSOLE_BUFFER_SIZE];
+} ConsoleDevice;
+
+// The standard devices of an image run
+typedef struct {
+    MMIOBus bus;
+    TimerDevice timer;
+    RngDevice rng;
+    BlockDevice block;
+    ConsoleDevice console;
+} DeviceSet;
+
+// Function Prototypes
+
+/**
+ * Registers the timer, RNG, console and, if a disk image is given, the block
+ * device, then attaches the bus to the CPU. The timer needs cpu->interrupts.
+ * @param devices - Pointer to the DeviceSet structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param disk_file - Disk image for the block device, or NULL for none.
+ * @param console_file - File receiving console output, or NULL for stdout.
+ * @return 0 on success, -1 on failure.
+ */
+int init_devices(DeviceSet *devices, CPU *cpu, const char *disk_file, const char *console_file);
+
+/**
+ * Appends bytes to the console buffer, flushing first if they do not fit.
+ * @param console - Pointer to the ConsoleDevice structure.
+ * @param data - Bytes to append.
+ * @param length - Number of bytes, at most CONSOLE_BUFFER_SIZE.
+ */
+void append_console(ConsoleDevice *console, const char *data, uint32_t length);
+
+/**
+ * Writes out buffered console output.
+ * @param console - Pointer to the ConsoleDevice structure.
+ */
+void flush_console(ConsoleDevice *console);
+
+/**
+ * Flushes the console and closes the files opened for the devices.
+ * @param devices - Pointer to the DeviceSet structure.
+ */
+void close_devices(DeviceSet *devices);
+
+#endif // DEVICES_H
@@ -0,0 +1,57 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "instructions.h"
+
+// IEEE-754 single- and double-precision arithmetic on F0-F7. FPU_HOST runs
+// each operation on the host FPU and leaves its exception flags in the
+// host fenv; they are folded into cpu->fp_flags only when fpu_flags reads
+// them. FPU_SOFT uses softfloat.c instead, and FPU_CHECK runs both and
+// halts on the first result or flag that differs.
+//
+// The host flags belong to one CPU per thread at a time: the first host
+// operation of a CPU clears them, and flags another CPU left unread are
+// dropped. Host floating-point work between a guest operation and the read
+// (the --sample interval clock) can add a spurious FP_INEXACT.
+
+// Accrued exception flags read by FPFLAGS, in RISC-V fflags order
+typedef enum {
+    FP_INEXACT = 1 << 0,
+    FP_UNDERFLOW = 1 << 1,
+    FP_OVERFLOW = 1 << 2,
+    FP_DIVIDE_BY_ZERO = 1 << 3,
+    FP_INVALID = 1 << 4
+} FPUFlag;
+
+// Function Prototypes
+
+/**
+ * Executes one arithmetic, compare or convert FPU instruction in the
+ * CPU's FPU mode.
+ * @param cpu - CPU whose fp_flags receive the exception flags.
+ * @param opcode - An FPU opcode other than the loads, stores and FPFLAGS.
+ * @param a - First source: FP register bits, or an integer for FCVTSW/FCVTDW.
+ * @param b - Second source FP register bits.
+ * @param c - Addend for FMADDS/FMADDD (the destination's old value).
+ * @return Result bits; single results use the low 32 bits, compares and
+ *         conversions to integer return a sign-extended int32.
+ */
+uint64_t fpu_execute(CPU *cpu, Opcode opcode, uint64_t a, uint64_t b, uint64_t c);
+
+/**
+ * Folds any pending host flags into cpu->fp_flags and returns them.
+ * @param cpu - CPU to read.
+ * @return Accrued FPUFlag bits.
+ */
+uint32_t fpu_flags(CPU *cpu);
+
+/**
+ * Replaces the accrued flags, discarding any pending host flags.
+ * @param cpu - CPU to update.
+ * @param flags - New FPUFlag bits.
+ */
+void fpu_set_flags(CPU *cpu, uint32_t flags);
+
+#endif // FPU_H
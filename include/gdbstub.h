@@ -0,0 +1,69 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "cpu.h"
+#include "breakpoints.h"
+
+#define GDB_PACKET_SIZE 4096
+#define GDB_REGISTER_COUNT (REGISTER_COUNT + 3)     // R0-R7, SP, PC, flags
+
+// Execution state shared by the packet thread and the execution thread
+typedef enum {
+    GDB_STOPPED,        // Execution thread parked; the packet thread owns the CPU
+    GDB_RUNNING,        // Execution thread owns the CPU
+    GDB_DETACHED,       // Run freely to completion
+    GDB_KILLED          // Stop serving immediately
+} GDBState;
+
+// Remote serial protocol server for one debugger connection
+typedef struct {
+    CPU *cpu;
+    int listen_fd;
+    int client_fd;
+    int wake_pipe[2];           // Execution thread -> packet thread stop notifications
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    GDBState state;
+    bool single_step;           // Resume request is a single step
+    atomic_bool interrupt;      // Ctrl-C from the debugger
+    int stop_signal;            // Signal reported at the last stop, 0 if the program exited
+    uint32_t watch_address;     // Data address of the watchpoint hit, if any
+    bool watch_hit;
+
+    // Only modified while the execution thread is parked
+    BreakpointEngine breakpoints;
+} GDBStub;
+
+// Function Prototypes
+
+/**
+ * Listens on a TCP port of the loopback interface, or on a Unix socket when
+ * the address has the form "unix:/path", and waits for the debugger.
+ * @param stub - Pointer to the GDBStub structure.
+ * @param cpu - CPU to debug; it starts stopped.
+ * @param address - Port number or "unix:/path".
+ * @return 0 once a debugger is connected, -1 on failure.
+ */
+int start_gdb_stub(GDBStub *stub, CPU *cpu, const char *address);
+
+/**
+ * Runs the execution side on the calling thread: executes whenever the
+ * debugger resumes the CPU and returns when it detaches, kills the target or
+ * the program halts.
+ * @param stub - Pointer to the GDBStub structure.
+ */
+void gdb_serve(GDBStub *stub);
+
+/**
+ * Joins the packet thread and closes the sockets.
+ * @param stub - Pointer to the GDBStub structure.
+ */
+void stop_gdb_stub(GDBStub *stub);
+
+#endif // GDBSTUB_H
@@ -0,0 +1,62 @@
+#ifndef HOSTCALLS_H
+#define HOSTCALLS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+#include "devices.h"
+
+// SYSCALL n: arguments in R1-R3, result in R1
+typedef enum {
+    SYS_MEMCPY = 0,     // R1 = dst, R2 = src, R3 = length; returns dst
+    SYS_MEMSET = 1,     // R1 = dst, R2 = byte, R3 = length; returns dst
+    SYS_STRLEN = 2,     // R1 = string; returns its length
+    SYS_MALLOC = 3,     // R1 = size; returns the block address or 0
+    SYS_FREE = 4,       // R1 = block address or 0
+    SYS_PRINT = 5,      // R1 = format (%d %u %x %c %s %%), R2-R3 = arguments; returns bytes printed
+    SYSCALL_COUNT
+} Syscall;
+
+// Heap blocks are a word header (payload size | HEAP_USED) followed by the
+// payload; blocks tile [heap_start, heap_end) and live in guest memory, so
+// the allocator state is checkpointed and traced with the rest of memory.
+#define HEAP_USED 1u
+#define HEAP_ALIGN 4
+
+// Runtime routines run natively for SYSCALL
+typedef struct HostCalls {
+    uint32_t heap_start;
+    uint32_t heap_end;
+    ConsoleDevice *console;     // SYS_PRINT target, or NULL for stdout
+    bool quiet;                 // Drop SYS_PRINT output, e.g. while re-executing sampled intervals
+    uint64_t calls[SYSCALL_COUNT];
+} HostCalls;
+
+// Function Prototypes
+
+/**
+ * Initializes the host-call table, writes an empty heap into guest memory
+ * and attaches the table to the CPU.
+ * @param calls - Pointer to the HostCalls structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param image_end - First byte after the loaded image; the heap starts at
+ *                    HEAP_START or after the image, whichever is higher.
+ * @param console - Console receiving SYS_PRINT output, or NULL for stdout.
+ * @return 0 on success, -1 if no room is left for a heap.
+ */
+int init_host_calls(HostCalls *calls, CPU *cpu, uint32_t image_end, ConsoleDevice *console);
+
+/**
+ * Executes a host call; invalid arguments halt the CPU.
+ * @param cpu - Pointer to the CPU structure.
+ * @param number - Syscall number.
+ */
+void host_call(CPU *cpu, uint32_t number);
+
+/**
+ * Prints how often each host call ran; nothing if none did.
+ * @param calls - Pointer to the HostCalls structure.
+ */
+void display_host_calls(const HostCalls *calls);
+
+#endif // HOSTCALLS_H
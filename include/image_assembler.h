@@ -0,0 +1,53 @@
+#ifndef IMAGE_ASSEMBLER_H
+#define IMAGE_ASSEMBLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "link_optimizer.h"
+
+// Multi-pass assembler producing flat images for the current instruction
+// encoding. Operands use the disassembler's syntax:
+//
+//     ; comment (or #)
+//     .org 0x20            set the location counter (starts at CODE_START)
+//     .word 5, loop        emit 32-bit words; labels may be used as values
+//     .quad -1             emit 64-bit words, the data words of cpu_simulator64
+//     loop:                define a label at the location counter
+//     VADD V0, V1, V2      R registers, V vector registers, F FP registers,
+//     LOAD R1, [0x20]      immediates and [address] as numbers or labels
+//     ADDI R1, R1, -1      signed byte immediates
+//     BNZ loop             branch targets as addresses; offsets are computed
+//
+// Omitted trailing operands are 0, so "TLBFLUSH" flushes the whole TLB.
+// Instructions must start word-aligned. With compression on, consecutive
+// instructions that have compressed forms (compressed.h) are packed in
+// pairs; passes repeat until no label moves. The optional post-link pass
+// (link_optimizer.h) rewrites the laid-out source, which is then laid out
+// again.
+
+#define ASM_MAX_LABELS 2048
+#define ASM_MAX_LABEL_LENGTH 32
+
+// Function Prototypes
+
+/**
+ * Assembles a source file into a flat binary image loaded at address 0.
+ * @param source_file - Assembly source.
+ * @param image_file - Image to write.
+ * @param compress - Pack eligible instruction pairs into compressed form.
+ * @param optimize - Receives the post-link pass statistics; NULL skips the pass.
+ * @return 0 on success, -1 after reporting the first error.
+ */
+int assemble_image(const char *source_file, const char *image_file, bool compress, LinkOptStats *optimize);
+
+/**
+ * Assembles a source file into memory, as load_image would load its image.
+ * @param source_file - Assembly source.
+ * @param compress - Pack eligible instruction pairs into compressed form.
+ * @param optimize - Receives the post-link pass statistics; NULL skips the pass.
+ * @param memory - MEMORY_SIZE bytes receiving the image from address 0.
+ * @return Image size in bytes, or -1 after reporting the first error.
+ */
+int assemble_to_memory(const char *source_file, bool compress, LinkOptStats *optimize, uint8_t *memory);
+
+#endif // IMAGE_ASSEMBLER_H
@@ -2,9 +2,11 @@
 #define INSTRUCTIONS_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "cpu.h"
 #include "alu.h"
 #include "memory.h"
+#include "mmu.h"
 
 // Define opcodes for the instruction set
 typedef enum {
@@ -33,7 +35,72 @@ typedef enum {
     RET,       // 0x16
     PUSH,      // 0x17
     POP,       // 0x18
-    HALT       // 0x19
+    HALT,      // 0x19
+    RDPERF,    // 0x1A  RDPERF rd, counter, half: rd = 32-bit half of a PerfCounter
+    EI,        // 0x1B  Enable interrupts
+    DI,        // 0x1C  Disable interrupts
+    IRET,      // 0x1D  Pop PC and flags pushed on interrupt entry
+    TIMER,     // 0x1E  TIMER t, rs, line: raise line every rs instructions (0 disarms)
+    SYSCALL,   // 0x1F  SYSCALL n: host call n with arguments in R1-R3, result in R1
+    MEMCPY,    // 0x20  MEMCPY rd, rs, rn: copy rn bytes from [rs] to [rd]; ranges may overlap
+    MEMSET,    // 0x21  MEMSET rd, rv, rn: fill rn bytes at [rd] with the low byte of rv
+    MEMCMP,    // 0x22  MEMCMP ra, rb, rn: compare rn bytes; sets ZERO/EQUAL, LESS or GREATER
+    MMUSET,    // 0x23  MMUSET rs, n: write rs to MMU register n
+    MMUGET,    // 0x24  MMUGET rd, n: read MMU register n into rd
+    TLBFLUSH,  // 0x25  TLBFLUSH rs, page: flush the TLB, or only the page holding [rs] if page is 1
+    VLOAD,     // 0x26  VLOAD vd, rs: load 16 bytes at [rs] into vd
+    VSTORE,    // 0x27  VSTORE vs, rd: store vs to the 16 bytes at [rd]
+    VSPLAT,    // 0x28  VSPLAT vd, rs: copy rs into every lane of vd
+    VADD,      // 0x29  VADD vd, va, vb: lane-wise, wrapping
+    VSUB,      // 0x2A
+    VMUL,      // 0x2B  Low 32 bits of each product
+    VAND,      // 0x2C
+    VOR,       // 0x2D
+    VXOR,      // 0x2E
+    VCMPEQ,    // 0x2F  VCMPEQ vd, va, vb: lane = -1 where va == vb, else 0
+    VCMPGT,    // 0x30  Signed va > vb
+    VSHUF,     // 0x31  VSHUF vd, va, sel: lane i = va lane (sel >> 2i) & 3
+    VREDUCE,   // 0x32  VREDUCE rd, va: rd = wrapping sum of the lanes of va
+    CLZ,       // 0x33  CLZ rd, rs: leading zero bits of rs (WORD_SIZE if rs is 0)
+    CTZ,       // 0x34  CTZ rd, rs: trailing zero bits of rs (WORD_SIZE if rs is 0)
+    POPCNT,    // 0x35  POPCNT rd, rs: set bits of rs
+    ROL,       // 0x36  ROL rd, rs, n: rotate left by n modulo WORD_SIZE
+    ROR,       // 0x37  ROR rd, rs, n: rotate right by n modulo WORD_SIZE
+    BEXT,      // 0x38  BEXT rd, rs, rc: field of rs at start rc[7:0], length rc[15:8]
+    BINS,      // 0x39  BINS rd, rs, rc: replace that field of rd with the low bits of rs
+    BREV,      // 0x3A  BREV rd, rs: reverse the bit order
+    BSWAP,     // 0x3B  BSWAP rd, rs: reverse the byte order
+    FLDS,      // 0x3C  FLDS fd, rs: load the single at [rs] into fd
+    FLDD,      // 0x3D  FLDD fd, rs: load the double at [rs] into fd
+    FSTS,      // 0x3E  FSTS fs, rd: store the single in fs to [rd]
+    FSTD,      // 0x3F  FSTD fs, rd: store the double in fs to [rd]
+    FADDS,     // 0x40  FADDS fd, fa, fb: single-precision fd = fa + fb
+    FSUBS,     // 0x41
+    FMULS,     // 0x42
+    FDIVS,     // 0x43
+    FSQRTS,    // 0x44  FSQRTS fd, fa
+    FMADDS,    // 0x45  FMADDS fd, fa, fb: fd = fa * fb + fd, rounded once
+    FCMPS,     // 0x46  FCMPS rd, fa, fb: rd = -1, 0 or 1, or 2 if unordered; sets EQUAL/LESS/GREATER
+    FADDD,     // 0x47  Double-precision forms of 0x40-0x46
+    FSUBD,     // 0x48
+    FMULD,     // 0x49
+    FDIVD,     // 0x4A
+    FSQRTD,    // 0x4B
+    FMADDD,    // 0x4C
+    FCMPD,     // 0x4D
+    FCVTSW,    // 0x4E  FCVTSW fd, rs: single from a signed integer
+    FCVTDW,    // 0x4F  FCVTDW fd, rs: double from a signed integer
+    FCVTWS,    // 0x50  FCVTWS rd, fs: integer from a single, truncated and saturated
+    FCVTWD,    // 0x51  FCVTWD rd, fs: integer from a double, truncated and saturated
+    FCVTSD,    // 0x52  FCVTSD fd, fs: single from a double
+    FCVTDS,    // 0x53  FCVTDS fd, fs: double from a single
+    FPFLAGS,   // 0x54  FPFLAGS rd, clear: rd = accrued FPUFlag bits, cleared if clear is 1
+    MOV,       // 0x55  MOV rd, rs: rd = rs; flags unchanged
+    ADDI,      // 0x56  ADDI rd, rs, imm: rd = rs + imm, a signed byte; flags as ADD
+    BRA,       // 0x57  BRA target: branch by a signed 24-bit byte offset from this instruction
+    BZ,        // 0x58  BZ target: BRA if the zero flag is set
+    BNZ,       // 0x59  BNZ target: BRA if the zero flag is clear
+    NOP        // 0x5A
 } Opcode;
 
 // Define instruction structure
@@ -44,19 +111,156 @@ typedef struct {
 
 // Function Prototypes
 
+/**
+ * Returns the byte offset of a BRA, BZ or BNZ instruction, which spans all
+ * three operand fields.
+ * @param instruction - Decoded branch.
+ * @return Signed offset from the branch's own address.
+ */
+static inline int32_t branch_offset(Instruction instruction) {
+    uint32_t field = instruction.operands[0] << 16 | instruction.operands[1] << 8 | instruction.operands[2];
+    return (int32_t)(field ^ 0x800000) - 0x800000;     // Sign-extend 24 bits
+}
+
 /**
  * Decodes a 32-bit binary instruction into an Instruction struct.
  * @param raw - The 32-bit binary instruction.
  * @return Decoded instruction.
  */
-// Removed function declaration
+Instruction decode_instruction(uint32_t raw);
+
+/**
+ * Encodes an opcode and three 8-bit operands into a 32-bit binary instruction.
+ * @param opcode - Operation code.
+ * @param a - First operand (usually the destination register).
+ * @param b - Second operand.
+ * @param c - Third operand.
+ * @return Encoded instruction.
+ */
+uint32_t encode_instruction(Opcode opcode, uint8_t a, uint8_t b, uint8_t c);
+
+/**
+ * Reads a word from RAM, or from the device mapped at the address. With
+ * paging enabled the address is virtual and must be readable.
+ * @param cpu - Pointer to the CPU structure.
+ * Words are WORD_SIZE bits; devices are 32 bits wide and read zero-extended.
+ * @param address - Address to read from.
+ * @return The word read, or 0 after a page fault.
+ */
+word_t load_word(CPU *cpu, uint32_t address);
+
+/**
+ * Decodes the instruction at a physical address on a decode cache miss,
+ * filling the slots of both instructions of a compressed pair.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Physical address of the instruction.
+ * @param length - Receives 2 or 4, or 0 if no instruction starts at the
+ *                 address: it is odd, outside memory, or inside a 32-bit one.
+ * @return The 32-bit form of the instruction, or 0.
+ */
+uint32_t fill_decode_cache(CPU *cpu, uint32_t address, uint32_t *length);
 
 /**
- * Executes a given instruction on the CPU.
+ * Returns the 32-bit form of the instruction at a physical address,
+ * decoding it only if its decode cache slot is empty.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Physical address of the instruction.
+ * @param length - Receives 2 or 4, or 0 if no instruction starts there.
+ * @return The 32-bit form of the instruction, or 0.
+ */
+static inline uint32_t decode_cached(CPU *cpu, uint32_t address, uint32_t *length) {
+    uint32_t slot = address / 2;
+    if (slot < INSTRUCTION_SLOTS && (address & 1) == 0 && cpu->decoded_length[slot]) {
+        *length = cpu->decoded_length[slot];
+        return cpu->decoded[slot];
+    }
+    return fill_decode_cache(cpu, address, length);
+}
+
+/**
+ * Empties the decode cache slots of every instruction word overlapping a
+ * physical range. record_store calls it; code writing memory without
+ * record_store must call it or flush_decode_cache itself.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - First byte written.
+ * @param size - Number of bytes written.
+ */
+void invalidate_decoded(CPU *cpu, uint32_t address, uint32_t size);
+
+/**
+ * Empties the whole decode cache, e.g. after loading a new memory image.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void flush_decode_cache(CPU *cpu);
+
+/**
+ * Fetches an instruction through the MMU and the decode cache. The aligned
+ * word holding it is translated, so an instruction never straddles pages.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Virtual address of the instruction; must be executable.
+ * @param length - Receives the instruction's length, or 0 if it is
+ *                 misaligned or faulted.
+ * @return The 32-bit form of the instruction, or 0.
+ */
+uint32_t fetch_translated(CPU *cpu, uint32_t address, uint32_t *length);
+
+/**
+ * Writes a word to RAM, or to the device mapped at the address, and records
+ * the RAM range for tracing and watchpoints; every guest-visible store goes
+ * through it. With paging enabled the address is virtual, and a faulting
+ * store writes nothing.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Address to write to.
+ * @param value - The word to write; devices receive its low 32 bits.
+ */
+void store_word(CPU *cpu, uint32_t address, word_t value);
+
+/**
+ * Records the RAM range written by the current step for tracing, time travel
+ * and watchpoints. Used by store_word and by operations writing whole ranges.
+ * Several stores in one step widen the range to cover them all.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - First physical byte written.
+ * @param size - Number of bytes written.
+ */
+void record_store(CPU *cpu, uint32_t address, uint32_t size);
+
+/**
+ * Validates a byte range for a bulk operation: it must lie inside memory and
+ * touch no memory-mapped device. Reports the error and halts the CPU otherwise.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - First byte.
+ * @param length - Number of bytes; 0 is always valid.
+ * @param operation - Name used in the error message.
+ * @return True if the range is valid.
+ */
+bool check_bulk_range(CPU *cpu, uint32_t address, uint32_t length, const char *operation);
+
+/**
+ * Returns the operand fields an opcode's execution uses as general register
+ * numbers. opcode_operands (debug.h) must declare each of them 'R'; the
+ * verifier checks that before trusting its register validation.
+ * @param opcode - Opcode value.
+ * @return Bit i set for operand field i.
+ */
+uint32_t register_fields(Opcode opcode);
+
+/**
+ * Executes a given instruction on the CPU, halting it if a register
+ * operand is outside the register file.
  * @param cpu - Pointer to the CPU structure.
  * @param instruction - Instruction to execute.
  */
-// Removed function declaration
+void execute_instruction(CPU *cpu, Instruction instruction);
+
+/**
+ * Executes an instruction without checking its register operands or
+ * tracing it. Only for instructions the load-time verifier (verifier.h)
+ * has accepted.
+ * @param cpu - Pointer to the CPU structure.
+ * @param instruction - Verified instruction to execute.
+ */
+void execute_verified(CPU *cpu, Instruction instruction);
 
 /**
  * Displays the decoded instruction for debugging purposes.
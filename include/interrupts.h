@@ -0,0 +1,135 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+#define INTERRUPT_LINES 8
+#define INTERRUPT_VECTOR_BASE 0xE0      // Handler addresses for lines 0-7, one word each
+#define TIMER_COUNT 4
+#define MAX_EVENTS 64
+#define NO_EVENT UINT64_MAX
+
+typedef struct InterruptController InterruptController;
+
+/**
+ * Device callback run when a scheduled event comes due.
+ * @param pic - Controller the event was scheduled on.
+ * @param context - Device state given to schedule_event.
+ */
+typedef void (*EventHandler)(InterruptController *pic, void *context);
+
+// An event due once the CPU has retired `when` instructions
+typedef struct {
+    uint64_t when;
+    uint64_t sequence;          // Keeps events due at the same time in FIFO order
+    EventHandler handler;
+    void *context;
+} Event;
+
+// Periodic timer that raises an interrupt line
+typedef struct {
+    uint32_t period;            // Instructions between interrupts, 0 when disarmed
+    int line;
+    uint64_t deadline;          // Next expiry; periods are added to it so they never drift
+    uint64_t fired;
+} Timer;
+
+// Interrupt lines, their pending state and the device event queue.
+// The CPU only compares its retired-instruction count with next_event, so
+// nothing here is polled between events.
+struct InterruptController {
+    CPU *cpu;
+    uint32_t pending;           // One bit per line
+    uint64_t delivered[INTERRUPT_LINES];
+
+    Event events[MAX_EVENTS];   // Min-heap ordered by when, then sequence
+    int event_count;
+    uint64_t sequence;
+
+    Timer timers[TIMER_COUNT];
+};
+
+// Function Prototypes
+
+/**
+ * Initializes a controller with no pending interrupts or events and
+ * attaches it to the CPU.
+ * @param pic - Pointer to the InterruptController structure.
+ * @param cpu - CPU whose interrupts it delivers.
+ */
+void init_interrupts(InterruptController *pic, CPU *cpu);
+
+/**
+ * Schedules a device event.
+ * @param pic - Pointer to the InterruptController structure.
+ * @param when - Retired-instruction count at which the event is due.
+ * @param handler - Callback to run.
+ * @param context - Passed to the callback.
+ * @return 0 on success, -1 if the queue is full.
+ */
+int schedule_event(InterruptController *pic, uint64_t when, EventHandler handler, void *context);
+
+/**
+ * Removes every scheduled event of a device.
+ * @param pic - Pointer to the InterruptController structure.
+ * @param context - Device state the events were scheduled with.
+ */
+void cancel_events(InterruptController *pic, void *context);
+
+/**
+ * Marks an interrupt line pending; it is delivered once interrupts are enabled.
+ * @param pic - Pointer to the InterruptController structure.
+ * @param line - Interrupt line, 0 (highest priority) to INTERRUPT_LINES - 1.
+ */
+void raise_interrupt(InterruptController *pic, int line);
+
+/**
+ * Arms a timer to raise a line every period instructions, or disarms it.
+ * @param pic - Pointer to the InterruptController structure.
+ * @param timer - Timer number.
+ * @param period - Instructions between interrupts; 0 disarms the timer.
+ * @param line - Interrupt line to raise.
+ * @return 0 on success, -1 for an invalid timer or line.
+ */
+int set_timer(InterruptController *pic, int timer, uint32_t period, int line);
+
+/**
+ * Recomputes the CPU's next_event after the controller or FLAG_INTERRUPT changed.
+ * @param pic - Pointer to the InterruptController structure.
+ */
+void update_next_event(InterruptController *pic);
+
+/**
+ * Runs every due event and delivers the highest-priority pending interrupt if
+ * interrupts are enabled. Delivery pushes the flags and PC, clears
+ * FLAG_INTERRUPT and jumps to the line's vector; it takes the place of one
+ * instruction. Called by step_cpu when next_event comes due.
+ * @param cpu - Pointer to the CPU structure.
+ * @return True if an interrupt was delivered.
+ */
+bool service_interrupts(CPU *cpu);
+
+/**
+ * Packs the CPU flags into a word, as pushed on interrupt entry.
+ * @param cpu - Pointer to the CPU structure.
+ * @return One bit per CPUFlags entry.
+ */
+uint32_t pack_flags(const CPU *cpu);
+
+/**
+ * Restores the CPU flags from a word made by pack_flags.
+ * @param cpu - Pointer to the CPU structure.
+ * @param value - Packed flags.
+ */
+void unpack_flags(CPU *cpu, uint32_t value);
+
+/**
+ * Prints per-line delivery counts and timer state; nothing if no interrupt
+ * or timer was ever used.
+ * @param pic - Pointer to the InterruptController structure.
+ */
+void display_interrupts(const InterruptController *pic);
+
+#endif // INTERRUPTS_H
@@ -0,0 +1,337 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "word.h"
+
+// SSA intermediate representation of the C compiler (compiler.h). Every
+// instruction defines at most one value, named by its index in the
+// function's instruction array. Blocks list phis first and end in exactly
+// one JUMP, BRANCH or RET; phi operands follow the order of the block's
+// predecessors. Folding and trivial-phi removal never rewrite users in
+// place: they point the old instruction's replaced field at the new value,
+// and operands are read through ir_resolve.
+
+#define IR_NONE (-1)
+#define IR_NAME_LENGTH 32           // Labels, as limited by the image assembler
+#define IR_MAX_ARGS 5               // Call arguments, passed in R1-R5
+#define IR_ALLOCATABLE 6            // R0-R5 hold values; R6 and R7 are code generator scratch
+#define IR_DATA_PAGE_END 0xA0       // Data page below the device windows and interrupt vectors
+#define IR_POOL_SIZE (IR_DATA_PAGE_END / 4)
+
+typedef enum {
+    // Values without operands; the constants and parameters live in the entry block
+    IR_CONST,       // imm
+    IR_ADDRESS,     // Address of symbol
+    IR_PARAM,       // Argument imm, arriving in R(imm + 1)
+    IR_PHI,         // args, one per predecessor
+
+    // Binary operations on a and b
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,         // Halts on a zero divisor, so never removed as dead
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_EQ,          // Comparisons give 1 or 0
+    IR_NE,
+    IR_LT,
+    IR_GT,
+    IR_LE,
+    IR_GE,
+
+    // Unary operations on a, some with an immediate
+    IR_NOT,
+    IR_ADDI,        // a + imm, imm a signed byte
+    IR_SHL,         // Shifts by imm
+    IR_SHR,         // Logical
+    IR_SAR,         // Arithmetic
+
+    // Memory
+    IR_LOAD,        // size bytes at address a, zero-extended
+    IR_STORE,       // Low size bytes of b to address a
+    IR_LOADG,       // Data page word of symbol
+    IR_STOREG,      // a to the data page word of symbol
+
+    // Calls; results arrive in R1
+    IR_CALL,        // symbol with args
+    IR_SYSCALL,     // Host call imm with args
+
+    // Terminators
+    IR_JUMP,        // To target[0]
+    IR_BRANCH,      // To target[0] if a is nonzero, else target[1]
+    IR_RET          // Return a, or nothing if a is IR_NONE
+} IROp;
+
+typedef struct {
+    IROp op;
+    int block;
+    int a, b;               // Operand values, or IR_NONE
+    sword_t imm;
+    int size;               // LOAD and STORE width: WORD_BYTES or 1
+    int symbol;             // ADDRESS, LOADG, STOREG and CALL
+    int *args;              // PHI operands, CALL and SYSCALL arguments
+    int arg_count;
+    int target[2];          // JUMP and BRANCH successors
+    int replaced;           // Value this one was replaced by, or IR_NONE
+    bool dead;              // Removed from its block
+} IRInstr;
+
+typedef struct {
+    int *instrs;
+    int count;
+    int capacity;
+    int *preds;
+    int pred_count;
+    int pred_capacity;
+    bool sealed;            // All predecessors known (SSA construction)
+} IRBlock;
+
+typedef struct {
+    int symbol;             // The function's IRSymbol
+    IRInstr *instrs;
+    int instr_count;
+    int instr_capacity;
+    IRBlock *blocks;        // Block 0 is the entry
+    int block_count;
+    int block_capacity;
+    int param_count;
+    bool frame;             // Allocates a heap frame, so it cannot make tail calls
+} IRFunction;
+
+typedef struct {
+    char name[IR_NAME_LENGTH];
+    bool function;
+    bool defined;           // Functions: has a body
+    bool direct;            // Data: one word in the data page, reached with LOAD/STORE
+    uint32_t size;          // Data: bytes
+    uint8_t *data;          // Data: initial bytes, or NULL for zeros
+} IRSymbol;
+
+// Data page word shared by all functions: a constant or a symbol's address
+typedef struct {
+    bool address;
+    sword_t value;          // Number, or symbol index if address
+} IRPoolEntry;
+
+typedef struct {
+    IRSymbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    uint32_t direct_bytes;  // Scratch word plus direct globals, from address 0
+    IRPoolEntry pool[IR_POOL_SIZE];
+    int pool_count;
+    int spill_slots;        // Most slots any function spills to; functions share them
+    int labels;             // Block labels issued so far
+} IRProgram;
+
+// Function Prototypes
+
+/**
+ * Initializes an empty program whose data page holds only the scratch word.
+ * @param program - Program to initialize.
+ */
+void ir_init_program(IRProgram *program);
+
+/**
+ * Frees a program's symbols.
+ * @param program - Program to free.
+ */
+void ir_free_program(IRProgram *program);
+
+/**
+ * Finds a symbol by name.
+ * @param program - Program to search.
+ * @param name - Symbol name.
+ * @return Its index, or IR_NONE.
+ */
+int ir_find_symbol(const IRProgram *program, const char *name);
+
+/**
+ * Adds a symbol; the caller fills in its data fields.
+ * @param program - Program to extend.
+ * @param name - Symbol name, shorter than IR_NAME_LENGTH.
+ * @param function - True for a function.
+ * @return Its index, or IR_NONE if out of memory.
+ */
+int ir_add_symbol(IRProgram *program, const char *name, bool function);
+
+/**
+ * Initializes a function with an empty, sealed entry block.
+ * @param fn - Function to initialize.
+ * @param symbol - The function's symbol.
+ */
+void ir_init_function(IRFunction *fn, int symbol);
+
+/**
+ * Frees a function's instructions and blocks.
+ * @param fn - Function to free.
+ */
+void ir_free_function(IRFunction *fn);
+
+/**
+ * Adds an empty, unsealed block.
+ * @param fn - Function to extend.
+ * @return The block's index.
+ */
+int ir_new_block(IRFunction *fn);
+
+/**
+ * Appends an instruction to a block. Appending to a block that already
+ * ends in a terminator is ignored and returns IR_NONE.
+ * @param fn - Function to extend.
+ * @param block - Block to append to.
+ * @param op - Operation.
+ * @param a - First operand, or IR_NONE.
+ * @param b - Second operand, or IR_NONE.
+ * @return The new value.
+ */
+int ir_append(IRFunction *fn, int block, IROp op, int a, int b);
+
+/**
+ * Appends a binary or unary operation, folding constant operands and
+ * simplifying identities such as x + 0.
+ * @param fn - Function to extend.
+ * @param block - Block to append to.
+ * @param op - IR_ADD to IR_GE, IR_NOT, or a shift or IR_ADDI with b unused.
+ * @param a - First operand.
+ * @param b - Second operand, or IR_NONE.
+ * @param imm - Immediate of IR_ADDI and the shifts.
+ * @return The value, which may be an existing one.
+ */
+int ir_operation(IRFunction *fn, int block, IROp op, int a, int b, sword_t imm);
+
+/**
+ * Returns the function's constant with a value, creating it in the entry
+ * block on first use.
+ * @param fn - Function.
+ * @param value - Constant.
+ * @return The constant's value.
+ */
+int ir_const(IRFunction *fn, sword_t value);
+
+/**
+ * Returns the function's value holding a symbol's address.
+ * @param fn - Function.
+ * @param symbol - Symbol index.
+ * @return The address value.
+ */
+int ir_address(IRFunction *fn, int symbol);
+
+/**
+ * Adds an operand-less phi at the start of a block.
+ * @param fn - Function.
+ * @param block - Block receiving the phi.
+ * @return The phi.
+ */
+int ir_phi(IRFunction *fn, int block);
+
+/**
+ * Appends an operand to a phi or call.
+ * @param fn - Function.
+ * @param value - The phi or call.
+ * @param operand - Operand to append.
+ */
+void ir_add_arg(IRFunction *fn, int value, int operand);
+
+/**
+ * Ends a block with a jump.
+ * @param fn - Function.
+ * @param block - Block to end.
+ * @param target - Successor.
+ */
+void ir_jump(IRFunction *fn, int block, int target);
+
+/**
+ * Ends a block with a conditional branch.
+ * @param fn - Function.
+ * @param block - Block to end.
+ * @param condition - Value tested against zero.
+ * @param if_true - Successor if it is nonzero.
+ * @param if_false - Successor if it is zero.
+ */
+void ir_branch(IRFunction *fn, int block, int condition, int if_true, int if_false);
+
+/**
+ * Tests whether a block already ends in a terminator.
+ * @param fn - Function.
+ * @param block - Block to test.
+ * @return True if it does.
+ */
+bool ir_terminated(const IRFunction *fn, int block);
+
+/**
+ * Follows replacements to the value now standing for another.
+ * @param fn - Function.
+ * @param value - Value or IR_NONE.
+ * @return The current value, or IR_NONE.
+ */
+int ir_resolve(const IRFunction *fn, int value);
+
+/**
+ * Replaces a phi that merges only one value (ignoring itself) by that value.
+ * @param fn - Function.
+ * @param phi - Phi to test.
+ * @return The value standing for the phi afterwards.
+ */
+int ir_remove_trivial_phi(IRFunction *fn, int phi);
+
+/**
+ * Tests whether a value is a constant.
+ * @param fn - Function.
+ * @param value - Value to test.
+ * @param constant - Receives the constant if so; may be NULL.
+ * @return True for IR_CONST.
+ */
+bool ir_is_const(const IRFunction *fn, int value, sword_t *constant);
+
+/**
+ * Optimizes a complete function: constant folding and propagation through
+ * phis, branch folding, unreachable block removal, strength reduction and
+ * dead code elimination, repeated until nothing changes. Operands are left
+ * resolved and critical edges into phis split, ready for generate_function.
+ * @param fn - Function to optimize.
+ */
+void ir_optimize(IRFunction *fn);
+
+/**
+ * Translates a function to assembly: linear-scan register allocation over
+ * R0-R5 with spill slots in the data page, phi moves, caller-saved registers
+ * around calls and tail calls as jumps.
+ * @param program - Program, whose pool and spill slots the code uses.
+ * @param fn - Optimized function.
+ * @param out - Assembly output.
+ * @return 0 on success, -1 if the data page is exhausted.
+ */
+int generate_function(IRProgram *program, IRFunction *fn, FILE *out);
+
+/**
+ * Writes the code at CODE_START that calls a function and halts.
+ * @param program - Program, which gains a pool word for the function.
+ * @param symbol - Function to call, normally main.
+ * @param out - Assembly output.
+ * @return 0 on success, -1 if the pool is full.
+ */
+int write_entry(IRProgram *program, int symbol, FILE *out);
+
+/**
+ * Writes the data page: the scratch word, direct globals, spill slots and
+ * the constant pool, from address 0.
+ * @param program - Program after every function was generated.
+ * @param out - Assembly output.
+ * @return 0 on success, -1 if they do not fit below IR_DATA_PAGE_END.
+ */
+int write_data_page(const IRProgram *program, FILE *out);
+
+/**
+ * Writes the remaining data symbols (arrays, strings and globals outside
+ * the data page) as labelled words.
+ * @param program - Program.
+ * @param out - Assembly output, positioned after the code.
+ */
+void write_data_section(const IRProgram *program, FILE *out);
+
+#endif // IR_H
@@ -0,0 +1,62 @@
+#ifndef LINK_OPTIMIZER_H
+#define LINK_OPTIMIZER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Post-link optimizer run by the image assembler once every label has an
+// address. It rewrites the program's source lines, and the assembler then
+// lays them out again: references are symbolic, so laying out renumbers the
+// code and fixes up every branch offset and code address stored in data.
+//
+// Code is reached from the instruction at CODE_START and from code
+// addresses stored in data words (call pools, interrupt vectors). Within a
+// basic block the pass forwards stored and loaded data page words, drops
+// repeated and dead stores, and folds BZ/BNZ whose zero flag is known from
+// constant operands. It also threads branches to branches and removes
+// branches to the next instruction. Data page forwarding is off in programs
+// that enable interrupts or paging, whose memory can change between
+// instructions.
+
+// A label and the address it was laid out at
+typedef struct {
+    const char *name;
+    uint32_t address;
+} LinkLabel;
+
+// What the pass removed
+typedef struct {
+    int before;             // Instructions before the pass
+    int after;
+    int unreachable;        // Removed as unreachable from the entry
+    int threaded;           // Branches retargeted past branches
+    int jumps;              // Branches to the next instruction removed
+    int branches;           // BZ/BNZ folded on a known zero flag
+    int loads;              // Loads removed or turned into MOV
+    int stores;             // Repeated or overwritten stores removed
+} LinkOptStats;
+
+// Function Prototypes
+
+/**
+ * Optimizes a laid-out program in place. Changed lines are replaced by
+ * newly allocated strings and the old ones freed.
+ * @param lines - Source lines, each allocated with malloc.
+ * @param addresses - Address of the instruction on each line, from the last layout.
+ * @param line_count - Number of lines.
+ * @param labels - Every label with its address.
+ * @param label_count - Number of labels.
+ * @param stats - Receives what was removed.
+ * @return 1 if lines changed, 0 if not, -1 if the program cannot be
+ *         optimized safely (the reason is reported and no line is changed).
+ */
+int optimize_linked_program(char **lines, const uint32_t *addresses, int line_count,
+                            const LinkLabel *labels, int label_count, LinkOptStats *stats);
+
+/**
+ * Prints the static savings of a pass.
+ * @param stats - Statistics from optimize_linked_program.
+ */
+void display_link_opt_stats(const LinkOptStats *stats);
+
+#endif // LINK_OPTIMIZER_H
@@ -50,4 +50,13 @@ void resolve_symbols(Linker *linker);
  */
 void generate_binary(Linker *linker, const char *output_file);
 
+/**
+ * Finds the symbol covering a byte address in an image linked at address 0.
+ * Symbol addresses are instruction indices, so index * 4 is the byte address.
+ * @param linker - Pointer to the Linker context.
+ * @param address - Byte address to look up.
+ * @return The symbol with the highest address not above it, or NULL.
+ */
+const Symbol *find_symbol(const Linker *linker, uint32_t address);
+
 #endif // LINKER_H
@@ -2,6 +2,7 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include "word.h"
 
 // Function Prototypes
 
@@ -21,6 +22,29 @@ uint32_t read_memory(const uint8_t *memory, uint32_t address);
  */
 void write_memory(uint8_t *memory, uint32_t address, uint32_t value);
 
+#if WORD_SIZE == 32
+#define read_memory_word read_memory
+#define write_memory_word write_memory
+#else
+/**
+ * Reads a WORD_SIZE-bit value from memory; the 32-bit engine maps this
+ * to read_memory.
+ * @param memory - Pointer to the memory array.
+ * @param address - Address to read from.
+ * @return The word stored at the specified address.
+ */
+word_t read_memory_word(const uint8_t *memory, uint32_t address);
+
+/**
+ * Writes a WORD_SIZE-bit value to memory; the 32-bit engine maps this
+ * to write_memory.
+ * @param memory - Pointer to the memory array.
+ * @param address - Address to write to.
+ * @param value - The word to write.
+ */
+void write_memory_word(uint8_t *memory, uint32_t address, word_t value);
+#endif
+
 /**
  * Loads a program (array of 32-bit instructions) into the code segment.
  * @param memory - Pointer to the memory array.
@@ -29,6 +53,16 @@ void write_memory(uint8_t *memory, uint32_t address, uint32_t value);
  */
 int load_program(uint8_t *memory, const uint32_t *program, uint32_t size);
 
+/**
+ * Loads a flat binary image (e.g. the output of generate_binary) at address 0.
+ * The first 0x100 bytes form the data page addressed by LOAD/STORE and code
+ * begins at the CPU's CODE_START.
+ * @param memory - Pointer to the memory array.
+ * @param filename - Path of the image file.
+ * @return Number of bytes loaded, or -1 on failure.
+ */
+int load_image(uint8_t *memory, const char *filename);
+
 /**
  * Displays the contents of memory in hexadecimal or ASCII format.
  * @param memory - Pointer to the memory array.
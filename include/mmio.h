@@ -0,0 +1,105 @@
+#ifndef MMIO_H
+#define MMIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+#define MMIO_MAX_DEVICES 8
+
+/**
+ * Device register read.
+ * @param context - Device state given to register_device.
+ * @param cpu - CPU performing the access.
+ * @param offset - Byte offset from the device base.
+ * @return Register value.
+ */
+typedef uint32_t (*DeviceRead)(void *context, CPU *cpu, uint32_t offset);
+
+/**
+ * Device register write. A device that writes guest RAM (e.g. by DMA)
+ * records the range with record_store.
+ * @param context - Device state given to register_device.
+ * @param cpu - CPU performing the access.
+ * @param offset - Byte offset from the device base.
+ * @param value - Value written.
+ */
+typedef void (*DeviceWrite)(void *context, CPU *cpu, uint32_t offset, uint32_t value);
+
+// A device claiming [base, base + size) of the address space
+typedef struct {
+    const char *name;
+    uint32_t base;
+    uint32_t size;
+    DeviceRead read;            // NULL reads as 0
+    DeviceWrite write;          // NULL ignores writes
+    void *context;
+    uint64_t reads;
+    uint64_t writes;
+} Device;
+
+// Devices are registered before the bus is attached to a CPU. Attaching
+// copies the IO_PAGE_SIZE page map into the CPU, after which the map is
+// never modified, so RAM accesses cost one table lookup and no locking.
+typedef struct MMIOBus {
+    Device devices[MMIO_MAX_DEVICES];
+    int device_count;
+    uint8_t pages[IO_PAGE_COUNT];   // Device index + 1, or 0 for RAM
+    bool attached;
+} MMIOBus;
+
+// Function Prototypes
+
+/**
+ * Initializes a bus with no devices.
+ * @param bus - Pointer to the MMIOBus structure.
+ */
+void init_bus(MMIOBus *bus);
+
+/**
+ * Registers a device over an address range.
+ * @param bus - Pointer to the MMIOBus structure.
+ * @param name - Device name for reports.
+ * @param base - First address; must be IO_PAGE_SIZE aligned.
+ * @param size - Range size; a multiple of IO_PAGE_SIZE.
+ * @param read - Register read callback, or NULL.
+ * @param write - Register write callback, or NULL.
+ * @param context - Passed to the callbacks.
+ * @return 0 on success, -1 if the range is invalid, taken, or the bus is attached.
+ */
+int register_device(MMIOBus *bus, const char *name, uint32_t base, uint32_t size,
+                    DeviceRead read, DeviceWrite write, void *context);
+
+/**
+ * Attaches the bus to a CPU; no devices can be registered afterwards.
+ * @param bus - Pointer to the MMIOBus structure.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void attach_bus(MMIOBus *bus, CPU *cpu);
+
+/**
+ * Dispatches a read to the device mapped at an address.
+ * Called only for addresses whose page is marked in cpu->io_pages.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Guest address.
+ * @return Register value.
+ */
+uint32_t mmio_read(CPU *cpu, uint32_t address);
+
+/**
+ * Dispatches a write to the device mapped at an address.
+ * Called only for addresses whose page is marked in cpu->io_pages.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Guest address.
+ * @param value - Value written.
+ */
+void mmio_write(CPU *cpu, uint32_t address, uint32_t value);
+
+/**
+ * Prints the device map with per-device access counts; nothing if no device
+ * was accessed.
+ * @param bus - Pointer to the MMIOBus structure.
+ */
+void display_bus(const MMIOBus *bus);
+
+#endif // MMIO_H
@@ -0,0 +1,159 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+
+// Virtual addresses are 16 bits: a 5-bit directory index, a 5-bit table
+// index and a 6-bit page offset. Directories and tables are 32 words in
+// guest memory; both levels are walked with physical addresses.
+#define MMU_PAGE_SHIFT 6
+#define MMU_PAGE_SIZE (1u << MMU_PAGE_SHIFT)
+#define MMU_OFFSET_MASK (MMU_PAGE_SIZE - 1)
+#define MMU_TABLE_ENTRIES 32
+#define MMU_TABLE_SHIFT 5
+#define MMU_VIRTUAL_SIZE 0x10000u
+#define MMU_TLB_SIZE 16             // Direct-mapped on the low bits of the page number
+#define MMU_NO_PAGE UINT32_MAX      // Never a virtual page number
+#define MMU_FAULT UINT32_MAX        // translate_address result for a faulting access
+
+// Directory entries hold a table address | PTE_VALID; table entries hold a
+// page-aligned frame address | permission bits
+#define PTE_VALID 0x1u
+#define PTE_READ 0x2u
+#define PTE_WRITE 0x4u
+#define PTE_EXECUTE 0x8u
+
+// Registers accessed with MMUSET and MMUGET
+typedef enum {
+    MMU_REG_DIRECTORY = 0,      // Physical page directory address; nonzero enables paging
+    MMU_REG_FAULT_HANDLER = 1,  // Virtual address entered on a page fault
+    MMU_REG_FAULT_ADDRESS = 2,  // Read-only: virtual address of the last fault
+    MMU_REG_FAULT_CAUSE = 3,    // Read-only: MMUAccess | MMU_CAUSE_PRESENT
+    MMU_REGISTER_COUNT
+} MMURegister;
+
+typedef enum {
+    MMU_READ = 0,
+    MMU_WRITE = 1,
+    MMU_EXECUTE = 2,
+    MMU_ACCESS_COUNT
+} MMUAccess;
+
+#define MMU_CAUSE_PRESENT 0x4u      // Set when the page was mapped but the access not permitted
+
+// One TLB slot. tags[access] is the cached virtual page number if the page
+// allows that access and MMU_NO_PAGE otherwise, so a hit is one compare.
+typedef struct {
+    uint32_t tags[MMU_ACCESS_COUNT];
+    uint32_t frame;             // Physical address of the page
+    uint8_t *host;              // cpu->memory + frame
+} TLBEntry;
+
+// Memory management unit; attached to the CPU and enabled by the guest
+typedef struct MMU {
+    CPU *cpu;
+    uint32_t registers[MMU_REGISTER_COUNT];
+    bool fault_pending;         // Set by a faulting access, cleared on fault entry
+    bool used;                  // Paging was enabled at some point
+
+    TLBEntry tlb[MMU_TLB_SIZE];
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t faults;
+    uint64_t flushes;
+} MMU;
+
+/**
+ * Looks up a virtual access in the TLB.
+ * @param mmu - Pointer to the MMU structure.
+ * @param address - Virtual address of the first byte.
+ * @param size - Bytes accessed: 4 for instruction fetch, WORD_BYTES for data.
+ * @param access - Kind of access.
+ * @return Host address of the access, or NULL on a miss, a permission the
+ *         entry lacks or an access straddling two pages.
+ */
+static inline uint8_t *tlb_lookup(MMU *mmu, uint32_t address, uint32_t size, MMUAccess access) {
+    const TLBEntry *entry = &mmu->tlb[(address >> MMU_PAGE_SHIFT) % MMU_TLB_SIZE];
+    // The tag is compared with the page of the access's last byte, so
+    // accesses crossing into the next page miss without a separate check
+    if (entry->tags[access] != (address + size - 1) >> MMU_PAGE_SHIFT) {
+        return NULL;
+    }
+    mmu->hits++;
+    return entry->host + (address & MMU_OFFSET_MASK);
+}
+
+// Function Prototypes
+
+/**
+ * Initializes an MMU with paging disabled and attaches it to the CPU.
+ * @param mmu - Pointer to the MMU structure.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void init_mmu(MMU *mmu, CPU *cpu);
+
+/**
+ * Writes an MMU register; a new directory flushes the TLB.
+ * @param mmu - Pointer to the MMU structure.
+ * @param reg - MMURegister to write.
+ * @param value - New value.
+ * @return 0 on success, -1 for a read-only register or an invalid directory.
+ */
+int set_mmu_register(MMU *mmu, uint32_t reg, uint32_t value);
+
+/**
+ * Invalidates the whole TLB.
+ * @param mmu - Pointer to the MMU structure.
+ */
+void flush_tlb(MMU *mmu);
+
+/**
+ * Invalidates the TLB entry of one virtual page.
+ * @param mmu - Pointer to the MMU structure.
+ * @param address - Any virtual address in the page.
+ */
+void flush_tlb_page(MMU *mmu, uint32_t address);
+
+/**
+ * Translates a virtual address, walking the page tables on a TLB miss and
+ * refilling the TLB. A fault is recorded in the fault registers and sets
+ * fault_pending; step_cpu then rolls the instruction back and enters the
+ * fault handler.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Virtual address.
+ * @param access - Kind of access.
+ * @return Physical address, or MMU_FAULT.
+ */
+uint32_t translate_address(CPU *cpu, uint32_t address, MMUAccess access);
+
+/**
+ * Translates a virtual range, which must map to contiguous physical memory.
+ * @param cpu - Pointer to the CPU structure.
+ * @param address - Virtual start address, replaced by the physical one.
+ * @param length - Length of the range in bytes.
+ * @param access - Kind of access.
+ * @return true on success; false after a fault or for a range whose pages
+ *         are not physically contiguous, which halts the CPU.
+ */
+bool translate_range(CPU *cpu, uint32_t *address, uint32_t length, MMUAccess access);
+
+/**
+ * Executes one instruction with paging enabled. A faulting instruction
+ * leaves registers, flags and counters as they were and enters the fault
+ * handler with the flags and its own PC pushed, so IRET retries it.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void step_paged(CPU *cpu);
+
+/**
+ * Prints TLB hit, miss, fault and flush counts; nothing if paging was
+ * never enabled.
+ * @param mmu - Pointer to the MMU structure.
+ */
+void display_mmu(const MMU *mmu);
+
+#endif // MMU_H
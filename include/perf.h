@@ -0,0 +1,64 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define PERF_MAX_PHASES 8
+
+// Host-side wall-clock metrics for one simulator run
+typedef struct {
+    const char *phase_names[PERF_MAX_PHASES];
+    double phase_seconds[PERF_MAX_PHASES];
+    int phase_count;
+    int current_phase;          // -1 when no phase is open
+    double phase_start;
+    double execute_seconds;     // Time spent in phases marked as execution
+    uint64_t start_instructions;
+} HostMetrics;
+
+// Function Prototypes
+
+/**
+ * Reads a guest performance counter.
+ * @param cpu - Pointer to the CPU structure.
+ * @param counter - Counter to read.
+ * @return Counter value, or 0 for an invalid counter.
+ */
+uint64_t read_perf_counter(const CPU *cpu, PerfCounter counter);
+
+/**
+ * Clears all guest performance counters.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void reset_perf_counters(CPU *cpu);
+
+/**
+ * Initializes host metrics with no phases recorded.
+ * @param metrics - Pointer to the HostMetrics structure.
+ */
+void init_host_metrics(HostMetrics *metrics);
+
+/**
+ * Closes the open phase, if any, and starts timing a new one.
+ * @param metrics - Pointer to the HostMetrics structure.
+ * @param name - Phase name (must outlive the metrics).
+ * @param cpu - CPU whose retired instructions are attributed to execution
+ *              phases; NULL for phases that do not execute guest code.
+ */
+void begin_phase(HostMetrics *metrics, const char *name, const CPU *cpu);
+
+/**
+ * Closes the open phase.
+ * @param metrics - Pointer to the HostMetrics structure.
+ */
+void end_phase(HostMetrics *metrics);
+
+/**
+ * Displays wall time per phase, simulator MIPS and the guest instruction mix.
+ * @param metrics - Pointer to the HostMetrics structure.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void display_host_metrics(const HostMetrics *metrics, const CPU *cpu);
+
+#endif // PERF_H
@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "linker.h"
+
+#define PROFILER_MAX_DEPTH 256      // Deeper calls are attributed to the deepest frame
+#define PROFILER_OPCODES 256
+
+// Calling-context tree node: one per distinct call path
+typedef struct {
+    int function;           // Index into the symbol table, -1 if unknown
+    uint32_t entry;         // Entry address of the called function
+    int parent;             // Parent node, -1 for the root
+    int first_child;
+    int next_sibling;
+    uint64_t self_count;    // Instructions executed directly in this context
+} ProfileNode;
+
+// Exact-count instruction profiler
+typedef struct {
+    const Linker *symbols;                      // Symbol table, may be NULL
+    uint64_t pc_counts[INSTRUCTION_SLOTS];       // By address / 2
+    uint64_t opcode_counts[PROFILER_OPCODES];
+    uint64_t total;
+
+    ProfileNode *nodes;                         // Calling-context tree
+    int node_count;
+    int node_capacity;
+    int current;                                // Node of the executing frame
+    int depth;
+    int overflow;                               // Frames beyond PROFILER_MAX_DEPTH
+} Profiler;
+
+// Function Prototypes
+
+/**
+ * Initializes a profiler for a program whose entry is at the CPU's PC.
+ * @param profiler - Pointer to the Profiler structure.
+ * @param cpu - CPU with the program loaded.
+ * @param symbols - Linker context whose Symbol table names functions, or NULL.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int init_profiler(Profiler *profiler, const CPU *cpu, const Linker *symbols);
+
+/**
+ * Releases memory held by the profiler.
+ * @param profiler - Pointer to the Profiler structure.
+ */
+void free_profiler(Profiler *profiler);
+
+/**
+ * Runs the CPU until it halts, counting every instruction by PC, opcode
+ * and calling context. CALL/RET maintain the shadow call stack.
+ * @param profiler - Pointer to the Profiler structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_instructions - Stop after this many instructions.
+ */
+void profile_cpu(Profiler *profiler, CPU *cpu, uint64_t max_instructions);
+
+/**
+ * Displays per-function inclusive/exclusive counts and the opcode mix.
+ * @param profiler - Pointer to the Profiler structure.
+ */
+void display_profile(const Profiler *profiler);
+
+/**
+ * Writes folded stacks ("main;f;g count" per line) for flamegraph tools.
+ * @param profiler - Pointer to the Profiler structure.
+ * @param out - Output stream.
+ */
+void write_folded_stacks(const Profiler *profiler, FILE *out);
+
+/**
+ * Writes a disassembly listing of the code segment annotated with
+ * per-instruction execution counts and symbol labels.
+ * @param profiler - Pointer to the Profiler structure.
+ * @param cpu - CPU whose memory holds the program.
+ * @param out - Output stream.
+ */
+void write_annotated_listing(const Profiler *profiler, const CPU *cpu, FILE *out);
+
+#endif // PROFILER_H
@@ -0,0 +1,78 @@
+#ifndef SAMPLE_PROFILER_H
+#define SAMPLE_PROFILER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "linker.h"
+
+#define SAMPLE_PROFILER_STACK_SIZE 1024     // Shadow call stack capacity
+#define SAMPLE_PROFILER_FRAMES 16           // Innermost frames copied per sample
+#define SAMPLE_PROFILER_RING_SIZE 4096      // Power of two
+#define SAMPLE_PROFILER_DRAIN_MASK 0xFFFF   // Drain the ring every 64K instructions
+#define SAMPLE_PROFILER_DEFAULT_US 1000     // Default SIGPROF interval
+
+// One sample taken by the SIGPROF handler
+typedef struct {
+    uint32_t pc;
+    uint32_t depth;                             // Frames stored below
+    uint32_t frames[SAMPLE_PROFILER_FRAMES];    // Entry addresses, innermost first
+} PCSample;
+
+// Statistical profiler driven by a host interval timer
+typedef struct {
+    const volatile CPU *cpu;
+
+    // Shadow call stack of function entry addresses, maintained by the run loop
+    uint32_t stack[SAMPLE_PROFILER_STACK_SIZE];
+    volatile uint32_t depth;
+    uint32_t overflow;
+
+    // Single-producer (signal handler) single-consumer (run loop) ring
+    PCSample ring[SAMPLE_PROFILER_RING_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint dropped;
+
+    // Aggregates built when the ring is drained
+    uint64_t pc_samples[INSTRUCTION_SLOTS];
+    uint64_t self_samples[INSTRUCTION_SLOTS];      // By innermost entry
+    uint64_t total_samples_by_entry[INSTRUCTION_SLOTS];  // Entry anywhere on stack
+    uint64_t total_samples;
+    uint32_t interval_us;
+} SampleProfiler;
+
+// Function Prototypes
+
+/**
+ * Installs the SIGPROF handler and starts the interval timer.
+ * Only one sample profiler can be active at a time.
+ * @param profiler - Pointer to the SampleProfiler structure.
+ * @param cpu - CPU whose Program Counter is sampled.
+ * @param interval_us - Sampling interval in microseconds of CPU time.
+ * @return 0 on success, -1 on failure.
+ */
+int start_sample_profiler(SampleProfiler *profiler, CPU *cpu, uint32_t interval_us);
+
+/**
+ * Stops the timer, restores the previous handler and drains the ring.
+ * @param profiler - Pointer to the SampleProfiler structure.
+ */
+void stop_sample_profiler(SampleProfiler *profiler);
+
+/**
+ * Runs the CPU until it halts while maintaining the shadow call stack.
+ * @param profiler - Pointer to the SampleProfiler structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_instructions - Stop after this many instructions.
+ */
+void sample_profile_cpu(SampleProfiler *profiler, CPU *cpu, uint64_t max_instructions);
+
+/**
+ * Displays samples aggregated per symbol and the hottest PCs.
+ * @param profiler - Pointer to the SampleProfiler structure.
+ * @param symbols - Linker context whose Symbol table names functions, or NULL.
+ */
+void display_sample_profile(const SampleProfiler *profiler, const Linker *symbols);
+
+#endif // SAMPLE_PROFILER_H
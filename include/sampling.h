@@ -0,0 +1,74 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// Basic-block vectors are hashed into 2^SAMPLING_BBV_BITS buckets
+#define SAMPLING_BBV_BITS 5
+#define SAMPLING_BBV_DIM (1 << SAMPLING_BBV_BITS)
+#define SAMPLING_MAX_INTERVALS 1024     // Interval length doubles past this
+#define SAMPLING_MAX_CLUSTERS 16
+
+// Sampled simulation parameters
+typedef struct {
+    uint64_t interval_length;   // Instructions per interval
+    uint64_t warmup_length;     // Detailed warmup before each measured interval
+    int max_clusters;           // Upper bound on k for k-means
+    uint64_t max_instructions;  // Fast-forward limit
+    bool validate;              // Also run the whole program in detailed mode
+} SamplingConfig;
+
+// One cluster of intervals (a phase)
+typedef struct {
+    int representative;         // Interval closest to the centroid
+    int members;                // Number of intervals in the cluster
+    double weight;              // Fraction of all instructions
+    double cpi;                 // Detailed CPI of the representative
+    double cpi_stddev;          // From a second member, pooled for singletons
+    bool pooled;                // cpi_stddev was borrowed from other clusters
+} SamplingCluster;
+
+// Sampled simulation results
+typedef struct {
+    uint64_t total_instructions;
+    uint64_t detailed_instructions;     // Measured plus warmup
+    uint64_t interval_length;           // Final length after doubling
+    int interval_count;
+    int cluster_count;
+    SamplingCluster clusters[SAMPLING_MAX_CLUSTERS];
+    double cpi;                         // Weighted CPI estimate
+    double cpi_error;                   // 95% confidence half-width, INFINITY if unbounded
+    double full_cpi;                    // Only set when validating
+    double fast_forward_seconds;
+    double detailed_seconds;
+} SamplingResult;
+
+// Function Prototypes
+
+/**
+ * Fills a configuration with default interval, warmup and cluster settings.
+ * @param config - Pointer to the SamplingConfig structure.
+ */
+void init_sampling_config(SamplingConfig *config);
+
+/**
+ * Runs a SimPoint-style sampled simulation.
+ * - Fast-forwards functionally, collecting a basic-block vector per interval.
+ * - Clusters the intervals with k-means, choosing k by BIC.
+ * - Warms caches and predictor, then times one representative per cluster.
+ * @param initial - CPU state with the program loaded; not modified.
+ * @param config - Sampling parameters.
+ * @param result - Receives the weighted CPI estimate.
+ * @return 0 on success, -1 on failure.
+ */
+int run_sampled_simulation(const CPU *initial, const SamplingConfig *config, SamplingResult *result);
+
+/**
+ * Displays the per-cluster breakdown and the weighted CPI estimate.
+ * @param result - Pointer to the SamplingResult structure.
+ */
+void display_sampling_result(const SamplingResult *result);
+
+#endif // SAMPLING_H
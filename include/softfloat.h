@@ -0,0 +1,27 @@
+#ifndef SOFTFLOAT_H
+#define SOFTFLOAT_H
+
+#include <stdint.h>
+#include "instructions.h"
+
+// Bit-exact software IEEE-754 arithmetic behind the FPU's soft and check
+// modes. Every operation rounds to nearest-even (conversions to integer
+// truncate), returns the canonical quiet NaN for any NaN result and
+// detects tininess after rounding, as x86 SSE does, so results and
+// exception flags match the host fast path bit for bit.
+
+// Function Prototypes
+
+/**
+ * Executes one arithmetic, compare or convert FPU instruction.
+ * @param opcode - An FPU opcode other than the loads, stores and FPFLAGS.
+ * @param a - First source: FP register bits, or an integer for FCVTSW/FCVTDW.
+ * @param b - Second source FP register bits.
+ * @param c - Addend for FMADDS/FMADDD (the destination's old value).
+ * @param flags - FPUFlag bits raised by the operation are ORed in here.
+ * @return Result bits; single results use the low 32 bits, compares and
+ *         conversions to integer return a sign-extended int32.
+ */
+uint64_t softfloat_execute(Opcode opcode, uint64_t a, uint64_t b, uint64_t c, uint32_t *flags);
+
+#endif // SOFTFLOAT_H
@@ -0,0 +1,145 @@
+#ifndef TIMETRAVEL_H
+#define TIMETRAVEL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "cpu.h"
+
+#define TIMETRAVEL_PAGE_SIZE 256
+#define TIMETRAVEL_PAGE_COUNT (MEMORY_SIZE / TIMETRAVEL_PAGE_SIZE)
+#define TIMETRAVEL_DEFAULT_INTERVAL 65536       // Instructions between checkpoints
+#define TIMETRAVEL_DEFAULT_CHECKPOINTS 256      // Checkpoints kept before thinning
+#define TIMETRAVEL_MAX_BREAKPOINTS 16
+
+#if TIMETRAVEL_PAGE_COUNT > 32
+#error "Page masks are 32 bits wide; raise TIMETRAVEL_PAGE_SIZE"
+#endif
+
+// Architectural state saved in a checkpoint; memory is kept as page deltas
+typedef struct {
+    sword_t registers[REGISTER_COUNT];
+    int32_t vectors[VECTOR_REGISTER_COUNT][VECTOR_LANES];
+    uint64_t fp_registers[FP_REGISTER_COUNT];
+    uint32_t fp_flags;
+    uint32_t program_counter;
+    uint32_t stack_pointer;
+    uint32_t instruction_register;
+    uint32_t instruction_length;
+    bool flags[16];
+    bool halted;
+    uint64_t perf_counters[PERF_COUNTER_COUNT];
+} CheckpointState;
+
+// Checkpoint taken after `instruction` instructions. The summary fields
+// describe the interval since the previous checkpoint: the pages written
+// there (stored here with their contents at this checkpoint), the code pages
+// executed and the registers changed. Queries use them to skip intervals.
+typedef struct {
+    uint64_t instruction;
+    CheckpointState state;
+    uint8_t *pages[TIMETRAVEL_PAGE_COUNT];      // NULL if the page was not written
+    uint32_t written_pages;
+    uint32_t executed_pages;
+    uint8_t changed_registers;
+} Checkpoint;
+
+// Reverse execution over a run of the CPU
+typedef struct {
+    uint64_t interval;
+    int max_checkpoints;
+    Checkpoint *checkpoints;        // Ordered by instruction; checkpoints[0] is the start
+    int count;
+
+    uint64_t position;              // Instructions executed to reach the CPU's current state
+    uint64_t head;                  // Furthest position reached; later ones are new territory
+
+    // Summary of the interval after the newest checkpoint
+    uint32_t written_pages;
+    uint32_t executed_pages;
+    uint8_t changed_registers;
+
+    CPU *scratch;                   // Re-executes intervals without disturbing the live CPU
+    uint64_t reexecuted;            // Instructions re-executed for queries and seeks
+} TimeTravel;
+
+// Function Prototypes
+
+/**
+ * Starts reverse execution support at the CPU's current state.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param interval - Instructions between checkpoints.
+ * @param max_checkpoints - Checkpoints kept; older ones are thinned out.
+ * @return 0 on success, -1 on failure.
+ */
+int init_time_travel(TimeTravel *tt, CPU *cpu, uint64_t interval, int max_checkpoints);
+
+/**
+ * Frees all checkpoints.
+ * @param tt - Pointer to the TimeTravel structure.
+ */
+void free_time_travel(TimeTravel *tt);
+
+/**
+ * Executes one instruction forward, taking checkpoints in new territory.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void time_travel_step(TimeTravel *tt, CPU *cpu);
+
+/**
+ * Moves the CPU to the state after `instruction` instructions by restoring
+ * the nearest earlier checkpoint and re-executing forward.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param instruction - Target position.
+ * @return 0 on success, -1 if the program halts before the target.
+ */
+int seek_instruction(TimeTravel *tt, CPU *cpu, uint64_t instruction);
+
+/**
+ * Steps back one instruction.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @return 0 on success, -1 at the start of the run.
+ */
+int reverse_step(TimeTravel *tt, CPU *cpu);
+
+/**
+ * Runs backward to the most recent earlier point where the PC is a breakpoint.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param breakpoints - Breakpoint addresses.
+ * @param count - Number of breakpoints.
+ * @return 0 if a breakpoint was hit, 1 if the start of the run was reached.
+ */
+int reverse_continue(TimeTravel *tt, CPU *cpu, const uint32_t *breakpoints, int count);
+
+/**
+ * Finds the last instruction before the current position that changed a register.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param reg - Register number.
+ * @param pc - Receives the address of that instruction, or NULL.
+ * @return Index of the instruction, or -1 if the register never changed.
+ */
+int64_t last_register_change(TimeTravel *tt, int reg, uint32_t *pc);
+
+/**
+ * Finds the last instruction before the current position that changed a memory word.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param address - Address of the 32-bit word.
+ * @param pc - Receives the address of that instruction, or NULL.
+ * @return Index of the instruction, or -1 if the word never changed.
+ */
+int64_t last_memory_change(TimeTravel *tt, uint32_t address, uint32_t *pc);
+
+/**
+ * Reads time-travel commands (step, rstep, continue, rcontinue, break, goto,
+ * last, regs, info, quit) and applies them to the CPU.
+ * @param tt - Pointer to the TimeTravel structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param in - Command input stream.
+ */
+void run_time_travel_console(TimeTravel *tt, CPU *cpu, FILE *in);
+
+#endif // TIMETRAVEL_H
@@ -0,0 +1,76 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// Cache and predictor geometry for the detailed timing model
+#define CACHE_LINE_SIZE 16
+#define CACHE_LINES 32              // 512-byte direct-mapped caches
+#define PREDICTOR_ENTRIES 64        // 2-bit bimodal counters indexed by PC
+
+// Latencies in cycles
+#define CACHE_MISS_PENALTY 10
+#define MISPREDICT_PENALTY 4
+#define TAKEN_JUMP_PENALTY 1
+#define MUL_LATENCY 3
+#define DIV_LATENCY 20
+
+// Direct-mapped cache model (tags only, no data)
+typedef struct {
+    uint32_t tags[CACHE_LINES];
+    bool valid[CACHE_LINES];
+    uint64_t accesses;
+    uint64_t misses;
+} CacheModel;
+
+// Bimodal branch predictor for JZ/JNZ and BZ/BNZ
+typedef struct {
+    uint8_t counters[PREDICTOR_ENTRIES];
+    uint64_t predictions;
+    uint64_t mispredictions;
+} BranchPredictor;
+
+// Detailed timing model state
+typedef struct {
+    CacheModel icache;
+    CacheModel dcache;
+    BranchPredictor predictor;
+    uint64_t cycles;
+    uint64_t instructions;
+} TimingModel;
+
+// Function Prototypes
+
+/**
+ * Initializes the timing model with cold caches and a weakly-not-taken predictor.
+ * @param model - Pointer to the TimingModel structure.
+ */
+void init_timing_model(TimingModel *model);
+
+/**
+ * Clears the cycle, instruction, miss and misprediction counters while
+ * keeping the warmed cache and predictor contents.
+ * @param model - Pointer to the TimingModel structure.
+ */
+void reset_timing_stats(TimingModel *model);
+
+/**
+ * Executes one instruction in detailed mode and accounts its cycles.
+ * Also advances the CPU's PERF_CYCLES and PERF_CACHE_MISSES counters.
+ * A step that enters an interrupt handler instead, and every step while
+ * paging is on, runs through step_cpu without being timed.
+ * @param model - Pointer to the TimingModel structure.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void timing_step(TimingModel *model, CPU *cpu);
+
+/**
+ * Returns cycles per instruction measured since the last reset.
+ * @param model - Pointer to the TimingModel structure.
+ * @return CPI, or 0 if no instructions were executed.
+ */
+double timing_cpi(const TimingModel *model);
+
+#endif // TIMING_H
@@ -0,0 +1,165 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "cpu.h"
+
+#define TRACE_DEFAULT_KEYFRAME_INTERVAL 4096    // Instructions per block
+
+/*
+ * Trace file layout (all integers little-endian):
+ *   header: "CPUTRACE", u32 version, u32 keyframe interval
+ *   blocks: u64 first instruction, u32 instructions, u32 raw size,
+ *           u32 stored size, u32 flags, then the payload
+ * A block payload starts with a keyframe (full architectural state before
+ * its first instruction) followed by one delta record per instruction:
+ *   u8 mask (TRACE_DELTA_*), then in order: PC delta from PC+4 (zigzag
+ *   varint), u8 register mask and zigzag varint deltas, SP delta, u16 flags,
+ *   memory write (varint address, varint size, bytes).
+ * Nondeterministic inputs reach the CPU as register and memory writes, so
+ * replay applies them from the deltas without re-executing anything.
+ */
+
+// Delta record mask bits
+#define TRACE_DELTA_PC 0x01          // PC is not PC+4
+#define TRACE_DELTA_REGISTERS 0x02
+#define TRACE_DELTA_SP 0x04
+#define TRACE_DELTA_FLAGS 0x08
+#define TRACE_DELTA_MEMORY 0x10
+#define TRACE_DELTA_HALTED 0x20
+
+// Recording options
+typedef struct {
+    uint32_t keyframe_interval;     // Instructions between full-state keyframes
+    bool compress;                  // LZ-compress each block
+} TraceConfig;
+
+// A block of the trace being filled or written
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t first_instruction;
+    uint32_t instructions;
+} TraceBlock;
+
+// Records a trace; full blocks are compressed and written by a background thread
+typedef struct {
+    FILE *file;
+    TraceConfig config;
+
+    // Double buffer: the run loop fills blocks[active] while the writer drains the other
+    TraceBlock blocks[2];
+    int active;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending_block;              // Block waiting for the writer, or -1
+    bool stopping;
+    bool failed;
+
+    uint64_t instructions;
+    uint64_t raw_bytes;
+    uint64_t written_bytes;
+} TraceWriter;
+
+// Location of one block in a trace file
+typedef struct {
+    long offset;                    // Payload offset
+    uint64_t first_instruction;
+    uint32_t instructions;
+    uint32_t raw_size;
+    uint32_t stored_size;
+    uint32_t flags;
+} TraceBlockIndex;
+
+// Replays a recorded trace into a CPU
+typedef struct {
+    FILE *file;
+    uint32_t keyframe_interval;
+    TraceBlockIndex *blocks;
+    int block_count;
+    uint64_t total_instructions;
+
+    // Decoded payload of the current block
+    int current_block;
+    uint8_t *data;
+    size_t size;
+    size_t position;
+    uint64_t instruction;           // Index of the next instruction to replay
+} TraceReader;
+
+// Function Prototypes
+
+/**
+ * Fills a TraceConfig with the default keyframe interval and compression.
+ * @param config - Pointer to the TraceConfig structure.
+ */
+void init_trace_config(TraceConfig *config);
+
+/**
+ * Creates a trace file and starts the background writer.
+ * @param writer - Pointer to the TraceWriter structure.
+ * @param filename - Path of the trace file.
+ * @param config - Recording options.
+ * @return 0 on success, -1 on failure.
+ */
+int start_trace_recording(TraceWriter *writer, const char *filename, const TraceConfig *config);
+
+/**
+ * Executes one instruction and appends its delta record to the trace.
+ * @param writer - Pointer to the TraceWriter structure.
+ * @param cpu - Pointer to the CPU structure.
+ */
+void trace_step(TraceWriter *writer, CPU *cpu);
+
+/**
+ * Runs the CPU until it halts, recording every instruction.
+ * @param writer - Pointer to the TraceWriter structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_instructions - Stop after this many instructions.
+ */
+void record_cpu(TraceWriter *writer, CPU *cpu, uint64_t max_instructions);
+
+/**
+ * Flushes the last block, stops the writer thread and closes the file.
+ * @param writer - Pointer to the TraceWriter structure.
+ * @return 0 if every block was written, -1 on failure.
+ */
+int stop_trace_recording(TraceWriter *writer);
+
+/**
+ * Opens a trace file and indexes its blocks.
+ * @param reader - Pointer to the TraceReader structure.
+ * @param filename - Path of the trace file.
+ * @return 0 on success, -1 on failure.
+ */
+int open_trace(TraceReader *reader, const char *filename);
+
+/**
+ * Sets the CPU to the state before instruction `instruction`, starting from
+ * the nearest keyframe. Seeking to the instruction count gives the final state.
+ * @param reader - Pointer to the TraceReader structure.
+ * @param cpu - Pointer to the CPU structure.
+ * @param instruction - Index of the instruction to stop before.
+ * @return 0 on success, -1 on failure.
+ */
+int seek_trace(TraceReader *reader, CPU *cpu, uint64_t instruction);
+
+/**
+ * Applies the next recorded instruction to the CPU.
+ * @param reader - Pointer to the TraceReader structure.
+ * @param cpu - Pointer to the CPU structure, positioned by seek_trace.
+ * @return 0 on success, 1 at the end of the trace, -1 on a corrupt trace.
+ */
+int replay_step(TraceReader *reader, CPU *cpu);
+
+/**
+ * Closes the trace file and frees the block index.
+ * @param reader - Pointer to the TraceReader structure.
+ */
+void close_trace(TraceReader *reader);
+
+#endif // TRACE_H
@@ -0,0 +1,45 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "instructions.h"
+
+// Lane-wise kernels behind the vector instructions. They use SSE2 when the
+// compiler targets it and plain loops otherwise; building with
+// -DVECTOR_SCALAR forces the loops. No kernel touches the flags.
+
+// Function Prototypes
+
+/**
+ * Applies a two-operand lane-wise instruction.
+ * @param opcode - VADD, VSUB, VMUL, VAND, VOR, VXOR, VCMPEQ or VCMPGT.
+ * @param dst - Destination lanes; may alias a source.
+ * @param a - First source lanes.
+ * @param b - Second source lanes.
+ */
+void vector_binary(Opcode opcode, int32_t *dst, const int32_t *a, const int32_t *b);
+
+/**
+ * Permutes lanes: lane i of dst is lane (selector >> 2i) & 3 of a.
+ * @param dst - Destination lanes; may alias the source.
+ * @param a - Source lanes.
+ * @param selector - Four 2-bit lane indices.
+ */
+void vector_shuffle(int32_t *dst, const int32_t *a, uint8_t selector);
+
+/**
+ * Copies a scalar into every lane.
+ * @param dst - Destination lanes.
+ * @param value - Value to broadcast.
+ */
+void vector_splat(int32_t *dst, int32_t value);
+
+/**
+ * Sums the lanes with 32-bit wraparound.
+ * @param a - Source lanes.
+ * @return The sum.
+ */
+int32_t vector_reduce(const int32_t *a);
+
+#endif // VECTOR_H
@@ -0,0 +1,85 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// Load-time verification of a flat image. Code is walked from CODE_START
+// along fall-through paths and direct branches, and from every code address
+// stored in data (call pools, interrupt vectors). Each reachable instruction
+// must start on an instruction boundary, have a defined opcode and register
+// operands inside their register files, and branch only to an instruction
+// inside the image. Verification is refused unless opcode_operands declares
+// every field register_fields reports as a register. Anything else
+// reachable from the entry is rejected with a warning; candidates found in
+// data are dropped silently.
+//
+// Accepted instructions that cannot fault or halt unexpectedly (register
+// ALU and vector work, direct LOAD/STORE to data page RAM, branches and
+// HALT) form fault-free blocks ending at a control transfer. run_verified
+// executes those blocks from pre-decoded words with no fetch, bounds or
+// register checks: LOAD, STORE and vector instructions access memory and
+// vector registers directly, and the rest go through execute_verified.
+// Everything else (rejected or unreached code, DIV, stack, device, bulk
+// memory and FP instructions) goes through step_cpu with its full checks,
+// and a block is only entered after looking up the PC, so indirect jumps
+// land checked unless their target is a verified block.
+
+#define VERIFY_MAX_BLOCK 64     // Instructions per fault-free block
+
+// A verified image, looked up by address / 2
+typedef struct {
+    uint32_t code[INSTRUCTION_SLOTS];       // 32-bit form of each verified instruction
+    uint8_t lengths[INSTRUCTION_SLOTS];     // Its length in bytes, 0 if not verified
+    uint16_t blocks[INSTRUCTION_SLOTS];     // Fault-free instructions from here on, 0 if none
+    uint16_t block_ends[INSTRUCTION_SLOTS]; // Slot after the last fault-free instruction reached
+    uint32_t code_start;                    // Bytes covered by verified instructions
+    uint32_t code_end;
+
+    // Load-time statistics
+    uint32_t verified;          // Reachable instructions accepted
+    uint32_t rejected;          // Instructions reachable from the entry rejected
+    uint32_t fault_free;        // Accepted instructions inside fault-free blocks
+    uint32_t block_count;       // Fault-free blocks entered from outside a block
+
+    // Run statistics
+    uint64_t blocks_run;
+    uint64_t unchecked_instructions;
+    uint64_t checked_instructions;
+    uint32_t invalidated;       // Block entries dropped after their code was written
+} VerifiedProgram;
+
+// Function Prototypes
+
+/**
+ * Verifies the image loaded into the CPU and marks its fault-free blocks.
+ * Run it once devices are attached, so that device windows are known.
+ * @param program - Verified image to fill in.
+ * @param cpu - CPU holding the image.
+ * @param image_size - Size of the loaded image in bytes.
+ * @return 0 if every reachable instruction was accepted, -1 if some were
+ *         rejected (each is reported and keeps full checks) or the operand
+ *         kinds disagree with the executor (nothing is verified).
+ */
+int verify_program(VerifiedProgram *program, CPU *cpu, uint32_t image_size);
+
+/**
+ * Runs the CPU, executing fault-free blocks unchecked and stepping every
+ * other instruction through step_cpu: at PCs outside a block, while paging
+ * or tracing, and when an interrupt could fall inside the block. Blocks
+ * whose code is written are dropped, so self-modifying code falls back to
+ * the checked interpreter.
+ * @param program - Verified image.
+ * @param cpu - Pointer to the CPU structure.
+ * @param max_instructions - Stop after this many instructions.
+ */
+void run_verified(VerifiedProgram *program, CPU *cpu, uint64_t max_instructions);
+
+/**
+ * Prints what the verifier accepted and how much of the run was unchecked.
+ * @param program - Verified image after run_verified.
+ */
+void display_verified(const VerifiedProgram *program);
+
+#endif // VERIFIER_H
@@ -0,0 +1,40 @@
+#ifndef WORD_H
+#define WORD_H
+
+#include <stdint.h>
+#include <inttypes.h>
+
+// Width of the general-purpose registers, the ALU and LOAD/STORE/stack
+// words, fixed at compile time. The default engine is 32-bit; building with
+// -DWORD_SIZE=64 (the Makefile's cpu_simulator64) specializes the same
+// sources for 64-bit words, so no hot path ever tests the width at runtime.
+// Instructions stay 32 bits wide and addresses stay uint32_t in both
+// engines: a register used as an address contributes its low 32 bits.
+#ifndef WORD_SIZE
+#define WORD_SIZE 32
+#endif
+
+#if WORD_SIZE == 32
+typedef uint32_t word_t;
+typedef int32_t sword_t;
+#define WORD_MAX UINT32_MAX
+#define PRIdWORD PRId32
+#define PRIuWORD PRIu32
+#define PRIxWORD PRIx32
+#define PRIXWORD PRIX32
+#elif WORD_SIZE == 64
+typedef uint64_t word_t;
+typedef int64_t sword_t;
+#define WORD_MAX UINT64_MAX
+#define PRIdWORD PRId64
+#define PRIuWORD PRIu64
+#define PRIxWORD PRIx64
+#define PRIXWORD PRIX64
+#else
+#error "WORD_SIZE must be 32 or 64"
+#endif
+
+#define WORD_BYTES (WORD_SIZE / 8)
+#define WORD_HEX_DIGITS (WORD_SIZE / 4)   // Field width for printing a word in hex
+
+#endif // WORD_H
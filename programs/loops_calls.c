@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+
+// Sieve of Eratosthenes over a global array
+char composite[200];
+
+int count_primes(int limit) {
+    int i, j, count = 0;
+    for (i = 2; i < limit; i++) {
+        if (composite[i]) {
+            continue;
+        }
+        count++;
+        for (j = i * i; j < limit; j += i) {
+            composite[j] = 1;
+        }
+    }
+    return count;
+}
+
+// Euclid's algorithm, recursive
+int gcd(int a, int b) {
+    if (b == 0) {
+        return a;
+    }
+    return gcd(b, a % b);
+}
+
+// Iterative and recursive Fibonacci
+int fib_loop(int n) {
+    int a = 0, b = 1;
+    while (n-- > 0) {
+        int t = a + b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int fib_rec(int n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib_rec(n - 1) + fib_rec(n - 2);
+}
+
+// Longest Collatz chain below a bound
+int collatz_steps(int n) {
+    int steps = 0;
+    do {
+        if (n % 2) {
+            n = 3 * n + 1;
+        } else {
+            n = n / 2;
+        }
+        steps++;
+    } while (n != 1);
+    return steps;
+}
+
+// Insertion sort through a pointer, returning the number of shifts
+int sort(int *values, int n) {
+    int i, shifts = 0;
+    for (i = 1; i < n; i++) {
+        int key = values[i], j = i - 1;
+        while (j >= 0 && values[j] > key) {
+            values[j + 1] = values[j];
+            j--;
+            shifts++;
+        }
+        values[j + 1] = key;
+    }
+    return shifts;
+}
+
+void reverse(char *s) {
+    int i = 0, j = strlen(s) - 1;
+    while (i < j) {
+        char t = s[i];
+        s[i++] = s[j];
+        s[j--] = t;
+    }
+}
+
+int main() {
+    int values[10];
+    char word[16];
+    int i, best = 0, best_start = 0;
+
+    printf("primes below 200: %d\n", count_primes(200));
+    printf("gcd(1071, 462) = %d\n", gcd(1071, 462));
+    printf("fib(24) = %d, fib(15) = %d\n", fib_loop(24), fib_rec(15));
+
+    for (i = 2; i < 100; i++) {
+        int steps = collatz_steps(i);
+        if (steps > best) {
+            best = steps;
+            best_start = i;
+        }
+    }
+    printf("longest collatz below 100: %d (%d steps)\n", best_start, best);
+
+    for (i = 0; i < 10; i++) {
+        values[i] = (i * 37 + 11) % 23 - 8;
+    }
+    printf("shifts: %d\n", sort(values, 10));
+    for (i = 0; i < 10; i++) {
+        printf("%d ", values[i]);
+    }
+    putchar('\n');
+
+    memcpy(word, "simulator", 10);
+    reverse(word);
+    puts(word);
+    return 0;
+}
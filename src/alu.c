@@ -3,11 +3,14 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#if defined(__BMI__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 // Helper function to update CPU flags for comprehensive integer handling
-static void update_flags(CPU *cpu, int32_t result, bool overflow) {
-    // Reset all flags
-    for (int i = 0; i < 16; i++) {
+static void update_flags(CPU *cpu, sword_t result, bool overflow) {
+    // Reset all result flags; the interrupt-enable flag is system state
+    for (int i = 0; i < FLAG_INTERRUPT; i++) {
         cpu->flags[i] = false;
     }
 
@@ -37,8 +40,8 @@ static void update_flags(CPU *cpu, int32_t result, bool overflow) {
         cpu->flags[FLAG_ODD] = true;
     }
 
-    // Unsigned Flags (for 32-bit unsigned representation)
-    if ((uint32_t)result == UINT32_MAX) {
+    // Unsigned Flags (for the WORD_SIZE-bit unsigned representation)
+    if ((word_t)result == WORD_MAX) {
         cpu->flags[FLAG_UNSIGNED_MAX] = true;
     }
     if (result == 0) {
@@ -47,8 +50,8 @@ static void update_flags(CPU *cpu, int32_t result, bool overflow) {
 }
 
 // Arithmetic Operations
-int32_t alu_add(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = a + b;
+sword_t alu_add(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = a + b;
     
     // Check for signed overflow
     bool overflow = ((a > 0 && b > 0 && result <= 0) || 
@@ -98,60 +101,152 @@ bool ripple_carry_adder(const bool *a, const bool *b, bool *result, size_t size)
 
 // Additional Primitive Functions
 
-// Count leading zeros in a 32-bit integer
+// Count leading zeros in a 32-bit integer; __builtin_clz is undefined for 0
 uint8_t count_leading_zeros(uint32_t x) {
-    uint8_t count = 0;
-    if (x == 0) return 32;
-    
-    while (!(x & 0x80000000)) {
-        count++;
-        x <<= 1;
-    }
-    
-    return count;
+    return x ? (uint8_t)__builtin_clz(x) : 32;
+}
+
+// Count trailing zeros in a 32-bit integer
+uint8_t count_trailing_zeros(uint32_t x) {
+    return x ? (uint8_t)__builtin_ctz(x) : 32;
+}
+
+// Count set bits in a 32-bit integer
+uint8_t population_count(uint32_t x) {
+    return (uint8_t)__builtin_popcount(x);
 }
 
 // Perform bit reversal of a 32-bit integer
 uint32_t bit_reverse(uint32_t x) {
-    x = ((x & 0xffff0000) >> 16) | ((x & 0x0000ffff) << 16);
-    x = ((x & 0xff00ff00) >> 8) | ((x & 0x00ff00ff) << 8);
+    x = __builtin_bswap32(x);
     x = ((x & 0xf0f0f0f0) >> 4) | ((x & 0x0f0f0f0f) << 4);
     x = ((x & 0xcccccccc) >> 2) | ((x & 0x33333333) << 2);
     x = ((x & 0xaaaaaaaa) >> 1) | ((x & 0x55555555) << 1);
     return x;
 }
 
+// Reverse the byte order of a 32-bit integer
+uint32_t byte_swap(uint32_t x) {
+    return __builtin_bswap32(x);
+}
+
 // Check if a number is a power of 2
 bool is_power_of_two(uint32_t x) {
     return x && !(x & (x - 1));
 }
 
-// Extract a bit field from a number
+// Mask of the low length bits; length may be 32 or more
+static uint32_t low_mask(uint8_t length) {
+#ifdef __BMI2__
+    return _bzhi_u32(UINT32_MAX, length);
+#else
+    return length >= 32 ? UINT32_MAX : (1U << length) - 1;
+#endif
+}
+
+// Extract a bit field from a number; bits past bit 31 read as zero
 uint32_t extract_bits(uint32_t x, uint8_t start, uint8_t length) {
-    uint32_t mask = ((1U << length) - 1) << start;
-    return (x & mask) >> start;
+#ifdef __BMI__
+    return _bextr_u32(x, start, length);
+#else
+    if (start >= 32) {
+        return 0;
+    }
+    return (x >> start) & low_mask(length);
+#endif
 }
 
-// Insert a bit field into a number
+// Insert a bit field into a number; field bits past bit 31 are dropped
 uint32_t insert_bits(uint32_t original, uint32_t field, uint8_t start, uint8_t length) {
-    uint32_t mask = ((1U << length) - 1) << start;
+    if (start >= 32) {
+        return original;
+    }
+    uint32_t mask = low_mask(length) << start;
     return (original & ~mask) | ((field << start) & mask);
 }
 
-// Rotate bits left
+// Rotate bits left; the masked form compiles to a single rotate
 uint32_t rotate_left(uint32_t x, uint8_t n) {
-    n %= 32;  // Ensure rotation is within 32-bit range
-    return (x << n) | (x >> (32 - n));
+    n &= 31;
+    return (x << n) | (x >> (-n & 31));
 }
 
 // Rotate bits right
 uint32_t rotate_right(uint32_t x, uint8_t n) {
-    n %= 32;  // Ensure rotation is within 32-bit range
-    return (x >> n) | (x << (32 - n));
+    n &= 31;
+    return (x >> n) | (x << (-n & 31));
+}
+
+// Word-width primitives behind the alu_* bit operations: the 32-bit engine
+// uses the functions above as they are, the 64-bit engine these widenings
+#if WORD_SIZE == 32
+#define word_leading_zeros count_leading_zeros
+#define word_trailing_zeros count_trailing_zeros
+#define word_population_count population_count
+#define word_bit_reverse bit_reverse
+#define word_byte_swap byte_swap
+#define word_extract_bits extract_bits
+#define word_insert_bits insert_bits
+#define word_rotate_left rotate_left
+#define word_rotate_right rotate_right
+#else
+static uint8_t word_leading_zeros(word_t x) {
+    return x ? (uint8_t)__builtin_clzll(x) : WORD_SIZE;
+}
+
+static uint8_t word_trailing_zeros(word_t x) {
+    return x ? (uint8_t)__builtin_ctzll(x) : WORD_SIZE;
+}
+
+static uint8_t word_population_count(word_t x) {
+    return (uint8_t)__builtin_popcountll(x);
+}
+
+// Reverse each half, then swap the halves
+static word_t word_bit_reverse(word_t x) {
+    return ((word_t)bit_reverse((uint32_t)x) << 32) | bit_reverse((uint32_t)(x >> 32));
+}
+
+static word_t word_byte_swap(word_t x) {
+    return __builtin_bswap64(x);
+}
+
+static word_t word_low_mask(uint8_t length) {
+    return length >= WORD_SIZE ? WORD_MAX : ((word_t)1 << length) - 1;
+}
+
+static word_t word_extract_bits(word_t x, uint8_t start, uint8_t length) {
+#ifdef __BMI__
+    return _bextr_u64(x, start, length);
+#else
+    if (start >= WORD_SIZE) {
+        return 0;
+    }
+    return (x >> start) & word_low_mask(length);
+#endif
+}
+
+static word_t word_insert_bits(word_t original, word_t field, uint8_t start, uint8_t length) {
+    if (start >= WORD_SIZE) {
+        return original;
+    }
+    word_t mask = word_low_mask(length) << start;
+    return (original & ~mask) | ((field << start) & mask);
+}
+
+static word_t word_rotate_left(word_t x, uint8_t n) {
+    n &= WORD_SIZE - 1;
+    return (x << n) | (x >> (-n & (WORD_SIZE - 1)));
+}
+
+static word_t word_rotate_right(word_t x, uint8_t n) {
+    n &= WORD_SIZE - 1;
+    return (x >> n) | (x << (-n & (WORD_SIZE - 1)));
 }
+#endif
 
-int32_t alu_subtract(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = a - b;
+sword_t alu_subtract(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = a - b;
     update_flags(cpu, result, false);
 
     // Detect signed overflow
@@ -161,94 +256,150 @@ int32_t alu_subtract(CPU *cpu, int32_t a, int32_t b) {
     return result;
 }
 
-int32_t alu_mul(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = a * b;
+sword_t alu_mul(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = a * b;
     update_flags(cpu, result, false);
     return result; // Overflow detection is typically not included for multiplication in simple ALUs
 }
 
-int32_t alu_div(CPU *cpu, int32_t a, int32_t b) {
+sword_t alu_div(CPU *cpu, sword_t a, sword_t b) {
     if (b == 0) {
         fprintf(stderr, "Error: Division by zero.\n");
         cpu->halted = true; // Halt the CPU on division by zero
         return 0;
     }
-    int32_t result = a / b;
+    sword_t result = a / b;
     update_flags(cpu, result, false);
     return result;
 }
 
 // Logical Operations
-int32_t alu_and(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = a & b;
+sword_t alu_and(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = a & b;
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_or(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = a | b;
+sword_t alu_or(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = a | b;
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_xor(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = a ^ b;
+sword_t alu_xor(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = a ^ b;
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_not(CPU *cpu, int32_t a) {
-    int32_t result = ~a;
+sword_t alu_not(CPU *cpu, sword_t a) {
+    sword_t result = ~a;
     update_flags(cpu, result, false);
     return result;
 }
 
 // Shift Operations
-int32_t alu_shl(CPU *cpu, int32_t a, int32_t shift) {
-    int32_t result = a << shift;
+sword_t alu_shl(CPU *cpu, sword_t a, sword_t shift) {
+    sword_t result = a << shift;
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_shr(CPU *cpu, int32_t a, int32_t shift) {
-    int32_t result = (int32_t)((uint32_t)a >> shift); // Perform logical right shift
+sword_t alu_shr(CPU *cpu, sword_t a, sword_t shift) {
+    sword_t result = (sword_t)((word_t)a >> shift); // Perform logical right shift
     update_flags(cpu, result, false);
     return result;
 }
 
 // Comparison Operations
-int32_t alu_eq(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = (a == b) ? 1 : 0;
+sword_t alu_eq(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = (a == b) ? 1 : 0;
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_neq(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = (a != b) ? 1 : 0;
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_gt(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = (a > b) ? 1 : 0;
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_lt(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = (a < b) ? 1 : 0;
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_ge(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = (a >= b) ? 1 : 0;
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_le(CPU *cpu, sword_t a, sword_t b) {
+    sword_t result = (a <= b) ? 1 : 0;
+    update_flags(cpu, result, false);
+    return result;
+}
+
+// Bit Manipulation Operations
+sword_t alu_clz(CPU *cpu, sword_t a) {
+    sword_t result = word_leading_zeros((word_t)a);
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_ctz(CPU *cpu, sword_t a) {
+    sword_t result = word_trailing_zeros((word_t)a);
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_popcnt(CPU *cpu, sword_t a) {
+    sword_t result = word_population_count((word_t)a);
+    update_flags(cpu, result, false);
+    return result;
+}
+
+sword_t alu_rol(CPU *cpu, sword_t a, sword_t shift) {
+    sword_t result = (sword_t)word_rotate_left((word_t)a, (uint8_t)shift);
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_neq(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = (a != b) ? 1 : 0;
+sword_t alu_ror(CPU *cpu, sword_t a, sword_t shift) {
+    sword_t result = (sword_t)word_rotate_right((word_t)a, (uint8_t)shift);
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_gt(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = (a > b) ? 1 : 0;
+sword_t alu_bext(CPU *cpu, sword_t a, sword_t control) {
+    sword_t result = (sword_t)word_extract_bits((word_t)a, (uint8_t)control, (uint8_t)(control >> 8));
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_lt(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = (a < b) ? 1 : 0;
+sword_t alu_bins(CPU *cpu, sword_t original, sword_t field, sword_t control) {
+    sword_t result = (sword_t)word_insert_bits((word_t)original, (word_t)field,
+                                               (uint8_t)control, (uint8_t)(control >> 8));
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_ge(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = (a >= b) ? 1 : 0;
+sword_t alu_brev(CPU *cpu, sword_t a) {
+    sword_t result = (sword_t)word_bit_reverse((word_t)a);
     update_flags(cpu, result, false);
     return result;
 }
 
-int32_t alu_le(CPU *cpu, int32_t a, int32_t b) {
-    int32_t result = (a <= b) ? 1 : 0;
+sword_t alu_bswap(CPU *cpu, sword_t a) {
+    sword_t result = (sword_t)word_byte_swap((word_t)a);
     update_flags(cpu, result, false);
     return result;
 }
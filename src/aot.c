@@ -0,0 +1,526 @@
+#include "aot.h"
+#include "instructions.h"
+#include "memory.h"
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Counter names for the generated code, indexed by PerfCounter
+static const char *const perf_names[PERF_COUNTER_COUNT] = {
+    "PERF_INSTRUCTIONS", "PERF_CYCLES", "PERF_BRANCHES", "PERF_LOADS", "PERF_STORES", "PERF_CACHE_MISSES"
+};
+
+// State while writing one block
+typedef struct {
+    FILE *out;
+    uint32_t written;                       // Registers assigned so far
+    uint32_t counts[PERF_COUNTER_COUNT];    // Not yet added to perf_counters
+} BlockWriter;
+
+// Hash an image with 64-bit FNV-1a
+uint64_t image_hash(const uint8_t *memory, uint32_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (uint32_t i = 0; i < size; i++) {
+        hash = (hash ^ memory[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// ALU routine the interpreter calls for an opcode, or NULL
+static const char *alu_routine(Opcode opcode) {
+    switch (opcode) {
+        case ADD: case ADDI: return "alu_add";
+        case SUB: return "alu_subtract";
+        case MUL: return "alu_mul";
+        case DIV: return "alu_div";
+        case AND: return "alu_and";
+        case OR: return "alu_or";
+        case XOR: return "alu_xor";
+        case NOT: return "alu_not";
+        case SHL: return "alu_shl";
+        case SHR: return "alu_shr";
+        case EQ: return "alu_eq";
+        case NEQ: return "alu_neq";
+        case GT: return "alu_gt";
+        case LT: return "alu_lt";
+        case GE: return "alu_ge";
+        case LE: return "alu_le";
+        case CLZ: return "alu_clz";
+        case CTZ: return "alu_ctz";
+        case POPCNT: return "alu_popcnt";
+        case ROL: return "alu_rol";
+        case ROR: return "alu_ror";
+        case BEXT: return "alu_bext";
+        case BINS: return "alu_bins";
+        case BREV: return "alu_brev";
+        case BSWAP: return "alu_bswap";
+        default: return NULL;
+    }
+}
+
+// Number of leading operands naming general registers, or -1 if the
+// instruction is left to the interpreter
+static int register_operands(Opcode opcode) {
+    switch (opcode) {
+        case ADD: case SUB: case MUL: case DIV: case AND: case OR: case XOR:
+        case EQ: case NEQ: case GT: case LT: case GE: case LE: case BEXT: case BINS:
+            return 3;
+        case NOT: case SHL: case SHR: case CLZ: case CTZ: case POPCNT: case ROL: case ROR:
+        case BREV: case BSWAP: case ADDI: case MOV:
+            return 2;
+        case LOAD: case STORE: case PUSH: case POP: case JUMP: case JZ: case JNZ: case CALL:
+            return 1;
+        case RET: case HALT: case NOP: case BRA: case BZ: case BNZ:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// Check that an instruction can be translated, including its register numbers
+static bool translatable(Instruction instr) {
+    int count = register_operands(instr.opcode);
+    for (int i = 0; i < count; i++) {
+        if (instr.operands[i] >= REGISTER_COUNT) {
+            return false;
+        }
+    }
+    return count >= 0;
+}
+
+// Control transfers and stores end a block; stores so that the runner sees
+// writes to code before running more of it
+static bool ends_block(Opcode opcode) {
+    switch (opcode) {
+        case JUMP: case JZ: case JNZ: case CALL: case RET: case BRA: case BZ: case BNZ:
+        case HALT: case STORE: case PUSH:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Registers an instruction reads or writes, as a bit mask
+static uint32_t registers_used(Instruction instr) {
+    uint32_t mask = 0;
+    for (int i = 0; i < register_operands(instr.opcode); i++) {
+        mask |= 1u << instr.operands[i];
+    }
+    return mask;
+}
+
+// Emit the pending counter updates
+static void write_counts(const BlockWriter *w) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (w->counts[i]) {
+            fprintf(w->out, "    perf[%s] += %u;\n", perf_names[i], w->counts[i]);
+        }
+    }
+}
+
+// Emit the pending counter updates ahead of a call that may observe them
+static void flush_counts(BlockWriter *w) {
+    write_counts(w);
+    memset(w->counts, 0, sizeof(w->counts));
+}
+
+// Emit a block exit: write back the registers, settle the counters and
+// return the next PC
+static void write_exit(const BlockWriter *w, const char *indent, const char *next) {
+    for (uint32_t r = 0; r < REGISTER_COUNT; r++) {
+        if (w->written & 1u << r) {
+            fprintf(w->out, "%s    cpu->registers[%u] = (sword_t)r%u;\n", indent, r, r);
+        }
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (w->counts[i]) {
+            fprintf(w->out, "%s    perf[%s] += %u;\n", indent, perf_names[i], w->counts[i]);
+        }
+    }
+    fprintf(w->out, "%s    return %s;\n", indent, next);
+}
+
+// Emit one instruction; returns false if it ended the block with an exit
+static bool write_instruction(BlockWriter *w, Instruction instr, uint32_t pc, uint32_t next) {
+    FILE *out = w->out;
+    uint32_t a = instr.operands[0], b = instr.operands[1], c = instr.operands[2];
+    const char *alu = alu_routine(instr.opcode);
+    char target[64];
+    char fall[16];
+    snprintf(fall, sizeof(fall), "0x%03Xu", next);
+    snprintf(target, sizeof(target), "0x%03Xu", pc + (uint32_t)branch_offset(instr));
+
+    w->counts[PERF_INSTRUCTIONS]++;
+    switch (instr.opcode) {
+        case ADDI:
+            fprintf(out, "    r%u = %s(cpu, r%u, %d);\n", a, alu, b, (int8_t)c);
+            break;
+        case SHL: case SHR: case ROL: case ROR:
+            fprintf(out, "    r%u = %s(cpu, r%u, %u);\n", a, alu, b, c);
+            break;
+        case NOT: case CLZ: case CTZ: case POPCNT: case BREV: case BSWAP:
+            fprintf(out, "    r%u = %s(cpu, r%u);\n", a, alu, b);
+            break;
+        case BINS:
+            fprintf(out, "    r%u = %s(cpu, r%u, r%u, r%u);\n", a, alu, a, b, c);
+            break;
+        case MOV:
+            fprintf(out, "    r%u = r%u;\n", a, b);
+            break;
+        case NOP:
+            break;
+        case LOAD:
+            flush_counts(w);
+            fprintf(out, "    r%u = load_word(cpu, 0x%02Xu);\n", a, b);
+            w->counts[PERF_LOADS]++;
+            break;
+        case POP:
+            flush_counts(w);
+            fprintf(out, "    r%u = load_word(cpu, cpu->stack_pointer);\n", a);
+            fprintf(out, "    cpu->stack_pointer += WORD_BYTES;\n");
+            w->counts[PERF_LOADS]++;
+            break;
+        case STORE:
+            flush_counts(w);
+            fprintf(out, "    store_word(cpu, 0x%02Xu, r%u);\n", b, a);
+            w->counts[PERF_STORES]++;
+            break;
+        case PUSH:
+            flush_counts(w);
+            fprintf(out, "    cpu->stack_pointer -= WORD_BYTES;\n");
+            fprintf(out, "    store_word(cpu, cpu->stack_pointer, r%u);\n", a);
+            w->counts[PERF_STORES]++;
+            break;
+        case CALL:
+            flush_counts(w);
+            fprintf(out, "    cpu->stack_pointer -= WORD_BYTES;\n");
+            fprintf(out, "    store_word(cpu, cpu->stack_pointer, %s);\n", fall);
+            w->counts[PERF_BRANCHES]++;
+            w->counts[PERF_STORES]++;
+            snprintf(target, sizeof(target), "(uint32_t)r%u", a);
+            write_exit(w, "", target);
+            return false;
+        case RET:
+            flush_counts(w);
+            fprintf(out, "    uint32_t target = (uint32_t)load_word(cpu, cpu->stack_pointer);\n");
+            fprintf(out, "    cpu->stack_pointer += WORD_BYTES;\n");
+            w->counts[PERF_BRANCHES]++;
+            w->counts[PERF_LOADS]++;
+            write_exit(w, "", "target");
+            return false;
+        case JUMP:
+            w->counts[PERF_BRANCHES]++;
+            snprintf(target, sizeof(target), "(uint32_t)r%u", a);
+            write_exit(w, "", target);
+            return false;
+        case JZ: case JNZ: case BZ: case BNZ: {
+            char choice[128];
+            bool zero = instr.opcode == JZ || instr.opcode == BZ;
+            if (instr.opcode == JZ || instr.opcode == JNZ) {
+                snprintf(target, sizeof(target), "(uint32_t)r%u", a);
+            }
+            snprintf(choice, sizeof(choice), "%scpu->flags[FLAG_ZERO] ? %s : %s", zero ? "" : "!", target, fall);
+            w->counts[PERF_BRANCHES]++;
+            write_exit(w, "", choice);
+            return false;
+        }
+        case BRA:
+            w->counts[PERF_BRANCHES]++;
+            write_exit(w, "", target);
+            return false;
+        case HALT:
+            fprintf(out, "    cpu->halted = true;\n");
+            write_exit(w, "", fall);
+            return false;
+        default:
+            // Three-register ALU operations; only DIV can halt
+            fprintf(out, "    r%u = %s(cpu, r%u, r%u);\n", a, alu, b, c);
+            if (instr.opcode == DIV) {
+                w->written |= 1u << a;
+                fprintf(out, "    if (cpu->halted) {\n");
+                write_exit(w, "    ", fall);
+                fprintf(out, "    }\n");
+            }
+            break;
+    }
+
+    if (register_operands(instr.opcode) > 0 && instr.opcode != STORE && instr.opcode != PUSH) {
+        w->written |= 1u << a;
+    }
+    if (ends_block(instr.opcode)) {     // STORE and PUSH
+        write_exit(w, "", fall);
+        return false;
+    }
+    return true;
+}
+
+// Emit the function for a block of count instructions starting at start
+static void write_block(FILE *out, CPU *cpu, uint32_t start, uint32_t count, uint32_t end) {
+    uint32_t used = 0;
+    uint32_t length;
+    uint32_t pc = start;
+    for (uint32_t i = 0; i < count; i++, pc += length) {
+        used |= registers_used(decode_instruction(decode_cached(cpu, pc, &length)));
+    }
+
+    fprintf(out, "\n// 0x%03X-0x%03X: %u instructions\n", start, end - 1, count);
+    fprintf(out, "static uint32_t block_%03X(CPU *cpu) {\n", start);
+    fprintf(out, "    uint64_t *perf = cpu->perf_counters;\n");
+    for (uint32_t r = 0; r < REGISTER_COUNT; r++) {
+        if (used & 1u << r) {
+            fprintf(out, "    word_t r%u = (word_t)cpu->registers[%u];\n", r, r);
+        }
+    }
+
+    BlockWriter w = {out, 0, {0}};
+    pc = start;
+    for (uint32_t i = 0; i < count; i++) {
+        Instruction instr = decode_instruction(decode_cached(cpu, pc, &length));
+        if (!write_instruction(&w, instr, pc, pc + length)) {
+            fprintf(out, "}\n");
+            return;
+        }
+        pc += length;
+    }
+    char next[16];
+    snprintf(next, sizeof(next), "0x%03Xu", pc);
+    write_exit(&w, "", next);
+    fprintf(out, "}\n");
+}
+
+// Translate an image to C: find instruction starts and block leaders, then
+// emit a function per block and the tables load_native_image reads
+int translate_image(const char *image_file, const char *output_file) {
+    CPU *cpu = malloc(sizeof(CPU));
+    if (!cpu) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+    reset_cpu(cpu);
+    int image_size = load_image(cpu->memory, image_file);
+    if (image_size < 0) {
+        free(cpu);
+        return -1;
+    }
+    uint32_t code_end = (uint32_t)image_size < MEMORY_SIZE ? (uint32_t)image_size : MEMORY_SIZE;
+
+    // Walk the code from CODE_START, marking where instructions begin
+    bool starts[INSTRUCTION_SLOTS] = {false};
+    bool leaders[INSTRUCTION_SLOTS] = {false};
+    uint32_t length;
+    uint32_t total = 0;
+    for (uint32_t pc = CODE_START; pc + 2 <= code_end; pc += length) {
+        uint32_t raw = decode_cached(cpu, pc, &length);
+        if (length == 0) {
+            break;
+        }
+        starts[pc / 2] = true;
+        total++;
+
+        Instruction instr = decode_instruction(raw);
+        uint32_t next = pc + length;
+        if (instr.opcode == BRA || instr.opcode == BZ || instr.opcode == BNZ) {
+            uint32_t target = pc + (uint32_t)branch_offset(instr);
+            if (target < code_end && target % 2 == 0) {
+                leaders[target / 2] = true;
+            }
+        }
+        if ((ends_block(instr.opcode) || !translatable(instr)) && next < code_end) {
+            leaders[next / 2] = true;
+        }
+    }
+    if (code_end > CODE_START) {
+        leaders[CODE_START / 2] = true;
+    }
+
+    // Words that look like code addresses may be JUMP or CALL targets
+    for (uint32_t address = 0; address + 4 <= code_end; address += 4) {
+        uint32_t value = read_memory(cpu->memory, address);
+        if (value >= CODE_START && value < code_end && value % 2 == 0) {
+            leaders[value / 2] = true;
+        }
+    }
+
+    FILE *out = fopen(output_file, "w");
+    if (!out) {
+        perror("Error opening translation output");
+        free(cpu);
+        return -1;
+    }
+    fprintf(out, "// Translated from %s by --translate; build with\n", image_file);
+    fprintf(out, "// cc -O2 -shared -fPIC -I include -o LIBRARY.so %s\n", output_file);
+    fprintf(out, "#define WORD_SIZE %d\n", WORD_SIZE);
+    fprintf(out, "#include \"instructions.h\"\n");
+    fprintf(out, "#include \"aot.h\"\n");
+
+    // Form blocks from every translatable leader, splitting long runs
+    uint16_t block_lengths[INSTRUCTION_SLOTS] = {0};
+    uint16_t block_sizes[INSTRUCTION_SLOTS] = {0};
+    uint32_t block_count = 0;
+    uint32_t covered = 0;
+    for (uint32_t slot = CODE_START / 2; slot < code_end / 2; slot++) {
+        if (!leaders[slot] || !starts[slot]) {
+            continue;
+        }
+        uint32_t start = slot * 2;
+        uint32_t pc = start;
+        uint32_t count = 0;
+        while (pc < code_end && count < NATIVE_MAX_BLOCK) {
+            Instruction instr = decode_instruction(decode_cached(cpu, pc, &length));
+            if (!translatable(instr) || (count > 0 && leaders[pc / 2])) {
+                break;
+            }
+            count++;
+            pc += length;
+            if (ends_block(instr.opcode)) {
+                break;
+            }
+        }
+        if (count == NATIVE_MAX_BLOCK && pc < code_end) {
+            leaders[pc / 2] = true;
+        }
+        if (count == 0) {
+            continue;
+        }
+        write_block(out, cpu, start, count, pc);
+        block_lengths[slot] = (uint16_t)count;
+        block_sizes[slot] = (uint16_t)(pc - start);
+        block_count++;
+        covered += count;
+    }
+
+    fprintf(out, "\nconst NativeBlockEntry native_blocks[] = {\n");
+    for (uint32_t slot = 0; slot < INSTRUCTION_SLOTS; slot++) {
+        if (block_lengths[slot]) {
+            fprintf(out, "    {0x%03X, %u, %u, block_%03X},\n", slot * 2, block_lengths[slot],
+                    block_sizes[slot], slot * 2);
+        }
+    }
+    fprintf(out, "    {0, 0, 0, 0}\n};\n");
+    fprintf(out, "\nconst NativeHeader native_header = {\n");
+    fprintf(out, "    NATIVE_FORMAT, WORD_SIZE, 0x%016llXull, %u, 0x%03X, 0x%03X, %u\n};\n",
+            (unsigned long long)image_hash(cpu->memory, code_end), (uint32_t)image_size,
+            CODE_START, code_end, block_count);
+
+    int status = 0;
+    if (fclose(out) != 0) {
+        perror("Error writing translation output");
+        status = -1;
+    } else {
+        printf("Translated %s: %u blocks covering %u of %u instructions\n", image_file, block_count,
+               covered, total);
+    }
+    free(cpu);
+    return status;
+}
+
+// Open a translated library and fill the block table
+int load_native_image(NativeImage *native, const char *library, const CPU *cpu, uint32_t image_size) {
+    memset(native, 0, sizeof(*native));
+
+    // dlopen searches the library path for bare names, so anchor them here
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%s", strchr(library, '/') ? "" : "./", library);
+    native->library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!native->library) {
+        fprintf(stderr, "Error: %s\n", dlerror());
+        return -1;
+    }
+
+    const NativeHeader *header = dlsym(native->library, "native_header");
+    const NativeBlockEntry *entries = dlsym(native->library, "native_blocks");
+    uint32_t hashed = image_size < MEMORY_SIZE ? image_size : MEMORY_SIZE;
+    const char *problem = NULL;
+    if (!header || !entries || header->format != NATIVE_FORMAT) {
+        problem = "is not a translated image";
+    } else if (header->word_size != WORD_SIZE) {
+        problem = "was translated for another word size";
+    } else if (header->image_size != image_size || header->image_hash != image_hash(cpu->memory, hashed)) {
+        problem = "was translated from a different image";
+    }
+    if (problem) {
+        fprintf(stderr, "Error: %s %s\n", library, problem);
+        close_native_image(native);
+        return -1;
+    }
+
+    native->code_start = header->code_start;
+    native->code_end = header->code_end;
+    for (uint32_t i = 0; i < header->block_count; i++) {
+        const NativeBlockEntry *entry = &entries[i];
+        uint32_t slot = entry->address / 2;
+        if (entry->address % 2 != 0 || slot >= INSTRUCTION_SLOTS || !entry->run) {
+            continue;
+        }
+        native->blocks[slot] = entry->run;
+        native->lengths[slot] = entry->instructions;
+        native->sizes[slot] = entry->bytes;
+    }
+    return 0;
+}
+
+// Drop every block overlapping a written range
+static void invalidate_native(NativeImage *native, uint32_t address, uint32_t size) {
+    if (address >= native->code_end || address + size <= native->code_start) {
+        return;
+    }
+    uint32_t reach = NATIVE_MAX_BLOCK * 4;      // Largest block in bytes
+    uint32_t first = address > native->code_start + reach ? address - reach : native->code_start;
+    for (uint32_t slot = first / 2; slot < INSTRUCTION_SLOTS && slot * 2 < address + size; slot++) {
+        if (native->blocks[slot] && slot * 2 + native->sizes[slot] > address) {
+            native->blocks[slot] = NULL;
+            native->invalidated++;
+        }
+    }
+}
+
+// Run blocks natively where it is safe, and step the interpreter elsewhere
+void run_native(NativeImage *native, CPU *cpu, uint64_t max_instructions) {
+    uint64_t *perf = cpu->perf_counters;
+    uint64_t executed = 0;
+    while (!cpu->halted && executed < max_instructions) {
+        uint32_t pc = cpu->program_counter;
+        uint32_t slot = pc / 2;
+        NativeBlock block = pc % 2 == 0 && slot < INSTRUCTION_SLOTS ? native->blocks[slot] : NULL;
+
+        // The interpreter checks for interrupts before every instruction, so
+        // a block only runs if none can become due inside it
+        if (block && !cpu->paging && !cpu->trace_execution &&
+            perf[PERF_INSTRUCTIONS] + native->lengths[slot] <= cpu->next_event &&
+            executed + native->lengths[slot] <= max_instructions) {
+            uint64_t before = perf[PERF_INSTRUCTIONS];
+            cpu->store_size = 0;
+            cpu->program_counter = block(cpu);
+            uint64_t ran = perf[PERF_INSTRUCTIONS] - before;
+            executed += ran;
+            native->native_instructions += ran;
+            native->blocks_run++;
+        } else {
+            step_cpu(cpu);
+            executed++;
+            native->interpreted_instructions++;
+        }
+        if (cpu->store_size) {
+            invalidate_native(native, cpu->store_address, cpu->store_size);
+        }
+    }
+}
+
+// Print the native share of the run
+void display_native(const NativeImage *native) {
+    uint64_t total = native->native_instructions + native->interpreted_instructions;
+    printf("Native: %llu blocks run, %llu instructions native (%.1f%%), %llu interpreted, %u blocks invalidated\n",
+           (unsigned long long)native->blocks_run, (unsigned long long)native->native_instructions,
+           total ? 100.0 * (double)native->native_instructions / (double)total : 0.0,
+           (unsigned long long)native->interpreted_instructions, native->invalidated);
+}
+
+// Unload the library
+void close_native_image(NativeImage *native) {
+    if (native->library) {
+        dlclose(native->library);
+        native->library = NULL;
+    }
+    memset(native->blocks, 0, sizeof(native->blocks));
+}
@@ -194,6 +194,6 @@ void demonstrate_fetch_decode_execute(CPU *cpu) {
     // Memory/Register State
     printf("\nMEMORY/REGISTER State:\n");
     for (int i = 0; i < 8; i++) {
-        printf("  R%d: %d\n", i, cpu->registers[i]);
+        printf("  R%d: %" PRIdWORD "\n", i, cpu->registers[i]);
     }
 }
@@ -0,0 +1,473 @@
+#include "breakpoints.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+// Recursive-descent compiler state
+typedef struct {
+    const char *text;
+    const char *cursor;
+    Condition *condition;
+    int depth;                  // Stack depth after the code emitted so far
+    bool failed;
+} ConditionParser;
+
+static void parse_or(ConditionParser *parser);
+
+static void condition_error(ConditionParser *parser, const char *message) {
+    if (!parser->failed) {
+        fprintf(stderr, "Error: %s at column %d of condition \"%s\"\n", message,
+                (int)(parser->cursor - parser->text) + 1, parser->text);
+    }
+    parser->failed = true;
+}
+
+// Append an opcode, tracking the evaluation stack depth
+static void emit_op(ConditionParser *parser, ConditionOp op, int depth_change) {
+    Condition *condition = parser->condition;
+    if (condition->length >= CONDITION_CODE_SIZE - 1) {
+        condition_error(parser, "Condition too long");
+        return;
+    }
+    condition->code[condition->length++] = (uint8_t)op;
+    parser->depth += depth_change;
+    if (parser->depth > CONDITION_STACK_SIZE) {
+        condition_error(parser, "Condition nested too deeply");
+    }
+}
+
+static void emit_byte(ConditionParser *parser, uint8_t value) {
+    if (parser->condition->length >= CONDITION_CODE_SIZE - 1) {
+        condition_error(parser, "Condition too long");
+        return;
+    }
+    parser->condition->code[parser->condition->length++] = value;
+}
+
+static void skip_spaces(ConditionParser *parser) {
+    while (isspace((unsigned char)*parser->cursor)) {
+        parser->cursor++;
+    }
+}
+
+// Consume a token if it comes next
+static bool accept(ConditionParser *parser, const char *token) {
+    skip_spaces(parser);
+    size_t length = strlen(token);
+    if (strncmp(parser->cursor, token, length) != 0) {
+        return false;
+    }
+    // Keep "<" from matching the start of "<=", and "&" the start of "&&"
+    char next = parser->cursor[length];
+    if (length == 1 && (next == '=' || (next == token[0] && (next == '&' || next == '|')))) {
+        return false;
+    }
+    parser->cursor += length;
+    return true;
+}
+
+static bool accept_word(ConditionParser *parser, const char *word) {
+    skip_spaces(parser);
+    size_t length = strlen(word);
+    if (strncasecmp(parser->cursor, word, length) != 0 || isalnum((unsigned char)parser->cursor[length])) {
+        return false;
+    }
+    parser->cursor += length;
+    return true;
+}
+
+// primary := number | Rn | PC | SP | mem[expr] | (expr)
+static void parse_primary(ConditionParser *parser) {
+    skip_spaces(parser);
+    const char *cursor = parser->cursor;
+
+    if (isdigit((unsigned char)*cursor)) {
+        char *end;
+        uint32_t value = (uint32_t)strtoul(cursor, &end, 0);
+        parser->cursor = end;
+        emit_op(parser, COND_CONST, 1);
+        for (int i = 0; i < 4; i++) {
+            emit_byte(parser, (uint8_t)(value >> (8 * i)));
+        }
+    } else if ((*cursor == 'R' || *cursor == 'r') && isdigit((unsigned char)cursor[1]) &&
+               !isalnum((unsigned char)cursor[2])) {
+        int reg = cursor[1] - '0';
+        if (reg >= REGISTER_COUNT) {
+            condition_error(parser, "Unknown register");
+            return;
+        }
+        parser->cursor += 2;
+        emit_op(parser, COND_REGISTER, 1);
+        emit_byte(parser, (uint8_t)reg);
+    } else if (accept_word(parser, "PC")) {
+        emit_op(parser, COND_PC, 1);
+    } else if (accept_word(parser, "SP")) {
+        emit_op(parser, COND_SP, 1);
+    } else if (accept_word(parser, "mem")) {
+        if (!accept(parser, "[")) {
+            condition_error(parser, "Expected '['");
+            return;
+        }
+        parse_or(parser);
+        if (!accept(parser, "]")) {
+            condition_error(parser, "Expected ']'");
+            return;
+        }
+        emit_op(parser, COND_MEMORY, 0);
+    } else if (accept(parser, "(")) {
+        parse_or(parser);
+        if (!accept(parser, ")")) {
+            condition_error(parser, "Expected ')'");
+        }
+    } else {
+        condition_error(parser, "Expected a number, register or mem[...]");
+    }
+}
+
+// unary := ! unary | - unary | primary
+static void parse_unary(ConditionParser *parser) {
+    if (accept(parser, "!")) {
+        parse_unary(parser);
+        emit_op(parser, COND_NOT, 0);
+    } else if (accept(parser, "-")) {
+        parse_unary(parser);
+        emit_op(parser, COND_NEGATE, 0);
+    } else {
+        parse_primary(parser);
+    }
+}
+
+// sum := unary (('+' | '-' | '&') unary)*
+static void parse_sum(ConditionParser *parser) {
+    parse_unary(parser);
+    while (!parser->failed) {
+        ConditionOp op;
+        if (accept(parser, "+")) {
+            op = COND_ADD;
+        } else if (accept(parser, "-")) {
+            op = COND_SUB;
+        } else if (accept(parser, "&")) {
+            op = COND_BIT_AND;
+        } else {
+            break;
+        }
+        parse_unary(parser);
+        emit_op(parser, op, -1);
+    }
+}
+
+// compare := sum (relop sum)?
+static void parse_compare(ConditionParser *parser) {
+    static const struct {
+        const char *token;
+        ConditionOp op;
+    } relops[] = {
+        {"==", COND_EQ}, {"!=", COND_NE}, {"<=", COND_LE}, {">=", COND_GE}, {"<", COND_LT}, {">", COND_GT},
+    };
+
+    parse_sum(parser);
+    for (size_t i = 0; i < sizeof(relops) / sizeof(relops[0]); i++) {
+        if (accept(parser, relops[i].token)) {
+            parse_sum(parser);
+            emit_op(parser, relops[i].op, -1);
+            return;
+        }
+    }
+}
+
+// and := compare ('&&' compare)*
+static void parse_and(ConditionParser *parser) {
+    parse_compare(parser);
+    while (!parser->failed && accept(parser, "&&")) {
+        parse_compare(parser);
+        emit_op(parser, COND_AND, -1);
+    }
+}
+
+// or := and ('||' and)*
+static void parse_or(ConditionParser *parser) {
+    parse_and(parser);
+    while (!parser->failed && accept(parser, "||")) {
+        parse_and(parser);
+        emit_op(parser, COND_OR, -1);
+    }
+}
+
+// Compile a condition expression to bytecode
+int compile_condition(const char *text, Condition *condition) {
+    memset(condition, 0, sizeof(*condition));
+    if (text == NULL) {
+        return 0;
+    }
+
+    ConditionParser parser = {text, text, condition, 0, false};
+    skip_spaces(&parser);
+    if (*parser.cursor == '\0') {
+        return 0;
+    }
+
+    parse_or(&parser);
+    skip_spaces(&parser);
+    if (!parser.failed && *parser.cursor != '\0') {
+        condition_error(&parser, "Unexpected text");
+    }
+    if (parser.failed) {
+        memset(condition, 0, sizeof(*condition));
+        return -1;
+    }
+    condition->code[condition->length] = COND_END;
+    return 0;
+}
+
+// Evaluate compiled bytecode; the compiler guarantees the stack bounds
+bool evaluate_condition(const Condition *condition, const CPU *cpu) {
+    if (condition->length == 0) {
+        return true;
+    }
+
+    sword_t stack[CONDITION_STACK_SIZE];
+    int top = -1;
+    const uint8_t *code = condition->code;
+
+    for (int pc = 0; pc < condition->length;) {
+        ConditionOp op = (ConditionOp)code[pc++];
+        sword_t right;
+        switch (op) {
+            case COND_CONST:
+                stack[++top] = (int32_t)((uint32_t)code[pc] | (uint32_t)code[pc + 1] << 8 |
+                                         (uint32_t)code[pc + 2] << 16 | (uint32_t)code[pc + 3] << 24);
+                pc += 4;
+                break;
+            case COND_REGISTER:
+                stack[++top] = cpu->registers[code[pc++]];
+                break;
+            case COND_PC:
+                stack[++top] = cpu->program_counter;
+                break;
+            case COND_SP:
+                stack[++top] = cpu->stack_pointer;
+                break;
+            case COND_MEMORY: {
+                uint32_t address = (uint32_t)stack[top];
+                stack[top] = address <= MEMORY_SIZE - WORD_BYTES
+                                 ? (sword_t)read_memory_word(cpu->memory, address) : 0;
+                break;
+            }
+            case COND_NOT:
+                stack[top] = !stack[top];
+                break;
+            case COND_NEGATE:
+                stack[top] = (sword_t)((word_t)0 - (word_t)stack[top]);
+                break;
+            default:
+                right = stack[top--];
+                switch (op) {
+                    case COND_ADD: stack[top] = (sword_t)((word_t)stack[top] + (word_t)right); break;
+                    case COND_SUB: stack[top] = (sword_t)((word_t)stack[top] - (word_t)right); break;
+                    case COND_BIT_AND: stack[top] &= right; break;
+                    case COND_EQ: stack[top] = stack[top] == right; break;
+                    case COND_NE: stack[top] = stack[top] != right; break;
+                    case COND_LT: stack[top] = stack[top] < right; break;
+                    case COND_GT: stack[top] = stack[top] > right; break;
+                    case COND_LE: stack[top] = stack[top] <= right; break;
+                    case COND_GE: stack[top] = stack[top] >= right; break;
+                    case COND_AND: stack[top] = stack[top] && right; break;
+                    case COND_OR: stack[top] = stack[top] || right; break;
+                    default: return true;       // COND_END
+                }
+                break;
+        }
+    }
+    return top >= 0 && stack[top] != 0;
+}
+
+// Initialize an empty engine
+void init_breakpoints(BreakpointEngine *engine) {
+    memset(engine, 0, sizeof(*engine));
+    engine->hit_index = -1;
+}
+
+// Rebuild the page mask and slot bitmap from the breakpoint list
+static void rebuild_break_bits(BreakpointEngine *engine) {
+    engine->break_pages = 0;
+    memset(engine->break_slots, 0, sizeof(engine->break_slots));
+    for (int i = 0; i < engine->breakpoint_count; i++) {
+        uint32_t slot = engine->breakpoints[i].address / 2;
+        engine->break_pages |= 1u << (engine->breakpoints[i].address / BREAKPOINT_PAGE_SIZE);
+        engine->break_slots[slot / 32] |= 1u << (slot % 32);
+    }
+}
+
+static void rebuild_watch_pages(BreakpointEngine *engine) {
+    engine->watch_pages = 0;
+    for (int i = 0; i < engine->watchpoint_count; i++) {
+        const Watchpoint *watch = &engine->watchpoints[i];
+        uint32_t first = watch->address / BREAKPOINT_PAGE_SIZE;
+        uint32_t last = (watch->address + watch->length - 1) / BREAKPOINT_PAGE_SIZE;
+        for (uint32_t page = first; page <= last && page < BREAKPOINT_PAGE_COUNT; page++) {
+            engine->watch_pages |= 1u << page;
+        }
+    }
+}
+
+// Add or update a breakpoint
+int add_breakpoint(BreakpointEngine *engine, uint32_t address, const char *condition) {
+    Condition compiled;
+    if (address > MEMORY_SIZE - 2 || address % 2 != 0) {
+        fprintf(stderr, "Error: Breakpoint address 0x%X is not an instruction address\n", address);
+        return -1;
+    }
+    if (compile_condition(condition, &compiled) != 0) {
+        return -1;
+    }
+
+    int index = 0;
+    while (index < engine->breakpoint_count && engine->breakpoints[index].address != address) {
+        index++;
+    }
+    if (index == engine->breakpoint_count) {
+        if (engine->breakpoint_count == MAX_BREAKPOINTS) {
+            fprintf(stderr, "Error: Too many breakpoints\n");
+            return -1;
+        }
+        engine->breakpoint_count++;
+        engine->breakpoints[index].hits = 0;
+    }
+    engine->breakpoints[index].address = address;
+    engine->breakpoints[index].condition = compiled;
+    rebuild_break_bits(engine);
+    return 0;
+}
+
+// Remove a breakpoint
+int remove_breakpoint(BreakpointEngine *engine, uint32_t address) {
+    for (int i = 0; i < engine->breakpoint_count; i++) {
+        if (engine->breakpoints[i].address == address) {
+            engine->breakpoints[i] = engine->breakpoints[--engine->breakpoint_count];
+            rebuild_break_bits(engine);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Add a write watchpoint
+int add_watchpoint(BreakpointEngine *engine, uint32_t address, uint32_t length, const char *condition) {
+    if (length == 0 || address >= MEMORY_SIZE || length > MEMORY_SIZE - address) {
+        fprintf(stderr, "Error: Watchpoint 0x%X,%u is outside memory\n", address, length);
+        return -1;
+    }
+    Condition compiled;
+    if (compile_condition(condition, &compiled) != 0) {
+        return -1;
+    }
+
+    int index = 0;
+    while (index < engine->watchpoint_count && (engine->watchpoints[index].address != address ||
+                                                engine->watchpoints[index].length != length)) {
+        index++;
+    }
+    if (index == engine->watchpoint_count) {
+        if (engine->watchpoint_count == MAX_WATCHPOINTS) {
+            fprintf(stderr, "Error: Too many watchpoints\n");
+            return -1;
+        }
+        engine->watchpoint_count++;
+        engine->watchpoints[index].hits = 0;
+    }
+    engine->watchpoints[index].address = address;
+    engine->watchpoints[index].length = length;
+    engine->watchpoints[index].condition = compiled;
+    rebuild_watch_pages(engine);
+    return 0;
+}
+
+// Remove a write watchpoint
+int remove_watchpoint(BreakpointEngine *engine, uint32_t address, uint32_t length) {
+    for (int i = 0; i < engine->watchpoint_count; i++) {
+        if (engine->watchpoints[i].address == address && engine->watchpoints[i].length == length) {
+            engine->watchpoints[i] = engine->watchpoints[--engine->watchpoint_count];
+            rebuild_watch_pages(engine);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Slow path: a breakpoint slot is marked at the PC
+static bool check_breakpoint(BreakpointEngine *engine, const CPU *cpu) {
+    for (int i = 0; i < engine->breakpoint_count; i++) {
+        Breakpoint *breakpoint = &engine->breakpoints[i];
+        if (breakpoint->address == cpu->program_counter && evaluate_condition(&breakpoint->condition, cpu)) {
+            breakpoint->hits++;
+            engine->hit_index = i;
+            engine->hit_address = breakpoint->address;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Slow path: the last store wrote into a watched page
+static bool check_watchpoints(BreakpointEngine *engine, const CPU *cpu) {
+    for (int i = 0; i < engine->watchpoint_count; i++) {
+        Watchpoint *watch = &engine->watchpoints[i];
+        if (cpu->store_address < watch->address + watch->length &&
+            watch->address < cpu->store_address + cpu->store_size &&
+            evaluate_condition(&watch->condition, cpu)) {
+            watch->hits++;
+            engine->hit_index = i;
+            engine->hit_address = watch->address;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Run until a breakpoint or watchpoint hits
+StopReason run_with_breakpoints(BreakpointEngine *engine, CPU *cpu, uint64_t max_instructions) {
+    uint64_t executed = 0;
+    engine->hit_index = -1;
+
+    if (engine->breakpoint_count == 0 && engine->watchpoint_count == 0) {
+        for (; !cpu->halted && executed < max_instructions; executed++) {
+            step_cpu(cpu);
+        }
+        return STOP_NONE;
+    }
+
+    const uint32_t break_pages = engine->break_pages;
+    StopReason reason = STOP_NONE;
+    cpu->watch_pages = engine->watch_pages;
+    cpu->watch_hit = false;
+
+    for (; !cpu->halted && executed < max_instructions; executed++) {
+        step_cpu(cpu);
+        if (cpu->halted) {
+            break;
+        }
+
+        if (cpu->watch_hit) {
+            cpu->watch_hit = false;
+            if (check_watchpoints(engine, cpu)) {
+                reason = STOP_WATCHPOINT;
+                break;
+            }
+        }
+
+        uint32_t pc = cpu->program_counter;
+        if (pc < MEMORY_SIZE && (break_pages >> (pc / BREAKPOINT_PAGE_SIZE) & 1)) {
+            uint32_t slot = pc / 2;
+            if ((engine->break_slots[slot / 32] >> (slot % 32) & 1) && check_breakpoint(engine, cpu)) {
+                reason = STOP_BREAKPOINT;
+                break;
+            }
+        }
+    }
+
+    cpu->watch_pages = 0;
+    return reason;
+}
@@ -0,0 +1,1077 @@
+#include "ir.h"
+#include "cpu.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Registers R0-R5 hold values. R6 and R7 are never allocated: operands in
+// spill slots are loaded into them, and indirect accesses use them for the
+// MEMCPY address and byte count. LOAD and STORE only reach the data page, so
+// an indirect load copies the bytes to the scratch word at address 0 and
+// loads that; a store goes the other way.
+
+#define SCRATCH_ADDRESS 0       // Data page word indirect accesses pass through
+#define SCRATCH_A 6             // Temporary; 0 (the scratch address) around MEMCPY
+#define SCRATCH_B 7             // Byte counts, call targets and the move cycle temporary
+#define POOL_RESERVE 4          // Data page words the pool leaves to spill slots
+
+typedef enum {
+    LOC_NONE,       // Unused value
+    LOC_REG,        // Register index
+    LOC_SLOT,       // Spill slot index
+    LOC_REMAT       // Constant or address, rebuilt at each use; index is the value
+} LocationKind;
+
+typedef struct {
+    LocationKind kind;
+    int index;
+} Location;
+
+typedef struct {
+    Location dst;
+    Location src;
+} Move;
+
+// State while generating one function
+typedef struct {
+    IRProgram *program;
+    IRFunction *fn;
+    FILE *out;
+    int *layout;            // Reachable blocks in reverse postorder
+    int layout_count;
+    int *label;             // Label number of each block that is branched to, else -1
+    int *position;          // Definition point of each value, -1 if unplaced
+    int *block_start;
+    int *block_end;         // Position of the block's terminator
+    int *end;               // Last point each value is live, -1 if unused
+    int *use_hint;          // Register a call argument or return value is wanted in
+    int *phi_user;          // Phi a value is an operand of
+    Location *location;
+    int slots;
+    int flags_value;        // Value the zero flag reflects, or IR_NONE
+    bool r6_zero;
+    bool r7_known;
+    sword_t r7_value;
+    bool failed;
+} Codegen;
+
+static const char *const operation_names[] = {
+    [IR_ADD] = "ADD", [IR_SUB] = "SUB", [IR_MUL] = "MUL", [IR_DIV] = "DIV",
+    [IR_AND] = "AND", [IR_OR] = "OR", [IR_XOR] = "XOR",
+    [IR_EQ] = "EQ", [IR_NE] = "NEQ", [IR_LT] = "LT", [IR_GT] = "GT", [IR_LE] = "LE", [IR_GE] = "GE",
+    [IR_SHL] = "SHL", [IR_SHR] = "SHR"
+};
+
+// Write one instruction line
+static void emit(Codegen *cg, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fputs("    ", cg->out);
+    vfprintf(cg->out, format, args);
+    fputc('\n', cg->out);
+    va_end(args);
+}
+
+// Forget what the scratch registers hold after writing one of them
+static void clobber(Codegen *cg, int reg) {
+    if (reg == SCRATCH_A) {
+        cg->r6_zero = false;
+    } else if (reg == SCRATCH_B) {
+        cg->r7_known = false;
+    }
+}
+
+// Find or add a pool word; numbers are refused once the data page is short
+static int pool_entry(IRProgram *program, bool address, sword_t value) {
+    for (int i = 0; i < program->pool_count; i++) {
+        if (program->pool[i].address == address && program->pool[i].value == value) {
+            return i;
+        }
+    }
+    uint32_t words = (uint32_t)(program->spill_slots + program->pool_count + 1 + (address ? 0 : POOL_RESERVE));
+    if (program->pool_count == IR_POOL_SIZE ||
+        (!address && program->direct_bytes + words * WORD_BYTES > IR_DATA_PAGE_END)) {
+        return IR_NONE;
+    }
+    program->pool[program->pool_count].address = address;
+    program->pool[program->pool_count].value = value;
+    return program->pool_count++;
+}
+
+// Pool word holding a symbol's address
+static int address_entry(Codegen *cg, int symbol) {
+    int entry = pool_entry(cg->program, true, symbol);
+    if (entry == IR_NONE && !cg->failed) {
+        fprintf(stderr, "Error: Too many addresses for the data page\n");
+        cg->failed = true;
+    }
+    return entry;
+}
+
+// Put a number in a register: small ones as immediates, others from the
+// pool, or built 7 bits at a time when the pool is full
+static void load_constant(Codegen *cg, int reg, sword_t value) {
+    cg->flags_value = IR_NONE;
+    if (value >= -128 && value <= 127) {
+        emit(cg, "XOR R%d, R%d, R%d", reg, reg, reg);
+        if (value != 0) {
+            emit(cg, "ADDI R%d, R%d, %d", reg, reg, (int)value);
+        }
+    } else {
+        int entry = pool_entry(cg->program, false, value);
+        if (entry != IR_NONE) {
+            emit(cg, "LOAD R%d, [__k%d]", reg, entry);
+        } else {
+            word_t bits = value < 0 ? ~(word_t)value : (word_t)value;
+            bool started = false;
+            emit(cg, "XOR R%d, R%d, R%d", reg, reg, reg);
+            for (int shift = (WORD_SIZE - 1) / 7 * 7; shift >= 0; shift -= 7) {
+                int chunk = (int)((bits >> shift) & 127);
+                if (started) {
+                    emit(cg, "SHL R%d, R%d, 7", reg, reg);
+                }
+                if (chunk) {
+                    emit(cg, "ADDI R%d, R%d, %d", reg, reg, chunk);
+                    started = true;
+                }
+            }
+            if (value < 0) {
+                emit(cg, "NOT R%d, R%d", reg, reg);
+            }
+        }
+    }
+    clobber(cg, reg);
+    if (reg == SCRATCH_A) {
+        cg->r6_zero = value == 0;
+    } else if (reg == SCRATCH_B) {
+        cg->r7_known = true;
+        cg->r7_value = value;
+    }
+}
+
+// Offset of a data symbol from the start of the data section, whose
+// layout write_data_section follows
+static uint32_t data_offset(const IRProgram *program, int symbol) {
+    uint32_t offset = 0;
+    for (int i = 0; i < symbol; i++) {
+        const IRSymbol *s = &program->symbols[i];
+        if (!s->function && !s->direct) {
+            offset += s->size ? (s->size + 3) & ~3u : 4;
+        }
+    }
+    return offset;
+}
+
+// Put a symbol's address in a register. A data symbol that lies a little
+// past one already in the pool is reached from it, so strings and small
+// arrays share pool words.
+static void load_address(Codegen *cg, int reg, int symbol) {
+    const IRProgram *program = cg->program;
+    if (!program->symbols[symbol].function) {
+        uint32_t offset = data_offset(program, symbol);
+        for (int i = 0; i < program->pool_count; i++) {
+            const IRPoolEntry *entry = &program->pool[i];
+            if (!entry->address || program->symbols[entry->value].function) {
+                continue;
+            }
+            uint32_t anchor = data_offset(program, (int)entry->value);
+            if (anchor <= offset && offset - anchor <= 2 * 127) {
+                emit(cg, "LOAD R%d, [__k%d]", reg, i);
+                for (uint32_t delta = offset - anchor; delta > 0; delta -= delta > 127 ? 127 : delta) {
+                    emit(cg, "ADDI R%d, R%d, %u", reg, reg, delta > 127 ? 127 : delta);
+                    cg->flags_value = IR_NONE;
+                }
+                clobber(cg, reg);
+                return;
+            }
+        }
+    }
+    emit(cg, "LOAD R%d, [__k%d]", reg, address_entry(cg, symbol));
+    clobber(cg, reg);
+}
+
+// Rebuild a constant or address value in a register
+static void materialize(Codegen *cg, int value, int reg) {
+    const IRInstr *instr = &cg->fn->instrs[value];
+    if (instr->op == IR_CONST) {
+        load_constant(cg, reg, instr->imm);
+        return;
+    }
+    load_address(cg, reg, instr->symbol);
+}
+
+// Register holding an operand, loading it into scratch if it has none
+static int fetch(Codegen *cg, int value, int scratch) {
+    Location location = cg->location[value];
+    if (location.kind == LOC_REG) {
+        return location.index;
+    }
+    if (location.kind == LOC_SLOT) {
+        emit(cg, "LOAD R%d, [__s%d]", scratch, location.index);
+        clobber(cg, scratch);
+    } else {
+        materialize(cg, value, scratch);
+    }
+    return scratch;
+}
+
+// Register to compute a value into; spilled and unused values go through R6
+static int destination(const Codegen *cg, int value) {
+    return cg->location[value].kind == LOC_REG ? cg->location[value].index : SCRATCH_A;
+}
+
+// Store a value computed in a register to its spill slot, if it has one
+static void finish(Codegen *cg, int value, int reg) {
+    clobber(cg, reg);
+    if (cg->location[value].kind == LOC_SLOT) {
+        emit(cg, "STORE R%d, [__s%d]", reg, cg->location[value].index);
+    }
+}
+
+// Point R6 at the scratch word
+static void set_r6_zero(Codegen *cg) {
+    if (!cg->r6_zero) {
+        load_constant(cg, SCRATCH_A, 0);
+    }
+}
+
+// Put a byte count in R7, adjusting the one already there when possible
+static void set_r7(Codegen *cg, sword_t value) {
+    if (cg->r7_known && cg->r7_value == value) {
+        return;
+    }
+    if (cg->r7_known && value - cg->r7_value >= -128 && value - cg->r7_value <= 127) {
+        emit(cg, "ADDI R7, R7, %d", (int)(value - cg->r7_value));
+        cg->flags_value = IR_NONE;
+        cg->r7_value = value;
+        return;
+    }
+    load_constant(cg, SCRATCH_B, value);
+}
+
+static bool same_location(Location a, Location b) {
+    return a.kind == b.kind && a.index == b.index;
+}
+
+// Copy between two locations; memory-to-memory goes through R6
+static void emit_move(Codegen *cg, Location dst, Location src) {
+    if (dst.kind == LOC_REG) {
+        if (src.kind == LOC_REG) {
+            if (src.index != dst.index) {
+                emit(cg, "MOV R%d, R%d", dst.index, src.index);
+            }
+        } else if (src.kind == LOC_SLOT) {
+            emit(cg, "LOAD R%d, [__s%d]", dst.index, src.index);
+        } else {
+            materialize(cg, src.index, dst.index);
+        }
+        clobber(cg, dst.index);
+        return;
+    }
+    int reg = src.kind == LOC_REG ? src.index : SCRATCH_A;
+    if (src.kind == LOC_SLOT) {
+        emit(cg, "LOAD R6, [__s%d]", src.index);
+        clobber(cg, SCRATCH_A);
+    } else if (src.kind == LOC_REMAT) {
+        materialize(cg, src.index, SCRATCH_A);
+    }
+    emit(cg, "STORE R%d, [__s%d]", reg, dst.index);
+}
+
+// Perform moves as if simultaneously. A move waits while its destination
+// is still to be read; when only cycles remain, one destination is parked
+// in R7 and its readers redirected there.
+static void parallel_move(Codegen *cg, Move *moves, int count) {
+    for (int i = 0; i < count;) {
+        if (same_location(moves[i].dst, moves[i].src)) {
+            moves[i] = moves[--count];
+        } else {
+            i++;
+        }
+    }
+    while (count > 0) {
+        int ready = IR_NONE;
+        for (int i = 0; i < count && ready == IR_NONE; i++) {
+            ready = i;
+            for (int j = 0; j < count; j++) {
+                if (j != i && same_location(moves[j].src, moves[i].dst)) {
+                    ready = IR_NONE;
+                    break;
+                }
+            }
+        }
+        if (ready == IR_NONE) {
+            Location temporary = {LOC_REG, SCRATCH_B};
+            Location parked = moves[0].dst;
+            emit_move(cg, temporary, parked);
+            for (int j = 0; j < count; j++) {
+                if (same_location(moves[j].src, parked)) {
+                    moves[j].src = temporary;
+                }
+            }
+            continue;
+        }
+        emit_move(cg, moves[ready].dst, moves[ready].src);
+        moves[ready] = moves[--count];
+    }
+}
+
+// Terminator of a block
+static const IRInstr *block_terminator(const IRFunction *fn, int block) {
+    const IRBlock *b = &fn->blocks[block];
+    return &fn->instrs[b->instrs[b->count - 1]];
+}
+
+// Number of successors of a terminator
+static int successor_count(const IRInstr *terminator) {
+    return terminator->op == IR_BRANCH ? 2 : terminator->op == IR_JUMP ? 1 : 0;
+}
+
+// Order reachable blocks in reverse postorder, visiting a branch's false
+// successor first so that its true successor directly follows the branch
+static void compute_layout(Codegen *cg) {
+    IRFunction *fn = cg->fn;
+    int *stack = malloc((size_t)fn->block_count * sizeof(int));
+    int *next = calloc((size_t)fn->block_count, sizeof(int));
+    bool *visited = calloc((size_t)fn->block_count, sizeof(bool));
+    if (!stack || !next || !visited) {
+        abort();
+    }
+    int depth = 0;
+    stack[depth++] = 0;
+    visited[0] = true;
+    while (depth > 0) {
+        int block = stack[depth - 1];
+        const IRInstr *terminator = block_terminator(fn, block);
+        int count = successor_count(terminator);
+        if (next[block] < count) {
+            int successor = terminator->target[count - 1 - next[block]++];
+            if (!visited[successor]) {
+                visited[successor] = true;
+                stack[depth++] = successor;
+            }
+        } else {
+            cg->layout[cg->layout_count++] = block;
+            depth--;
+        }
+    }
+    for (int i = 0; i < cg->layout_count / 2; i++) {
+        int swap = cg->layout[i];
+        cg->layout[i] = cg->layout[cg->layout_count - 1 - i];
+        cg->layout[cg->layout_count - 1 - i] = swap;
+    }
+    free(stack);
+    free(next);
+    free(visited);
+}
+
+// Number instructions in layout order; phis and parameters take their
+// block's start, ahead of its first instruction
+static void number_instructions(Codegen *cg) {
+    int position = 0;
+    for (int i = 0; i < cg->layout_count; i++) {
+        int block = cg->layout[i];
+        const IRBlock *b = &cg->fn->blocks[block];
+        cg->block_start[block] = position;
+        position += 2;
+        for (int j = 0; j < b->count; j++) {
+            int value = b->instrs[j];
+            IROp op = cg->fn->instrs[value].op;
+            if (op == IR_PHI || op == IR_PARAM) {
+                cg->position[value] = cg->block_start[block];
+            } else {
+                cg->position[value] = position;
+                position += 2;
+            }
+        }
+        cg->block_end[block] = cg->position[b->instrs[b->count - 1]];
+    }
+}
+
+// Index of pred among block's predecessors
+static int pred_index(const IRFunction *fn, int block, int pred) {
+    const IRBlock *b = &fn->blocks[block];
+    for (int k = 0; k < b->pred_count; k++) {
+        if (b->preds[k] == pred) {
+            return k;
+        }
+    }
+    return IR_NONE;
+}
+
+#define BIT_SET(set, bit) ((set)[(bit) / 64] |= (uint64_t)1 << ((bit) % 64))
+#define BIT_TEST(set, bit) (((set)[(bit) / 64] >> ((bit) % 64)) & 1)
+
+// Compute live intervals as hulls: from the definition to the last use,
+// stretched to the end of every block the value is live out of
+static void compute_intervals(Codegen *cg) {
+    IRFunction *fn = cg->fn;
+    size_t words = ((size_t)fn->instr_count + 63) / 64;
+    uint64_t *gen = calloc((size_t)fn->block_count * words, sizeof(uint64_t));
+    uint64_t *kill = calloc((size_t)fn->block_count * words, sizeof(uint64_t));
+    uint64_t *live_in = calloc((size_t)fn->block_count * words, sizeof(uint64_t));
+    uint64_t *live_out = calloc((size_t)fn->block_count * words, sizeof(uint64_t));
+    if (!gen || !kill || !live_in || !live_out) {
+        abort();
+    }
+
+    for (int i = 0; i < cg->layout_count; i++) {
+        int block = cg->layout[i];
+        const IRBlock *b = &fn->blocks[block];
+        for (int j = 0; j < b->count; j++) {
+            const IRInstr *instr = &fn->instrs[b->instrs[j]];
+            BIT_SET(kill + block * words, b->instrs[j]);
+            if (instr->op == IR_PHI) {
+                continue;
+            }
+            int operands[2] = {instr->a, instr->b};
+            for (int k = 0; k < 2 + instr->arg_count; k++) {
+                int operand = k < 2 ? operands[k] : instr->args[k - 2];
+                if (operand != IR_NONE && !BIT_TEST(kill + block * words, operand)) {
+                    BIT_SET(gen + block * words, operand);
+                }
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = cg->layout_count - 1; i >= 0; i--) {
+            int block = cg->layout[i];
+            uint64_t *out = live_out + block * words, *in = live_in + block * words;
+            const IRInstr *terminator = block_terminator(fn, block);
+            for (int s = 0; s < successor_count(terminator); s++) {
+                int successor = terminator->target[s];
+                const IRBlock *sb = &fn->blocks[successor];
+                for (size_t w = 0; w < words; w++) {
+                    out[w] |= live_in[successor * words + w];
+                }
+                int k = pred_index(fn, successor, block);
+                for (int j = 0; j < sb->count && fn->instrs[sb->instrs[j]].op == IR_PHI; j++) {
+                    BIT_SET(out, fn->instrs[sb->instrs[j]].args[k]);
+                }
+            }
+            for (size_t w = 0; w < words; w++) {
+                uint64_t updated = gen[block * words + w] | (out[w] & ~kill[block * words + w]);
+                if (updated != in[w]) {
+                    in[w] = updated;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < cg->layout_count; i++) {
+        int block = cg->layout[i];
+        const IRBlock *b = &fn->blocks[block];
+        for (int j = 0; j < b->count; j++) {
+            int value = b->instrs[j];
+            const IRInstr *instr = &fn->instrs[value];
+            if (instr->op == IR_PHI) {
+                for (int k = 0; k < instr->arg_count; k++) {
+                    int use = cg->block_end[b->preds[k]] - 1;
+                    if (use > cg->end[instr->args[k]]) {
+                        cg->end[instr->args[k]] = use;
+                    }
+                }
+                continue;
+            }
+            int operands[2] = {instr->a, instr->b};
+            for (int k = 0; k < 2 + instr->arg_count; k++) {
+                int operand = k < 2 ? operands[k] : instr->args[k - 2];
+                if (operand != IR_NONE && cg->position[value] > cg->end[operand]) {
+                    cg->end[operand] = cg->position[value];
+                }
+            }
+        }
+        for (int value = 0; value < fn->instr_count; value++) {
+            if (BIT_TEST(live_out + block * words, value) && cg->block_end[block] > cg->end[value]) {
+                cg->end[value] = cg->block_end[block];
+            }
+        }
+    }
+    free(gen);
+    free(kill);
+    free(live_in);
+    free(live_out);
+}
+
+// Register a value would rather have, or IR_NONE
+static int allocation_hint(const Codegen *cg, int value) {
+    const IRInstr *instr = &cg->fn->instrs[value];
+    if (instr->op == IR_PARAM) {
+        return (int)instr->imm + 1;
+    }
+    if (instr->op == IR_CALL || instr->op == IR_SYSCALL) {
+        return 1;
+    }
+    if (instr->op == IR_PHI) {
+        for (int k = 0; k < instr->arg_count; k++) {
+            if (cg->location[instr->args[k]].kind == LOC_REG) {
+                return cg->location[instr->args[k]].index;
+            }
+        }
+    }
+    int phi = cg->phi_user[value];
+    if (phi != IR_NONE && cg->location[phi].kind == LOC_REG) {
+        return cg->location[phi].index;
+    }
+    return cg->use_hint[value];
+}
+
+static bool rematerializable(const Codegen *cg, int value) {
+    IROp op = cg->fn->instrs[value].op;
+    return op == IR_CONST || op == IR_ADDRESS;
+}
+
+static void spill(Codegen *cg, int value) {
+    if (rematerializable(cg, value)) {
+        cg->location[value] = (Location){LOC_REMAT, value};
+    } else {
+        cg->location[value] = (Location){LOC_SLOT, cg->slots++};
+    }
+}
+
+// Order values by interval start
+static const Codegen *sorting;
+static int compare_starts(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    int px = sorting->position[x], py = sorting->position[y];
+    return px != py ? (px > py) - (px < py) : (x > y) - (x < y);
+}
+
+// Linear scan over R0-R5. When every register is taken, the interval that
+// ends furthest away is spilled, constants and addresses first since they
+// cost no slot.
+static void allocate_registers(Codegen *cg) {
+    IRFunction *fn = cg->fn;
+    int *values = malloc((size_t)fn->instr_count * sizeof(int));
+    if (!values) {
+        abort();
+    }
+    int count = 0;
+    for (int value = 0; value < fn->instr_count; value++) {
+        if (cg->position[value] >= 0 && cg->end[value] >= 0) {
+            values[count++] = value;
+        }
+    }
+    sorting = cg;
+    qsort(values, (size_t)count, sizeof(int), compare_starts);
+
+    int owner[IR_ALLOCATABLE];
+    for (int r = 0; r < IR_ALLOCATABLE; r++) {
+        owner[r] = IR_NONE;
+    }
+    for (int i = 0; i < count; i++) {
+        int value = values[i];
+        int start = cg->position[value];
+        for (int r = 0; r < IR_ALLOCATABLE; r++) {
+            if (owner[r] != IR_NONE && cg->end[owner[r]] <= start) {
+                owner[r] = IR_NONE;
+            }
+        }
+
+        int reg = allocation_hint(cg, value);
+        if (reg < 0 || reg >= IR_ALLOCATABLE || owner[reg] != IR_NONE) {
+            reg = IR_NONE;
+            for (int r = 0; r < IR_ALLOCATABLE && reg == IR_NONE; r++) {
+                if (owner[r] == IR_NONE) {
+                    reg = r;
+                }
+            }
+        }
+        if (reg == IR_NONE) {
+            int victim = value;
+            for (int r = 0; r < IR_ALLOCATABLE; r++) {
+                int other = owner[r];
+                bool cheaper = rematerializable(cg, other) && !rematerializable(cg, victim);
+                bool same_cost = rematerializable(cg, other) == rematerializable(cg, victim);
+                if (cheaper || (same_cost && cg->end[other] > cg->end[victim])) {
+                    victim = other;
+                }
+            }
+            if (victim == value) {
+                spill(cg, value);
+                continue;
+            }
+            reg = cg->location[victim].index;
+            spill(cg, victim);
+        }
+        cg->location[value] = (Location){LOC_REG, reg};
+        owner[reg] = value;
+    }
+    free(values);
+}
+
+// Give a label to every block reached other than by falling through
+static void assign_labels(Codegen *cg) {
+    for (int i = 0; i < cg->layout_count; i++) {
+        int next = i + 1 < cg->layout_count ? cg->layout[i + 1] : IR_NONE;
+        const IRInstr *terminator = block_terminator(cg->fn, cg->layout[i]);
+        for (int s = 0; s < successor_count(terminator); s++) {
+            int target = terminator->target[s];
+            bool falls_through = target == next &&
+                                 (terminator->op == IR_JUMP || s == 0 || terminator->target[0] != next);
+            if (!falls_through && cg->label[target] == IR_NONE) {
+                cg->label[target] = cg->program->labels++;
+            }
+        }
+    }
+}
+
+// Values a call must preserve: those live across it in a register it
+// clobbers, and for CALL also spill slots, which every function shares
+static int live_across(const Codegen *cg, int call, bool host, Location *saved) {
+    int count = 0;
+    int position = cg->position[call];
+    for (int value = 0; value < cg->fn->instr_count; value++) {
+        if (value == call || cg->position[value] < 0 || cg->position[value] >= position ||
+            cg->end[value] <= position) {
+            continue;
+        }
+        Location location = cg->location[value];
+        if (location.kind == LOC_REG ? !host || (location.index >= 1 && location.index <= 3)
+                                     : location.kind == LOC_SLOT && !host) {
+            saved[count++] = location;
+        }
+    }
+    return count;
+}
+
+// Move call arguments into R1 onwards
+static void move_arguments(Codegen *cg, const IRInstr *call) {
+    Move moves[IR_MAX_ARGS];
+    for (int k = 0; k < call->arg_count; k++) {
+        moves[k].dst = (Location){LOC_REG, k + 1};
+        moves[k].src = cg->location[call->args[k]];
+    }
+    parallel_move(cg, moves, call->arg_count);
+}
+
+// CALL or SYSCALL, saving what it would clobber around it
+static void emit_call(Codegen *cg, int value) {
+    const IRInstr *call = &cg->fn->instrs[value];
+    bool host = call->op == IR_SYSCALL;
+    Location *saved = malloc((size_t)cg->fn->instr_count * sizeof(Location));
+    if (!saved) {
+        abort();
+    }
+    int count = live_across(cg, value, host, saved);
+    for (int i = 0; i < count; i++) {
+        if (saved[i].kind == LOC_REG) {
+            emit(cg, "PUSH R%d", saved[i].index);
+        } else {
+            emit(cg, "LOAD R6, [__s%d]", saved[i].index);
+            emit(cg, "PUSH R6");
+        }
+    }
+    move_arguments(cg, call);
+    if (host) {
+        emit(cg, "SYSCALL %d", (int)call->imm);
+    } else {
+        emit(cg, "LOAD R7, [__k%d]", address_entry(cg, call->symbol));
+        emit(cg, "CALL R7");
+    }
+    if (cg->location[value].kind != LOC_NONE) {
+        emit_move(cg, cg->location[value], (Location){LOC_REG, 1});
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        if (saved[i].kind == LOC_REG) {
+            emit(cg, "POP R%d", saved[i].index);
+        } else {
+            emit(cg, "POP R6");
+            emit(cg, "STORE R6, [__s%d]", saved[i].index);
+        }
+    }
+    free(saved);
+    cg->flags_value = IR_NONE;
+    cg->r6_zero = false;
+    cg->r7_known = false;
+}
+
+// A call whose result is returned at once becomes a jump; a call to the
+// function itself becomes a branch to its start
+static void emit_tail_call(Codegen *cg, const IRInstr *call) {
+    move_arguments(cg, call);
+    if (call->symbol == cg->fn->symbol) {
+        emit(cg, "BRA %s", cg->program->symbols[call->symbol].name);
+    } else {
+        emit(cg, "LOAD R7, [__k%d]", address_entry(cg, call->symbol));
+        emit(cg, "JUMP R7");
+    }
+}
+
+// A register for an address operand; a spilled one is loaded into a
+// register borrowed (pushed) for the access, which the caller pops
+static int pointer_register(Codegen *cg, int value, int avoid, int *borrowed) {
+    Location location = cg->location[value];
+    if (location.kind == LOC_REG) {
+        *borrowed = IR_NONE;
+        return location.index;
+    }
+    *borrowed = avoid == 0 ? 1 : 0;
+    emit(cg, "PUSH R%d", *borrowed);
+    emit_move(cg, (Location){LOC_REG, *borrowed}, location);
+    return *borrowed;
+}
+
+// Indirect load through the scratch word
+static void emit_load(Codegen *cg, int value) {
+    const IRInstr *instr = &cg->fn->instrs[value];
+    int borrowed;
+    int pointer = pointer_register(cg, instr->a, IR_NONE, &borrowed);
+    set_r6_zero(cg);
+    if (instr->size == 1) {
+        emit(cg, "STORE R6, [%d]", SCRATCH_ADDRESS);     // Clear the bytes above
+        set_r7(cg, 1);
+    } else {
+        set_r7(cg, WORD_BYTES);
+    }
+    emit(cg, "MEMCPY R6, R%d, R7", pointer);
+    if (borrowed != IR_NONE) {
+        emit(cg, "POP R%d", borrowed);
+    }
+    int reg = destination(cg, value);
+    emit(cg, "LOAD R%d, [%d]", reg, SCRATCH_ADDRESS);
+    finish(cg, value, reg);
+}
+
+// Indirect store: a word through the scratch word, a byte with MEMSET
+static void emit_store(Codegen *cg, const IRInstr *instr) {
+    int stored = fetch(cg, instr->b, SCRATCH_A);
+    int borrowed, pointer;
+    if (instr->size == 1) {
+        pointer = pointer_register(cg, instr->a, stored, &borrowed);
+        set_r7(cg, 1);
+        emit(cg, "MEMSET R%d, R%d, R7", pointer, stored);
+    } else {
+        emit(cg, "STORE R%d, [%d]", stored, SCRATCH_ADDRESS);
+        pointer = pointer_register(cg, instr->a, IR_NONE, &borrowed);
+        set_r6_zero(cg);
+        set_r7(cg, WORD_BYTES);
+        emit(cg, "MEMCPY R%d, R6, R7", pointer);
+    }
+    if (borrowed != IR_NONE) {
+        emit(cg, "POP R%d", borrowed);
+    }
+}
+
+// Arithmetic shift right from the logical one: ((x ^ m) >> n) ^ m, with m
+// all ones for negative x
+static void emit_sar(Codegen *cg, int value) {
+    const IRInstr *instr = &cg->fn->instrs[value];
+    int x = fetch(cg, instr->a, SCRATCH_B);
+    int reg = destination(cg, value);
+    emit(cg, "SHR R6, R%d, %d", x, WORD_SIZE - 1);
+    emit(cg, "NOT R6, R6");
+    emit(cg, "ADDI R6, R6, 1");
+    emit(cg, "XOR R7, R%d, R6", x);
+    emit(cg, "SHR R7, R7, %d", (int)instr->imm);
+    emit(cg, "XOR R%d, R7, R6", reg);
+    cg->r6_zero = false;
+    cg->r7_known = false;
+    finish(cg, value, reg);
+}
+
+// Phi moves for the edge to a block, then the jump unless it falls through
+static void emit_jump(Codegen *cg, int block, int target, int next) {
+    const IRBlock *t = &cg->fn->blocks[target];
+    int k = pred_index(cg->fn, target, block);
+    Move *moves = malloc((size_t)(t->count + 1) * sizeof(Move));
+    if (!moves) {
+        abort();
+    }
+    int count = 0;
+    for (int j = 0; j < t->count && cg->fn->instrs[t->instrs[j]].op == IR_PHI; j++) {
+        int phi = t->instrs[j];
+        if (cg->location[phi].kind != LOC_NONE) {
+            moves[count].dst = cg->location[phi];
+            moves[count].src = cg->location[cg->fn->instrs[phi].args[k]];
+            count++;
+        }
+    }
+    parallel_move(cg, moves, count);
+    free(moves);
+    if (target != next) {
+        emit(cg, "BRA __L%d", cg->label[target]);
+    }
+}
+
+// Test the condition unless the flags already reflect it, then branch
+static void emit_branch(Codegen *cg, const IRInstr *branch, int next) {
+    if (cg->flags_value != branch->a) {
+        int reg = fetch(cg, branch->a, SCRATCH_A);
+        emit(cg, "ADDI R%d, R%d, 0", reg, reg);
+    }
+    int if_true = branch->target[0], if_false = branch->target[1];
+    if (if_true == next) {
+        emit(cg, "BZ __L%d", cg->label[if_false]);
+    } else if (if_false == next) {
+        emit(cg, "BNZ __L%d", cg->label[if_true]);
+    } else {
+        emit(cg, "BNZ __L%d", cg->label[if_true]);
+        emit(cg, "BRA __L%d", cg->label[if_false]);
+    }
+}
+
+static void emit_instruction(Codegen *cg, int block, int value, int next) {
+    const IRInstr *instr = &cg->fn->instrs[value];
+    switch (instr->op) {
+        case IR_CONST:
+        case IR_ADDRESS:
+            if (cg->location[value].kind == LOC_REG) {
+                materialize(cg, value, cg->location[value].index);
+            }
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_AND: case IR_OR: case IR_XOR:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE: {
+            int a = fetch(cg, instr->a, SCRATCH_A);
+            int b = fetch(cg, instr->b, SCRATCH_B);
+            int reg = destination(cg, value);
+            emit(cg, "%s R%d, R%d, R%d", operation_names[instr->op], reg, a, b);
+            finish(cg, value, reg);
+            cg->flags_value = value;
+            break;
+        }
+        case IR_NOT:
+        case IR_ADDI:
+        case IR_SHL:
+        case IR_SHR: {
+            int a = fetch(cg, instr->a, SCRATCH_A);
+            int reg = destination(cg, value);
+            if (instr->op == IR_NOT) {
+                emit(cg, "NOT R%d, R%d", reg, a);
+            } else {
+                emit(cg, "%s R%d, R%d, %d", instr->op == IR_ADDI ? "ADDI" : operation_names[instr->op],
+                     reg, a, (int)instr->imm);
+            }
+            finish(cg, value, reg);
+            cg->flags_value = value;
+            break;
+        }
+        case IR_SAR:
+            emit_sar(cg, value);
+            cg->flags_value = value;
+            break;
+        case IR_LOAD:
+            emit_load(cg, value);
+            break;
+        case IR_STORE:
+            emit_store(cg, instr);
+            break;
+        case IR_LOADG: {
+            int reg = destination(cg, value);
+            emit(cg, "LOAD R%d, [%s]", reg, cg->program->symbols[instr->symbol].name);
+            finish(cg, value, reg);
+            break;
+        }
+        case IR_STOREG: {
+            int reg = fetch(cg, instr->a, SCRATCH_A);
+            emit(cg, "STORE R%d, [%s]", reg, cg->program->symbols[instr->symbol].name);
+            break;
+        }
+        case IR_CALL:
+        case IR_SYSCALL:
+            emit_call(cg, value);
+            break;
+        case IR_JUMP:
+            emit_jump(cg, block, instr->target[0], next);
+            break;
+        case IR_BRANCH:
+            emit_branch(cg, instr, next);
+            break;
+        case IR_RET:
+            if (instr->a != IR_NONE) {
+                Move move = {{LOC_REG, 1}, cg->location[instr->a]};
+                parallel_move(cg, &move, 1);
+            }
+            emit(cg, "RET");
+            break;
+        default:
+            break;
+    }
+}
+
+// A call directly followed by returning its result, from a function
+// without a frame to free
+static bool is_tail_call(const Codegen *cg, const IRBlock *b, int j) {
+    const IRInstr *call = &cg->fn->instrs[b->instrs[j]];
+    if (call->op != IR_CALL || cg->fn->frame || j + 1 >= b->count) {
+        return false;
+    }
+    const IRInstr *ret = &cg->fn->instrs[b->instrs[j + 1]];
+    return ret->op == IR_RET && (ret->a == b->instrs[j] || ret->a == IR_NONE);
+}
+
+// Translate an optimized function to assembly
+int generate_function(IRProgram *program, IRFunction *fn, FILE *out) {
+    Codegen cg = {0};
+    cg.program = program;
+    cg.fn = fn;
+    cg.out = out;
+    size_t blocks = (size_t)fn->block_count, values = (size_t)fn->instr_count;
+    cg.layout = malloc(blocks * sizeof(int));
+    cg.label = malloc(blocks * sizeof(int));
+    cg.block_start = calloc(blocks, sizeof(int));
+    cg.block_end = calloc(blocks, sizeof(int));
+    cg.position = malloc(values * sizeof(int));
+    cg.end = malloc(values * sizeof(int));
+    cg.use_hint = malloc(values * sizeof(int));
+    cg.phi_user = malloc(values * sizeof(int));
+    cg.location = calloc(values, sizeof(Location));
+    if (!cg.layout || !cg.label || !cg.block_start || !cg.block_end || !cg.position || !cg.end ||
+        !cg.use_hint || !cg.phi_user || !cg.location) {
+        abort();
+    }
+    for (size_t i = 0; i < blocks; i++) {
+        cg.label[i] = IR_NONE;
+    }
+    for (size_t v = 0; v < values; v++) {
+        cg.position[v] = cg.end[v] = cg.use_hint[v] = cg.phi_user[v] = IR_NONE;
+    }
+    for (size_t v = 0; v < values; v++) {
+        const IRInstr *instr = &fn->instrs[v];
+        if (instr->dead) {
+            continue;
+        }
+        for (int k = 0; k < instr->arg_count; k++) {
+            if (instr->op == IR_PHI) {
+                cg.phi_user[instr->args[k]] = (int)v;
+            } else if (cg.use_hint[instr->args[k]] == IR_NONE) {
+                cg.use_hint[instr->args[k]] = k + 1;
+            }
+        }
+        if (instr->op == IR_RET && instr->a != IR_NONE) {
+            cg.use_hint[instr->a] = 1;
+        }
+    }
+
+    compute_layout(&cg);
+    number_instructions(&cg);
+    compute_intervals(&cg);
+    allocate_registers(&cg);
+    assign_labels(&cg);
+    if (cg.slots > program->spill_slots) {
+        program->spill_slots = cg.slots;
+    }
+
+    const char *name = program->symbols[fn->symbol].name;
+    fprintf(out, "\n; %s\n%s:\n", name, name);
+    for (int i = 0; i < cg.layout_count; i++) {
+        int block = cg.layout[i];
+        int next = i + 1 < cg.layout_count ? cg.layout[i + 1] : IR_NONE;
+        const IRBlock *b = &fn->blocks[block];
+        if (cg.label[block] != IR_NONE) {
+            fprintf(out, "__L%d:\n", cg.label[block]);
+        }
+        cg.flags_value = IR_NONE;
+        cg.r6_zero = false;
+        cg.r7_known = false;
+
+        if (block == 0) {
+            // Parameters arrive in R1 onwards
+            Move moves[IR_MAX_ARGS];
+            int count = 0;
+            for (int j = 0; j < b->count && fn->instrs[b->instrs[j]].op == IR_PARAM; j++) {
+                int param = b->instrs[j];
+                if (cg.location[param].kind != LOC_NONE) {
+                    moves[count].dst = cg.location[param];
+                    moves[count].src = (Location){LOC_REG, (int)fn->instrs[param].imm + 1};
+                    count++;
+                }
+            }
+            parallel_move(&cg, moves, count);
+        }
+        for (int j = 0; j < b->count; j++) {
+            int value = b->instrs[j];
+            if (is_tail_call(&cg, b, j)) {
+                emit_tail_call(&cg, &fn->instrs[value]);
+                break;
+            }
+            emit_instruction(&cg, block, value, next);
+        }
+    }
+
+    free(cg.layout);
+    free(cg.label);
+    free(cg.block_start);
+    free(cg.block_end);
+    free(cg.position);
+    free(cg.end);
+    free(cg.use_hint);
+    free(cg.phi_user);
+    free(cg.location);
+    return cg.failed ? -1 : 0;
+}
+
+// Code at CODE_START: call the function and halt
+int write_entry(IRProgram *program, int symbol, FILE *out) {
+    int entry = pool_entry(program, true, symbol);
+    if (entry == IR_NONE) {
+        fprintf(stderr, "Error: Too many addresses for the data page\n");
+        return -1;
+    }
+    fprintf(out, "\n; Entry\n    .org 0x%X\n    LOAD R1, [__k%d]\n    CALL R1\n    HALT\n", CODE_START, entry);
+    return 0;
+}
+
+// Data page: scratch word, direct globals, spill slots and the pool
+int write_data_page(const IRProgram *program, FILE *out) {
+    uint32_t size = program->direct_bytes + (uint32_t)(program->spill_slots + program->pool_count) * WORD_BYTES;
+    if (size > IR_DATA_PAGE_END) {
+        fprintf(stderr, "Error: Data page needs %u bytes for globals, spill slots and constants; %u are free\n",
+                size, IR_DATA_PAGE_END);
+        return -1;
+    }
+    const char *directive = WORD_BYTES == 8 ? ".quad" : ".word";
+    fprintf(out, "; Data page\n    .org 0\n    %s 0            ; Scratch word\n", directive);
+    for (int i = 0; i < program->symbol_count; i++) {
+        const IRSymbol *symbol = &program->symbols[i];
+        if (symbol->function || !symbol->direct) {
+            continue;
+        }
+        sword_t value = 0;
+        if (symbol->data) {
+            memcpy(&value, symbol->data, sizeof(value));
+        }
+        fprintf(out, "%s: %s %" PRIdWORD "\n", symbol->name, directive, value);
+    }
+    for (int i = 0; i < program->spill_slots; i++) {
+        fprintf(out, "__s%d: %s 0\n", i, directive);
+    }
+    for (int i = 0; i < program->pool_count; i++) {
+        const IRPoolEntry *entry = &program->pool[i];
+        if (entry->address) {
+            fprintf(out, "__k%d: %s %s\n", i, directive, program->symbols[entry->value].name);
+        } else {
+            fprintf(out, "__k%d: %s %" PRIdWORD "\n", i, directive, entry->value);
+        }
+    }
+    return 0;
+}
+
+// Arrays, strings and globals outside the data page, as 32-bit words
+void write_data_section(const IRProgram *program, FILE *out) {
+    bool first = true;
+    for (int i = 0; i < program->symbol_count; i++) {
+        const IRSymbol *symbol = &program->symbols[i];
+        if (symbol->function || symbol->direct) {
+            continue;
+        }
+        if (first) {
+            fprintf(out, "\n; Data\n");
+            first = false;
+        }
+        fprintf(out, "%s:", symbol->name);
+        uint32_t words = symbol->size ? (symbol->size + 3) / 4 : 1;
+        for (uint32_t w = 0; w < words; w++) {
+            uint32_t word = 0;
+            for (uint32_t byte = 0; byte < 4 && symbol->data && w * 4 + byte < symbol->size; byte++) {
+                word |= (uint32_t)symbol->data[w * 4 + byte] << (8 * byte);
+            }
+            fprintf(out, "%s0x%08X", w % 16 == 0 ? "\n    .word " : ", ", word);
+        }
+        fprintf(out, "\n");
+    }
+}
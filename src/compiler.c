@@ -0,0 +1,2000 @@
+#include "compiler.h"
+#include "ir.h"
+#include "hostcalls.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LOCALS 256
+#define MAX_SCOPE 512
+#define OP_MOD (-2)             // Binary % is lowered to a - a / b * b
+
+// Lexer
+
+typedef enum {
+    TOKEN_EOF,
+    TOKEN_NUMBER,       // Integer and character constants
+    TOKEN_STRING,
+    TOKEN_IDENT,        // Identifiers and keywords
+    TOKEN_PUNCT
+} TokenKind;
+
+typedef struct {
+    TokenKind kind;
+    int line;
+    sword_t value;
+    char *text;         // Identifier, punctuator, or string bytes
+    int length;         // String length without the terminator
+} Token;
+
+// Longest first, so the first match is the right one
+static const char *const punctuators[] = {
+    "<<=", ">>=", "...", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+    "+", "-", "*", "/", "%", "&", "|", "^", "~", "!", "<", ">", "=", "?", ":", ";", ",", ".",
+    "(", ")", "[", "]", "{", "}"
+};
+
+// Types
+
+typedef enum {
+    TYPE_VOID,
+    TYPE_CHAR,
+    TYPE_WORD,
+    TYPE_POINTER,
+    TYPE_ARRAY
+} TypeKind;
+
+typedef struct Type {
+    TypeKind kind;
+    struct Type *base;      // Pointers and arrays
+    uint32_t length;        // Arrays
+} Type;
+
+static Type void_type = {TYPE_VOID, NULL, 0};
+static Type char_type = {TYPE_CHAR, NULL, 0};
+static Type word_type = {TYPE_WORD, NULL, 0};
+
+// Syntax tree
+
+typedef enum {
+    // Expressions
+    NODE_NUMBER,
+    NODE_LOCAL,
+    NODE_GLOBAL,
+    NODE_BINARY,        // op is an IROp or OP_MOD
+    NODE_AND,           // &&
+    NODE_OR,            // ||
+    NODE_NOT,
+    NODE_NEGATE,
+    NODE_COMPLEMENT,
+    NODE_DEREF,
+    NODE_ADDRESS,
+    NODE_ASSIGN,        // op is the compound operation, or IR_NONE
+    NODE_INCREMENT,     // value is +1 or -1; op is 1 for prefix
+    NODE_CONDITIONAL,
+    NODE_CALL,
+    NODE_COMMA,
+    NODE_CAST,
+
+    // Statements
+    NODE_BLOCK,
+    NODE_IF,
+    NODE_WHILE,
+    NODE_DO,
+    NODE_FOR,
+    NODE_BREAK,
+    NODE_CONTINUE,
+    NODE_RETURN,
+    NODE_EXPRESSION,
+    NODE_EMPTY
+} NodeKind;
+
+typedef struct Node {
+    NodeKind kind;
+    int op;
+    Type *type;
+    struct Node *a, *b, *c, *d;     // Operands; for: init, condition, step, body
+    struct Node *next;              // Statement lists and call arguments
+    sword_t value;
+    int index;                      // Local or symbol
+    int line;
+} Node;
+
+typedef struct {
+    char name[IR_NAME_LENGTH];
+    Type *type;
+    bool addressed;         // Has its address taken, so lives in the frame
+    uint32_t offset;        // Frame offset
+} Local;
+
+// Per-symbol information beside the IRSymbol
+typedef struct {
+    Type *type;             // Variables: type; functions: return type
+    bool addressed;
+    bool called;
+    int param_count;
+    int line;
+} SymbolInfo;
+
+typedef struct {
+    int symbol;
+    Node *body;
+    Local *locals;
+    int local_count;
+    int param_count;
+    uint32_t frame_size;
+} FunctionDef;
+
+typedef struct {
+    const char *file;
+    Token *tokens;
+    int token_count;
+    int pos;
+    bool failed;
+
+    void **allocations;     // Everything allocated while compiling, freed at the end
+    int allocation_count;
+    int allocation_capacity;
+
+    IRProgram *program;
+    SymbolInfo *info;       // Parallel to program->symbols
+    int info_capacity;
+    FunctionDef *functions;
+    int function_count;
+    int function_capacity;
+    int strings;
+
+    // Function being parsed
+    Local locals[MAX_LOCALS];
+    int local_count;
+    int scope[MAX_SCOPE];   // Visible locals, innermost last
+    int scope_count;
+    Type *return_type;
+} Compiler;
+
+static Node error_node = {NODE_NUMBER, 0, &word_type, NULL, NULL, NULL, NULL, NULL, 0, 0, 0};
+
+// Report the first error and stop parsing by jumping to the end of input
+static void compile_error(Compiler *c, int line, const char *format, ...) {
+    if (!c->failed) {
+        va_list args;
+        va_start(args, format);
+        fprintf(stderr, "Error: %s:%d: ", c->file, line);
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+        va_end(args);
+        c->failed = true;
+    }
+    c->pos = c->token_count - 1;
+}
+
+static void *allocate(Compiler *c, size_t size) {
+    if (c->allocation_count == c->allocation_capacity) {
+        int capacity = c->allocation_capacity ? c->allocation_capacity * 2 : 256;
+        void **grown = realloc(c->allocations, (size_t)capacity * sizeof(void *));
+        if (!grown) {
+            abort();
+        }
+        c->allocations = grown;
+        c->allocation_capacity = capacity;
+    }
+    void *memory = calloc(1, size ? size : 1);
+    if (!memory) {
+        abort();
+    }
+    c->allocations[c->allocation_count++] = memory;
+    return memory;
+}
+
+// Decode one escape sequence after the backslash
+static int escape(const char **p) {
+    char ch = *(*p)++;
+    switch (ch) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'a': return '\a';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'x': {
+            int value = 0;
+            while (isxdigit((unsigned char)**p)) {
+                char digit = *(*p)++;
+                value = value * 16 + (isdigit((unsigned char)digit) ? digit - '0' : tolower(digit) - 'a' + 10);
+            }
+            return value & 0xFF;
+        }
+        default:
+            if (ch >= '0' && ch <= '7') {
+                int value = ch - '0';
+                for (int i = 0; i < 2 && **p >= '0' && **p <= '7'; i++) {
+                    value = value * 8 + *(*p)++ - '0';
+                }
+                return value & 0xFF;
+            }
+            return (unsigned char)ch;
+    }
+}
+
+static Token *add_token(Compiler *c, int *capacity, TokenKind kind, int line) {
+    if (c->token_count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        Token *grown = realloc(c->tokens, (size_t)*capacity * sizeof(Token));
+        if (!grown) {
+            abort();
+        }
+        c->tokens = grown;
+    }
+    Token *token = &c->tokens[c->token_count++];
+    memset(token, 0, sizeof(*token));
+    token->kind = kind;
+    token->line = line;
+    return token;
+}
+
+// Split source into tokens, skipping comments and preprocessor lines;
+// adjacent string literals are joined
+static int tokenize(Compiler *c, const char *source) {
+    int capacity = 0, line = 1;
+    bool line_start = true;
+    const char *p = source;
+    while (*p) {
+        if (*p == '\n') {
+            line++;
+            line_start = true;
+            p++;
+        } else if (isspace((unsigned char)*p)) {
+            p++;
+        } else if (*p == '#' && line_start) {
+            while (*p && *p != '\n') {
+                if (*p == '\\' && p[1] == '\n') {
+                    line++;
+                    p++;
+                }
+                p++;
+            }
+        } else if (p[0] == '/' && p[1] == '/') {
+            while (*p && *p != '\n') {
+                p++;
+            }
+        } else if (p[0] == '/' && p[1] == '*') {
+            const char *end = strstr(p + 2, "*/");
+            if (!end) {
+                compile_error(c, line, "Unterminated comment");
+                return -1;
+            }
+            for (; p < end; p++) {
+                line += *p == '\n';
+            }
+            p += 2;
+        } else {
+            line_start = false;
+            if (isdigit((unsigned char)*p)) {
+                Token *token = add_token(c, &capacity, TOKEN_NUMBER, line);
+                char *end;
+                token->value = (sword_t)strtoull(p, &end, 0);
+                p = end;
+                while (*p == 'u' || *p == 'U' || *p == 'l' || *p == 'L') {
+                    p++;
+                }
+            } else if (isalpha((unsigned char)*p) || *p == '_') {
+                const char *start = p;
+                while (isalnum((unsigned char)*p) || *p == '_') {
+                    p++;
+                }
+                Token *token = add_token(c, &capacity, TOKEN_IDENT, line);
+                token->length = (int)(p - start);
+                token->text = allocate(c, (size_t)token->length + 1);
+                memcpy(token->text, start, (size_t)token->length);
+            } else if (*p == '\'') {
+                p++;
+                Token *token = add_token(c, &capacity, TOKEN_NUMBER, line);
+                token->value = *p == '\\' ? (p++, escape(&p)) : (unsigned char)*p++;
+                if (*p++ != '\'') {
+                    compile_error(c, line, "Bad character constant");
+                    return -1;
+                }
+            } else if (*p == '"') {
+                Token *token = c->token_count && c->tokens[c->token_count - 1].kind == TOKEN_STRING
+                                   ? &c->tokens[c->token_count - 1] : add_token(c, &capacity, TOKEN_STRING, line);
+                size_t limit = (size_t)token->length + strlen(p) + 1;
+                char *text = allocate(c, limit);
+                if (token->text) {
+                    memcpy(text, token->text, (size_t)token->length);
+                }
+                p++;
+                while (*p && *p != '"' && *p != '\n') {
+                    text[token->length++] = (char)(*p == '\\' ? (p++, escape(&p)) : *p++);
+                }
+                if (*p++ != '"') {
+                    compile_error(c, line, "Unterminated string");
+                    return -1;
+                }
+                token->text = text;
+            } else {
+                size_t i = 0;
+                while (i < sizeof(punctuators) / sizeof(punctuators[0]) &&
+                       strncmp(p, punctuators[i], strlen(punctuators[i])) != 0) {
+                    i++;
+                }
+                if (i == sizeof(punctuators) / sizeof(punctuators[0])) {
+                    compile_error(c, line, "Unexpected character '%c'", *p);
+                    return -1;
+                }
+                Token *token = add_token(c, &capacity, TOKEN_PUNCT, line);
+                token->text = (char *)punctuators[i];
+                p += strlen(punctuators[i]);
+            }
+        }
+    }
+    add_token(c, &capacity, TOKEN_EOF, line);
+    return 0;
+}
+
+// Parser
+
+static Token *peek(Compiler *c) {
+    return &c->tokens[c->pos];
+}
+
+static bool is_punct(const Token *token, const char *text) {
+    return token->kind == TOKEN_PUNCT && strcmp(token->text, text) == 0;
+}
+
+static bool is_word(const Token *token, const char *text) {
+    return token->kind == TOKEN_IDENT && strcmp(token->text, text) == 0;
+}
+
+// Consume a punctuator if it is next
+static bool accept(Compiler *c, const char *text) {
+    if (is_punct(peek(c), text)) {
+        c->pos++;
+        return true;
+    }
+    return false;
+}
+
+static void expect(Compiler *c, const char *text) {
+    if (!accept(c, text)) {
+        compile_error(c, peek(c)->line, "Expected '%s'", text);
+    }
+}
+
+static bool is_type_word(const Token *token) {
+    static const char *const words[] = {
+        "void", "char", "short", "int", "long", "signed", "unsigned", "const", "static", "extern", "volatile",
+        "register"
+    };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        if (is_word(token, words[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static Type *pointer_to(Compiler *c, Type *base) {
+    Type *type = allocate(c, sizeof(Type));
+    type->kind = TYPE_POINTER;
+    type->base = base;
+    return type;
+}
+
+static Type *array_of(Compiler *c, Type *base, uint32_t length) {
+    Type *type = allocate(c, sizeof(Type));
+    type->kind = TYPE_ARRAY;
+    type->base = base;
+    type->length = length;
+    return type;
+}
+
+static uint32_t type_size(const Type *type) {
+    switch (type->kind) {
+        case TYPE_CHAR: return 1;
+        case TYPE_ARRAY: return type->length * type_size(type->base);
+        case TYPE_VOID: return 1;
+        default: return WORD_BYTES;
+    }
+}
+
+static bool is_pointer(const Type *type) {
+    return type->kind == TYPE_POINTER || type->kind == TYPE_ARRAY;
+}
+
+// Arrays used as values become pointers to their first element
+static Type *decay(Compiler *c, Type *type) {
+    return type->kind == TYPE_ARRAY ? pointer_to(c, type->base) : type;
+}
+
+// Parse type specifiers and qualifiers; all integer types but char are a word
+static Type *parse_base_type(Compiler *c) {
+    Type *type = NULL;
+    bool seen = false;
+    while (is_type_word(peek(c))) {
+        Token *token = &c->tokens[c->pos++];
+        seen = true;
+        if (is_word(token, "void")) {
+            type = &void_type;
+        } else if (is_word(token, "char")) {
+            type = &char_type;
+        } else if (!is_word(token, "const") && !is_word(token, "static") && !is_word(token, "extern") &&
+                   !is_word(token, "volatile") && !is_word(token, "register") && type != &char_type) {
+            type = &word_type;
+        }
+    }
+    if (!seen) {
+        compile_error(c, peek(c)->line, "Expected a type");
+    }
+    return type ? type : &word_type;
+}
+
+// Parse "*... name" after the base type
+static Type *parse_declarator(Compiler *c, Type *type, const char **name, int *line) {
+    while (accept(c, "*")) {
+        type = pointer_to(c, type);
+        while (is_word(peek(c), "const") || is_word(peek(c), "volatile")) {
+            c->pos++;
+        }
+    }
+    Token *token = peek(c);
+    *line = token->line;
+    if (is_punct(token, ",") || is_punct(token, ")")) {
+        *name = "";     // Unnamed prototype parameter
+        return type;
+    }
+    if (token->kind != TOKEN_IDENT || is_type_word(token)) {
+        compile_error(c, token->line, "Expected a name");
+        *name = "";
+        return type;
+    }
+    c->pos++;
+    *name = token->text;
+    if (token->length >= IR_NAME_LENGTH || strncmp(token->text, "__", 2) == 0) {
+        compile_error(c, token->line, "Name %s is reserved or longer than %d characters", token->text,
+                      IR_NAME_LENGTH - 1);
+    }
+    return type;
+}
+
+static Node *new_node(Compiler *c, NodeKind kind, int line) {
+    Node *node = allocate(c, sizeof(Node));
+    node->kind = kind;
+    node->line = line;
+    node->type = &word_type;
+    node->op = IR_NONE;
+    return node;
+}
+
+static Node *number_node(Compiler *c, sword_t value, int line) {
+    Node *node = new_node(c, NODE_NUMBER, line);
+    node->value = value;
+    return node;
+}
+
+// Find or add a global symbol
+static int global_symbol(Compiler *c, const char *name, bool function) {
+    int symbol = ir_find_symbol(c->program, name);
+    if (symbol != IR_NONE) {
+        return symbol;
+    }
+    symbol = ir_add_symbol(c->program, name, function);
+    if (symbol >= c->info_capacity) {
+        int capacity = c->info_capacity ? c->info_capacity * 2 : 64;
+        SymbolInfo *grown = realloc(c->info, (size_t)capacity * sizeof(SymbolInfo));
+        if (!grown) {
+            abort();
+        }
+        memset(grown + c->info_capacity, 0, (size_t)(capacity - c->info_capacity) * sizeof(SymbolInfo));
+        c->info = grown;
+        c->info_capacity = capacity;
+    }
+    c->info[symbol].type = &word_type;
+    return symbol;
+}
+
+// A string literal becomes an anonymous char array
+static int string_symbol(Compiler *c, const char *text, int length) {
+    for (int i = 0; i < c->program->symbol_count; i++) {
+        const IRSymbol *s = &c->program->symbols[i];
+        if (strncmp(s->name, "__str", 5) == 0 && s->size == (uint32_t)length + 1 &&
+            memcmp(s->data, text, (size_t)length) == 0) {
+            return i;   // Identical literals may share storage
+        }
+    }
+    char name[IR_NAME_LENGTH];
+    snprintf(name, sizeof(name), "__str%d", c->strings++);
+    int symbol = global_symbol(c, name, false);
+    IRSymbol *s = &c->program->symbols[symbol];
+    s->size = (uint32_t)length + 1;
+    s->data = calloc(s->size, 1);
+    if (!s->data) {
+        abort();
+    }
+    memcpy(s->data, text, (size_t)length);
+    c->info[symbol].type = array_of(c, &char_type, s->size);
+    return symbol;
+}
+
+static int find_local(const Compiler *c, const char *name) {
+    for (int i = c->scope_count - 1; i >= 0; i--) {
+        if (strcmp(c->locals[c->scope[i]].name, name) == 0) {
+            return c->scope[i];
+        }
+    }
+    return IR_NONE;
+}
+
+static int declare_local(Compiler *c, const char *name, Type *type, int line) {
+    if (c->local_count == MAX_LOCALS || c->scope_count == MAX_SCOPE) {
+        compile_error(c, line, "Too many locals");
+        return 0;
+    }
+    Local *local = &c->locals[c->local_count];
+    memset(local, 0, sizeof(*local));
+    snprintf(local->name, sizeof(local->name), "%s", name);
+    local->type = type;
+    c->scope[c->scope_count++] = c->local_count;
+    return c->local_count++;
+}
+
+static Node *parse_expression(Compiler *c);
+static Node *parse_assignment(Compiler *c);
+static Node *parse_unary(Compiler *c);
+
+static bool is_lvalue(const Node *node) {
+    return (node->kind == NODE_LOCAL || node->kind == NODE_GLOBAL || node->kind == NODE_DEREF) &&
+           node->type->kind != TYPE_ARRAY;
+}
+
+// Type of an arithmetic result; pointer arithmetic keeps the pointer type
+static Type *binary_type(Compiler *c, int op, const Node *a, const Node *b) {
+    if (op >= IR_EQ && op <= IR_GE) {
+        return &word_type;
+    }
+    if (op == IR_ADD || op == IR_SUB) {
+        if (is_pointer(a->type) && is_pointer(b->type)) {
+            return &word_type;
+        }
+        if (is_pointer(a->type)) {
+            return decay(c, a->type);
+        }
+        if (is_pointer(b->type)) {
+            return decay(c, b->type);
+        }
+    }
+    return &word_type;
+}
+
+static Node *binary_node(Compiler *c, int op, Node *a, Node *b, int line) {
+    Node *node = new_node(c, NODE_BINARY, line);
+    node->op = op;
+    node->a = a;
+    node->b = b;
+    node->type = binary_type(c, op, a, b);
+    return node;
+}
+
+// Record that a name's address escapes
+static void mark_addressed(Compiler *c, const Node *node) {
+    if (node->kind == NODE_LOCAL) {
+        c->locals[node->index].addressed = true;
+    } else if (node->kind == NODE_GLOBAL) {
+        c->info[node->index].addressed = true;
+    }
+}
+
+static Node *parse_call(Compiler *c, const Token *name) {
+    Node *node = new_node(c, NODE_CALL, name->line);
+    node->index = global_symbol(c, name->text, true);
+    if (!c->program->symbols[node->index].function) {
+        compile_error(c, name->line, "%s is not a function", name->text);
+        return &error_node;
+    }
+    c->info[node->index].called = true;
+    node->type = c->info[node->index].type;
+    Node **tail = &node->a;
+    int count = 0;
+    if (!accept(c, ")")) {
+        do {
+            *tail = parse_assignment(c);
+            tail = &(*tail)->next;
+            count++;
+        } while (accept(c, ","));
+        expect(c, ")");
+    }
+    node->value = count;
+    return node;
+}
+
+static Node *parse_primary(Compiler *c) {
+    Token *token = peek(c);
+    if (token->kind == TOKEN_NUMBER) {
+        c->pos++;
+        return number_node(c, token->value, token->line);
+    }
+    if (token->kind == TOKEN_STRING) {
+        c->pos++;
+        Node *node = new_node(c, NODE_GLOBAL, token->line);
+        node->index = string_symbol(c, token->text, token->length);
+        node->type = c->info[node->index].type;
+        return node;
+    }
+    if (accept(c, "(")) {
+        Node *node = parse_expression(c);
+        expect(c, ")");
+        return node;
+    }
+    if (token->kind == TOKEN_IDENT && !is_type_word(token)) {
+        c->pos++;
+        if (accept(c, "(")) {
+            return parse_call(c, token);
+        }
+        int local = find_local(c, token->text);
+        if (local != IR_NONE) {
+            Node *node = new_node(c, NODE_LOCAL, token->line);
+            node->index = local;
+            node->type = c->locals[local].type;
+            return node;
+        }
+        int symbol = ir_find_symbol(c->program, token->text);
+        if (symbol == IR_NONE || c->program->symbols[symbol].function) {
+            compile_error(c, token->line, symbol == IR_NONE ? "Undeclared %s" : "Function %s used as a value",
+                          token->text);
+            return &error_node;
+        }
+        Node *node = new_node(c, NODE_GLOBAL, token->line);
+        node->index = symbol;
+        node->type = c->info[symbol].type;
+        return node;
+    }
+    compile_error(c, token->line, "Expected an expression");
+    return &error_node;
+}
+
+static Node *parse_postfix(Compiler *c) {
+    Node *node = parse_primary(c);
+    for (;;) {
+        int line = peek(c)->line;
+        if (accept(c, "[")) {
+            Node *index = parse_expression(c);
+            expect(c, "]");
+            if (!is_pointer(node->type) && !is_pointer(index->type)) {
+                compile_error(c, line, "Subscript of a non-pointer");
+                return &error_node;
+            }
+            Node *deref = new_node(c, NODE_DEREF, line);
+            deref->a = binary_node(c, IR_ADD, node, index, line);
+            deref->type = deref->a->type->base;
+            node = deref;
+        } else if (is_punct(peek(c), "++") || is_punct(peek(c), "--")) {
+            Node *increment = new_node(c, NODE_INCREMENT, line);
+            increment->value = is_punct(peek(c), "++") ? 1 : -1;
+            increment->op = 0;
+            c->pos++;
+            if (!is_lvalue(node)) {
+                compile_error(c, line, "Operand of %s is not assignable", increment->value > 0 ? "++" : "--");
+            }
+            increment->a = node;
+            increment->type = node->type;
+            node = increment;
+        } else if (is_punct(peek(c), ".") || is_punct(peek(c), "->")) {
+            compile_error(c, line, "Structures are not supported");
+            return &error_node;
+        } else {
+            return node;
+        }
+    }
+}
+
+// sizeof (type) or sizeof expression
+static Node *parse_sizeof(Compiler *c, int line) {
+    if (is_punct(peek(c), "(") && is_type_word(&c->tokens[c->pos + 1])) {
+        c->pos++;
+        Type *type = parse_base_type(c);
+        while (accept(c, "*")) {
+            type = pointer_to(c, type);
+        }
+        expect(c, ")");
+        return number_node(c, (sword_t)type_size(type), line);
+    }
+    Node *operand = parse_unary(c);
+    return number_node(c, (sword_t)type_size(operand->type), line);
+}
+
+static Node *parse_unary(Compiler *c) {
+    Token *token = peek(c);
+    int line = token->line;
+    if (is_word(token, "sizeof")) {
+        c->pos++;
+        return parse_sizeof(c, line);
+    }
+    if (token->kind != TOKEN_PUNCT) {
+        return parse_postfix(c);
+    }
+    if (is_punct(token, "(") && is_type_word(&c->tokens[c->pos + 1])) {
+        c->pos++;
+        Type *type = parse_base_type(c);
+        while (accept(c, "*")) {
+            type = pointer_to(c, type);
+        }
+        expect(c, ")");
+        Node *node = new_node(c, NODE_CAST, line);
+        node->a = parse_unary(c);
+        node->type = type;
+        return node;
+    }
+    static const struct {
+        const char *text;
+        NodeKind kind;
+    } prefixes[] = {
+        {"-", NODE_NEGATE}, {"!", NODE_NOT}, {"~", NODE_COMPLEMENT}, {"*", NODE_DEREF}, {"&", NODE_ADDRESS},
+        {"++", NODE_INCREMENT}, {"--", NODE_INCREMENT}, {"+", NODE_EMPTY}
+    };
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+        if (!is_punct(token, prefixes[i].text)) {
+            continue;
+        }
+        c->pos++;
+        Node *operand = parse_unary(c);
+        if (prefixes[i].kind == NODE_EMPTY) {
+            return operand;
+        }
+        Node *node = new_node(c, prefixes[i].kind, line);
+        node->a = operand;
+        switch (node->kind) {
+            case NODE_DEREF:
+                if (!is_pointer(operand->type)) {
+                    compile_error(c, line, "Dereference of a non-pointer");
+                    return &error_node;
+                }
+                node->type = operand->type->base;
+                break;
+            case NODE_ADDRESS:
+                if (operand->kind != NODE_LOCAL && operand->kind != NODE_GLOBAL && operand->kind != NODE_DEREF) {
+                    compile_error(c, line, "Operand of & has no address");
+                    return &error_node;
+                }
+                mark_addressed(c, operand);
+                node->type = pointer_to(c, operand->type->kind == TYPE_ARRAY ? operand->type->base : operand->type);
+                break;
+            case NODE_INCREMENT:
+                node->value = prefixes[i].text[0] == '+' ? 1 : -1;
+                node->op = 1;
+                node->type = operand->type;
+                if (!is_lvalue(operand)) {
+                    compile_error(c, line, "Operand of %s is not assignable", prefixes[i].text);
+                }
+                break;
+            default:
+                break;
+        }
+        return node;
+    }
+    return parse_postfix(c);
+}
+
+// Binary operators from loosest to tightest binding
+static const struct {
+    const char *text;
+    int op;
+} binary_levels[][4] = {
+    {{"|", IR_OR}},
+    {{"^", IR_XOR}},
+    {{"&", IR_AND}},
+    {{"==", IR_EQ}, {"!=", IR_NE}},
+    {{"<", IR_LT}, {">", IR_GT}, {"<=", IR_LE}, {">=", IR_GE}},
+    {{"<<", IR_SHL}, {">>", IR_SAR}},
+    {{"+", IR_ADD}, {"-", IR_SUB}},
+    {{"*", IR_MUL}, {"/", IR_DIV}, {"%", OP_MOD}}
+};
+
+#define BINARY_LEVELS ((int)(sizeof(binary_levels) / sizeof(binary_levels[0])))
+
+static Node *parse_binary(Compiler *c, int level) {
+    if (level == BINARY_LEVELS) {
+        return parse_unary(c);
+    }
+    Node *node = parse_binary(c, level + 1);
+    for (;;) {
+        int line = peek(c)->line, op = IR_NONE;
+        for (int i = 0; i < 4 && binary_levels[level][i].text; i++) {
+            if (accept(c, binary_levels[level][i].text)) {
+                op = binary_levels[level][i].op;
+                break;
+            }
+        }
+        if (op == IR_NONE) {
+            return node;
+        }
+        node = binary_node(c, op, node, parse_binary(c, level + 1), line);
+    }
+}
+
+static Node *parse_logical(Compiler *c, bool or) {
+    Node *node = or ? parse_logical(c, false) : parse_binary(c, 0);
+    while (is_punct(peek(c), or ? "||" : "&&")) {
+        Node *logical = new_node(c, or ? NODE_OR : NODE_AND, peek(c)->line);
+        c->pos++;
+        logical->a = node;
+        logical->b = or ? parse_logical(c, false) : parse_binary(c, 0);
+        node = logical;
+    }
+    return node;
+}
+
+static Node *parse_conditional(Compiler *c) {
+    Node *node = parse_logical(c, true);
+    if (!is_punct(peek(c), "?")) {
+        return node;
+    }
+    Node *conditional = new_node(c, NODE_CONDITIONAL, peek(c)->line);
+    c->pos++;
+    conditional->a = node;
+    conditional->b = parse_expression(c);
+    expect(c, ":");
+    conditional->c = parse_conditional(c);
+    conditional->type = decay(c, conditional->b->type);
+    return conditional;
+}
+
+static Node *parse_assignment(Compiler *c) {
+    Node *node = parse_conditional(c);
+    static const struct {
+        const char *text;
+        int op;
+    } operators[] = {
+        {"=", IR_NONE}, {"+=", IR_ADD}, {"-=", IR_SUB}, {"*=", IR_MUL}, {"/=", IR_DIV}, {"%=", OP_MOD},
+        {"&=", IR_AND}, {"|=", IR_OR}, {"^=", IR_XOR}, {"<<=", IR_SHL}, {">>=", IR_SAR}
+    };
+    for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+        if (is_punct(peek(c), operators[i].text)) {
+            Node *assign = new_node(c, NODE_ASSIGN, peek(c)->line);
+            c->pos++;
+            if (!is_lvalue(node)) {
+                compile_error(c, assign->line, "Left of %s is not assignable", operators[i].text);
+                return &error_node;
+            }
+            assign->op = operators[i].op;
+            assign->a = node;
+            assign->b = parse_assignment(c);
+            assign->type = node->type;
+            return assign;
+        }
+    }
+    return node;
+}
+
+static Node *parse_expression(Compiler *c) {
+    Node *node = parse_assignment(c);
+    while (is_punct(peek(c), ",")) {
+        Node *comma = new_node(c, NODE_COMMA, peek(c)->line);
+        c->pos++;
+        comma->a = node;
+        comma->b = parse_assignment(c);
+        comma->type = comma->b->type;
+        node = comma;
+    }
+    return node;
+}
+
+// Array bounds after a declarator; an empty bound is taken from the initializer
+static Type *parse_array_suffix(Compiler *c, Type *type, bool *unsized) {
+    *unsized = false;
+    if (!accept(c, "[")) {
+        return type;
+    }
+    if (accept(c, "]")) {
+        *unsized = true;
+        return array_of(c, type, 0);
+    }
+    Token *token = peek(c);
+    if (token->kind != TOKEN_NUMBER || token->value <= 0) {
+        compile_error(c, token->line, "Array size must be a positive number");
+        return type;
+    }
+    c->pos++;
+    expect(c, "]");
+    return array_of(c, type, (uint32_t)token->value);
+}
+
+static Node *parse_statement(Compiler *c);
+
+// Local declaration; each initialized declarator becomes an assignment
+static Node *parse_local_declaration(Compiler *c) {
+    Type *base = parse_base_type(c);
+    Node *first = NULL, **tail = &first;
+    do {
+        const char *name;
+        int line;
+        bool unsized;
+        Type *type = parse_declarator(c, base, &name, &line);
+        type = parse_array_suffix(c, type, &unsized);
+        if (type->kind == TYPE_VOID || unsized) {
+            compile_error(c, line, "Local %s needs a complete type", name);
+        }
+        int local = declare_local(c, name, type, line);
+        if (accept(c, "=")) {
+            if (type->kind == TYPE_ARRAY) {
+                compile_error(c, line, "Local arrays cannot be initialized");
+                break;
+            }
+            Node *target = new_node(c, NODE_LOCAL, line);
+            target->index = local;
+            target->type = type;
+            Node *assign = new_node(c, NODE_ASSIGN, line);
+            assign->a = target;
+            assign->b = parse_assignment(c);
+            assign->type = type;
+            Node *statement = new_node(c, NODE_EXPRESSION, line);
+            statement->a = assign;
+            *tail = statement;
+            tail = &statement->next;
+        }
+    } while (accept(c, ","));
+    expect(c, ";");
+    Node *block = new_node(c, NODE_BLOCK, peek(c)->line);
+    block->a = first;
+    return block;
+}
+
+static Node *parse_block(Compiler *c) {
+    Node *block = new_node(c, NODE_BLOCK, peek(c)->line);
+    int scope = c->scope_count;
+    Node **tail = &block->a;
+    while (!accept(c, "}")) {
+        if (peek(c)->kind == TOKEN_EOF) {
+            compile_error(c, peek(c)->line, "Expected '}'");
+            break;
+        }
+        *tail = parse_statement(c);
+        tail = &(*tail)->next;
+    }
+    c->scope_count = scope;
+    return block;
+}
+
+static Node *parse_statement(Compiler *c) {
+    Token *token = peek(c);
+    int line = token->line;
+    if (accept(c, "{")) {
+        return parse_block(c);
+    }
+    if (accept(c, ";")) {
+        return new_node(c, NODE_EMPTY, line);
+    }
+    if (is_type_word(token)) {
+        return parse_local_declaration(c);
+    }
+    if (token->kind == TOKEN_IDENT) {
+        static const NodeKind kinds[] = {NODE_IF, NODE_WHILE, NODE_DO, NODE_FOR, NODE_BREAK, NODE_CONTINUE,
+                                         NODE_RETURN};
+        static const char *const words[] = {"if", "while", "do", "for", "break", "continue", "return"};
+        for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+            if (!is_word(token, words[i])) {
+                continue;
+            }
+            c->pos++;
+            Node *node = new_node(c, kinds[i], line);
+            switch (node->kind) {
+                case NODE_IF:
+                    expect(c, "(");
+                    node->a = parse_expression(c);
+                    expect(c, ")");
+                    node->b = parse_statement(c);
+                    if (is_word(peek(c), "else")) {
+                        c->pos++;
+                        node->c = parse_statement(c);
+                    }
+                    break;
+                case NODE_WHILE:
+                    expect(c, "(");
+                    node->b = parse_expression(c);
+                    expect(c, ")");
+                    node->d = parse_statement(c);
+                    break;
+                case NODE_DO:
+                    node->d = parse_statement(c);
+                    if (!is_word(peek(c), "while")) {
+                        compile_error(c, peek(c)->line, "Expected 'while'");
+                        break;
+                    }
+                    c->pos++;
+                    expect(c, "(");
+                    node->b = parse_expression(c);
+                    expect(c, ")");
+                    expect(c, ";");
+                    break;
+                case NODE_FOR: {
+                    int scope = c->scope_count;
+                    expect(c, "(");
+                    if (is_type_word(peek(c))) {
+                        node->a = parse_local_declaration(c);
+                    } else if (!accept(c, ";")) {
+                        node->a = new_node(c, NODE_EXPRESSION, line);
+                        node->a->a = parse_expression(c);
+                        expect(c, ";");
+                    }
+                    if (!is_punct(peek(c), ";")) {
+                        node->b = parse_expression(c);
+                    }
+                    expect(c, ";");
+                    if (!is_punct(peek(c), ")")) {
+                        node->c = parse_expression(c);
+                    }
+                    expect(c, ")");
+                    node->d = parse_statement(c);
+                    c->scope_count = scope;
+                    break;
+                }
+                case NODE_RETURN:
+                    if (!accept(c, ";")) {
+                        node->a = parse_expression(c);
+                        expect(c, ";");
+                    }
+                    if ((node->a != NULL) != (c->return_type->kind != TYPE_VOID)) {
+                        compile_error(c, line, node->a ? "Return with a value in a void function"
+                                                       : "Return without a value");
+                    }
+                    break;
+                default:
+                    expect(c, ";");
+                    break;
+            }
+            return node;
+        }
+        if (is_word(token, "switch") || is_word(token, "goto") || is_word(token, "struct") ||
+            is_word(token, "union") || is_word(token, "typedef") || is_word(token, "enum")) {
+            compile_error(c, line, "'%s' is not supported", token->text);
+            return &error_node;
+        }
+    }
+    Node *node = new_node(c, NODE_EXPRESSION, line);
+    node->a = parse_expression(c);
+    expect(c, ";");
+    return node;
+}
+
+// Value of a global initializer, which must be constant
+static bool constant_value(const Node *node, sword_t *value) {
+    sword_t a, b;
+    switch (node->kind) {
+        case NODE_NUMBER:
+            *value = node->value;
+            return true;
+        case NODE_NEGATE:
+            if (!constant_value(node->a, &a)) {
+                return false;
+            }
+            *value = (sword_t)(0 - (word_t)a);
+            return true;
+        case NODE_COMPLEMENT:
+            if (!constant_value(node->a, &a)) {
+                return false;
+            }
+            *value = ~a;
+            return true;
+        case NODE_CAST:
+            if (!constant_value(node->a, &a)) {
+                return false;
+            }
+            *value = node->type->kind == TYPE_CHAR ? (a & 0xFF) : a;
+            return true;
+        case NODE_BINARY:
+            if (!constant_value(node->a, &a) || !constant_value(node->b, &b) || is_pointer(node->type)) {
+                return false;
+            }
+            switch (node->op) {
+                case IR_ADD: *value = (sword_t)((word_t)a + (word_t)b); return true;
+                case IR_SUB: *value = (sword_t)((word_t)a - (word_t)b); return true;
+                case IR_MUL: *value = (sword_t)((word_t)a * (word_t)b); return true;
+                case IR_DIV: if (b == 0) return false; *value = a / b; return true;
+                case OP_MOD: if (b == 0) return false; *value = a % b; return true;
+                case IR_AND: *value = a & b; return true;
+                case IR_OR: *value = a | b; return true;
+                case IR_XOR: *value = a ^ b; return true;
+                case IR_SHL: *value = (sword_t)((word_t)a << (b & (WORD_SIZE - 1))); return true;
+                case IR_SAR: *value = a >> (b & (WORD_SIZE - 1)); return true;
+                default: return false;
+            }
+        default:
+            return false;
+    }
+}
+
+// Store one initializer element into a global's data
+static void put_element(Compiler *c, IRSymbol *symbol, uint32_t offset, uint32_t size, const Node *node) {
+    sword_t value;
+    if (!constant_value(node, &value)) {
+        compile_error(c, node->line, "Initializer of %s is not a constant", symbol->name);
+        return;
+    }
+    if (offset + size <= symbol->size) {
+        memcpy(symbol->data + offset, &value, size);    // Little-endian, like the guest
+    }
+}
+
+// Global initializer: a constant, a brace list for arrays, or a string for char arrays
+static void parse_global_initializer(Compiler *c, int symbol, Type *type, bool unsized) {
+    IRSymbol *s = &c->program->symbols[symbol];   // Reloaded after parsing, which may add string symbols
+    if (type->kind == TYPE_ARRAY && peek(c)->kind == TOKEN_STRING && type->base->kind == TYPE_CHAR) {
+        Token *token = &c->tokens[c->pos++];
+        if (unsized) {
+            type->length = (uint32_t)token->length + 1;
+        }
+        s->size = type_size(type);
+        s->data = calloc(s->size ? s->size : 1, 1);
+        memcpy(s->data, token->text, (size_t)token->length < s->size ? (size_t)token->length : s->size);
+        return;
+    }
+    if (type->kind == TYPE_ARRAY) {
+        expect(c, "{");
+        Node *items[4096];
+        uint32_t count = 0;
+        while (!is_punct(peek(c), "}") && !c->failed) {
+            if (count == sizeof(items) / sizeof(items[0])) {
+                compile_error(c, peek(c)->line, "Initializer too long");
+                return;
+            }
+            items[count++] = parse_assignment(c);
+            if (!accept(c, ",")) {
+                break;
+            }
+        }
+        expect(c, "}");
+        if (unsized) {
+            type->length = count;
+        }
+        s = &c->program->symbols[symbol];
+        s->size = type_size(type);
+        s->data = calloc(s->size ? s->size : 1, 1);
+        uint32_t element = type_size(type->base);
+        for (uint32_t i = 0; i < count && i < type->length; i++) {
+            put_element(c, s, i * element, element, items[i]);
+        }
+        return;
+    }
+    Node *node = parse_assignment(c);
+    s = &c->program->symbols[symbol];
+    s->size = type_size(type);
+    s->data = calloc(WORD_BYTES, 1);
+    put_element(c, s, 0, s->size, node);
+}
+
+// Function parameters and body, after the opening parenthesis
+static void parse_function(Compiler *c, int symbol, Type *return_type, int line) {
+    SymbolInfo *info = &c->info[symbol];
+    info->type = return_type;
+    c->local_count = 0;
+    c->scope_count = 0;
+    c->return_type = return_type;
+    int params = 0;
+    if (is_word(peek(c), "void") && is_punct(&c->tokens[c->pos + 1], ")")) {
+        c->pos++;
+    }
+    if (!accept(c, ")")) {
+        do {
+            if (accept(c, "...")) {
+                break;
+            }
+            const char *name;
+            int param_line;
+            bool unsized;
+            Type *type = parse_declarator(c, parse_base_type(c), &name, &param_line);
+            type = parse_array_suffix(c, type, &unsized);
+            declare_local(c, name, decay(c, type), param_line);
+            params++;
+        } while (accept(c, ","));
+        expect(c, ")");
+    }
+    if (params > IR_MAX_ARGS) {
+        compile_error(c, line, "Function %s has more than %d parameters", c->program->symbols[symbol].name,
+                      IR_MAX_ARGS);
+    }
+    info->param_count = params;
+    if (accept(c, ";")) {
+        return;     // Prototype
+    }
+    if (c->program->symbols[symbol].defined) {
+        compile_error(c, line, "Function %s defined twice", c->program->symbols[symbol].name);
+        return;
+    }
+    expect(c, "{");
+    c->program->symbols[symbol].defined = true;
+    Node *body = parse_block(c);
+
+    if (c->function_count == c->function_capacity) {
+        c->function_capacity = c->function_capacity ? c->function_capacity * 2 : 16;
+        FunctionDef *grown = realloc(c->functions, (size_t)c->function_capacity * sizeof(FunctionDef));
+        if (!grown) {
+            abort();
+        }
+        c->functions = grown;
+    }
+    FunctionDef *def = &c->functions[c->function_count++];
+    def->symbol = symbol;
+    def->body = body;
+    def->param_count = params;
+    def->local_count = c->local_count;
+    def->locals = allocate(c, (size_t)c->local_count * sizeof(Local));
+    memcpy(def->locals, c->locals, (size_t)c->local_count * sizeof(Local));
+
+    // Arrays and locals whose address is taken get frame offsets
+    def->frame_size = 0;
+    for (int i = 0; i < def->local_count; i++) {
+        Local *local = &def->locals[i];
+        if (local->addressed || local->type->kind == TYPE_ARRAY) {
+            local->addressed = true;
+            local->offset = def->frame_size;
+            def->frame_size += (type_size(local->type) + WORD_BYTES - 1) & ~(uint32_t)(WORD_BYTES - 1);
+        }
+    }
+}
+
+// Top level: functions, prototypes and global variables
+static void parse_program(Compiler *c) {
+    while (peek(c)->kind != TOKEN_EOF) {
+        Type *base = parse_base_type(c);
+        bool function = false;
+        do {
+            const char *name;
+            int line;
+            bool unsized;
+            Type *type = parse_declarator(c, base, &name, &line);
+            if (c->failed) {
+                return;
+            }
+            if (accept(c, "(")) {
+                int symbol = global_symbol(c, name, true);
+                if (!c->program->symbols[symbol].function) {
+                    compile_error(c, line, "%s redeclared as a function", name);
+                    return;
+                }
+                parse_function(c, symbol, type, line);
+                function = true;    // Ends at its body or the prototype's semicolon
+                break;
+            }
+            type = parse_array_suffix(c, type, &unsized);
+            if (type->kind == TYPE_VOID) {
+                compile_error(c, line, "Variable %s has type void", name);
+                return;
+            }
+            if (ir_find_symbol(c->program, name) != IR_NONE) {
+                compile_error(c, line, "%s declared twice", name);
+                return;
+            }
+            int symbol = global_symbol(c, name, false);
+            c->info[symbol].type = type;
+            c->info[symbol].line = line;
+            if (accept(c, "=")) {
+                parse_global_initializer(c, symbol, type, unsized);
+            } else if (unsized) {
+                compile_error(c, line, "Array %s needs a size", name);
+            }
+            c->program->symbols[symbol].size = type_size(type);
+        } while (accept(c, ","));
+        if (!function) {
+            expect(c, ";");
+        }
+    }
+}
+
+// IR generation
+
+typedef struct {
+    int block;
+    int variable;
+    int phi;
+} IncompletePhi;
+
+typedef struct {
+    Compiler *c;
+    FunctionDef *def;
+    IRFunction *fn;
+    int block;              // Current block
+    int *defs;              // Current value of each variable per block
+    int defs_blocks;
+    IncompletePhi *incomplete;
+    int incomplete_count;
+    int incomplete_capacity;
+    int frame;              // Frame address value, or IR_NONE
+    int break_target;
+    int continue_target;
+} Generator;
+
+// Lvalue as a variable, direct global or memory address
+typedef struct {
+    enum { LVALUE_VARIABLE, LVALUE_DIRECT, LVALUE_MEMORY } kind;
+    int index;              // Local or symbol
+    int address;
+    Type *type;
+} LValue;
+
+static int new_block(Generator *g) {
+    int block = ir_new_block(g->fn);
+    if (block >= g->defs_blocks) {
+        int blocks = g->defs_blocks ? g->defs_blocks * 2 : 16;
+        int *grown = realloc(g->defs, (size_t)blocks * (size_t)g->def->local_count * sizeof(int));
+        if (!grown && g->def->local_count) {
+            abort();
+        }
+        g->defs = grown;
+        for (int i = g->defs_blocks * g->def->local_count; i < blocks * g->def->local_count; i++) {
+            g->defs[i] = IR_NONE;
+        }
+        g->defs_blocks = blocks;
+    }
+    return block;
+}
+
+static void write_variable(Generator *g, int variable, int block, int value) {
+    g->defs[block * g->def->local_count + variable] = value;
+}
+
+static int read_variable(Generator *g, int variable, int block);
+
+static int add_phi_operands(Generator *g, int variable, int phi) {
+    int block = g->fn->instrs[phi].block;
+    for (int k = 0; k < g->fn->blocks[block].pred_count; k++) {
+        ir_add_arg(g->fn, phi, read_variable(g, variable, g->fn->blocks[block].preds[k]));
+    }
+    return ir_remove_trivial_phi(g->fn, phi);
+}
+
+// Value of a variable at the end of a block, creating phis on the way
+// (Braun et al., "Simple and Efficient Construction of SSA Form")
+static int read_variable(Generator *g, int variable, int block) {
+    int value = g->defs[block * g->def->local_count + variable];
+    if (value != IR_NONE) {
+        return ir_resolve(g->fn, value);
+    }
+    IRBlock *b = &g->fn->blocks[block];
+    if (!b->sealed) {
+        value = ir_phi(g->fn, block);
+        if (g->incomplete_count == g->incomplete_capacity) {
+            g->incomplete_capacity = g->incomplete_capacity ? g->incomplete_capacity * 2 : 32;
+            IncompletePhi *grown = realloc(g->incomplete, (size_t)g->incomplete_capacity * sizeof(IncompletePhi));
+            if (!grown) {
+                abort();
+            }
+            g->incomplete = grown;
+        }
+        g->incomplete[g->incomplete_count++] = (IncompletePhi){block, variable, value};
+    } else if (b->pred_count == 0) {
+        value = ir_const(g->fn, 0);     // Read before any assignment
+    } else if (b->pred_count == 1) {
+        value = read_variable(g, variable, b->preds[0]);
+    } else {
+        value = ir_phi(g->fn, block);
+        write_variable(g, variable, block, value);
+        value = add_phi_operands(g, variable, value);
+    }
+    write_variable(g, variable, block, value);
+    return value;
+}
+
+// All predecessors of a block are known: complete its phis
+static void seal_block(Generator *g, int block) {
+    for (int i = 0; i < g->incomplete_count;) {
+        if (g->incomplete[i].block == block) {
+            IncompletePhi phi = g->incomplete[i];
+            g->incomplete[i] = g->incomplete[--g->incomplete_count];
+            add_phi_operands(g, phi.variable, phi.phi);
+        } else {
+            i++;
+        }
+    }
+    g->fn->blocks[block].sealed = true;
+}
+
+// Continue in a fresh block nothing jumps to, after a return or break
+static void start_unreachable(Generator *g) {
+    g->block = new_block(g);
+    g->fn->blocks[g->block].sealed = true;
+}
+
+static int generate_expression(Generator *g, Node *node);
+
+static int operation(Generator *g, int op, int a, int b, sword_t imm) {
+    return ir_operation(g->fn, g->block, (IROp)op, a, b, imm);
+}
+
+// Narrow a value to the type it is stored as
+static int convert(Generator *g, int value, const Type *type) {
+    if (type->kind == TYPE_CHAR) {
+        return operation(g, IR_AND, value, ir_const(g->fn, 0xFF), 0);
+    }
+    return value;
+}
+
+static int load(Generator *g, int address, const Type *type) {
+    int value = ir_append(g->fn, g->block, IR_LOAD, address, IR_NONE);
+    if (value != IR_NONE) {
+        g->fn->instrs[value].size = type->kind == TYPE_CHAR ? 1 : WORD_BYTES;
+    }
+    return value;
+}
+
+static void store(Generator *g, int address, int value, const Type *type) {
+    int instr = ir_append(g->fn, g->block, IR_STORE, address, value);
+    if (instr != IR_NONE) {
+        g->fn->instrs[instr].size = type->kind == TYPE_CHAR ? 1 : WORD_BYTES;
+    }
+}
+
+static bool is_direct(const Generator *g, int symbol) {
+    return g->c->program->symbols[symbol].direct;
+}
+
+static LValue generate_lvalue(Generator *g, Node *node) {
+    LValue lvalue = {LVALUE_MEMORY, node->index, IR_NONE, node->type};
+    if (node->kind == NODE_LOCAL) {
+        Local *local = &g->def->locals[node->index];
+        if (!local->addressed) {
+            lvalue.kind = LVALUE_VARIABLE;
+        } else {
+            lvalue.address = operation(g, IR_ADD, g->frame, ir_const(g->fn, (sword_t)local->offset), 0);
+        }
+    } else if (node->kind == NODE_GLOBAL) {
+        if (is_direct(g, node->index)) {
+            lvalue.kind = LVALUE_DIRECT;
+        } else {
+            lvalue.address = ir_address(g->fn, node->index);
+        }
+    } else {
+        lvalue.address = generate_expression(g, node->a);
+    }
+    return lvalue;
+}
+
+static int load_lvalue(Generator *g, const LValue *lvalue) {
+    if (lvalue->type->kind == TYPE_ARRAY) {
+        return lvalue->address;     // Arrays are used through their address
+    }
+    switch (lvalue->kind) {
+        case LVALUE_VARIABLE:
+            return read_variable(g, lvalue->index, g->block);
+        case LVALUE_DIRECT: {
+            int value = ir_append(g->fn, g->block, IR_LOADG, IR_NONE, IR_NONE);
+            if (value != IR_NONE) {
+                g->fn->instrs[value].symbol = lvalue->index;
+            }
+            return value;
+        }
+        default:
+            return load(g, lvalue->address, lvalue->type);
+    }
+}
+
+// Store through an lvalue; returns the value as the expression sees it
+static int store_lvalue(Generator *g, const LValue *lvalue, int value) {
+    value = convert(g, value, lvalue->type);
+    switch (lvalue->kind) {
+        case LVALUE_VARIABLE:
+            write_variable(g, lvalue->index, g->block, value);
+            break;
+        case LVALUE_DIRECT: {
+            int instr = ir_append(g->fn, g->block, IR_STOREG, value, IR_NONE);
+            if (instr != IR_NONE) {
+                g->fn->instrs[instr].symbol = lvalue->index;
+            }
+            break;
+        }
+        default:
+            store(g, lvalue->address, value, lvalue->type);
+            break;
+    }
+    return value;
+}
+
+// Pointer element size for scaling, 1 for integers
+static sword_t scale_of(const Type *type) {
+    return is_pointer(type) ? (sword_t)type_size(type->base) : 1;
+}
+
+// Arithmetic on two values, scaling for pointer arithmetic
+static int arithmetic(Generator *g, int op, int a, const Type *ta, int b, const Type *tb, int line) {
+    if (op == IR_ADD || op == IR_SUB) {
+        if (is_pointer(ta) && !is_pointer(tb)) {
+            b = operation(g, IR_MUL, b, ir_const(g->fn, scale_of(ta)), 0);
+        } else if (is_pointer(tb) && !is_pointer(ta) && op == IR_ADD) {
+            a = operation(g, IR_MUL, a, ir_const(g->fn, scale_of(tb)), 0);
+        } else if (is_pointer(ta) && is_pointer(tb)) {
+            int difference = operation(g, IR_SUB, a, b, 0);
+            return scale_of(ta) == 1 ? difference
+                                     : operation(g, IR_DIV, difference, ir_const(g->fn, scale_of(ta)), 0);
+        }
+        return operation(g, op, a, b, 0);
+    }
+    if (op == OP_MOD) {
+        int quotient = operation(g, IR_DIV, a, b, 0);
+        return operation(g, IR_SUB, a, operation(g, IR_MUL, quotient, b, 0), 0);
+    }
+    if (op == IR_SHL || op == IR_SAR) {
+        sword_t count;
+        if (!ir_is_const(g->fn, b, &count)) {
+            compile_error(g->c, line, "Shift count must be a constant");
+            return a;
+        }
+        return operation(g, op, a, IR_NONE, count & (WORD_SIZE - 1));
+    }
+    return operation(g, op, a, b, 0);
+}
+
+static void generate_condition(Generator *g, Node *node, int if_true, int if_false);
+
+// Value of &&, || or ! as 1 or 0
+static int generate_truth(Generator *g, Node *node) {
+    int if_true = new_block(g), if_false = new_block(g), join = new_block(g);
+    generate_condition(g, node, if_true, if_false);
+    seal_block(g, if_true);
+    seal_block(g, if_false);
+    ir_jump(g->fn, if_true, join);
+    ir_jump(g->fn, if_false, join);
+    seal_block(g, join);
+    g->block = join;
+    int phi = ir_phi(g->fn, join);
+    ir_add_arg(g->fn, phi, ir_const(g->fn, 1));
+    ir_add_arg(g->fn, phi, ir_const(g->fn, 0));
+    return phi;
+}
+
+// Branch on a condition, short-circuiting && and ||
+static void generate_condition(Generator *g, Node *node, int if_true, int if_false) {
+    if (node->kind == NODE_AND || node->kind == NODE_OR) {
+        int middle = new_block(g);
+        if (node->kind == NODE_AND) {
+            generate_condition(g, node->a, middle, if_false);
+        } else {
+            generate_condition(g, node->a, if_true, middle);
+        }
+        seal_block(g, middle);
+        g->block = middle;
+        generate_condition(g, node->b, if_true, if_false);
+    } else if (node->kind == NODE_NOT) {
+        generate_condition(g, node->a, if_false, if_true);
+    } else {
+        ir_branch(g->fn, g->block, generate_expression(g, node), if_true, if_false);
+    }
+}
+
+// A library call the file does not define, as a SYSCALL
+static int generate_builtin(Generator *g, Node *call, int *values) {
+    static const struct {
+        const char *name;
+        int syscall;
+        int args;           // -1: one to three
+        const char *format; // printf format wrapping the arguments
+    } builtins[] = {
+        {"memcpy", SYS_MEMCPY, 3, NULL}, {"memset", SYS_MEMSET, 3, NULL}, {"strlen", SYS_STRLEN, 1, NULL},
+        {"malloc", SYS_MALLOC, 1, NULL}, {"free", SYS_FREE, 1, NULL}, {"printf", SYS_PRINT, -1, NULL},
+        {"putchar", SYS_PRINT, 1, "%c"}, {"puts", SYS_PRINT, 1, "%s\n"}
+    };
+    const char *name = g->c->program->symbols[call->index].name;
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcmp(name, builtins[i].name) != 0) {
+            continue;
+        }
+        int count = (int)call->value;
+        if (builtins[i].args < 0 ? count < 1 || count > 3 : count != builtins[i].args) {
+            compile_error(g->c, call->line, builtins[i].args < 0 ? "%s takes a format and at most two arguments"
+                                                                  : "Wrong number of arguments to %s", name);
+            return IR_NONE;
+        }
+        int value = ir_append(g->fn, g->block, IR_SYSCALL, IR_NONE, IR_NONE);
+        if (value == IR_NONE) {
+            return ir_const(g->fn, 0);
+        }
+        g->fn->instrs[value].imm = builtins[i].syscall;
+        if (builtins[i].format) {
+            int format = string_symbol(g->c, builtins[i].format, (int)strlen(builtins[i].format));
+            ir_add_arg(g->fn, value, ir_address(g->fn, format));
+        }
+        for (int k = 0; k < count; k++) {
+            ir_add_arg(g->fn, value, values[k]);
+        }
+        return value;
+    }
+    compile_error(g->c, call->line, "Function %s is not defined", name);
+    return IR_NONE;
+}
+
+static int generate_call(Generator *g, Node *call) {
+    int values[IR_MAX_ARGS];
+    int count = 0;
+    for (Node *arg = call->a; arg; arg = arg->next) {
+        if (count == IR_MAX_ARGS) {
+            compile_error(g->c, call->line, "More than %d arguments", IR_MAX_ARGS);
+            return ir_const(g->fn, 0);
+        }
+        values[count++] = generate_expression(g, arg);
+    }
+    if (!g->c->program->symbols[call->index].defined) {
+        int value = generate_builtin(g, call, values);
+        return value == IR_NONE ? ir_const(g->fn, 0) : value;
+    }
+    if (count != g->c->info[call->index].param_count) {
+        compile_error(g->c, call->line, "Wrong number of arguments to %s", g->c->program->symbols[call->index].name);
+    }
+    int value = ir_append(g->fn, g->block, IR_CALL, IR_NONE, IR_NONE);
+    if (value == IR_NONE) {
+        return ir_const(g->fn, 0);
+    }
+    g->fn->instrs[value].symbol = call->index;
+    for (int k = 0; k < count; k++) {
+        ir_add_arg(g->fn, value, values[k]);
+    }
+    return value;
+}
+
+static int generate_expression(Generator *g, Node *node) {
+    switch (node->kind) {
+        case NODE_NUMBER:
+            return ir_const(g->fn, node->value);
+        case NODE_LOCAL:
+        case NODE_GLOBAL:
+        case NODE_DEREF: {
+            LValue lvalue = generate_lvalue(g, node);
+            return load_lvalue(g, &lvalue);
+        }
+        case NODE_ADDRESS: {
+            LValue lvalue = generate_lvalue(g, node->a);
+            return lvalue.address;
+        }
+        case NODE_BINARY: {
+            int a = generate_expression(g, node->a);
+            int b = generate_expression(g, node->b);
+            return arithmetic(g, node->op, a, node->a->type, b, node->b->type, node->line);
+        }
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_NOT:
+            return generate_truth(g, node);
+        case NODE_NEGATE:
+            return operation(g, IR_SUB, ir_const(g->fn, 0), generate_expression(g, node->a), 0);
+        case NODE_COMPLEMENT:
+            return operation(g, IR_NOT, generate_expression(g, node->a), IR_NONE, 0);
+        case NODE_ASSIGN: {
+            LValue lvalue = generate_lvalue(g, node->a);
+            int value;
+            if (node->op == IR_NONE) {
+                value = generate_expression(g, node->b);
+            } else {
+                int old = load_lvalue(g, &lvalue);
+                int operand = generate_expression(g, node->b);
+                value = arithmetic(g, node->op, old, node->a->type, operand, node->b->type, node->line);
+            }
+            return store_lvalue(g, &lvalue, value);
+        }
+        case NODE_INCREMENT: {
+            LValue lvalue = generate_lvalue(g, node->a);
+            int old = load_lvalue(g, &lvalue);
+            int step = ir_const(g->fn, node->value * scale_of(node->a->type));
+            int stored = store_lvalue(g, &lvalue, operation(g, IR_ADD, old, step, 0));
+            return node->op ? stored : old;
+        }
+        case NODE_CONDITIONAL: {
+            int if_true = new_block(g), if_false = new_block(g), join = new_block(g);
+            generate_condition(g, node->a, if_true, if_false);
+            seal_block(g, if_true);
+            seal_block(g, if_false);
+            g->block = if_true;
+            int a = generate_expression(g, node->b);
+            ir_jump(g->fn, g->block, join);
+            g->block = if_false;
+            int b = generate_expression(g, node->c);
+            ir_jump(g->fn, g->block, join);
+            seal_block(g, join);
+            g->block = join;
+            int phi = ir_phi(g->fn, join);
+            ir_add_arg(g->fn, phi, a);
+            ir_add_arg(g->fn, phi, b);
+            return ir_remove_trivial_phi(g->fn, phi);
+        }
+        case NODE_CALL:
+            return generate_call(g, node);
+        case NODE_COMMA:
+            generate_expression(g, node->a);
+            return generate_expression(g, node->b);
+        case NODE_CAST:
+            return convert(g, generate_expression(g, node->a), node->type);
+        default:
+            return ir_const(g->fn, 0);
+    }
+}
+
+// Free the frame and return
+static void generate_return(Generator *g, int value) {
+    if (g->frame != IR_NONE) {
+        int free_call = ir_append(g->fn, g->block, IR_SYSCALL, IR_NONE, IR_NONE);
+        if (free_call != IR_NONE) {
+            g->fn->instrs[free_call].imm = SYS_FREE;
+            ir_add_arg(g->fn, free_call, g->frame);
+        }
+    }
+    ir_append(g->fn, g->block, IR_RET, value, IR_NONE);
+}
+
+static void generate_statement(Generator *g, Node *node);
+
+// Loop with the condition tested at the top (while, for) or bottom (do)
+static void generate_loop(Generator *g, Node *node) {
+    int saved_break = g->break_target, saved_continue = g->continue_target;
+    if (node->kind == NODE_FOR && node->a) {
+        generate_statement(g, node->a);
+    }
+    int header = new_block(g), body = new_block(g), step = new_block(g), exit = new_block(g);
+    g->break_target = exit;
+    g->continue_target = step;
+
+    ir_jump(g->fn, g->block, node->kind == NODE_DO ? body : header);
+    g->block = header;
+    if (node->b) {
+        generate_condition(g, node->b, body, exit);
+    } else {
+        ir_jump(g->fn, g->block, body);
+    }
+    if (node->kind != NODE_DO) {
+        seal_block(g, body);
+    }
+
+    g->block = body;
+    generate_statement(g, node->d);
+    ir_jump(g->fn, g->block, step);
+    seal_block(g, step);
+    g->block = step;
+    if (node->c) {
+        generate_expression(g, node->c);
+    }
+    ir_jump(g->fn, g->block, header);
+    seal_block(g, header);
+    if (node->kind == NODE_DO) {
+        seal_block(g, body);
+    }
+    seal_block(g, exit);
+    g->block = exit;
+    g->break_target = saved_break;
+    g->continue_target = saved_continue;
+}
+
+static void generate_statement(Generator *g, Node *node) {
+    switch (node->kind) {
+        case NODE_BLOCK:
+            for (Node *statement = node->a; statement; statement = statement->next) {
+                generate_statement(g, statement);
+            }
+            break;
+        case NODE_EXPRESSION:
+            generate_expression(g, node->a);
+            break;
+        case NODE_IF: {
+            int then_block = new_block(g), else_block = new_block(g), join = new_block(g);
+            generate_condition(g, node->a, then_block, else_block);
+            seal_block(g, then_block);
+            seal_block(g, else_block);
+            g->block = then_block;
+            generate_statement(g, node->b);
+            ir_jump(g->fn, g->block, join);
+            g->block = else_block;
+            if (node->c) {
+                generate_statement(g, node->c);
+            }
+            ir_jump(g->fn, g->block, join);
+            seal_block(g, join);
+            g->block = join;
+            break;
+        }
+        case NODE_WHILE:
+        case NODE_DO:
+        case NODE_FOR:
+            generate_loop(g, node);
+            break;
+        case NODE_BREAK:
+        case NODE_CONTINUE: {
+            int target = node->kind == NODE_BREAK ? g->break_target : g->continue_target;
+            if (target == IR_NONE) {
+                compile_error(g->c, node->line, "%s outside a loop", node->kind == NODE_BREAK ? "break" : "continue");
+                break;
+            }
+            ir_jump(g->fn, g->block, target);
+            start_unreachable(g);
+            break;
+        }
+        case NODE_RETURN:
+            generate_return(g, node->a ? generate_expression(g, node->a) : IR_NONE);
+            start_unreachable(g);
+            break;
+        default:
+            break;
+    }
+}
+
+// Translate a function's syntax tree to SSA form
+static void generate_ir(Compiler *c, FunctionDef *def, IRFunction *fn) {
+    Generator g = {0};
+    g.c = c;
+    g.def = def;
+    g.fn = fn;
+    g.frame = IR_NONE;
+    g.break_target = g.continue_target = IR_NONE;
+    ir_init_function(fn, def->symbol);
+    fn->param_count = def->param_count;
+    g.defs_blocks = 0;
+    int *defs = malloc((size_t)16 * (size_t)(def->local_count ? def->local_count : 1) * sizeof(int));
+    if (!defs) {
+        abort();
+    }
+    g.defs = defs;
+    g.defs_blocks = 16;
+    for (int i = 0; i < 16 * def->local_count; i++) {
+        g.defs[i] = IR_NONE;
+    }
+    g.block = 0;
+
+    int params[IR_MAX_ARGS];
+    for (int i = 0; i < def->param_count && i < IR_MAX_ARGS; i++) {
+        params[i] = ir_append(fn, 0, IR_PARAM, IR_NONE, IR_NONE);
+        fn->instrs[params[i]].imm = i;
+    }
+    if (def->frame_size) {
+        g.frame = ir_append(fn, 0, IR_SYSCALL, IR_NONE, IR_NONE);
+        fn->instrs[g.frame].imm = SYS_MALLOC;
+        ir_add_arg(fn, g.frame, ir_const(fn, (sword_t)def->frame_size));
+        fn->frame = true;
+    }
+    for (int i = 0; i < def->param_count && i < IR_MAX_ARGS; i++) {
+        Local *local = &def->locals[i];
+        LValue lvalue = {local->addressed ? LVALUE_MEMORY : LVALUE_VARIABLE, i, IR_NONE, local->type};
+        if (local->addressed) {
+            lvalue.address = operation(&g, IR_ADD, g.frame, ir_const(fn, (sword_t)local->offset), 0);
+        }
+        store_lvalue(&g, &lvalue, params[i]);
+    }
+
+    generate_statement(&g, def->body);
+    if (!ir_terminated(fn, g.block)) {
+        generate_return(&g, c->info[def->symbol].type->kind == TYPE_VOID ? IR_NONE : ir_const(fn, 0));
+    }
+    free(g.defs);
+    free(g.incomplete);
+}
+
+// Scalar globals whose address is never taken live in the data page, up to
+// half of it; the rest is left to spill slots and the pool
+static void place_globals(Compiler *c) {
+    IRProgram *program = c->program;
+    for (int i = 0; i < program->symbol_count; i++) {
+        IRSymbol *symbol = &program->symbols[i];
+        if (symbol->function || strncmp(symbol->name, "__", 2) == 0) {
+            continue;
+        }
+        Type *type = c->info[i].type;
+        if (type->kind != TYPE_ARRAY && !c->info[i].addressed &&
+            program->direct_bytes + WORD_BYTES <= IR_DATA_PAGE_END / 2) {
+            symbol->direct = true;
+            program->direct_bytes += WORD_BYTES;
+            if (symbol->data && type->kind == TYPE_CHAR) {
+                memset(symbol->data + 1, 0, WORD_BYTES - 1);
+            }
+        } else if (!symbol->data) {
+            symbol->size = type_size(type);
+        }
+    }
+}
+
+// Copy the buffered code to the output
+static void copy_file(FILE *from, FILE *to) {
+    char buffer[4096];
+    size_t count;
+    rewind(from);
+    while ((count = fread(buffer, 1, sizeof(buffer), from)) > 0) {
+        fwrite(buffer, 1, count, to);
+    }
+}
+
+// Read a whole file into a NUL-terminated buffer
+static char *read_source(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char *source = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (source) {
+        size_t read = fread(source, 1, (size_t)size, file);
+        source[read] = '\0';
+    }
+    fclose(file);
+    return source;
+}
+
+// Compile a C file to assembly
+int compile_c_file(const char *c_file, const char *asm_file) {
+    char *source = read_source(c_file);
+    if (!source) {
+        fprintf(stderr, "Error: Cannot open %s\n", c_file);
+        return -1;
+    }
+    Compiler *c = calloc(1, sizeof(Compiler));
+    IRProgram *program = calloc(1, sizeof(IRProgram));
+    if (!c || !program) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(source);
+        free(c);
+        free(program);
+        return -1;
+    }
+    c->file = c_file;
+    c->program = program;
+    ir_init_program(program);
+
+    if (tokenize(c, source) == 0) {
+        parse_program(c);
+    }
+    int main_symbol = ir_find_symbol(program, "main");
+    if (!c->failed && (main_symbol == IR_NONE || !program->symbols[main_symbol].defined)) {
+        compile_error(c, 1, "No main function");
+    }
+
+    FILE *code = c->failed ? NULL : tmpfile();
+    if (!c->failed && !code) {
+        fprintf(stderr, "Error: Cannot create a temporary file\n");
+        c->failed = true;
+    }
+    if (!c->failed) {
+        place_globals(c);
+        c->failed = write_entry(program, main_symbol, code) != 0;
+    }
+    for (int i = 0; i < c->function_count && !c->failed; i++) {
+        IRFunction fn;
+        generate_ir(c, &c->functions[i], &fn);
+        ir_optimize(&fn);
+        if (!c->failed && generate_function(program, &fn, code) != 0) {
+            c->failed = true;
+        }
+        ir_free_function(&fn);
+    }
+
+    FILE *out = NULL;
+    if (!c->failed) {
+        out = fopen(asm_file, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Cannot create %s\n", asm_file);
+            c->failed = true;
+        }
+    }
+    if (!c->failed) {
+        fprintf(out, "; Compiled from %s\n\n", c_file);
+        if (write_data_page(program, out) != 0) {
+            c->failed = true;
+        } else {
+            copy_file(code, out);
+            write_data_section(program, out);
+        }
+    }
+    if (out && fclose(out) != 0 && !c->failed) {
+        fprintf(stderr, "Error: Cannot write %s\n", asm_file);
+        c->failed = true;
+    }
+    if (code) {
+        fclose(code);
+    }
+
+    bool failed = c->failed;
+    for (int i = 0; i < c->allocation_count; i++) {
+        free(c->allocations[i]);
+    }
+    free(c->allocations);
+    free(c->tokens);
+    free(c->info);
+    free(c->functions);
+    ir_free_program(program);
+    free(program);
+    free(c);
+    free(source);
+    return failed ? -1 : 0;
+}
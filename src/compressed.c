@@ -0,0 +1,84 @@
+#include "compressed.h"
+#include "instructions.h"
+
+#define INVALID_INSTRUCTION 0xFF000000u     // Opcode 0xFF is never defined
+
+// Compressed opcodes, bits 14-11 of a compressed instruction
+typedef enum {
+    C_NOP,
+    C_MOV,
+    C_ADDI,
+    C_PUSH,
+    C_POP,
+    C_RET,
+    C_CALL,
+    C_BRA,
+    C_BZ,
+    C_BNZ
+} CompressedOpcode;
+
+// 24-bit byte offset field of a 32-bit branch, from a signed offset
+static uint32_t branch_fields(Opcode opcode, int32_t offset) {
+    uint32_t field = (uint32_t)offset & 0xFFFFFF;
+    return encode_instruction(opcode, (uint8_t)(field >> 16), (uint8_t)(field >> 8), (uint8_t)field);
+}
+
+// Expand a compressed instruction to its 32-bit form
+uint32_t expand_compressed(uint32_t half) {
+    uint8_t rd = (half >> 8) & 7;
+    switch ((CompressedOpcode)((half >> 11) & 0xF)) {
+        case C_NOP: return encode_instruction(NOP, 0, 0, 0);
+        case C_MOV: return encode_instruction(MOV, rd, (half >> 5) & 7, 0);
+        case C_ADDI: return encode_instruction(ADDI, rd, rd, half & 0xFF);
+        case C_PUSH: return encode_instruction(PUSH, rd, 0, 0);
+        case C_POP: return encode_instruction(POP, rd, 0, 0);
+        case C_RET: return encode_instruction(RET, 0, 0, 0);
+        case C_CALL: return encode_instruction(CALL, rd, 0, 0);
+        case C_BRA:
+        case C_BZ:
+        case C_BNZ: {
+            int32_t offset = (int32_t)((half & 0x7FF) ^ 0x400) - 0x400;   // Sign-extend 11 bits
+            Opcode opcode = (Opcode)(BRA + (((half >> 11) & 0xF) - C_BRA));
+            return branch_fields(opcode, offset * 2);
+        }
+        default: return INVALID_INSTRUCTION;
+    }
+}
+
+// Build a candidate compressed form, then keep it only if it expands back exactly
+bool compress_instruction(uint32_t raw, uint32_t *half) {
+    Instruction instr = decode_instruction(raw);
+    uint32_t a = instr.operands[0] & 7;
+    uint32_t candidate;
+    switch (instr.opcode) {
+        case NOP: candidate = C_NOP << 11; break;
+        case MOV: candidate = C_MOV << 11 | a << 8 | (instr.operands[1] & 7) << 5; break;
+        case ADDI: candidate = C_ADDI << 11 | a << 8 | instr.operands[2]; break;
+        case PUSH: candidate = C_PUSH << 11 | a << 8; break;
+        case POP: candidate = C_POP << 11 | a << 8; break;
+        case RET: candidate = C_RET << 11; break;
+        case CALL: candidate = C_CALL << 11 | a << 8; break;
+        case BRA:
+        case BZ:
+        case BNZ: {
+            int32_t offset = branch_offset(instr);
+            if (offset % 2 != 0 || offset < -2048 || offset > 2046) {
+                return false;
+            }
+            candidate = (uint32_t)(C_BRA + (instr.opcode - BRA)) << 11 | ((uint32_t)(offset / 2) & 0x7FF);
+            break;
+        }
+        default:
+            return false;
+    }
+    if (expand_compressed(candidate) != raw) {
+        return false;
+    }
+    *half = candidate;
+    return true;
+}
+
+// Pack two compressed instructions into a pair word
+uint32_t pack_compressed(uint32_t first, uint32_t second) {
+    return COMPRESSED_PAIR_TAG | (second & COMPRESSED_MASK) << COMPRESSED_SHIFT | (first & COMPRESSED_MASK);
+}
@@ -3,17 +3,33 @@
 #include <stdlib.h>
 #include "cpu.h"
 #include "alu.h"
+#include "instructions.h"
+#include "interrupts.h"
+#include "fpu.h"
 
 // Define memory boundaries
-#define CODE_START 0x100
 #define CODE_END (MEMORY_SIZE - 1)
 #define STACK_END (MEMORY_SIZE - 1)
-#define HEAP_START 0x200
 
-// Initialize the CPU
+// Initialize the CPU and announce it
 void init_cpu(CPU *cpu) {
+    reset_cpu(cpu);
+
+    printf("CPU Initialized:\n");
+    printf("  Registers cleared\n");
+    printf("  Flags reset\n");
+    printf("  Memory zeroed\n");
+    printf("  Integer Mode: Signed\n");
+}
+
+// Reset the CPU to its initial state without printing
+void reset_cpu(CPU *cpu) {
     // Clear all registers
     memset(cpu->registers, 0, sizeof(cpu->registers));
+    memset(cpu->vectors, 0, sizeof(cpu->vectors));
+    memset(cpu->fp_registers, 0, sizeof(cpu->fp_registers));
+    fpu_set_flags(cpu, 0);
+    cpu->fpu_mode = FPU_HOST;
 
     // Clear flags
     for (int i = 0; i < 16; i++) {
@@ -29,35 +45,43 @@ void init_cpu(CPU *cpu) {
     // Clear entire memory
     memset(cpu->memory, 0, MEMORY_SIZE);
 
-    // Clear instruction register
+    // Clear instruction register and the decode cache
     cpu->instruction_register = 0;
+    cpu->instruction_length = 0;
+    flush_decode_cache(cpu);
 
     // Ensure CPU is not halted
     cpu->halted = false;
 
+    // Instruction tracing is opt-in
+    cpu->trace_execution = false;
+
+    // Clear performance counters
+    memset(cpu->perf_counters, 0, sizeof(cpu->perf_counters));
+    cpu->store_address = 0;
+    cpu->store_size = 0;
+    cpu->watch_pages = 0;
+    cpu->watch_hit = false;
+    cpu->interrupts = NULL;
+    cpu->next_event = UINT64_MAX;
+    cpu->bus = NULL;
+    memset(cpu->io_pages, 0, sizeof(cpu->io_pages));
+    cpu->host_calls = NULL;
+    cpu->mmu = NULL;
+    cpu->paging = false;
+
     // Set default integer mode to signed
     cpu->integer_mode = MODE_SIGNED;
-
-    printf("CPU Initialized:\n");
-    printf("  Registers cleared\n");
-    printf("  Flags reset\n");
-    printf("  Memory zeroed\n");
-    printf("  Integer Mode: Signed\n");
-}
-
-// Reset the CPU to its initial state
-void reset_cpu(CPU *cpu) {
-    init_cpu(cpu);
 }
 
 // Display current CPU state
-static void display_cpu_state(const CPU *cpu) {
+void display_cpu_state(const CPU *cpu) {
     printf("\n--- CPU State ---\n");
     
     // Print Registers
     printf("Registers:\n");
     for (int i = 0; i < REGISTER_COUNT; i++) {
-        printf("  R%d: 0x%08X\n", i, cpu->registers[i]);
+        printf("  R%d: 0x%0*" PRIXWORD "\n", i, WORD_HEX_DIGITS, (word_t)cpu->registers[i]);
     }
 
     // Print Special Registers
@@ -77,63 +101,54 @@ static void display_cpu_state(const CPU *cpu) {
 
 // Fetch next instruction
 uint32_t fetch_instruction(CPU *cpu) {
-    if (cpu->program_counter < CODE_START || cpu->program_counter > CODE_END) {
-        fprintf(stderr, "Error: Program Counter out of memory bounds at %08X.\n", cpu->program_counter);
+    uint32_t pc = cpu->program_counter;
+    if (pc < CODE_START || pc > MEMORY_SIZE - 2) {
+        fprintf(stderr, "Error: Program Counter out of memory bounds at %08X.\n", pc);
         cpu->halted = true;
         return 0;
     }
 
-    // Fetch 32-bit instruction
-    uint32_t instruction = *((uint32_t*)(cpu->memory + cpu->program_counter));
+    uint32_t length;
+    uint32_t instruction = decode_cached(cpu, pc, &length);
+    if (length == 0) {
+        fprintf(stderr, "Error: Misaligned instruction fetch at %08X.\n", pc);
+        cpu->halted = true;
+        return 0;
+    }
     cpu->instruction_register = instruction;
-    cpu->program_counter += sizeof(uint32_t);
+    cpu->instruction_length = length;
+    cpu->program_counter += length;
 
     return instruction;
 }
 
-// Decode instruction
-static Opcodes decode_instruction(uint32_t instruction) {
-    // Extract opcode (assuming first byte represents opcode)
-    return (Opcodes)(instruction & 0xFF);
-}
+// Fetch, decode and execute one instruction
+void step_cpu(CPU *cpu) {
+    if (cpu->halted) {
+        return;
+    }
 
-// Execute instruction
-static void execute_instruction(CPU *cpu, Opcodes opcode) {
-    switch (opcode) {
-        case OP_HALT:
-            cpu->halted = true;
-            printf("CPU Halted\n");
-            break;
-
-        case OP_ADD:
-            // Placeholder for ADD instruction
-            printf("ADD instruction\n");
-            break;
-
-        case OP_SUB:
-            // Placeholder for SUB instruction
-            printf("SUB instruction\n");
-            break;
-
-        // Add more instruction implementations here
-        default:
-            fprintf(stderr, "Unknown opcode: 0x%02X\n", opcode);
-            cpu->halted = true;
-            break;
+    cpu->store_size = 0;
+    if (cpu->perf_counters[PERF_INSTRUCTIONS] >= cpu->next_event && service_interrupts(cpu)) {
+        return;     // Interrupt entry replaces this step's instruction
+    }
+    if (cpu->paging) {
+        step_paged(cpu);    // Fetches through the MMU
+        return;
     }
+
+    uint32_t raw = fetch_instruction(cpu);
+    if (cpu->halted) {
+        return;
+    }
+
+    execute_instruction(cpu, decode_instruction(raw));
 }
 
 // Main CPU run loop
 void run_cpu(CPU *cpu) {
     while (!cpu->halted) {
-        // Fetch instruction
-        uint32_t instruction = fetch_instruction(cpu);
-        
-        // Decode instruction
-        Opcodes opcode = decode_instruction(instruction);
-        
-        // Execute instruction
-        execute_instruction(cpu, opcode);
+        step_cpu(cpu);
     }
 
     // Display final CPU state when halted
@@ -3,11 +3,28 @@
 #include <stdio.h>
 #include "cpu.h"  // Include your CPU structure definitions
 
+// Mnemonics indexed by Opcode
+static const char *mnemonics[] = {
+    "ADD", "SUB", "MUL", "DIV", "AND", "OR", "XOR", "NOT",
+    "SHL", "SHR", "EQ", "NEQ", "GT", "LT", "GE", "LE",
+    "LOAD", "STORE", "JUMP", "JZ", "JNZ", "CALL", "RET",
+    "PUSH", "POP", "HALT", "RDPERF", "EI", "DI", "IRET", "TIMER", "SYSCALL",
+    "MEMCPY", "MEMSET", "MEMCMP", "MMUSET", "MMUGET", "TLBFLUSH",
+    "VLOAD", "VSTORE", "VSPLAT", "VADD", "VSUB", "VMUL", "VAND", "VOR", "VXOR",
+    "VCMPEQ", "VCMPGT", "VSHUF", "VREDUCE",
+    "CLZ", "CTZ", "POPCNT", "ROL", "ROR", "BEXT", "BINS", "BREV", "BSWAP",
+    "FLDS", "FLDD", "FSTS", "FSTD",
+    "FADDS", "FSUBS", "FMULS", "FDIVS", "FSQRTS", "FMADDS", "FCMPS",
+    "FADDD", "FSUBD", "FMULD", "FDIVD", "FSQRTD", "FMADDD", "FCMPD",
+    "FCVTSW", "FCVTDW", "FCVTWS", "FCVTWD", "FCVTSD", "FCVTDS", "FPFLAGS",
+    "MOV", "ADDI", "BRA", "BZ", "BNZ", "NOP"
+};
+
 // Display the contents of all registers
 void display_registers(const CPU *cpu) {
     printf("\n=== Registers ===\n");
-    for (int i = 0; i < 4; i++) {
-        printf("R%d: %08X\n", i, cpu->registers[i]);
+    for (int i = 0; i < REGISTER_COUNT; i++) {
+        printf("R%d: %0*" PRIXWORD "\n", i, WORD_HEX_DIGITS, (word_t)cpu->registers[i]);
     }
     printf("PC: %08X\n", cpu->program_counter);
     printf("SP: %08X\n", cpu->stack_pointer);
@@ -34,19 +51,6 @@ void display_memory_state(const CPU *cpu, uint32_t start, uint32_t end, char for
 }
 
 
-// Display the current state of the CPU
-static void display_cpu_state(const CPU *cpu) {
-    printf("\n=== CPU State ===\n");
-    display_registers(cpu);
-
-    printf("\nFlags: ");
-    printf("Z=%d ", cpu->flags[FLAG_ZERO]); // Zero flag
-    printf("N=%d ", cpu->flags[FLAG_NEGATIVE]); // Negative flag
-    printf("O=%d\n", cpu->flags[FLAG_OVERFLOW]); // Overflow flag
-
-    printf("Halted: %s\n", cpu->halted ? "Yes" : "No");
-}
-
 // Display the decoded instruction for debugging purposes
 void display_instruction_debug(const Instruction *instruction) {
     printf("\n=== Decoded Instruction ===\n");
@@ -60,3 +64,144 @@ void display_instruction_debug(const Instruction *instruction) {
 
 
 
+
+// Look up the mnemonic of an opcode
+const char *opcode_name(uint32_t opcode) {
+    if (opcode >= sizeof(mnemonics) / sizeof(mnemonics[0])) {
+        return NULL;
+    }
+    return mnemonics[opcode];
+}
+
+// Operand kinds of an opcode; shared by the disassembler and the assembler
+const char *opcode_operands(uint32_t opcode) {
+    switch (opcode) {
+        case NOT:
+        case MOV:
+        case CLZ:
+        case CTZ:
+        case POPCNT:
+        case BREV:
+        case BSWAP:
+            return "RR";
+        case SHL:
+        case SHR:
+        case ROL:
+        case ROR:
+            return "RRI";
+        case RDPERF:
+            return "RII";
+        case TIMER:
+            return "IRI";
+        case LOAD:
+        case STORE:
+            return "RM";
+        case SYSCALL:
+            return "I";
+        case JUMP:
+        case JZ:
+        case JNZ:
+        case CALL:
+        case PUSH:
+        case POP:
+            return "R";
+        case RET:
+        case HALT:
+        case NOP:
+        case EI:
+        case DI:
+        case IRET:
+            return "";
+        case MMUSET:
+        case MMUGET:
+        case TLBFLUSH:
+            return "RI";
+        case VLOAD:
+        case VSTORE:
+        case VSPLAT:
+            return "VR";
+        case VSHUF:
+            return "VVI";
+        case VREDUCE:
+            return "RV";
+        case VADD:
+        case VSUB:
+        case VMUL:
+        case VAND:
+        case VOR:
+        case VXOR:
+        case VCMPEQ:
+        case VCMPGT:
+            return "VVV";
+        case FLDS:
+        case FLDD:
+        case FSTS:
+        case FSTD:
+        case FCVTSW:
+        case FCVTDW:
+            return "FR";
+        case FCVTWS:
+        case FCVTWD:
+            return "RF";
+        case FSQRTS:
+        case FSQRTD:
+        case FCVTSD:
+        case FCVTDS:
+            return "FF";
+        case FADDS:
+        case FSUBS:
+        case FMULS:
+        case FDIVS:
+        case FMADDS:
+        case FADDD:
+        case FSUBD:
+        case FMULD:
+        case FDIVD:
+        case FMADDD:
+            return "FFF";
+        case FCMPS:
+        case FCMPD:
+            return "RFF";
+        case FPFLAGS:
+            return "RI";
+        case ADDI:
+            return "RRS";
+        case BRA:
+        case BZ:
+        case BNZ:
+            return "L";
+        default:
+            return "RRR";
+    }
+}
+
+// Disassemble a 32-bit binary instruction located at address
+void disassemble_instruction(uint32_t raw, uint32_t address, char *buffer, size_t size) {
+    Instruction instr = decode_instruction(raw);
+
+    const char *name = opcode_name(instr.opcode);
+    if (name == NULL) {
+        snprintf(buffer, size, ".word 0x%08X", raw);
+        return;
+    }
+
+    // A whole-TLB flush has no meaningful operands
+    const char *kinds = instr.opcode == TLBFLUSH && instr.operands[1] == 0 ? "" : opcode_operands(instr.opcode);
+    size_t length = (size_t)snprintf(buffer, size, "%s", name);
+    for (int i = 0; kinds[i] && length < size; i++) {
+        const char *separator = i ? ", " : " ";
+        uint32_t operand = instr.operands[i];
+        switch (kinds[i]) {
+            case 'R': length += (size_t)snprintf(buffer + length, size - length, "%sR%u", separator, operand); break;
+            case 'V': length += (size_t)snprintf(buffer + length, size - length, "%sV%u", separator, operand); break;
+            case 'F': length += (size_t)snprintf(buffer + length, size - length, "%sF%u", separator, operand); break;
+            case 'M': length += (size_t)snprintf(buffer + length, size - length, "%s[0x%02X]", separator, operand); break;
+            case 'S': length += (size_t)snprintf(buffer + length, size - length, "%s%d", separator, (int8_t)operand); break;
+            case 'L':
+                length += (size_t)snprintf(buffer + length, size - length, "%s0x%03X", separator,
+                                           address + (uint32_t)branch_offset(instr));
+                break;
+            default: length += (size_t)snprintf(buffer + length, size - length, "%s%u", separator, operand); break;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include "decode_file.h"
+#include "aot.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DECODE_FILE_MAGIC "CPUDCODE"
+
+// File header, in host byte order; the arrays follow it directly
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;        // INSTRUCTION_SLOTS of the writing build
+    uint64_t image_hash;
+    uint32_t image_size;
+    uint32_t entries;           // Filled slots
+} DecodeFileHeader;
+
+// Layout of a whole mapped file
+typedef struct {
+    DecodeFileHeader header;
+    uint32_t decoded[INSTRUCTION_SLOTS];
+    uint8_t decoded_length[INSTRUCTION_SLOTS];
+} DecodeFileData;
+
+// Check that a slot's instruction word is unchanged since the image was loaded
+static bool slot_matches_image(const DecodeFile *file, const uint8_t *memory, uint32_t slot) {
+    uint32_t word = (slot * 2) & ~(uint32_t)3;
+    return memcmp(file->image + word, memory + word, sizeof(uint32_t)) == 0;
+}
+
+// Map the file and install its entries if it belongs to the loaded image
+void open_decode_file(DecodeFile *file, const char *path, CPU *cpu, uint32_t image_size) {
+    uint32_t hashed = image_size < MEMORY_SIZE ? image_size : MEMORY_SIZE;
+    file->path = path;
+    file->image_size = image_size;
+    file->image_hash = image_hash(cpu->memory, hashed);
+    memcpy(file->image, cpu->memory, MEMORY_SIZE);
+    file->loaded = 0;
+    file->saved = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;     // First run for this file
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)sizeof(DecodeFileData)) {
+        close(fd);
+        return;
+    }
+    const DecodeFileData *data = mmap(NULL, sizeof(DecodeFileData), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+
+    const DecodeFileHeader *header = &data->header;
+    if (memcmp(header->magic, DECODE_FILE_MAGIC, 8) == 0 && header->version == DECODE_FILE_VERSION &&
+        header->slot_count == INSTRUCTION_SLOTS && header->image_hash == file->image_hash &&
+        header->image_size == image_size) {
+        for (uint32_t slot = 0; slot < INSTRUCTION_SLOTS; slot++) {
+            uint8_t length = data->decoded_length[slot];
+            if ((length == 2 || (length == 4 && slot % 2 == 0)) && !cpu->decoded_length[slot]) {
+                cpu->decoded[slot] = data->decoded[slot];
+                cpu->decoded_length[slot] = length;
+                cpu->decoded_pages |= 1u << (slot * 2 / DECODE_PAGE_SIZE);
+                file->loaded++;
+            }
+        }
+    }
+    munmap((void *)data, sizeof(DecodeFileData));
+}
+
+// Write the still-valid decode cache entries to a temporary file and rename
+// it over the decode file, so concurrent runs never see a partial file
+int save_decode_file(DecodeFile *file, const CPU *cpu) {
+    static DecodeFileData data;
+    memset(&data, 0, sizeof(data));
+    memcpy(data.header.magic, DECODE_FILE_MAGIC, 8);
+    data.header.version = DECODE_FILE_VERSION;
+    data.header.slot_count = INSTRUCTION_SLOTS;
+    data.header.image_hash = file->image_hash;
+    data.header.image_size = file->image_size;
+    for (uint32_t slot = 0; slot < INSTRUCTION_SLOTS; slot++) {
+        if (cpu->decoded_length[slot] && slot_matches_image(file, cpu->memory, slot)) {
+            data.decoded[slot] = cpu->decoded[slot];
+            data.decoded_length[slot] = cpu->decoded_length[slot];
+            data.header.entries++;
+        }
+    }
+    if (data.header.entries <= file->loaded) {
+        return 0;       // Nothing the file does not already hold
+    }
+
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.%ld", file->path, (long)getpid());
+    FILE *out = fopen(temporary, "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot create decode file %s\n", temporary);
+        return -1;
+    }
+    bool written = fwrite(&data, sizeof(data), 1, out) == 1;
+    if (fclose(out) != 0 || !written || rename(temporary, file->path) != 0) {
+        fprintf(stderr, "Error: Cannot write decode file %s\n", file->path);
+        remove(temporary);
+        return -1;
+    }
+    file->saved = data.header.entries;
+    return 0;
+}
+
+// Print the decode file's contribution to the run
+void display_decode_file(const DecodeFile *file) {
+    printf("Decode file %s: %u entries loaded", file->path, file->loaded);
+    if (file->saved) {
+        printf(", %u saved", file->saved);
+    }
+    printf("\n");
+}
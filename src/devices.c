@@ -0,0 +1,227 @@
+#include "devices.h"
+#include "interrupts.h"
+#include "instructions.h"
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// Timer register reads
+static uint32_t timer_read(void *context, CPU *cpu, uint32_t offset) {
+    TimerDevice *timer = context;
+    if (offset == TIMER_REG_SELECT) {
+        return timer->selected;
+    }
+    if (offset == TIMER_REG_LINE) {
+        return timer->line;
+    }
+    if (cpu->interrupts == NULL || timer->selected >= TIMER_COUNT) {
+        return 0;
+    }
+    const Timer *t = &cpu->interrupts->timers[timer->selected];
+    if (offset == TIMER_REG_PERIOD) {
+        return t->period;
+    }
+    return offset == TIMER_REG_FIRED ? (uint32_t)t->fired : 0;
+}
+
+// Timer register writes
+static void timer_write(void *context, CPU *cpu, uint32_t offset, uint32_t value) {
+    TimerDevice *timer = context;
+    switch (offset) {
+        case TIMER_REG_SELECT:
+            timer->selected = value;
+            break;
+        case TIMER_REG_LINE:
+            timer->line = value;
+            break;
+        case TIMER_REG_PERIOD:
+            if (cpu->interrupts == NULL ||
+                set_timer(cpu->interrupts, (int)timer->selected, value, (int)timer->line) != 0) {
+                cpu->halted = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// xorshift64* output
+static uint32_t rng_read(void *context, CPU *cpu, uint32_t offset) {
+    (void)cpu;
+    RngDevice *rng = context;
+    if (offset != RNG_REG_VALUE) {
+        return 0;
+    }
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (uint32_t)((rng->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void rng_write(void *context, CPU *cpu, uint32_t offset, uint32_t value) {
+    (void)cpu;
+    RngDevice *rng = context;
+    if (offset == RNG_REG_SEED) {
+        rng->state = value ? value : RNG_DEFAULT_SEED;     // xorshift state must be nonzero
+    }
+}
+
+static uint32_t block_read(void *context, CPU *cpu, uint32_t offset) {
+    (void)cpu;
+    BlockDevice *block = context;
+    switch (offset) {
+        case BLOCK_REG_SECTOR: return block->sector;
+        case BLOCK_REG_ADDRESS: return block->address;
+        case BLOCK_REG_STATUS: return block->status;
+        default: return 0;
+    }
+}
+
+// Move one sector between the disk image and guest memory
+static void block_transfer(BlockDevice *block, CPU *cpu, uint32_t command) {
+    block->status = 1;
+    if ((command != BLOCK_READ && command != BLOCK_WRITE) || block->address >= MEMORY_SIZE ||
+        BLOCK_SECTOR_SIZE > MEMORY_SIZE - block->address ||
+        fseek(block->file, (long)block->sector * BLOCK_SECTOR_SIZE, SEEK_SET) != 0) {
+        return;
+    }
+
+    uint8_t *buffer = cpu->memory + block->address;
+    if (command == BLOCK_READ) {
+        size_t got = fread(buffer, 1, BLOCK_SECTOR_SIZE, block->file);
+        memset(buffer + got, 0, BLOCK_SECTOR_SIZE - got);      // Past the end reads as zeros
+        record_store(cpu, block->address, BLOCK_SECTOR_SIZE);
+    } else if (fwrite(buffer, 1, BLOCK_SECTOR_SIZE, block->file) != BLOCK_SECTOR_SIZE) {
+        return;
+    }
+    block->transfers++;
+    block->status = 0;
+}
+
+static void block_write(void *context, CPU *cpu, uint32_t offset, uint32_t value) {
+    BlockDevice *block = context;
+    switch (offset) {
+        case BLOCK_REG_SECTOR:
+            block->sector = value;
+            break;
+        case BLOCK_REG_ADDRESS:
+            block->address = value;
+            break;
+        case BLOCK_REG_COMMAND:
+            block_transfer(block, cpu, value);
+            break;
+        default:
+            break;
+    }
+}
+
+// Write the whole buffer, retrying short writes
+void flush_console(ConsoleDevice *console) {
+    if (console->length == 0) {
+        return;
+    }
+    if (console->fd == STDOUT_FILENO) {
+        fflush(stdout);     // Keep earlier host printf output in order
+    }
+
+    const char *data = console->buffer;
+    uint32_t remaining = console->length;
+    while (remaining > 0) {
+        ssize_t written = write(console->fd, data, remaining);
+        if (written <= 0) {
+            perror("Error writing console output");
+            break;
+        }
+        data += written;
+        remaining -= (uint32_t)written;
+    }
+    console->length = 0;
+    console->flushes++;
+}
+
+// Append bytes, flushing first if they do not fit
+void append_console(ConsoleDevice *console, const char *data, uint32_t length) {
+    if (length > CONSOLE_BUFFER_SIZE - console->length) {
+        flush_console(console);
+    }
+    memcpy(console->buffer + console->length, data, length);
+    console->length += length;
+    console->bytes += length;
+}
+
+static uint32_t console_read(void *context, CPU *cpu, uint32_t offset) {
+    (void)cpu;
+    ConsoleDevice *console = context;
+    return offset == CONSOLE_REG_PENDING ? console->length : 0;
+}
+
+static void console_write(void *context, CPU *cpu, uint32_t offset, uint32_t value) {
+    (void)cpu;
+    ConsoleDevice *console = context;
+    if (offset == CONSOLE_REG_DATA) {
+        char byte = (char)value;
+        append_console(console, &byte, 1);
+    } else if (offset == CONSOLE_REG_NUMBER) {
+        char digits[12];
+        int length = snprintf(digits, sizeof(digits), "%d", (int32_t)value);
+        append_console(console, digits, (uint32_t)length);
+    } else if (offset == CONSOLE_REG_FLUSH) {
+        flush_console(console);
+    }
+}
+
+// Register the standard devices and attach the bus
+int init_devices(DeviceSet *devices, CPU *cpu, const char *disk_file, const char *console_file) {
+    memset(devices, 0, sizeof(*devices));
+    init_bus(&devices->bus);
+    devices->rng.state = RNG_DEFAULT_SEED;
+    devices->console.fd = STDOUT_FILENO;
+
+    if (register_device(&devices->bus, "timer", TIMER_DEVICE_BASE, IO_PAGE_SIZE,
+                        timer_read, timer_write, &devices->timer) != 0 ||
+        register_device(&devices->bus, "rng", RNG_DEVICE_BASE, IO_PAGE_SIZE,
+                        rng_read, rng_write, &devices->rng) != 0 ||
+        register_device(&devices->bus, "console", CONSOLE_DEVICE_BASE, IO_PAGE_SIZE,
+                        console_read, console_write, &devices->console) != 0) {
+        return -1;
+    }
+
+    if (console_file) {
+        devices->console.fd = open(console_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (devices->console.fd < 0) {
+            fprintf(stderr, "Error: Cannot open console output %s\n", console_file);
+            return -1;
+        }
+        devices->console.close_fd = true;
+    }
+
+    if (disk_file) {
+        devices->block.file = fopen(disk_file, "r+b");
+        if (!devices->block.file) {
+            fprintf(stderr, "Error: Cannot open disk image %s\n", disk_file);
+            close_devices(devices);
+            return -1;
+        }
+        if (register_device(&devices->bus, "block", BLOCK_DEVICE_BASE, IO_PAGE_SIZE,
+                            block_read, block_write, &devices->block) != 0) {
+            close_devices(devices);
+            return -1;
+        }
+    }
+
+    attach_bus(&devices->bus, cpu);
+    return 0;
+}
+
+// Flush output and close device files
+void close_devices(DeviceSet *devices) {
+    flush_console(&devices->console);
+    if (devices->console.close_fd) {
+        close(devices->console.fd);
+        devices->console.close_fd = false;
+    }
+    if (devices->block.file) {
+        fclose(devices->block.file);
+        devices->block.file = NULL;
+    }
+}
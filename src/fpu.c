@@ -0,0 +1,153 @@
+#include "fpu.h"
+#include "softfloat.h"
+#include "debug.h"
+#include <fenv.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SINGLE_NAN 0x7FC00000u
+#define DOUBLE_NAN 0x7FF8000000000000ull
+
+// CPU whose guest flags the host fenv is accumulating; fenv is per thread
+static __thread CPU *flags_owner;
+
+static float to_single(uint64_t bits) {
+    uint32_t word = (uint32_t)bits;
+    float value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+static double to_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// NaN results are canonical, so their payload never depends on the host
+static uint64_t from_single(float value) {
+    uint32_t word;
+    if (isnan(value)) {
+        return SINGLE_NAN;
+    }
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+static uint64_t from_double(double value) {
+    uint64_t bits;
+    if (isnan(value)) {
+        return DOUBLE_NAN;
+    }
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Quiet comparison: only signaling NaNs raise invalid. Singles widen exactly.
+static int32_t compare_host(double a, double b) {
+    if (isunordered(a, b)) {
+        return 2;
+    }
+    return isless(a, b) ? -1 : isgreater(a, b);
+}
+
+// Truncate toward zero; out-of-range values and NaN saturate without touching the host flags
+static int32_t truncate_host(double value, uint32_t *flags) {
+    if (!(value > -2147483649.0 && value < 2147483648.0)) {
+        *flags |= FP_INVALID;
+        return value < 0 ? INT32_MIN : INT32_MAX;
+    }
+    return (int32_t)value;
+}
+
+// Execute an FPU operation on the host; most flags land in the host fenv
+static uint64_t host_execute(Opcode opcode, uint64_t a, uint64_t b, uint64_t c, uint32_t *flags) {
+    switch (opcode) {
+        case FADDS: return from_single(to_single(a) + to_single(b));
+        case FSUBS: return from_single(to_single(a) - to_single(b));
+        case FMULS: return from_single(to_single(a) * to_single(b));
+        case FDIVS: return from_single(to_single(a) / to_single(b));
+        case FSQRTS: return from_single(sqrtf(to_single(a)));
+        case FMADDS: return from_single(fmaf(to_single(a), to_single(b), to_single(c)));
+        case FCMPS: return (uint64_t)(int64_t)compare_host(to_single(a), to_single(b));
+        case FADDD: return from_double(to_double(a) + to_double(b));
+        case FSUBD: return from_double(to_double(a) - to_double(b));
+        case FMULD: return from_double(to_double(a) * to_double(b));
+        case FDIVD: return from_double(to_double(a) / to_double(b));
+        case FSQRTD: return from_double(sqrt(to_double(a)));
+        case FMADDD: return from_double(fma(to_double(a), to_double(b), to_double(c)));
+        case FCMPD: return (uint64_t)(int64_t)compare_host(to_double(a), to_double(b));
+        case FCVTSW: return from_single((float)(int32_t)a);
+        case FCVTDW: return from_double((double)(int32_t)a);
+        case FCVTWS: return (uint64_t)(int64_t)truncate_host(to_single(a), flags);
+        case FCVTWD: return (uint64_t)(int64_t)truncate_host(to_double(a), flags);
+        case FCVTSD: return from_single((float)to_double(a));
+        case FCVTDS: return from_double((double)to_single(a));
+        default: return 0;
+    }
+}
+
+// Host exception flags as FPUFlag bits
+static uint32_t host_flags(void) {
+    int raised = fetestexcept(FE_ALL_EXCEPT);
+    return (raised & FE_INEXACT ? FP_INEXACT : 0) |
+           (raised & FE_UNDERFLOW ? FP_UNDERFLOW : 0) |
+           (raised & FE_OVERFLOW ? FP_OVERFLOW : 0) |
+           (raised & FE_DIVBYZERO ? FP_DIVIDE_BY_ZERO : 0) |
+           (raised & FE_INVALID ? FP_INVALID : 0);
+}
+
+// Run both implementations and halt on any difference
+static uint64_t check_execute(CPU *cpu, Opcode opcode, uint64_t a, uint64_t b, uint64_t c) {
+    fpu_flags(cpu);
+    flags_owner = NULL;
+
+    uint32_t hard_flags = 0, soft_flags = 0;
+    feclearexcept(FE_ALL_EXCEPT);
+    volatile uint64_t hard = host_execute(opcode, a, b, c, &hard_flags);
+    hard_flags |= host_flags();
+    uint64_t soft = softfloat_execute(opcode, a, b, c, &soft_flags);
+
+    if (hard != soft || hard_flags != soft_flags) {
+        fprintf(stderr, "Error: %s 0x%llX, 0x%llX, 0x%llX: host 0x%llX flags 0x%02X, softfloat 0x%llX flags 0x%02X\n",
+                opcode_name(opcode), (unsigned long long)a, (unsigned long long)b, (unsigned long long)c,
+                (unsigned long long)hard, hard_flags, (unsigned long long)soft, soft_flags);
+        cpu->halted = true;
+    }
+    cpu->fp_flags |= hard_flags;
+    return hard;
+}
+
+// Execute an FPU operation in the CPU's mode
+uint64_t fpu_execute(CPU *cpu, Opcode opcode, uint64_t a, uint64_t b, uint64_t c) {
+    switch (cpu->fpu_mode) {
+        case FPU_SOFT:
+            return softfloat_execute(opcode, a, b, c, &cpu->fp_flags);
+        case FPU_CHECK:
+            return check_execute(cpu, opcode, a, b, c);
+        default:
+            if (flags_owner != cpu) {
+                feclearexcept(FE_ALL_EXCEPT);
+                flags_owner = cpu;
+            }
+            return host_execute(opcode, a, b, c, &cpu->fp_flags);
+    }
+}
+
+// Fold the pending host flags into the guest's accrued flags
+uint32_t fpu_flags(CPU *cpu) {
+    if (flags_owner == cpu) {
+        cpu->fp_flags |= host_flags();
+        feclearexcept(FE_ALL_EXCEPT);
+    }
+    return cpu->fp_flags;
+}
+
+// Replace the accrued flags; the next host operation starts from a clear fenv
+void fpu_set_flags(CPU *cpu, uint32_t flags) {
+    if (flags_owner == cpu) {
+        flags_owner = NULL;
+    }
+    cpu->fp_flags = flags;
+}
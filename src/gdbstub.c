@@ -0,0 +1,616 @@
+#include "gdbstub.h"
+#include "interrupts.h"
+#include "instructions.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define GDB_INTERRUPT_INTERVAL 1024 // Poll for Ctrl-C every 1024 instructions
+#define GDB_SIGINT 2
+#define GDB_SIGTRAP 5
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+#define GP_REGISTER(name) "<reg name=\"" name "\" bitsize=\"" STRINGIFY(WORD_SIZE) "\" type=\"int" STRINGIFY(WORD_SIZE) "\""
+
+// Register layout advertised to the debugger; r0-r7 are WORD_SIZE bits wide
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\"><feature name=\"org.cpusimulator.core\">"
+    GP_REGISTER("r0") " regnum=\"0\"/>"
+    GP_REGISTER("r1") "/>"
+    GP_REGISTER("r2") "/>"
+    GP_REGISTER("r3") "/>"
+    GP_REGISTER("r4") "/>"
+    GP_REGISTER("r5") "/>"
+    GP_REGISTER("r6") "/>"
+    GP_REGISTER("r7") "/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"flags\" bitsize=\"32\" type=\"uint32\"/>"
+    "</feature></target>";
+
+// Buffered reader over the debugger connection, owned by the packet thread
+typedef struct {
+    int fd;
+    uint8_t data[GDB_PACKET_SIZE];
+    size_t start;
+    size_t end;
+} Connection;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Append a value of size bytes in target (little-endian) byte order
+static char *put_hex_value(char *out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++, value >>= 8) {
+        *out++ = hex_digits[(value >> 4) & 0xF];
+        *out++ = hex_digits[value & 0xF];
+    }
+    return out;
+}
+
+// Parse a little-endian value of size bytes from 2 * size hex digits
+static bool get_hex_value(const char *in, size_t size, uint64_t *value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < size; i++) {
+        int high = hex_value(in[2 * i]);
+        int low = hex_value(in[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        result |= (uint64_t)(high << 4 | low) << (8 * i);
+    }
+    *value = result;
+    return true;
+}
+
+// Bytes of a register in the g/G/p/P packets
+static size_t register_size(int reg) {
+    return reg < REGISTER_COUNT ? WORD_BYTES : sizeof(uint32_t);
+}
+
+static uint64_t read_register(const CPU *cpu, int reg) {
+    if (reg < REGISTER_COUNT) {
+        return (word_t)cpu->registers[reg];
+    }
+    if (reg == REGISTER_COUNT) {
+        return cpu->stack_pointer;
+    }
+    if (reg == REGISTER_COUNT + 1) {
+        return cpu->program_counter;
+    }
+    return pack_flags(cpu);
+}
+
+static void write_register(CPU *cpu, int reg, uint64_t value) {
+    if (reg < REGISTER_COUNT) {
+        cpu->registers[reg] = (sword_t)value;
+    } else if (reg == REGISTER_COUNT) {
+        cpu->stack_pointer = (uint32_t)value;
+    } else if (reg == REGISTER_COUNT + 1) {
+        cpu->program_counter = (uint32_t)value;
+    } else {
+        unpack_flags(cpu, (uint32_t)value);
+    }
+}
+
+// Next byte from the debugger, or -1 when the connection closes
+static int read_byte(Connection *conn) {
+    if (conn->start == conn->end) {
+        ssize_t received = recv(conn->fd, conn->data, sizeof(conn->data), 0);
+        if (received <= 0) {
+            return -1;
+        }
+        conn->start = 0;
+        conn->end = (size_t)received;
+    }
+    return conn->data[conn->start++];
+}
+
+// Read one packet body; returns its length, -1 on disconnect, -2 for Ctrl-C
+static int get_packet(Connection *conn, char *buffer, size_t size) {
+    for (;;) {
+        int c;
+        do {
+            c = read_byte(conn);
+            if (c == 0x03) {
+                return -2;
+            }
+        } while (c >= 0 && c != '$');
+        if (c < 0) {
+            return -1;
+        }
+
+        size_t length = 0;
+        uint8_t checksum = 0;
+        while ((c = read_byte(conn)) >= 0 && c != '#') {
+            if (length + 1 < size) {
+                buffer[length++] = (char)c;
+            }
+            checksum += (uint8_t)c;
+        }
+        int high = read_byte(conn);
+        int low = read_byte(conn);
+        if (c < 0 || high < 0 || low < 0) {
+            return -1;
+        }
+        buffer[length] = '\0';
+
+        if (hex_value((char)high) << 4 == (checksum & 0xF0) && hex_value((char)low) == (checksum & 0xF)) {
+            send(conn->fd, "+", 1, MSG_NOSIGNAL);
+            return (int)length;
+        }
+        send(conn->fd, "-", 1, MSG_NOSIGNAL);
+    }
+}
+
+// Frame and send one packet
+static void put_packet(int fd, const char *data) {
+    static char frame[2 * GDB_PACKET_SIZE + 8];
+    size_t length = strlen(data);
+    uint8_t checksum = 0;
+
+    if (length > sizeof(frame) - 5) {
+        length = sizeof(frame) - 5;
+    }
+    frame[0] = '$';
+    for (size_t i = 0; i < length; i++) {
+        frame[i + 1] = data[i];
+        checksum += (uint8_t)data[i];
+    }
+    frame[length + 1] = '#';
+    frame[length + 2] = hex_digits[checksum >> 4];
+    frame[length + 3] = hex_digits[checksum & 0xF];
+    send(fd, frame, length + 4, MSG_NOSIGNAL);
+}
+
+// Execute until a breakpoint, watchpoint, interrupt or HALT; returns the stop signal
+static int run_until_stop(GDBStub *stub, bool single_step) {
+    CPU *cpu = stub->cpu;
+    stub->watch_hit = false;
+
+    if (single_step) {
+        step_cpu(cpu);
+        return cpu->halted ? 0 : GDB_SIGTRAP;
+    }
+
+    for (;;) {
+        if (atomic_load_explicit(&stub->interrupt, memory_order_relaxed)) {
+            return GDB_SIGINT;
+        }
+
+        StopReason reason = run_with_breakpoints(&stub->breakpoints, cpu, GDB_INTERRUPT_INTERVAL);
+        if (reason == STOP_WATCHPOINT) {
+            stub->watch_hit = true;
+            stub->watch_address = stub->breakpoints.hit_address;
+            return GDB_SIGTRAP;
+        }
+        if (reason == STOP_BREAKPOINT) {
+            return GDB_SIGTRAP;
+        }
+        if (cpu->halted) {
+            return 0;
+        }
+    }
+}
+
+// Format the reply describing the last stop
+static void stop_reply(const GDBStub *stub, char *reply) {
+    if (stub->stop_signal == 0) {
+        strcpy(reply, "W00");
+    } else if (stub->watch_hit) {
+        sprintf(reply, "T%02xwatch:%x;", stub->stop_signal, stub->watch_address);
+    } else {
+        sprintf(reply, "S%02x", stub->stop_signal);
+    }
+}
+
+// Add or remove a breakpoint or write watchpoint (Z/z packets)
+static const char *update_point(GDBStub *stub, const char *packet) {
+    bool insert = packet[0] == 'Z';
+    char type = packet[1];
+    uint32_t address, length;
+    if (sscanf(packet + 2, ",%x,%x", &address, &length) != 2) {
+        return "E01";
+    }
+
+    // Removing a point that does not exist is not an error
+    if (type == '0' || type == '1') {
+        if (!insert) {
+            remove_breakpoint(&stub->breakpoints, address);
+            return "OK";
+        }
+        return add_breakpoint(&stub->breakpoints, address, NULL) == 0 ? "OK" : "E02";
+    }
+
+    if (type == '2') {
+        if (!insert) {
+            remove_watchpoint(&stub->breakpoints, address, length);
+            return "OK";
+        }
+        return add_watchpoint(&stub->breakpoints, address, length, NULL) == 0 ? "OK" : "E02";
+    }
+
+    return "";      // Read and access watchpoints are not supported
+}
+
+// Serve qXfer:features:read:target.xml:offset,length
+static void read_target_xml(const char *annex, char *reply) {
+    unsigned offset, length;
+    size_t total = sizeof(target_xml) - 1;
+    if (sscanf(annex, "target.xml:%x,%x", &offset, &length) != 2) {
+        strcpy(reply, "E00");
+        return;
+    }
+    if (offset >= total) {
+        strcpy(reply, "l");
+        return;
+    }
+    if (length > GDB_PACKET_SIZE - 2) {
+        length = GDB_PACKET_SIZE - 2;
+    }
+    size_t count = total - offset < length ? total - offset : length;
+    reply[0] = offset + count < total ? 'm' : 'l';
+    memcpy(reply + 1, target_xml + offset, count);
+    reply[count + 1] = '\0';
+}
+
+// Read or write guest memory (m/M packets)
+static void access_memory(CPU *cpu, const char *packet, char *reply) {
+    uint32_t address, length;
+    int consumed = 0;
+    if (sscanf(packet + 1, "%x,%x%n", &address, &length, &consumed) != 2 ||
+        address > MEMORY_SIZE || length > MEMORY_SIZE - address) {
+        strcpy(reply, "E01");
+        return;
+    }
+
+    if (packet[0] == 'm') {
+        if (length > (GDB_PACKET_SIZE - 1) / 2) {
+            length = (GDB_PACKET_SIZE - 1) / 2;
+        }
+        for (uint32_t i = 0; i < length; i++) {
+            reply[2 * i] = hex_digits[cpu->memory[address + i] >> 4];
+            reply[2 * i + 1] = hex_digits[cpu->memory[address + i] & 0xF];
+        }
+        reply[2 * length] = '\0';
+        return;
+    }
+
+    const char *data = packet + 1 + consumed;
+    if (*data++ != ':' || strlen(data) < 2 * (size_t)length) {
+        strcpy(reply, "E01");
+        return;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        int high = hex_value(data[2 * i]);
+        int low = hex_value(data[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            strcpy(reply, "E01");
+            return;
+        }
+        cpu->memory[address + i] = (uint8_t)(high << 4 | low);
+    }
+    invalidate_decoded(cpu, address, length);
+    strcpy(reply, "OK");
+}
+
+// Hand the CPU to the execution thread and wait until it stops.
+// Returns false if the debugger disconnected meanwhile.
+static bool resume_and_wait(GDBStub *stub, Connection *conn, bool single_step) {
+    pthread_mutex_lock(&stub->lock);
+    stub->single_step = single_step;
+    stub->state = GDB_RUNNING;
+    atomic_store(&stub->interrupt, false);
+    pthread_cond_broadcast(&stub->cond);
+    pthread_mutex_unlock(&stub->lock);
+
+    struct pollfd fds[2] = {
+        {stub->wake_pipe[0], POLLIN, 0},
+        {conn->fd, POLLIN, 0},
+    };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            char wake;
+            if (read(stub->wake_pipe[0], &wake, 1) == 1) {
+                return true;
+            }
+        }
+        if (fds[1].revents & (POLLIN | POLLHUP)) {
+            int c = read_byte(conn);
+            if (c < 0) {
+                return false;
+            }
+            if (c == 0x03) {
+                atomic_store(&stub->interrupt, true);
+            }
+        }
+    }
+}
+
+// Set a terminal state and wake the execution thread
+static void finish_session(GDBStub *stub, GDBState state) {
+    pthread_mutex_lock(&stub->lock);
+    stub->state = state;
+    pthread_cond_broadcast(&stub->cond);
+    pthread_mutex_unlock(&stub->lock);
+}
+
+// Packet thread: talks to the debugger and owns the CPU while it is stopped
+static void *gdb_packet_thread(void *arg) {
+    GDBStub *stub = arg;
+    CPU *cpu = stub->cpu;
+    Connection conn = {.fd = stub->client_fd};
+    static char packet[GDB_PACKET_SIZE];
+    static char reply[GDB_PACKET_SIZE];
+
+    for (;;) {
+        int length = get_packet(&conn, packet, sizeof(packet));
+        if (length == -1) {
+            finish_session(stub, GDB_DETACHED);
+            return NULL;
+        }
+        if (length == -2) {
+            continue;       // Ctrl-C while already stopped
+        }
+
+        reply[0] = '\0';
+        switch (packet[0]) {
+            case '?':
+                stop_reply(stub, reply);
+                break;
+
+            case 'g': {
+                char *out = reply;
+                for (int reg = 0; reg < GDB_REGISTER_COUNT; reg++) {
+                    out = put_hex_value(out, read_register(cpu, reg), register_size(reg));
+                }
+                *out = '\0';
+                break;
+            }
+            case 'G': {
+                const char *in = packet + 1;
+                strcpy(reply, "OK");
+                for (int reg = 0; reg < GDB_REGISTER_COUNT; reg++) {
+                    size_t size = register_size(reg);
+                    uint64_t value;
+                    if (strlen(in) < 2 * size || !get_hex_value(in, size, &value)) {
+                        strcpy(reply, "E01");
+                        break;
+                    }
+                    write_register(cpu, reg, value);
+                    in += 2 * size;
+                }
+                break;
+            }
+            case 'p': {
+                unsigned reg = (unsigned)strtoul(packet + 1, NULL, 16);
+                if (reg < GDB_REGISTER_COUNT) {
+                    *put_hex_value(reply, read_register(cpu, (int)reg), register_size((int)reg)) = '\0';
+                } else {
+                    strcpy(reply, "E01");
+                }
+                break;
+            }
+            case 'P': {
+                char *equals = strchr(packet, '=');
+                unsigned reg = (unsigned)strtoul(packet + 1, NULL, 16);
+                uint64_t value;
+                if (equals && reg < GDB_REGISTER_COUNT && strlen(equals + 1) >= 2 * register_size((int)reg) &&
+                    get_hex_value(equals + 1, register_size((int)reg), &value)) {
+                    write_register(cpu, (int)reg, value);
+                    strcpy(reply, "OK");
+                } else {
+                    strcpy(reply, "E01");
+                }
+                break;
+            }
+
+            case 'm':
+            case 'M':
+                access_memory(cpu, packet, reply);
+                break;
+
+            case 'c':
+            case 's':
+                if (packet[1]) {
+                    cpu->program_counter = (uint32_t)strtoul(packet + 1, NULL, 16);
+                }
+                if (!cpu->halted && !resume_and_wait(stub, &conn, packet[0] == 's')) {
+                    finish_session(stub, GDB_DETACHED);
+                    return NULL;
+                }
+                stop_reply(stub, reply);
+                break;
+
+            case 'Z':
+            case 'z':
+                strcpy(reply, update_point(stub, packet));
+                break;
+
+            case 'H':
+            case 'T':
+                strcpy(reply, "OK");
+                break;
+
+            case 'D':
+                put_packet(conn.fd, "OK");
+                finish_session(stub, GDB_DETACHED);
+                return NULL;
+
+            case 'k':
+                finish_session(stub, GDB_KILLED);
+                return NULL;
+
+            case 'q':
+                if (strncmp(packet, "qSupported", 10) == 0) {
+                    sprintf(reply, "PacketSize=%x;qXfer:features:read+", GDB_PACKET_SIZE);
+                } else if (strncmp(packet, "qXfer:features:read:", 20) == 0) {
+                    read_target_xml(packet + 20, reply);
+                } else if (strcmp(packet, "qAttached") == 0) {
+                    strcpy(reply, "1");
+                } else if (strcmp(packet, "qC") == 0) {
+                    strcpy(reply, "QC1");
+                } else if (strcmp(packet, "qfThreadInfo") == 0) {
+                    strcpy(reply, "m1");
+                } else if (strcmp(packet, "qsThreadInfo") == 0) {
+                    strcpy(reply, "l");
+                }
+                break;
+
+            default:
+                break;      // Empty reply: unsupported packet
+        }
+        put_packet(conn.fd, reply);
+    }
+}
+
+// Create the listening socket
+static int open_listener(const char *address) {
+    int fd;
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strncpy(local.sun_path, address + 5, sizeof(local.sun_path) - 1);
+        unlink(local.sun_path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+            perror("Error binding GDB socket");
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_in local;
+        int reuse = 1;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local.sin_port = htons((uint16_t)atoi(address));
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (fd < 0 || bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+            perror("Error binding GDB port");
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, 1) != 0) {
+        perror("Error listening for GDB");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_descriptors(GDBStub *stub) {
+    int fds[] = {stub->client_fd, stub->listen_fd, stub->wake_pipe[0], stub->wake_pipe[1]};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+}
+
+// Wait for the debugger and start the packet thread
+int start_gdb_stub(GDBStub *stub, CPU *cpu, const char *address) {
+    memset(stub, 0, sizeof(*stub));
+    stub->cpu = cpu;
+    stub->state = GDB_STOPPED;
+    stub->stop_signal = GDB_SIGTRAP;
+    stub->client_fd = -1;
+    stub->wake_pipe[0] = stub->wake_pipe[1] = -1;
+    atomic_init(&stub->interrupt, false);
+    init_breakpoints(&stub->breakpoints);
+
+    stub->listen_fd = open_listener(address);
+    if (stub->listen_fd < 0) {
+        return -1;
+    }
+    printf("Waiting for GDB on %s\n", address);
+    fflush(stdout);
+
+    stub->client_fd = accept(stub->listen_fd, NULL, NULL);
+    if (stub->client_fd < 0 || pipe(stub->wake_pipe) != 0) {
+        perror("Error accepting GDB connection");
+        close_descriptors(stub);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(stub->client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    pthread_mutex_init(&stub->lock, NULL);
+    pthread_cond_init(&stub->cond, NULL);
+    if (pthread_create(&stub->thread, NULL, gdb_packet_thread, stub) != 0) {
+        fprintf(stderr, "Error: Cannot start GDB packet thread\n");
+        pthread_cond_destroy(&stub->cond);
+        pthread_mutex_destroy(&stub->lock);
+        close_descriptors(stub);
+        return -1;
+    }
+    return 0;
+}
+
+// Execution side: run whenever the debugger resumes the CPU
+void gdb_serve(GDBStub *stub) {
+    pthread_mutex_lock(&stub->lock);
+    for (;;) {
+        while (stub->state == GDB_STOPPED) {
+            pthread_cond_wait(&stub->cond, &stub->lock);
+        }
+        if (stub->state != GDB_RUNNING) {
+            break;
+        }
+
+        bool single_step = stub->single_step;
+        pthread_mutex_unlock(&stub->lock);
+        int signal = run_until_stop(stub, single_step);
+        pthread_mutex_lock(&stub->lock);
+
+        stub->stop_signal = signal;
+        if (stub->state == GDB_RUNNING) {
+            stub->state = GDB_STOPPED;
+        }
+        char wake = 1;
+        if (write(stub->wake_pipe[1], &wake, 1) != 1) {
+            perror("Error waking GDB packet thread");
+        }
+    }
+    GDBState state = stub->state;
+    pthread_mutex_unlock(&stub->lock);
+
+    // After a detach the program runs on without the debugger
+    if (state == GDB_DETACHED) {
+        while (!stub->cpu->halted) {
+            step_cpu(stub->cpu);
+        }
+    }
+}
+
+// Join the packet thread and close everything
+void stop_gdb_stub(GDBStub *stub) {
+    pthread_join(stub->thread, NULL);
+    pthread_cond_destroy(&stub->cond);
+    pthread_mutex_destroy(&stub->lock);
+    close_descriptors(stub);
+}
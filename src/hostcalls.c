@@ -0,0 +1,234 @@
+#include "hostcalls.h"
+#include "instructions.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HEADER_SIZE sizeof(uint32_t)
+#define PRINT_BUFFER_SIZE 512
+
+static const char *syscall_names[SYSCALL_COUNT] = {
+    "memcpy", "memset", "strlen", "malloc", "free", "print"
+};
+
+// Initialize the table and lay out one free block over the heap
+int init_host_calls(HostCalls *calls, CPU *cpu, uint32_t image_end, ConsoleDevice *console) {
+    memset(calls, 0, sizeof(*calls));
+    uint32_t start = image_end > HEAP_START ? image_end : HEAP_START;
+    calls->heap_start = (start + HEAP_ALIGN - 1) & ~(uint32_t)(HEAP_ALIGN - 1);
+    calls->heap_end = HEAP_END;
+    calls->console = console;
+    if (calls->heap_start + 2 * HEADER_SIZE > calls->heap_end) {
+        fprintf(stderr, "Error: Image leaves no room for a heap below 0x%X\n", HEAP_END);
+        return -1;
+    }
+
+    write_memory(cpu->memory, calls->heap_start, calls->heap_end - calls->heap_start - HEADER_SIZE);
+    cpu->host_calls = calls;
+    return 0;
+}
+
+// Length of a NUL-terminated guest string, or -1 if it runs off the end of memory
+static int32_t guest_strlen(const CPU *cpu, uint32_t address) {
+    if (address >= MEMORY_SIZE) {
+        return -1;
+    }
+    const uint8_t *end = memchr(cpu->memory + address, 0, MEMORY_SIZE - address);
+    return end ? (int32_t)(end - (cpu->memory + address)) : -1;
+}
+
+// First-fit allocation, splitting off the unused tail of a large block
+static uint32_t heap_alloc(HostCalls *calls, CPU *cpu, uint32_t size) {
+    if (size == 0 || size > calls->heap_end - calls->heap_start) {
+        return 0;
+    }
+    size = (size + HEAP_ALIGN - 1) & ~(uint32_t)(HEAP_ALIGN - 1);
+
+    for (uint32_t block = calls->heap_start; block < calls->heap_end;) {
+        uint32_t header = read_memory(cpu->memory, block);
+        uint32_t block_size = header & ~HEAP_USED;
+        if (!(header & HEAP_USED) && block_size >= size) {
+            uint32_t written = HEADER_SIZE;
+            if (block_size - size >= HEADER_SIZE + HEAP_ALIGN) {
+                write_memory(cpu->memory, block + HEADER_SIZE + size, block_size - size - HEADER_SIZE);
+                block_size = size;
+                written = HEADER_SIZE + size + HEADER_SIZE;
+            }
+            write_memory(cpu->memory, block, block_size | HEAP_USED);
+            record_store(cpu, block, written);
+            return block + HEADER_SIZE;
+        }
+        block += HEADER_SIZE + block_size;
+    }
+    return 0;
+}
+
+// Free a block and merge every run of adjacent free blocks
+static void heap_free(HostCalls *calls, CPU *cpu, uint32_t address) {
+    if (address == 0) {
+        return;
+    }
+
+    uint32_t target = address - HEADER_SIZE;
+    uint32_t block = calls->heap_start;
+    while (block < calls->heap_end && block < target) {
+        block += HEADER_SIZE + (read_memory(cpu->memory, block) & ~HEAP_USED);
+    }
+    if (block != target || !(read_memory(cpu->memory, block) & HEAP_USED)) {
+        fprintf(stderr, "Error: free of 0x%X, which is not an allocated block\n", address);
+        cpu->halted = true;
+        return;
+    }
+    write_memory(cpu->memory, block, read_memory(cpu->memory, block) & ~HEAP_USED);
+
+    uint32_t first_written = block;
+    uint32_t last_written = block;
+    for (uint32_t run = calls->heap_start; run < calls->heap_end;) {
+        uint32_t size = read_memory(cpu->memory, run);
+        uint32_t next = run + HEADER_SIZE + (size & ~HEAP_USED);
+        if (!(size & HEAP_USED)) {
+            while (next < calls->heap_end && !(read_memory(cpu->memory, next) & HEAP_USED)) {
+                size += HEADER_SIZE + read_memory(cpu->memory, next);
+                next = run + HEADER_SIZE + size;
+            }
+            if (size != read_memory(cpu->memory, run)) {
+                write_memory(cpu->memory, run, size);
+                first_written = run < first_written ? run : first_written;
+                last_written = run > last_written ? run : last_written;
+            }
+        }
+        run = next;
+    }
+    record_store(cpu, first_written, last_written - first_written + HEADER_SIZE);
+}
+
+// Append formatted text, truncating at the end of the buffer
+static void put_text(char *out, size_t *length, const char *text, size_t count) {
+    if (count > PRINT_BUFFER_SIZE - *length) {
+        count = PRINT_BUFFER_SIZE - *length;
+    }
+    memcpy(out + *length, text, count);
+    *length += count;
+}
+
+// printf subset over a guest format string with up to two arguments
+static int32_t guest_print(HostCalls *calls, CPU *cpu) {
+    uint32_t format = (uint32_t)cpu->registers[1];
+    int32_t format_length = guest_strlen(cpu, format);
+    if (format_length < 0) {
+        fprintf(stderr, "Error: print format at 0x%X is not terminated\n", format);
+        cpu->halted = true;
+        return 0;
+    }
+
+    const char *text = (const char *)cpu->memory + format;
+    const sword_t args[2] = {cpu->registers[2], cpu->registers[3]};
+    int next_arg = 0;
+    char out[PRINT_BUFFER_SIZE];
+    size_t length = 0;
+    char number[24];
+
+    for (int32_t i = 0; i < format_length; i++) {
+        if (text[i] != '%' || i + 1 == format_length) {
+            put_text(out, &length, &text[i], 1);
+            continue;
+        }
+
+        char conversion = text[++i];
+        sword_t arg = next_arg < 2 ? args[next_arg] : 0;
+        int count = 0;
+        switch (conversion) {
+            case 'd': count = snprintf(number, sizeof(number), "%" PRIdWORD, arg); next_arg++; break;
+            case 'u': count = snprintf(number, sizeof(number), "%" PRIuWORD, (word_t)arg); next_arg++; break;
+            case 'x': count = snprintf(number, sizeof(number), "%" PRIxWORD, (word_t)arg); next_arg++; break;
+            case 'c': number[0] = (char)arg; count = 1; next_arg++; break;
+            case 's': {
+                int32_t string_length = guest_strlen(cpu, (uint32_t)arg);
+                if (string_length >= 0) {
+                    put_text(out, &length, (const char *)cpu->memory + (uint32_t)arg, (size_t)string_length);
+                }
+                next_arg++;
+                break;
+            }
+            default: number[0] = '%'; number[1] = conversion; count = 2; break;
+        }
+        put_text(out, &length, number, (size_t)count);
+    }
+
+    if (calls->quiet) {
+        return (int32_t)length;     // Printed when the code first ran
+    }
+    if (calls->console) {
+        append_console(calls->console, out, (uint32_t)length);
+    } else {
+        fwrite(out, 1, length, stdout);
+    }
+    return (int32_t)length;
+}
+
+// Dispatch a SYSCALL
+void host_call(CPU *cpu, uint32_t number) {
+    HostCalls *calls = cpu->host_calls;
+    if (calls == NULL || number >= SYSCALL_COUNT) {
+        fprintf(stderr, "Error: Invalid host call %u\n", number);
+        cpu->halted = true;
+        return;
+    }
+    calls->calls[number]++;
+
+    sword_t *reg = cpu->registers;
+    uint32_t dst = (uint32_t)reg[1], src = (uint32_t)reg[2], length = (uint32_t)reg[3];
+    switch ((Syscall)number) {
+        case SYS_MEMCPY:
+            if (check_bulk_range(cpu, dst, length, "memcpy") && check_bulk_range(cpu, src, length, "memcpy")) {
+                memmove(cpu->memory + dst, cpu->memory + src, length);
+                record_store(cpu, dst, length);
+            }
+            break;
+        case SYS_MEMSET:
+            if (check_bulk_range(cpu, dst, length, "memset")) {
+                memset(cpu->memory + dst, (int)src, length);
+                record_store(cpu, dst, length);
+            }
+            break;
+        case SYS_STRLEN: {
+            int32_t string_length = guest_strlen(cpu, dst);
+            if (string_length < 0) {
+                fprintf(stderr, "Error: strlen of 0x%X runs off the end of memory\n", dst);
+                cpu->halted = true;
+            } else {
+                reg[1] = string_length;
+            }
+            break;
+        }
+        case SYS_MALLOC:
+            reg[1] = (sword_t)heap_alloc(calls, cpu, dst);
+            break;
+        case SYS_FREE:
+            heap_free(calls, cpu, dst);
+            break;
+        case SYS_PRINT:
+            reg[1] = guest_print(calls, cpu);
+            break;
+        default:
+            break;
+    }
+}
+
+// Display per-call counts
+void display_host_calls(const HostCalls *calls) {
+    uint64_t total = 0;
+    for (int i = 0; i < SYSCALL_COUNT; i++) {
+        total += calls->calls[i];
+    }
+    if (total == 0) {
+        return;
+    }
+
+    printf("\n=== Host Calls ===\n");
+    for (int i = 0; i < SYSCALL_COUNT; i++) {
+        if (calls->calls[i]) {
+            printf("%-8s %llu\n", syscall_names[i], (unsigned long long)calls->calls[i]);
+        }
+    }
+}
@@ -0,0 +1,498 @@
+#include "image_assembler.h"
+#include "instructions.h"
+#include "debug.h"
+#include "compressed.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    char name[ASM_MAX_LABEL_LENGTH];
+    uint32_t address;
+} AsmLabel;
+
+typedef struct {
+    AsmLabel labels[ASM_MAX_LABELS];
+    int label_count;
+    uint8_t image[MEMORY_SIZE];
+    uint32_t image_size;
+    uint32_t location;
+    bool emit;                  // Only the final pass writes the image
+    int pass;                   // Pass 0 defines the labels, later passes move them
+    bool moved;                 // This pass moved a label or widened a branch
+    bool compress;              // Pack eligible instructions into compressed pairs
+    bool pending;               // A compressed instruction waits at location for a partner
+    uint32_t pending_half;
+    int deferred[ASM_MAX_LABELS];   // Labels defined while an instruction is pending
+    int deferred_count;
+    bool *wide;                 // By line: branches found out of compressed range
+    char **lines;               // Source, which the post-link pass may rewrite
+    int line_count;
+    uint32_t *addresses;        // By line: where its instruction starts
+    int compressed_count;
+    const char *file;
+    int line;
+} Assembler;
+
+static void free_assembler(Assembler *as) {
+    if (!as) {
+        return;
+    }
+    for (int i = 0; i < as->line_count; i++) {
+        free(as->lines[i]);
+    }
+    free(as->lines);
+    free(as->addresses);
+    free(as->wide);
+    free(as);
+}
+
+// Report an error at the current line
+static int asm_error(const Assembler *as, const char *message, const char *detail) {
+    fprintf(stderr, "Error: %s:%d: %s%s%s\n", as->file, as->line, message, detail ? " " : "", detail ? detail : "");
+    return -1;
+}
+
+// Strip leading and trailing whitespace in place
+static char *trim(char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+static const AsmLabel *find_label(const Assembler *as, const char *name) {
+    for (int i = 0; i < as->label_count; i++) {
+        if (strcmp(as->labels[i].name, name) == 0) {
+            return &as->labels[i];
+        }
+    }
+    return NULL;
+}
+
+// Parse a number or a label; labels are only resolved after pass 0
+static int parse_value(const Assembler *as, const char *text, uint32_t *value) {
+    char *end;
+    long number = strtol(text, &end, 0);
+    if (end != text && *end == '\0') {
+        *value = (uint32_t)number;
+        return 0;
+    }
+    const AsmLabel *label = find_label(as, text);
+    if (label) {
+        *value = label->address;
+        return 0;
+    }
+    if (as->pass == 0 && (isalpha((unsigned char)text[0]) || text[0] == '_')) {
+        *value = 0;
+        return 0;
+    }
+    return asm_error(as, "Invalid value", text);
+}
+
+// Parse a .quad value: a 64-bit number or a label
+static int parse_quad(const Assembler *as, const char *text, uint64_t *value) {
+    char *end;
+    unsigned long long number = strtoull(text, &end, 0);
+    if (end != text && *end == '\0') {
+        *value = number;
+        return 0;
+    }
+    uint32_t address;
+    if (parse_value(as, text, &address) != 0) {
+        return -1;
+    }
+    *value = address;
+    return 0;
+}
+
+// Set a label's address, noting whether the layout is still settling
+static void place_label(Assembler *as, AsmLabel *label, uint32_t address) {
+    if (label->address != address) {
+        label->address = address;
+        as->moved = true;
+    }
+}
+
+// Place the labels that waited for the pending instruction
+static void settle_deferred(Assembler *as, uint32_t address) {
+    for (int i = 0; i < as->deferred_count; i++) {
+        place_label(as, &as->labels[as->deferred[i]], address);
+    }
+    as->deferred_count = 0;
+}
+
+// Define a label on pass 0; later passes only move it. A label after a
+// pending instruction is placed once that instruction's size is known.
+static int define_label(Assembler *as, const char *name) {
+    AsmLabel *label = (AsmLabel *)find_label(as, name);
+    if (as->pass == 0) {
+        if (label) {
+            return asm_error(as, "Duplicate label", name);
+        }
+        if (as->label_count == ASM_MAX_LABELS || strlen(name) >= ASM_MAX_LABEL_LENGTH || name[0] == '\0') {
+            return asm_error(as, "Cannot define label", name);
+        }
+        label = &as->labels[as->label_count++];
+        strcpy(label->name, name);
+    } else if (label == NULL) {
+        return asm_error(as, "Cannot define label", name);
+    }
+    if (as->pending) {
+        as->deferred[as->deferred_count++] = (int)(label - as->labels);
+        return 0;
+    }
+    place_label(as, label, as->location);
+    return 0;
+}
+
+static int put_word(Assembler *as, uint32_t value) {
+    if (as->location > MEMORY_SIZE - sizeof(uint32_t)) {
+        return asm_error(as, "Image does not fit in memory", NULL);
+    }
+    if (as->emit) {
+        write_memory(as->image, as->location, value);
+    }
+    as->location += sizeof(uint32_t);
+    if (as->location > as->image_size) {
+        as->image_size = as->location;
+    }
+    return 0;
+}
+
+// Emit a compressed instruction left without a partner in its 32-bit form
+static int flush_pending(Assembler *as) {
+    if (!as->pending) {
+        return 0;
+    }
+    as->pending = false;
+    as->compressed_count--;
+    if (put_word(as, expand_compressed(as->pending_half)) != 0) {
+        return -1;
+    }
+    settle_deferred(as, as->location);
+    return 0;
+}
+
+// Parse one operand of the given kind into an 8-bit field
+static int parse_operand(const Assembler *as, char kind, char *text, uint32_t *field) {
+    uint32_t value;
+    size_t length = strlen(text);
+    if (kind == 'R' || kind == 'V' || kind == 'F') {
+        char *end;
+        if (toupper((unsigned char)text[0]) != kind) {
+            return asm_error(as, kind == 'R' ? "Expected a register:" :
+                                 kind == 'V' ? "Expected a vector register:" : "Expected an FP register:", text);
+        }
+        value = (uint32_t)strtoul(text + 1, &end, 10);
+        if (end == text + 1 || *end != '\0' ||
+            value >= (kind == 'R' ? REGISTER_COUNT : kind == 'V' ? VECTOR_REGISTER_COUNT : FP_REGISTER_COUNT)) {
+            return asm_error(as, "Invalid register", text);
+        }
+    } else if (kind == 'M') {
+        if (length < 2 || text[0] != '[' || text[length - 1] != ']') {
+            return asm_error(as, "Expected [address]:", text);
+        }
+        text[length - 1] = '\0';
+        if (parse_value(as, trim(text + 1), &value) != 0) {
+            return -1;
+        }
+    } else if (parse_value(as, text, &value) != 0) {
+        return -1;
+    } else if (kind == 'L') {
+        if (value >= MEMORY_SIZE || value % 2 != 0) {
+            return asm_error(as, "Invalid branch target:", text);
+        }
+        *field = value;     // Becomes an offset once the branch is placed
+        return 0;
+    } else if (kind == 'S') {
+        if ((int32_t)value < -128 || (int32_t)value > 127) {
+            return asm_error(as, "Operand does not fit in a signed byte:", text);
+        }
+        value &= 0xFF;
+    }
+
+    if (value > 0xFF) {
+        return asm_error(as, "Operand does not fit in 8 bits:", text);
+    }
+    *field = value;
+    return 0;
+}
+
+// Encode an instruction placed at address; a branch target becomes an offset from it
+static uint32_t encode_at(uint32_t opcode, const char *kinds, const uint32_t *fields, uint32_t address) {
+    if (kinds[0] == 'L') {
+        uint32_t offset = (fields[0] - address) & 0xFFFFFF;
+        return encode_instruction((Opcode)opcode, (uint8_t)(offset >> 16), (uint8_t)(offset >> 8), (uint8_t)offset);
+    }
+    return encode_instruction((Opcode)opcode, (uint8_t)fields[0], (uint8_t)fields[1], (uint8_t)fields[2]);
+}
+
+// Assemble one instruction, pairing it with a pending compressed one when
+// both have compressed forms; a lone compressed instruction waits for the
+// next line before it is emitted
+static int assemble_instruction_line(Assembler *as, char *mnemonic, char *operands) {
+    uint32_t opcode = 0;
+    const char *name;
+    while ((name = opcode_name(opcode)) != NULL && strcasecmp(name, mnemonic) != 0) {
+        opcode++;
+    }
+    if (name == NULL) {
+        return asm_error(as, "Unknown instruction", mnemonic);
+    }
+    if (as->location % sizeof(uint32_t) != 0) {
+        return asm_error(as, "Instruction is not word-aligned", NULL);
+    }
+
+    const char *kinds = opcode_operands(opcode);
+    uint32_t fields[3] = {0, 0, 0};
+    int count = 0;
+    for (char *operand = strtok(operands, ","); operand; operand = strtok(NULL, ",")) {
+        if (kinds[count] == '\0') {
+            return asm_error(as, "Too many operands for", name);
+        }
+        if (parse_operand(as, kinds[count], trim(operand), &fields[count]) != 0) {
+            return -1;
+        }
+        count++;
+    }
+
+    bool compress = as->compress && !(as->wide && as->wide[as->line]);
+    uint32_t raw, half;
+    if (as->pending) {
+        raw = encode_at(opcode, kinds, fields, as->location + 2);
+        if (compress && compress_instruction(raw, &half)) {
+            as->addresses[as->line - 1] = as->location + 2;
+            settle_deferred(as, as->location + 2);
+            as->pending = false;
+            as->compressed_count++;
+            return put_word(as, pack_compressed(as->pending_half, half));
+        }
+        if (flush_pending(as) != 0) {
+            return -1;
+        }
+    }
+
+    as->addresses[as->line - 1] = as->location;
+    raw = encode_at(opcode, kinds, fields, as->location);
+    if (compress && compress_instruction(raw, &half)) {
+        as->pending = true;
+        as->pending_half = half;
+        as->compressed_count++;
+        return 0;
+    }
+    if (compress && kinds[0] == 'L' && as->pass > 0) {
+        // Out of compressed range where it landed: keep it wide from now on
+        // so that branches shrinking and growing cannot stop the layout settling
+        as->wide[as->line] = true;
+        as->moved = true;
+    }
+    return put_word(as, raw);
+}
+
+static int assemble_line(Assembler *as, char *line) {
+    line[strcspn(line, ";#\r\n")] = '\0';
+    char *text = trim(line);
+
+    char *colon = strchr(text, ':');
+    if (colon) {
+        *colon = '\0';
+        if (define_label(as, trim(text)) != 0) {
+            return -1;
+        }
+        text = trim(colon + 1);
+    }
+    if (*text == '\0') {
+        return 0;
+    }
+
+    char *operands = text + strcspn(text, " \t");
+    if (*operands) {
+        *operands++ = '\0';
+    }
+
+    if (text[0] == '.' && flush_pending(as) != 0) {
+        return -1;
+    }
+    if (strcasecmp(text, ".org") == 0) {
+        uint32_t address;
+        if (parse_value(as, trim(operands), &address) != 0) {
+            return -1;
+        }
+        if (address >= MEMORY_SIZE) {
+            return asm_error(as, "Address outside memory:", operands);
+        }
+        as->location = address;
+        return 0;
+    }
+    if (strcasecmp(text, ".word") == 0) {
+        for (char *item = strtok(operands, ","); item; item = strtok(NULL, ",")) {
+            uint32_t value;
+            if (parse_value(as, trim(item), &value) != 0 || put_word(as, value) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if (strcasecmp(text, ".quad") == 0) {
+        for (char *item = strtok(operands, ","); item; item = strtok(NULL, ",")) {
+            uint64_t value;
+            if (parse_quad(as, trim(item), &value) != 0 || put_word(as, (uint32_t)value) != 0 ||
+                put_word(as, (uint32_t)(value >> 32)) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    return assemble_instruction_line(as, text, operands);
+}
+
+// Run one pass over the source
+static int assemble_pass(Assembler *as) {
+    char line[256];
+    as->location = CODE_START;
+    as->line = 0;
+    as->moved = false;
+    as->pending = false;
+    as->deferred_count = 0;
+    as->compressed_count = 0;
+    while (as->line < as->line_count) {
+        snprintf(line, sizeof(line), "%s", as->lines[as->line++]);
+        if (assemble_line(as, line) != 0) {
+            return -1;
+        }
+    }
+    return flush_pending(as);
+}
+
+// Read the source into memory, one string per line
+static int read_lines(Assembler *as, FILE *source) {
+    char line[256];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), source)) {
+        if (as->line_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            char **grown = realloc(as->lines, (size_t)capacity * sizeof(char *));
+            if (!grown) {
+                return -1;
+            }
+            as->lines = grown;
+        }
+        if ((as->lines[as->line_count] = strdup(line)) == NULL) {
+            return -1;
+        }
+        as->line_count++;
+    }
+    as->addresses = calloc((size_t)as->line_count + 1, sizeof(uint32_t));
+    as->wide = calloc((size_t)as->line_count + 1, sizeof(bool));
+    return as->addresses && as->wide ? 0 : -1;
+}
+
+// Lay the source out: define the labels, then repeat until no label moves.
+// Compressing one instruction can bring a branch target into compressed
+// range, and pairing shifts what follows. Branches only ever widen, so the
+// layout settles.
+static int lay_out(Assembler *as) {
+    as->pass = 0;
+    as->label_count = 0;
+    memset(as->wide, 0, ((size_t)as->line_count + 1) * sizeof(bool));
+    int status = assemble_pass(as);
+    while (status == 0 && (as->pass == 0 || as->moved)) {
+        as->pass++;
+        status = assemble_pass(as);
+    }
+    return status;
+}
+
+// Run the post-link pass over the laid-out program and lay out what it left
+static int optimize_layout(Assembler *as, LinkOptStats *stats) {
+    LinkLabel *labels = malloc(((size_t)as->label_count + 1) * sizeof(LinkLabel));
+    if (!labels) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+    for (int i = 0; i < as->label_count; i++) {
+        labels[i] = (LinkLabel){as->labels[i].name, as->labels[i].address};
+    }
+    int changed = optimize_linked_program(as->lines, as->addresses, as->line_count, labels, as->label_count, stats);
+    free(labels);
+    return changed > 0 ? lay_out(as) : 0;
+}
+
+// Assemble a source file into the assembler's image
+static Assembler *assemble(const char *source_file, bool compress, LinkOptStats *optimize) {
+    FILE *source = fopen(source_file, "r");
+    if (!source) {
+        fprintf(stderr, "Error: Cannot open %s\n", source_file);
+        return NULL;
+    }
+    Assembler *as = calloc(1, sizeof(Assembler));
+    if (!as || read_lines(as, source) != 0) {
+        fprintf(stderr, "Error: Out of memory\n");
+        fclose(source);
+        free_assembler(as);
+        return NULL;
+    }
+    fclose(source);
+    as->file = source_file;
+    as->compress = compress;
+
+    int status = lay_out(as);
+    if (status == 0 && optimize) {
+        status = optimize_layout(as, optimize);
+    }
+    if (status == 0) {
+        as->emit = true;
+        status = assemble_pass(as);
+    }
+    if (status != 0) {
+        free_assembler(as);
+        return NULL;
+    }
+    return as;
+}
+
+// Assemble a source file into an image
+int assemble_image(const char *source_file, const char *image_file, bool compress, LinkOptStats *optimize) {
+    Assembler *as = assemble(source_file, compress, optimize);
+    if (!as) {
+        return -1;
+    }
+    int status = 0;
+    FILE *image = fopen(image_file, "wb");
+    if (!image || fwrite(as->image, 1, as->image_size, image) != as->image_size) {
+        fprintf(stderr, "Error: Cannot write %s\n", image_file);
+        status = -1;
+    }
+    if (image) {
+        fclose(image);
+    }
+    if (status == 0) {
+        printf("Assembled %s: %u bytes, %d labels", image_file, as->image_size, as->label_count);
+        if (as->compressed_count) {
+            printf(", %d compressed instructions", as->compressed_count);
+        }
+        printf("\n");
+    }
+    free_assembler(as);
+    return status;
+}
+
+// Assemble a source file straight into memory
+int assemble_to_memory(const char *source_file, bool compress, LinkOptStats *optimize, uint8_t *memory) {
+    Assembler *as = assemble(source_file, compress, optimize);
+    if (!as) {
+        return -1;
+    }
+    memcpy(memory, as->image, as->image_size);
+    int size = (int)as->image_size;
+    free_assembler(as);
+    return size;
+}
@@ -1,9 +1,17 @@
 #include "instructions.h"
 #include "alu.h"
+#include "breakpoints.h"
+#include "interrupts.h"
+#include "mmio.h"
+#include "hostcalls.h"
+#include "vector.h"
+#include "fpu.h"
+#include "compressed.h"
 #include <stdio.h>
+#include <string.h>
 
 // Decode a 32-bit binary instruction into an Instruction struct
-static Instruction decode_instruction(uint32_t raw) {
+Instruction decode_instruction(uint32_t raw) {
     Instruction instr;
     instr.opcode = (Opcode)((raw >> 24) & 0xFF); // Extract opcode (upper 8 bits)
     instr.operands[0] = (raw >> 16) & 0xFF;      // Extract first operand (next 8 bits)
@@ -12,6 +20,257 @@ static Instruction decode_instruction(uint32_t raw) {
     return instr;
 }
 
+// Encode an Instruction's fields into a 32-bit binary instruction
+uint32_t encode_instruction(Opcode opcode, uint8_t a, uint8_t b, uint8_t c) {
+    return ((uint32_t)opcode << 24) | ((uint32_t)a << 16) | ((uint32_t)b << 8) | c;
+}
+
+// Read size bytes (4 or WORD_BYTES) from physical RAM, or a 32-bit register
+// of a memory-mapped device; size is a constant at every call
+static inline word_t load_physical(CPU *cpu, uint32_t address, uint32_t size) {
+    if (cpu->io_pages[(address / IO_PAGE_SIZE) % IO_PAGE_COUNT]) {
+        return mmio_read(cpu, address);
+    }
+    return size == sizeof(uint32_t) ? read_memory(cpu->memory, address) : read_memory_word(cpu->memory, address);
+}
+
+// Write a word to physical RAM or a memory-mapped device
+static void store_physical(CPU *cpu, uint32_t address, word_t value) {
+    if (cpu->io_pages[(address / IO_PAGE_SIZE) % IO_PAGE_COUNT]) {
+        mmio_write(cpu, address, (uint32_t)value);
+        return;
+    }
+    write_memory_word(cpu->memory, address, value);
+    record_store(cpu, address, WORD_BYTES);
+}
+
+// Read size bytes through the TLB, assembling values that straddle two pages
+static inline word_t load_translated(CPU *cpu, uint32_t address, uint32_t size, MMUAccess access) {
+    word_t value = 0;
+    const uint8_t *host = tlb_lookup(cpu->mmu, address, size, access);
+    if (host) {
+        memcpy(&value, host, size);
+        return value;
+    }
+
+    uint32_t first = translate_address(cpu, address, access);
+    if (first == MMU_FAULT) {
+        return 0;
+    }
+    uint32_t split = MMU_PAGE_SIZE - (address & MMU_OFFSET_MASK);
+    if (split >= size) {
+        return load_physical(cpu, first, size);
+    }
+    uint32_t second = translate_address(cpu, address + split, access);
+    if (second == MMU_FAULT) {
+        return 0;
+    }
+    uint8_t bytes[sizeof(word_t)];
+    memcpy(bytes, cpu->memory + first, split);
+    memcpy(bytes + split, cpu->memory + second, size - split);
+    memcpy(&value, bytes, size);
+    return value;
+}
+
+// Read a word from RAM or a memory-mapped device
+word_t load_word(CPU *cpu, uint32_t address) {
+    if (cpu->paging) {
+        return load_translated(cpu, address, WORD_BYTES, MMU_READ);
+    }
+    return load_physical(cpu, address, WORD_BYTES);
+}
+
+// Decode the word holding an instruction into the cache; a compressed pair fills both slots
+uint32_t fill_decode_cache(CPU *cpu, uint32_t address, uint32_t *length) {
+    *length = 0;
+    if (address >= MEMORY_SIZE || (address & 1) != 0) {
+        return 0;
+    }
+    uint32_t base = address & ~(uint32_t)3;
+    uint32_t word = read_memory(cpu->memory, base);
+    uint32_t slot = base / 2;
+    if (is_compressed_pair(word)) {
+        cpu->decoded[slot] = expand_compressed(word & COMPRESSED_MASK);
+        cpu->decoded[slot + 1] = expand_compressed((word >> COMPRESSED_SHIFT) & COMPRESSED_MASK);
+        cpu->decoded_length[slot] = cpu->decoded_length[slot + 1] = 2;
+    } else if (address != base) {
+        return 0;   // The middle of a 32-bit instruction
+    } else {
+        cpu->decoded[slot] = word;
+        cpu->decoded_length[slot] = sizeof(uint32_t);
+    }
+    cpu->decoded_pages |= 1u << (base / DECODE_PAGE_SIZE);
+    *length = cpu->decoded_length[address / 2];
+    return cpu->decoded[address / 2];
+}
+
+// Empty the slots of every word overlapping the range, skipping pages never decoded
+void invalidate_decoded(CPU *cpu, uint32_t address, uint32_t size) {
+    if (size == 0 || address >= MEMORY_SIZE) {
+        return;
+    }
+    uint32_t last = address + size - 1 < MEMORY_SIZE ? address + size - 1 : MEMORY_SIZE - 1;
+    uint32_t first_page = address / DECODE_PAGE_SIZE;
+    uint32_t last_page = last / DECODE_PAGE_SIZE;
+    if (!(cpu->decoded_pages & ((2u << last_page) - (1u << first_page)))) {
+        return;
+    }
+    uint32_t first_slot = (address & ~(uint32_t)3) / 2;
+    uint32_t end_slot = ((last | 3) + 1) / 2;
+    memset(cpu->decoded_length + first_slot, 0, end_slot - first_slot);
+}
+
+// Empty the whole decode cache
+void flush_decode_cache(CPU *cpu) {
+    memset(cpu->decoded_length, 0, sizeof(cpu->decoded_length));
+    cpu->decoded_pages = 0;
+}
+
+// Fetch an instruction through the MMU; translating its aligned word keeps it inside one page
+uint32_t fetch_translated(CPU *cpu, uint32_t address, uint32_t *length) {
+    uint32_t base = address & ~(uint32_t)3;
+    uint32_t physical;
+    const uint8_t *host = tlb_lookup(cpu->mmu, base, sizeof(uint32_t), MMU_EXECUTE);
+    if (host) {
+        physical = (uint32_t)(host - cpu->memory);
+    } else {
+        physical = translate_address(cpu, base, MMU_EXECUTE);
+        if (physical == MMU_FAULT) {
+            *length = 0;
+            return 0;
+        }
+    }
+    return decode_cached(cpu, physical | (address & 3), length);
+}
+
+// Write a word through the TLB; both pages of a straddling word are checked before either is written
+static void store_translated(CPU *cpu, uint32_t address, word_t value) {
+    uint8_t *host = tlb_lookup(cpu->mmu, address, WORD_BYTES, MMU_WRITE);
+    if (host) {
+        memcpy(host, &value, sizeof(value));
+        record_store(cpu, (uint32_t)(host - cpu->memory), sizeof(value));
+        return;
+    }
+
+    uint32_t first = translate_address(cpu, address, MMU_WRITE);
+    if (first == MMU_FAULT) {
+        return;
+    }
+    uint32_t split = MMU_PAGE_SIZE - (address & MMU_OFFSET_MASK);
+    if (split >= sizeof(value)) {
+        store_physical(cpu, first, value);
+        return;
+    }
+    uint32_t second = translate_address(cpu, address + split, MMU_WRITE);
+    if (second == MMU_FAULT) {
+        return;
+    }
+    uint8_t bytes[sizeof(value)];
+    memcpy(bytes, &value, sizeof(value));
+    memcpy(cpu->memory + first, bytes, split);
+    memcpy(cpu->memory + second, bytes + split, sizeof(value) - split);
+    record_store(cpu, first, split);
+    record_store(cpu, second, sizeof(value) - split);
+}
+
+// Write a word to memory and record the range for tracing and watchpoints
+void store_word(CPU *cpu, uint32_t address, word_t value) {
+    if (cpu->paging) {
+        store_translated(cpu, address, value);
+        return;
+    }
+    store_physical(cpu, address, value);
+}
+
+// Record the RAM range written by this step, drop stale decoded instructions
+// and test the range against watched pages
+void record_store(CPU *cpu, uint32_t address, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (cpu->store_size == 0) {
+        cpu->store_address = address;
+        cpu->store_size = size;
+    } else {
+        uint32_t end = cpu->store_address + cpu->store_size;
+        end = address + size > end ? address + size : end;
+        cpu->store_address = address < cpu->store_address ? address : cpu->store_address;
+        cpu->store_size = end - cpu->store_address;
+    }
+    if (cpu->decoded_pages) {
+        invalidate_decoded(cpu, address, size);
+    }
+    if (cpu->watch_pages && address < MEMORY_SIZE) {
+        uint32_t last = address + size - 1 < MEMORY_SIZE ? address + size - 1 : MEMORY_SIZE - 1;
+        uint32_t first_page = address / BREAKPOINT_PAGE_SIZE;
+        uint32_t last_page = last / BREAKPOINT_PAGE_SIZE;
+        uint32_t pages = (2u << last_page) - (1u << first_page);   // Bits first_page..last_page
+        if (cpu->watch_pages & pages) {
+            cpu->watch_hit = true;
+        }
+    }
+}
+
+// Validate a bulk range once so the operation itself can use host memcpy/memset
+bool check_bulk_range(CPU *cpu, uint32_t address, uint32_t length, const char *operation) {
+    if (length == 0) {
+        return true;
+    }
+    if (address >= MEMORY_SIZE || length > MEMORY_SIZE - address) {
+        fprintf(stderr, "Error: %s range 0x%X+%u is outside memory\n", operation, address, length);
+        cpu->halted = true;
+        return false;
+    }
+    if (cpu->bus) {
+        for (uint32_t page = address / IO_PAGE_SIZE; page <= (address + length - 1) / IO_PAGE_SIZE; page++) {
+            if (cpu->io_pages[page]) {
+                fprintf(stderr, "Error: %s range 0x%X+%u covers device memory\n", operation, address, length);
+                cpu->halted = true;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Translate a bulk range when paging is on, then validate it physically
+static bool bulk_range(CPU *cpu, uint32_t *address, uint32_t length, MMUAccess access, const char *operation) {
+    if (cpu->paging && !translate_range(cpu, address, length, access)) {
+        return false;
+    }
+    return check_bulk_range(cpu, *address, length, operation);
+}
+
+// Report an MMU instruction executed without an MMU attached
+static bool require_mmu(CPU *cpu, const char *operation) {
+    if (cpu->mmu == NULL) {
+        fprintf(stderr, "Error: %s without an MMU\n", operation);
+        cpu->halted = true;
+        return false;
+    }
+    return true;
+}
+
+// Look up a vector register operand
+static int32_t *vector_register(CPU *cpu, uint32_t index) {
+    if (index >= VECTOR_REGISTER_COUNT) {
+        fprintf(stderr, "Error: Invalid vector register V%u\n", index);
+        cpu->halted = true;
+        return NULL;
+    }
+    return cpu->vectors[index];
+}
+
+// Look up a floating-point register operand
+static uint64_t *fp_register(CPU *cpu, uint32_t index) {
+    if (index >= FP_REGISTER_COUNT) {
+        fprintf(stderr, "Error: Invalid FP register F%u\n", index);
+        cpu->halted = true;
+        return NULL;
+    }
+    return &cpu->fp_registers[index];
+}
+
 // Display the decoded instruction for debugging
 static void display_instruction(Instruction instruction) {
     printf("Opcode: %02X\n", instruction.opcode);
@@ -21,22 +280,76 @@ static void display_instruction(Instruction instruction) {
            instruction.operands[2]);
 }
 
+// Operand fields execute_verified uses to index reg[]; keep in step with it
+uint32_t register_fields(Opcode opcode) {
+    switch (opcode) {
+        case ADD: case SUB: case MUL: case DIV: case AND: case OR: case XOR:
+        case EQ: case NEQ: case GT: case LT: case GE: case LE:
+        case BEXT: case BINS: case MEMCPY: case MEMSET: case MEMCMP:
+            return 7;
+        case NOT: case SHL: case SHR: case CLZ: case CTZ: case POPCNT: case ROL: case ROR:
+        case BREV: case BSWAP: case MOV: case ADDI:
+            return 3;
+        case LOAD: case STORE: case JUMP: case JZ: case JNZ: case CALL: case PUSH: case POP:
+        case RDPERF: case MMUSET: case MMUGET: case TLBFLUSH: case VREDUCE:
+        case FCMPS: case FCMPD: case FCVTWS: case FCVTWD: case FPFLAGS:
+            return 1;
+        case TIMER: case VLOAD: case VSTORE: case VSPLAT:
+        case FLDS: case FLDD: case FSTS: case FSTD: case FCVTSW: case FCVTDW:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Check the general register operands of an instruction; vector and FP
+// operands are checked as they are looked up, and undefined opcodes by
+// execute_verified
+static bool registers_valid(CPU *cpu, Instruction instruction) {
+    if ((instruction.operands[0] | instruction.operands[1] | instruction.operands[2]) < REGISTER_COUNT) {
+        return true;
+    }
+    uint32_t fields = register_fields(instruction.opcode);
+    for (int i = 0; i < 3; i++) {
+        if ((fields >> i & 1) && instruction.operands[i] >= REGISTER_COUNT) {
+            fprintf(stderr, "Error: Invalid register R%u\n", instruction.operands[i]);
+            cpu->halted = true;
+            return false;
+        }
+    }
+    return true;
+}
+
 // Execute a given instruction on the CPU
-static void execute_instruction(CPU *cpu, Instruction instruction) {
-    printf("Executing instruction: Opcode=%02X Operands=%u, %u, %u\n",
-           instruction.opcode,
-           instruction.operands[0],
-           instruction.operands[1],
-           instruction.operands[2]);
+void execute_instruction(CPU *cpu, Instruction instruction) {
+    if (cpu->trace_execution) {
+        printf("Executing instruction: Opcode=%02X Operands=%u, %u, %u\n",
+               instruction.opcode,
+               instruction.operands[0],
+               instruction.operands[1],
+               instruction.operands[2]);
+    }
+    if (registers_valid(cpu, instruction)) {
+        execute_verified(cpu, instruction);
+    }
+}
+
+// Execute an instruction whose register operands are known to be valid
+void execute_verified(CPU *cpu, Instruction instruction) {
+    word_t *reg = (word_t *)cpu->registers; // Shortcut to registers
+    uint64_t *perf = cpu->perf_counters;
+    word_t result;
 
-    uint32_t *reg = (uint32_t *)cpu->registers; // Shortcut to registers
-    uint32_t result;
+    perf[PERF_INSTRUCTIONS]++;
 
     switch (instruction.opcode) {
         // Arithmetic Operations
         case ADD:
             reg[instruction.operands[0]] = alu_add(cpu, reg[instruction.operands[1]], reg[instruction.operands[2]]);
             break;
+        case ADDI:
+            reg[instruction.operands[0]] = alu_add(cpu, reg[instruction.operands[1]], (int8_t)instruction.operands[2]);
+            break;
         case SUB:
             reg[instruction.operands[0]] = alu_subtract(cpu, reg[instruction.operands[1]], reg[instruction.operands[2]]);
             break;
@@ -69,6 +382,36 @@ static void execute_instruction(CPU *cpu, Instruction instruction) {
             reg[instruction.operands[0]] = alu_shr(cpu, reg[instruction.operands[1]], instruction.operands[2]);
             break;
 
+        // Bit Manipulation Operations
+        case CLZ:
+            reg[instruction.operands[0]] = alu_clz(cpu, reg[instruction.operands[1]]);
+            break;
+        case CTZ:
+            reg[instruction.operands[0]] = alu_ctz(cpu, reg[instruction.operands[1]]);
+            break;
+        case POPCNT:
+            reg[instruction.operands[0]] = alu_popcnt(cpu, reg[instruction.operands[1]]);
+            break;
+        case ROL:
+            reg[instruction.operands[0]] = alu_rol(cpu, reg[instruction.operands[1]], instruction.operands[2]);
+            break;
+        case ROR:
+            reg[instruction.operands[0]] = alu_ror(cpu, reg[instruction.operands[1]], instruction.operands[2]);
+            break;
+        case BEXT:
+            reg[instruction.operands[0]] = alu_bext(cpu, reg[instruction.operands[1]], reg[instruction.operands[2]]);
+            break;
+        case BINS:
+            reg[instruction.operands[0]] = alu_bins(cpu, reg[instruction.operands[0]], reg[instruction.operands[1]],
+                                                    reg[instruction.operands[2]]);
+            break;
+        case BREV:
+            reg[instruction.operands[0]] = alu_brev(cpu, reg[instruction.operands[1]]);
+            break;
+        case BSWAP:
+            reg[instruction.operands[0]] = alu_bswap(cpu, reg[instruction.operands[1]]);
+            break;
+
         // Comparison Operations
         case EQ:
             result = alu_eq(cpu, reg[instruction.operands[1]], reg[instruction.operands[2]]);
@@ -103,19 +446,21 @@ static void execute_instruction(CPU *cpu, Instruction instruction) {
                 fprintf(stderr, "Error: Memory read out of bounds at address 0x%08X.\n", address);
                 cpu->halted = true;
             } else {
-                cpu->registers[reg] = read_memory(cpu->memory, address);
+                cpu->registers[reg] = load_word(cpu, address);
+                perf[PERF_LOADS]++;
             }
             break;
         }
 
         case STORE: {
-            uint32_t reg_value = cpu->registers[instruction.operands[0]];
+            word_t reg_value = cpu->registers[instruction.operands[0]];
             uint32_t address = instruction.operands[1];
             if (address >= MEMORY_SIZE) {
                 fprintf(stderr, "Error: Memory write out of bounds at address 0x%08X.\n", address);
                 cpu->halted = true;
             } else {
-                write_memory(cpu->memory, address, reg_value);
+                store_word(cpu, address, reg_value);
+                perf[PERF_STORES]++;
             }
             break;
         }
@@ -124,38 +469,317 @@ static void execute_instruction(CPU *cpu, Instruction instruction) {
         // Control Flow
         case JUMP:
             cpu->program_counter = reg[instruction.operands[0]]; // Jump to address in register
+            perf[PERF_BRANCHES]++;
+            break;
+        case BRA:
+            cpu->program_counter += branch_offset(instruction) - cpu->instruction_length;
+            perf[PERF_BRANCHES]++;
+            break;
+        case BZ:
+            if (cpu->flags[FLAG_ZERO])
+                cpu->program_counter += branch_offset(instruction) - cpu->instruction_length;
+            perf[PERF_BRANCHES]++;
+            break;
+        case BNZ:
+            if (!cpu->flags[FLAG_ZERO])
+                cpu->program_counter += branch_offset(instruction) - cpu->instruction_length;
+            perf[PERF_BRANCHES]++;
             break;
         case JZ:
             if (cpu->flags[FLAG_ZERO]) // Zero flag is set
                 cpu->program_counter = reg[instruction.operands[0]];
+            perf[PERF_BRANCHES]++;
             break;
         case JNZ:
             if (!cpu->flags[FLAG_ZERO]) // Zero flag is not set
                 cpu->program_counter = reg[instruction.operands[0]];
+            perf[PERF_BRANCHES]++;
             break;
         case CALL:
-            cpu->stack_pointer -= 4; // Push current PC onto the stack
-            write_memory(cpu->memory, cpu->stack_pointer, cpu->program_counter);
+            cpu->stack_pointer -= WORD_BYTES; // Push current PC onto the stack
+            store_word(cpu, cpu->stack_pointer, cpu->program_counter);
             cpu->program_counter = reg[instruction.operands[0]]; // Jump to address in register
+            perf[PERF_BRANCHES]++;
+            perf[PERF_STORES]++;
             break;
         case RET:
-            cpu->program_counter = read_memory(cpu->memory, cpu->stack_pointer); // Pop return address from the stack
-            cpu->stack_pointer += 4;
+            cpu->program_counter = load_word(cpu, cpu->stack_pointer); // Pop return address from the stack
+            cpu->stack_pointer += WORD_BYTES;
+            perf[PERF_BRANCHES]++;
+            perf[PERF_LOADS]++;
             break;
 
-        // Stack Operations
+        // Register and Stack Operations
+        case MOV:
+            reg[instruction.operands[0]] = reg[instruction.operands[1]];
+            break;
         case PUSH:
-            cpu->stack_pointer -= 4;
-            write_memory(cpu->memory, cpu->stack_pointer, reg[instruction.operands[0]]);
+            cpu->stack_pointer -= WORD_BYTES;
+            store_word(cpu, cpu->stack_pointer, reg[instruction.operands[0]]);
+            perf[PERF_STORES]++;
             break;
         case POP:
-            reg[instruction.operands[0]] = read_memory(cpu->memory, cpu->stack_pointer);
-            cpu->stack_pointer += 4;
+            reg[instruction.operands[0]] = load_word(cpu, cpu->stack_pointer);
+            cpu->stack_pointer += WORD_BYTES;
+            perf[PERF_LOADS]++;
+            break;
+
+        // Performance Counters
+        case RDPERF:
+            if (instruction.operands[1] >= PERF_COUNTER_COUNT || instruction.operands[2] > 1) {
+                fprintf(stderr, "Error: Invalid performance counter %u.%u\n",
+                        instruction.operands[1], instruction.operands[2]);
+                cpu->halted = true;
+            } else {
+                reg[instruction.operands[0]] = (uint32_t)(perf[instruction.operands[1]] >> (32 * instruction.operands[2]));
+            }
+            break;
+
+        // Interrupts
+        case EI:
+            cpu->flags[FLAG_INTERRUPT] = true;
+            if (cpu->interrupts) {
+                update_next_event(cpu->interrupts);
+            }
+            break;
+        case DI:
+            cpu->flags[FLAG_INTERRUPT] = false;
+            break;
+        case IRET:
+            cpu->program_counter = load_word(cpu, cpu->stack_pointer);
+            unpack_flags(cpu, load_word(cpu, cpu->stack_pointer + WORD_BYTES));
+            cpu->stack_pointer += 2 * WORD_BYTES;
+            perf[PERF_BRANCHES]++;
+            perf[PERF_LOADS] += 2;
+            break;
+        case TIMER:
+            if (cpu->interrupts == NULL) {
+                fprintf(stderr, "Error: TIMER without an interrupt controller\n");
+                cpu->halted = true;
+            } else if (set_timer(cpu->interrupts, instruction.operands[0], reg[instruction.operands[1]],
+                                 instruction.operands[2]) != 0) {
+                cpu->halted = true;
+            }
+            break;
+
+        // Bulk Memory Operations
+        case MEMCPY: {
+            uint32_t dst = reg[instruction.operands[0]], src = reg[instruction.operands[1]];
+            uint32_t length = reg[instruction.operands[2]];
+            if (bulk_range(cpu, &dst, length, MMU_WRITE, "MEMCPY") && bulk_range(cpu, &src, length, MMU_READ, "MEMCPY")) {
+                memmove(cpu->memory + dst, cpu->memory + src, length);
+                record_store(cpu, dst, length);
+                perf[PERF_LOADS]++;
+                perf[PERF_STORES]++;
+            }
+            break;
+        }
+        case MEMSET: {
+            uint32_t dst = reg[instruction.operands[0]], length = reg[instruction.operands[2]];
+            if (bulk_range(cpu, &dst, length, MMU_WRITE, "MEMSET")) {
+                memset(cpu->memory + dst, (uint8_t)reg[instruction.operands[1]], length);
+                record_store(cpu, dst, length);
+                perf[PERF_STORES]++;
+            }
+            break;
+        }
+        case MEMCMP: {
+            uint32_t a = reg[instruction.operands[0]], b = reg[instruction.operands[1]];
+            uint32_t length = reg[instruction.operands[2]];
+            if (bulk_range(cpu, &a, length, MMU_READ, "MEMCMP") && bulk_range(cpu, &b, length, MMU_READ, "MEMCMP")) {
+                int order = length ? memcmp(cpu->memory + a, cpu->memory + b, length) : 0;
+                cpu->flags[FLAG_ZERO] = cpu->flags[FLAG_EQUAL] = order == 0;
+                cpu->flags[FLAG_LESS] = order < 0;
+                cpu->flags[FLAG_GREATER] = order > 0;
+                perf[PERF_LOADS]++;
+            }
+            break;
+        }
+
+        // Memory Management
+        case MMUSET:
+            if (require_mmu(cpu, "MMUSET") &&
+                set_mmu_register(cpu->mmu, instruction.operands[1], reg[instruction.operands[0]]) != 0) {
+                cpu->halted = true;
+            }
+            break;
+        case MMUGET:
+            if (!require_mmu(cpu, "MMUGET")) {
+                break;
+            }
+            if (instruction.operands[1] >= MMU_REGISTER_COUNT) {
+                fprintf(stderr, "Error: Invalid MMU register %u\n", instruction.operands[1]);
+                cpu->halted = true;
+            } else {
+                reg[instruction.operands[0]] = cpu->mmu->registers[instruction.operands[1]];
+            }
+            break;
+        case TLBFLUSH:
+            if (!require_mmu(cpu, "TLBFLUSH")) {
+                break;
+            }
+            if (instruction.operands[1]) {
+                flush_tlb_page(cpu->mmu, reg[instruction.operands[0]]);
+            } else {
+                flush_tlb(cpu->mmu);
+            }
+            break;
+
+        // Vector Operations
+        case VLOAD: {
+            int32_t *vd = vector_register(cpu, instruction.operands[0]);
+            uint32_t address = reg[instruction.operands[1]];
+            if (vd && bulk_range(cpu, &address, sizeof(cpu->vectors[0]), MMU_READ, "VLOAD")) {
+                memcpy(vd, cpu->memory + address, sizeof(cpu->vectors[0]));
+                perf[PERF_LOADS]++;
+            }
+            break;
+        }
+        case VSTORE: {
+            int32_t *vs = vector_register(cpu, instruction.operands[0]);
+            uint32_t address = reg[instruction.operands[1]];
+            if (vs && bulk_range(cpu, &address, sizeof(cpu->vectors[0]), MMU_WRITE, "VSTORE")) {
+                memcpy(cpu->memory + address, vs, sizeof(cpu->vectors[0]));
+                record_store(cpu, address, sizeof(cpu->vectors[0]));
+                perf[PERF_STORES]++;
+            }
+            break;
+        }
+        case VSPLAT: {
+            int32_t *vd = vector_register(cpu, instruction.operands[0]);
+            if (vd) {
+                vector_splat(vd, (int32_t)reg[instruction.operands[1]]);
+            }
+            break;
+        }
+        case VADD:
+        case VSUB:
+        case VMUL:
+        case VAND:
+        case VOR:
+        case VXOR:
+        case VCMPEQ:
+        case VCMPGT: {
+            int32_t *vd = vector_register(cpu, instruction.operands[0]);
+            int32_t *va = vector_register(cpu, instruction.operands[1]);
+            int32_t *vb = vector_register(cpu, instruction.operands[2]);
+            if (vd && va && vb) {
+                vector_binary(instruction.opcode, vd, va, vb);
+            }
+            break;
+        }
+        case VSHUF: {
+            int32_t *vd = vector_register(cpu, instruction.operands[0]);
+            int32_t *va = vector_register(cpu, instruction.operands[1]);
+            if (vd && va) {
+                vector_shuffle(vd, va, (uint8_t)instruction.operands[2]);
+            }
+            break;
+        }
+        case VREDUCE: {
+            int32_t *va = vector_register(cpu, instruction.operands[1]);
+            if (va) {
+                reg[instruction.operands[0]] = (word_t)(sword_t)vector_reduce(va);
+            }
+            break;
+        }
+
+        // Floating-Point Operations
+        case FLDS:
+        case FLDD: {
+            uint64_t *fd = fp_register(cpu, instruction.operands[0]);
+            uint32_t address = reg[instruction.operands[1]];
+            uint32_t size = instruction.opcode == FLDS ? sizeof(uint32_t) : sizeof(uint64_t);
+            if (fd && bulk_range(cpu, &address, size, MMU_READ, size == sizeof(uint32_t) ? "FLDS" : "FLDD")) {
+                *fd = 0;
+                memcpy(fd, cpu->memory + address, size);
+                perf[PERF_LOADS]++;
+            }
+            break;
+        }
+        case FSTS:
+        case FSTD: {
+            uint64_t *fs = fp_register(cpu, instruction.operands[0]);
+            uint32_t address = reg[instruction.operands[1]];
+            uint32_t size = instruction.opcode == FSTS ? sizeof(uint32_t) : sizeof(uint64_t);
+            if (fs && bulk_range(cpu, &address, size, MMU_WRITE, size == sizeof(uint32_t) ? "FSTS" : "FSTD")) {
+                memcpy(cpu->memory + address, fs, size);
+                record_store(cpu, address, size);
+                perf[PERF_STORES]++;
+            }
+            break;
+        }
+        case FADDS:
+        case FSUBS:
+        case FMULS:
+        case FDIVS:
+        case FSQRTS:
+        case FMADDS:
+        case FADDD:
+        case FSUBD:
+        case FMULD:
+        case FDIVD:
+        case FSQRTD:
+        case FMADDD:
+        case FCVTSD:
+        case FCVTDS: {
+            // Unary forms ignore the third operand, which is F0
+            uint64_t *fd = fp_register(cpu, instruction.operands[0]);
+            uint64_t *fa = fp_register(cpu, instruction.operands[1]);
+            uint64_t *fb = fp_register(cpu, instruction.operands[2]);
+            if (fd && fa && fb) {
+                *fd = fpu_execute(cpu, instruction.opcode, *fa, *fb, *fd);
+            }
+            break;
+        }
+        case FCMPS:
+        case FCMPD: {
+            uint64_t *fa = fp_register(cpu, instruction.operands[1]);
+            uint64_t *fb = fp_register(cpu, instruction.operands[2]);
+            if (fa && fb) {
+                int32_t order = (int32_t)fpu_execute(cpu, instruction.opcode, *fa, *fb, 0);
+                reg[instruction.operands[0]] = (word_t)(sword_t)order;
+                cpu->flags[FLAG_ZERO] = cpu->flags[FLAG_EQUAL] = order == 0;
+                cpu->flags[FLAG_LESS] = order == -1;
+                cpu->flags[FLAG_GREATER] = order == 1;
+            }
+            break;
+        }
+        case FCVTSW:
+        case FCVTDW: {
+            uint64_t *fd = fp_register(cpu, instruction.operands[0]);
+            if (fd) {
+                *fd = fpu_execute(cpu, instruction.opcode, reg[instruction.operands[1]], 0, 0);
+            }
+            break;
+        }
+        case FCVTWS:
+        case FCVTWD: {
+            uint64_t *fs = fp_register(cpu, instruction.operands[1]);
+            if (fs) {
+                reg[instruction.operands[0]] = (word_t)(sword_t)(int32_t)fpu_execute(cpu, instruction.opcode, *fs, 0, 0);
+            }
+            break;
+        }
+        case FPFLAGS:
+            reg[instruction.operands[0]] = fpu_flags(cpu);
+            if (instruction.operands[1]) {
+                fpu_set_flags(cpu, 0);
+            }
+            break;
+
+        // Host Calls
+        case SYSCALL:
+            host_call(cpu, instruction.operands[0]);
             break;
 
         // System Operations
+        case NOP:
+            break;
         case HALT:
-            printf("HALT instruction executed. Stopping CPU.\n");
+            if (cpu->trace_execution) {
+                printf("HALT instruction executed. Stopping CPU.\n");
+            }
             cpu->halted = true;
             break;
 
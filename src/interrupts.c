@@ -0,0 +1,233 @@
+#include "interrupts.h"
+#include "instructions.h"
+#include "memory.h"
+#include "mmu.h"
+#include <stdio.h>
+#include <string.h>
+
+// Initialize a controller and attach it to the CPU
+void init_interrupts(InterruptController *pic, CPU *cpu) {
+    memset(pic, 0, sizeof(*pic));
+    pic->cpu = cpu;
+    cpu->interrupts = pic;
+    update_next_event(pic);
+}
+
+// Heap order: earlier deadline first, FIFO among equal deadlines
+static bool event_before(const Event *a, const Event *b) {
+    return a->when < b->when || (a->when == b->when && a->sequence < b->sequence);
+}
+
+static void sift_up(InterruptController *pic, int index) {
+    Event event = pic->events[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!event_before(&event, &pic->events[parent])) {
+            break;
+        }
+        pic->events[index] = pic->events[parent];
+        index = parent;
+    }
+    pic->events[index] = event;
+}
+
+static void sift_down(InterruptController *pic, int index) {
+    Event event = pic->events[index];
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= pic->event_count) {
+            break;
+        }
+        if (child + 1 < pic->event_count && event_before(&pic->events[child + 1], &pic->events[child])) {
+            child++;
+        }
+        if (!event_before(&pic->events[child], &event)) {
+            break;
+        }
+        pic->events[index] = pic->events[child];
+        index = child;
+    }
+    pic->events[index] = event;
+}
+
+// Schedule a device event
+int schedule_event(InterruptController *pic, uint64_t when, EventHandler handler, void *context) {
+    if (pic->event_count == MAX_EVENTS) {
+        fprintf(stderr, "Error: Device event queue is full\n");
+        return -1;
+    }
+
+    Event *event = &pic->events[pic->event_count];
+    event->when = when;
+    event->sequence = pic->sequence++;
+    event->handler = handler;
+    event->context = context;
+    sift_up(pic, pic->event_count++);
+    update_next_event(pic);
+    return 0;
+}
+
+// Remove all events of one device and restore the heap
+void cancel_events(InterruptController *pic, void *context) {
+    int kept = 0;
+    for (int i = 0; i < pic->event_count; i++) {
+        if (pic->events[i].context != context) {
+            pic->events[kept++] = pic->events[i];
+        }
+    }
+    pic->event_count = kept;
+    for (int i = kept / 2 - 1; i >= 0; i--) {
+        sift_down(pic, i);
+    }
+    update_next_event(pic);
+}
+
+// Mark a line pending
+void raise_interrupt(InterruptController *pic, int line) {
+    if (line < 0 || line >= INTERRUPT_LINES) {
+        fprintf(stderr, "Error: Invalid interrupt line %d\n", line);
+        return;
+    }
+    pic->pending |= 1u << line;
+    update_next_event(pic);
+}
+
+// Timer expiry: raise the line and schedule the next period
+static void timer_expired(InterruptController *pic, void *context) {
+    Timer *timer = context;
+    timer->fired++;
+    raise_interrupt(pic, timer->line);
+    timer->deadline += timer->period;
+    schedule_event(pic, timer->deadline, timer_expired, timer);
+}
+
+// Arm or disarm a timer
+int set_timer(InterruptController *pic, int timer, uint32_t period, int line) {
+    if (timer < 0 || timer >= TIMER_COUNT || line < 0 || line >= INTERRUPT_LINES) {
+        fprintf(stderr, "Error: Invalid timer %d or interrupt line %d\n", timer, line);
+        return -1;
+    }
+
+    Timer *t = &pic->timers[timer];
+    cancel_events(pic, t);
+    t->period = period;
+    t->line = line;
+    if (period == 0) {
+        return 0;
+    }
+    t->deadline = pic->cpu->perf_counters[PERF_INSTRUCTIONS] + period;
+    return schedule_event(pic, t->deadline, timer_expired, t);
+}
+
+// The CPU must call back now if an interrupt is deliverable, else at the next event
+void update_next_event(InterruptController *pic) {
+    CPU *cpu = pic->cpu;
+    if (pic->pending && cpu->flags[FLAG_INTERRUPT]) {
+        cpu->next_event = 0;
+    } else {
+        cpu->next_event = pic->event_count ? pic->events[0].when : NO_EVENT;
+    }
+}
+
+// Push the flags and PC and enter the handler of a line
+static void enter_interrupt(InterruptController *pic, int line) {
+    CPU *cpu = pic->cpu;
+    uint32_t handler = read_memory(cpu->memory, INTERRUPT_VECTOR_BASE + line * sizeof(uint32_t));
+    if (handler == 0) {
+        fprintf(stderr, "Error: No handler for interrupt %d\n", line);
+        cpu->halted = true;
+        return;
+    }
+
+    pic->pending &= ~(1u << line);
+    pic->delivered[line]++;
+
+    cpu->stack_pointer -= WORD_BYTES;
+    store_word(cpu, cpu->stack_pointer, pack_flags(cpu));
+    cpu->stack_pointer -= WORD_BYTES;
+    store_word(cpu, cpu->stack_pointer, cpu->program_counter);
+    if (cpu->paging && cpu->mmu->fault_pending) {
+        fprintf(stderr, "Error: Page fault on 0x%X entering the handler of interrupt %d\n",
+                cpu->mmu->registers[MMU_REG_FAULT_ADDRESS], line);
+        cpu->halted = true;
+        return;
+    }
+
+    cpu->flags[FLAG_INTERRUPT] = false;
+    cpu->program_counter = handler;
+}
+
+// Run due events, then deliver the highest-priority pending line
+bool service_interrupts(CPU *cpu) {
+    InterruptController *pic = cpu->interrupts;
+    if (pic == NULL) {
+        cpu->next_event = NO_EVENT;
+        return false;
+    }
+
+    uint64_t now = cpu->perf_counters[PERF_INSTRUCTIONS];
+    while (pic->event_count && pic->events[0].when <= now) {
+        Event event = pic->events[0];
+        pic->events[0] = pic->events[--pic->event_count];
+        if (pic->event_count) {
+            sift_down(pic, 0);
+        }
+        event.handler(pic, event.context);
+    }
+
+    bool delivered = false;
+    if (pic->pending && cpu->flags[FLAG_INTERRUPT]) {
+        enter_interrupt(pic, __builtin_ctz(pic->pending));
+        delivered = true;
+    }
+    update_next_event(pic);
+    return delivered;
+}
+
+// Pack the flags into one bit each
+uint32_t pack_flags(const CPU *cpu) {
+    uint32_t value = 0;
+    for (int i = 0; i < 16; i++) {
+        value |= (uint32_t)cpu->flags[i] << i;
+    }
+    return value;
+}
+
+// Restore the flags; re-enabling interrupts may make one deliverable
+void unpack_flags(CPU *cpu, uint32_t value) {
+    for (int i = 0; i < 16; i++) {
+        cpu->flags[i] = (value >> i) & 1;
+    }
+    if (cpu->interrupts) {
+        update_next_event(cpu->interrupts);
+    }
+}
+
+// Display delivery counts and timers
+void display_interrupts(const InterruptController *pic) {
+    bool active = pic->pending != 0;
+    for (int i = 0; i < INTERRUPT_LINES; i++) {
+        active |= pic->delivered[i] != 0;
+    }
+    for (int i = 0; i < TIMER_COUNT; i++) {
+        active |= pic->timers[i].period != 0 || pic->timers[i].fired != 0;
+    }
+    if (!active) {
+        return;
+    }
+
+    printf("\n=== Interrupts ===\n");
+    for (int line = 0; line < INTERRUPT_LINES; line++) {
+        if (pic->delivered[line] || (pic->pending >> line & 1)) {
+            printf("IRQ %d: %llu delivered%s\n", line, (unsigned long long)pic->delivered[line],
+                   (pic->pending >> line & 1) ? ", pending" : "");
+        }
+    }
+    for (int i = 0; i < TIMER_COUNT; i++) {
+        const Timer *timer = &pic->timers[i];
+        if (timer->period || timer->fired) {
+            printf("Timer %d: period %u -> IRQ %d, fired %llu times\n", i, timer->period, timer->line,
+                   (unsigned long long)timer->fired);
+        }
+    }
+}
@@ -0,0 +1,686 @@
+#include "ir.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Grow a dynamic array to hold at least count + 1 elements
+static void *grow(void *array, int *capacity, int count, size_t element) {
+    if (count < *capacity) {
+        return array;
+    }
+    int wanted = *capacity ? *capacity * 2 : 8;
+    void *grown = realloc(array, (size_t)wanted * element);
+    if (!grown) {
+        abort();    // The compiler's inputs are small; running out of memory is fatal
+    }
+    *capacity = wanted;
+    return grown;
+}
+
+void ir_init_program(IRProgram *program) {
+    memset(program, 0, sizeof(*program));
+    program->direct_bytes = WORD_BYTES;     // Scratch word at address 0
+}
+
+void ir_free_program(IRProgram *program) {
+    for (int i = 0; i < program->symbol_count; i++) {
+        free(program->symbols[i].data);
+    }
+    free(program->symbols);
+    program->symbols = NULL;
+    program->symbol_count = 0;
+}
+
+int ir_find_symbol(const IRProgram *program, const char *name) {
+    for (int i = 0; i < program->symbol_count; i++) {
+        if (strcmp(program->symbols[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return IR_NONE;
+}
+
+int ir_add_symbol(IRProgram *program, const char *name, bool function) {
+    program->symbols = grow(program->symbols, &program->symbol_capacity, program->symbol_count, sizeof(IRSymbol));
+    IRSymbol *symbol = &program->symbols[program->symbol_count];
+    memset(symbol, 0, sizeof(*symbol));
+    snprintf(symbol->name, sizeof(symbol->name), "%s", name);
+    symbol->function = function;
+    return program->symbol_count++;
+}
+
+void ir_init_function(IRFunction *fn, int symbol) {
+    memset(fn, 0, sizeof(*fn));
+    fn->symbol = symbol;
+    int entry = ir_new_block(fn);
+    fn->blocks[entry].sealed = true;
+}
+
+void ir_free_function(IRFunction *fn) {
+    for (int i = 0; i < fn->instr_count; i++) {
+        free(fn->instrs[i].args);
+    }
+    for (int i = 0; i < fn->block_count; i++) {
+        free(fn->blocks[i].instrs);
+        free(fn->blocks[i].preds);
+    }
+    free(fn->instrs);
+    free(fn->blocks);
+    memset(fn, 0, sizeof(*fn));
+}
+
+int ir_new_block(IRFunction *fn) {
+    fn->blocks = grow(fn->blocks, &fn->block_capacity, fn->block_count, sizeof(IRBlock));
+    memset(&fn->blocks[fn->block_count], 0, sizeof(IRBlock));
+    return fn->block_count++;
+}
+
+// Create an instruction outside any block's list
+static int new_instr(IRFunction *fn, int block, IROp op, int a, int b) {
+    fn->instrs = grow(fn->instrs, &fn->instr_capacity, fn->instr_count, sizeof(IRInstr));
+    IRInstr *instr = &fn->instrs[fn->instr_count];
+    memset(instr, 0, sizeof(*instr));
+    instr->op = op;
+    instr->block = block;
+    instr->a = a;
+    instr->b = b;
+    instr->symbol = IR_NONE;
+    instr->target[0] = instr->target[1] = IR_NONE;
+    instr->replaced = IR_NONE;
+    return fn->instr_count++;
+}
+
+// Insert a value into a block's list at a position
+static void insert_at(IRFunction *fn, int block, int index, int value) {
+    IRBlock *b = &fn->blocks[block];
+    b->instrs = grow(b->instrs, &b->capacity, b->count, sizeof(int));
+    memmove(b->instrs + index + 1, b->instrs + index, (size_t)(b->count - index) * sizeof(int));
+    b->instrs[index] = value;
+    b->count++;
+}
+
+// Drop a value from its block's list and mark it dead
+static void remove_instr(IRFunction *fn, int value) {
+    IRInstr *instr = &fn->instrs[value];
+    IRBlock *b = &fn->blocks[instr->block];
+    for (int i = 0; i < b->count; i++) {
+        if (b->instrs[i] == value) {
+            memmove(b->instrs + i, b->instrs + i + 1, (size_t)(b->count - i - 1) * sizeof(int));
+            b->count--;
+            break;
+        }
+    }
+    instr->dead = true;
+}
+
+bool ir_terminated(const IRFunction *fn, int block) {
+    const IRBlock *b = &fn->blocks[block];
+    if (b->count == 0) {
+        return false;
+    }
+    IROp op = fn->instrs[b->instrs[b->count - 1]].op;
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RET;
+}
+
+int ir_append(IRFunction *fn, int block, IROp op, int a, int b) {
+    if (ir_terminated(fn, block)) {
+        return IR_NONE;
+    }
+    int value = new_instr(fn, block, op, a, b);
+    if (op == IR_PARAM) {
+        // Parameters lead the entry block, in order
+        int index = 0;
+        while (index < fn->blocks[block].count && fn->instrs[fn->blocks[block].instrs[index]].op == IR_PARAM) {
+            index++;
+        }
+        insert_at(fn, block, index, value);
+    } else {
+        insert_at(fn, block, fn->blocks[block].count, value);
+    }
+    return value;
+}
+
+// Find or create an operand-less value at the start of the entry block,
+// after the parameters
+static int entry_value(IRFunction *fn, IROp op, sword_t imm, int symbol) {
+    IRBlock *entry = &fn->blocks[0];
+    int index = 0;
+    for (; index < entry->count; index++) {
+        IRInstr *instr = &fn->instrs[entry->instrs[index]];
+        if (instr->op == op && instr->imm == imm && instr->symbol == symbol) {
+            return entry->instrs[index];
+        }
+        if (instr->op != IR_PARAM && instr->op != IR_CONST && instr->op != IR_ADDRESS) {
+            break;
+        }
+    }
+    int value = new_instr(fn, 0, op, IR_NONE, IR_NONE);
+    fn->instrs[value].imm = imm;
+    fn->instrs[value].symbol = symbol;
+    insert_at(fn, 0, index, value);
+    return value;
+}
+
+int ir_const(IRFunction *fn, sword_t value) {
+    return entry_value(fn, IR_CONST, value, IR_NONE);
+}
+
+int ir_address(IRFunction *fn, int symbol) {
+    return entry_value(fn, IR_ADDRESS, 0, symbol);
+}
+
+int ir_phi(IRFunction *fn, int block) {
+    int value = new_instr(fn, block, IR_PHI, IR_NONE, IR_NONE);
+    insert_at(fn, block, 0, value);
+    return value;
+}
+
+void ir_add_arg(IRFunction *fn, int value, int operand) {
+    IRInstr *instr = &fn->instrs[value];
+    int *args = realloc(instr->args, (size_t)(instr->arg_count + 1) * sizeof(int));
+    if (!args) {
+        abort();
+    }
+    instr->args = args;
+    instr->args[instr->arg_count++] = operand;
+}
+
+// Record pred as a predecessor of block
+static void add_pred(IRFunction *fn, int block, int pred) {
+    IRBlock *b = &fn->blocks[block];
+    b->preds = grow(b->preds, &b->pred_capacity, b->pred_count, sizeof(int));
+    b->preds[b->pred_count++] = pred;
+}
+
+void ir_jump(IRFunction *fn, int block, int target) {
+    int value = ir_append(fn, block, IR_JUMP, IR_NONE, IR_NONE);
+    if (value != IR_NONE) {
+        fn->instrs[value].target[0] = target;
+        add_pred(fn, target, block);
+    }
+}
+
+void ir_branch(IRFunction *fn, int block, int condition, int if_true, int if_false) {
+    int value = ir_append(fn, block, IR_BRANCH, condition, IR_NONE);
+    if (value != IR_NONE) {
+        fn->instrs[value].target[0] = if_true;
+        fn->instrs[value].target[1] = if_false;
+        add_pred(fn, if_true, block);
+        add_pred(fn, if_false, block);
+    }
+}
+
+int ir_resolve(const IRFunction *fn, int value) {
+    while (value != IR_NONE && fn->instrs[value].replaced != IR_NONE) {
+        value = fn->instrs[value].replaced;
+    }
+    return value;
+}
+
+bool ir_is_const(const IRFunction *fn, int value, sword_t *constant) {
+    value = ir_resolve(fn, value);
+    if (value == IR_NONE || fn->instrs[value].op != IR_CONST) {
+        return false;
+    }
+    if (constant) {
+        *constant = fn->instrs[value].imm;
+    }
+    return true;
+}
+
+// Point a value's users at its replacement
+static void replace(IRFunction *fn, int value, int by) {
+    if (!fn->instrs[value].dead) {
+        remove_instr(fn, value);
+    }
+    fn->instrs[value].replaced = by;
+}
+
+int ir_remove_trivial_phi(IRFunction *fn, int phi) {
+    int same = IR_NONE;
+    for (int i = 0; i < fn->instrs[phi].arg_count; i++) {
+        int operand = ir_resolve(fn, fn->instrs[phi].args[i]);
+        if (operand == same || operand == phi) {
+            continue;
+        }
+        if (same != IR_NONE) {
+            return phi;     // Merges two different values
+        }
+        same = operand;
+    }
+    if (same == IR_NONE) {
+        same = ir_const(fn, 0);     // Never assigned: read as 0
+    }
+    replace(fn, phi, same);
+    return same;
+}
+
+// Evaluate an operation on constants as the ALU would; false if it must be
+// left to run time (division by zero halts there)
+static bool fold(IROp op, sword_t a, sword_t b, sword_t imm, sword_t *result) {
+    word_t ua = (word_t)a, ub = (word_t)b;
+    switch (op) {
+        case IR_ADD: *result = (sword_t)(ua + ub); return true;
+        case IR_SUB: *result = (sword_t)(ua - ub); return true;
+        case IR_MUL: *result = (sword_t)(ua * ub); return true;
+        case IR_DIV:
+            if (b == 0 || b == -1) {
+                return false;
+            }
+            *result = a / b;
+            return true;
+        case IR_AND: *result = a & b; return true;
+        case IR_OR: *result = a | b; return true;
+        case IR_XOR: *result = a ^ b; return true;
+        case IR_EQ: *result = a == b; return true;
+        case IR_NE: *result = a != b; return true;
+        case IR_LT: *result = a < b; return true;
+        case IR_GT: *result = a > b; return true;
+        case IR_LE: *result = a <= b; return true;
+        case IR_GE: *result = a >= b; return true;
+        case IR_NOT: *result = ~a; return true;
+        case IR_ADDI: *result = (sword_t)(ua + (word_t)imm); return true;
+        case IR_SHL: *result = (sword_t)(ua << imm); return true;
+        case IR_SHR: *result = (sword_t)(ua >> imm); return true;
+        case IR_SAR: *result = a >> imm; return true;
+        default: return false;
+    }
+}
+
+// True for operations simplify understands
+static bool is_operation(IROp op) {
+    return op >= IR_ADD && op <= IR_SAR;
+}
+
+static bool is_unary(IROp op) {
+    return op >= IR_NOT && op <= IR_SAR;
+}
+
+// Find an existing value equal to op(a, b), or rewrite the operation into a
+// cheaper one in place; returns IR_NONE if no existing value will do
+static int simplify(IRFunction *fn, IROp *op, int *a, int *b, sword_t *imm) {
+    sword_t x, y, result;
+    bool ca = ir_is_const(fn, *a, &x);
+    bool cb = !is_unary(*op) && ir_is_const(fn, *b, &y);
+    if (ca && (cb || is_unary(*op)) && fold(*op, x, cb ? y : 0, *imm, &result)) {
+        return ir_const(fn, result);
+    }
+
+    // Put a constant second in commutative operations
+    if (ca && !cb && (*op == IR_ADD || *op == IR_MUL || *op == IR_AND || *op == IR_OR || *op == IR_XOR ||
+                      *op == IR_EQ || *op == IR_NE)) {
+        int swap = *a;
+        *a = *b;
+        *b = swap;
+        y = x;
+        cb = true;
+    }
+
+    switch (*op) {
+        case IR_ADD:
+            if (cb && y == 0) {
+                return *a;
+            }
+            if (cb && y >= -128 && y <= 127) {
+                *op = IR_ADDI;
+                *imm = y;
+            }
+            break;
+        case IR_SUB:
+            if (cb && y == 0) {
+                return *a;
+            }
+            if (*a == *b) {
+                return ir_const(fn, 0);
+            }
+            if (cb && y >= -127 && y <= 128) {
+                *op = IR_ADDI;
+                *imm = -y;
+            }
+            break;
+        case IR_MUL:
+            if (cb && y == 1) {
+                return *a;
+            }
+            if (cb && y == 0) {
+                return ir_const(fn, 0);
+            }
+            if (cb && y > 0 && (y & (y - 1)) == 0) {
+                int shift = 0;
+                while (((sword_t)1 << shift) != y) {
+                    shift++;
+                }
+                *op = IR_SHL;
+                *imm = shift;
+            }
+            break;
+        case IR_DIV:
+            if (cb && y == 1) {
+                return *a;
+            }
+            break;
+        case IR_AND:
+            if (cb && y == 0) {
+                return ir_const(fn, 0);
+            }
+            if (*a == *b || (cb && y == -1)) {
+                return *a;
+            }
+            break;
+        case IR_OR:
+            if ((cb && y == 0) || *a == *b) {
+                return *a;
+            }
+            break;
+        case IR_XOR:
+            if (cb && y == 0) {
+                return *a;
+            }
+            if (*a == *b) {
+                return ir_const(fn, 0);
+            }
+            break;
+        case IR_EQ: case IR_LE: case IR_GE:
+            if (*a == *b) {
+                return ir_const(fn, 1);
+            }
+            break;
+        case IR_NE: case IR_LT: case IR_GT:
+            if (*a == *b) {
+                return ir_const(fn, 0);
+            }
+            break;
+        case IR_ADDI: {
+            if (*imm == 0) {
+                return *a;
+            }
+            // Merge ADDI chains while the sum still fits
+            IRInstr *inner = &fn->instrs[*a];
+            if (inner->op == IR_ADDI && inner->imm + *imm >= -128 && inner->imm + *imm <= 127) {
+                *imm += inner->imm;
+                *a = ir_resolve(fn, inner->a);
+                if (*imm == 0) {
+                    return *a;
+                }
+            }
+            break;
+        }
+        case IR_SHL: case IR_SHR: case IR_SAR:
+            if (*imm == 0) {
+                return *a;
+            }
+            break;
+        default:
+            break;
+    }
+    if (is_unary(*op)) {
+        *b = IR_NONE;
+    }
+    return IR_NONE;
+}
+
+int ir_operation(IRFunction *fn, int block, IROp op, int a, int b, sword_t imm) {
+    a = ir_resolve(fn, a);
+    b = ir_resolve(fn, b);
+    int existing = simplify(fn, &op, &a, &b, &imm);
+    if (existing != IR_NONE) {
+        return existing;
+    }
+    int value = ir_append(fn, block, op, a, b);
+    if (value != IR_NONE) {
+        fn->instrs[value].imm = imm;
+    }
+    return value;
+}
+
+// Point every operand at its current value
+static void resolve_operands(IRFunction *fn) {
+    for (int v = 0; v < fn->instr_count; v++) {
+        IRInstr *instr = &fn->instrs[v];
+        if (instr->dead) {
+            continue;
+        }
+        instr->a = ir_resolve(fn, instr->a);
+        instr->b = ir_resolve(fn, instr->b);
+        for (int i = 0; i < instr->arg_count; i++) {
+            instr->args[i] = ir_resolve(fn, instr->args[i]);
+        }
+    }
+}
+
+// Fold, simplify and drop trivial phis throughout the function
+static bool simplify_instructions(IRFunction *fn) {
+    bool changed = false;
+    for (int v = 0; v < fn->instr_count; v++) {
+        IRInstr *instr = &fn->instrs[v];
+        if (instr->dead) {
+            continue;
+        }
+        if (instr->op == IR_PHI) {
+            changed |= ir_remove_trivial_phi(fn, v) != v;
+        } else if (is_operation(instr->op)) {
+            IROp op = instr->op;
+            int a = ir_resolve(fn, instr->a), b = ir_resolve(fn, instr->b);
+            sword_t imm = instr->imm;
+            int existing = simplify(fn, &op, &a, &b, &imm);
+            instr = &fn->instrs[v];     // simplify may have grown the array
+            if (existing != IR_NONE) {
+                replace(fn, v, existing);
+                changed = true;
+            } else if (op != instr->op || a != instr->a || b != instr->b || imm != instr->imm) {
+                instr->op = op;
+                instr->a = a;
+                instr->b = b;
+                instr->imm = imm;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Remove the first from -> to edge and the matching phi operands
+static void remove_edge(IRFunction *fn, int from, int to) {
+    IRBlock *b = &fn->blocks[to];
+    int k = 0;
+    while (k < b->pred_count && b->preds[k] != from) {
+        k++;
+    }
+    if (k == b->pred_count) {
+        return;
+    }
+    memmove(b->preds + k, b->preds + k + 1, (size_t)(b->pred_count - k - 1) * sizeof(int));
+    b->pred_count--;
+    for (int i = 0; i < b->count; i++) {
+        IRInstr *phi = &fn->instrs[b->instrs[i]];
+        if (phi->op != IR_PHI) {
+            break;
+        }
+        if (k < phi->arg_count) {
+            memmove(phi->args + k, phi->args + k + 1, (size_t)(phi->arg_count - k - 1) * sizeof(int));
+            phi->arg_count--;
+        }
+    }
+}
+
+// Terminator of a block, or IR_NONE
+static int terminator(const IRFunction *fn, int block) {
+    return ir_terminated(fn, block) ? fn->blocks[block].instrs[fn->blocks[block].count - 1] : IR_NONE;
+}
+
+// Turn branches on constants, or to one block both ways, into jumps
+static bool fold_branches(IRFunction *fn) {
+    bool changed = false;
+    for (int block = 0; block < fn->block_count; block++) {
+        int t = terminator(fn, block);
+        if (t == IR_NONE || fn->instrs[t].op != IR_BRANCH) {
+            continue;
+        }
+        IRInstr *branch = &fn->instrs[t];
+        sword_t condition;
+        int taken;
+        if (branch->target[0] == branch->target[1]) {
+            taken = branch->target[0];
+        } else if (ir_is_const(fn, branch->a, &condition)) {
+            taken = branch->target[condition ? 0 : 1];
+        } else {
+            continue;
+        }
+        remove_edge(fn, block, branch->target[0] == taken ? branch->target[1] : branch->target[0]);
+        branch->op = IR_JUMP;
+        branch->a = IR_NONE;
+        branch->target[0] = taken;
+        branch->target[1] = IR_NONE;
+        changed = true;
+    }
+    return changed;
+}
+
+// Empty every block the entry cannot reach
+static bool remove_unreachable(IRFunction *fn) {
+    bool *reached = calloc((size_t)fn->block_count, sizeof(bool));
+    int *stack = malloc((size_t)fn->block_count * sizeof(int));
+    if (!reached || !stack) {
+        abort();
+    }
+    int depth = 0;
+    reached[0] = true;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int t = terminator(fn, stack[--depth]);
+        for (int i = 0; t != IR_NONE && i < 2; i++) {
+            int target = fn->instrs[t].target[i];
+            if (target != IR_NONE && !reached[target]) {
+                reached[target] = true;
+                stack[depth++] = target;
+            }
+        }
+    }
+
+    bool changed = false;
+    for (int block = 0; block < fn->block_count; block++) {
+        if (reached[block] || fn->blocks[block].count == 0) {
+            continue;
+        }
+        int t = terminator(fn, block);
+        for (int i = 0; t != IR_NONE && i < 2; i++) {
+            if (fn->instrs[t].target[i] != IR_NONE) {
+                remove_edge(fn, block, fn->instrs[t].target[i]);
+            }
+        }
+        IRBlock *b = &fn->blocks[block];
+        for (int i = 0; i < b->count; i++) {
+            fn->instrs[b->instrs[i]].dead = true;
+        }
+        b->count = 0;
+        b->pred_count = 0;
+        changed = true;
+    }
+    free(reached);
+    free(stack);
+    return changed;
+}
+
+// Instructions kept even when their value is unused
+static bool has_effect(const IRFunction *fn, const IRInstr *instr) {
+    sword_t divisor;
+    switch (instr->op) {
+        case IR_STORE: case IR_STOREG: case IR_CALL: case IR_SYSCALL:
+        case IR_JUMP: case IR_BRANCH: case IR_RET:
+            return true;
+        case IR_DIV:
+            return !ir_is_const(fn, instr->b, &divisor) || divisor == 0;
+        default:
+            return false;
+    }
+}
+
+// Remove instructions no effect depends on
+static bool remove_dead_code(IRFunction *fn) {
+    bool *live = calloc((size_t)fn->instr_count, sizeof(bool));
+    int *work = malloc((size_t)fn->instr_count * sizeof(int));
+    if (!live || !work) {
+        abort();
+    }
+    int count = 0;
+    for (int v = 0; v < fn->instr_count; v++) {
+        if (!fn->instrs[v].dead && has_effect(fn, &fn->instrs[v])) {
+            live[v] = true;
+            work[count++] = v;
+        }
+    }
+    while (count > 0) {
+        const IRInstr *instr = &fn->instrs[work[--count]];
+        int operands[2] = {instr->a, instr->b};
+        for (int i = 0; i < 2 + instr->arg_count; i++) {
+            int operand = ir_resolve(fn, i < 2 ? operands[i] : instr->args[i - 2]);
+            if (operand != IR_NONE && !live[operand]) {
+                live[operand] = true;
+                work[count++] = operand;
+            }
+        }
+    }
+
+    bool changed = false;
+    for (int block = 0; block < fn->block_count; block++) {
+        IRBlock *b = &fn->blocks[block];
+        int kept = 0;
+        for (int i = 0; i < b->count; i++) {
+            if (live[b->instrs[i]]) {
+                b->instrs[kept++] = b->instrs[i];
+            } else {
+                fn->instrs[b->instrs[i]].dead = true;
+                changed = true;
+            }
+        }
+        b->count = kept;
+    }
+    free(live);
+    free(work);
+    return changed;
+}
+
+// Give every branch edge into a block with phis a block of its own, so the
+// code generator can place phi moves at the end of the predecessor
+static void split_critical_edges(IRFunction *fn) {
+    int blocks = fn->block_count;
+    for (int block = 0; block < blocks; block++) {
+        int t = terminator(fn, block);
+        if (t == IR_NONE || fn->instrs[t].op != IR_BRANCH) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            int target = fn->instrs[t].target[i];
+            IRBlock *s = &fn->blocks[target];
+            if (s->pred_count < 2 || s->count == 0 || fn->instrs[s->instrs[0]].op != IR_PHI) {
+                continue;
+            }
+            int split = ir_new_block(fn);
+            fn->blocks[split].sealed = true;
+            int jump = new_instr(fn, split, IR_JUMP, IR_NONE, IR_NONE);
+            fn->instrs[jump].target[0] = target;
+            insert_at(fn, split, 0, jump);
+            add_pred(fn, split, block);
+            s = &fn->blocks[target];
+            for (int k = 0; k < s->pred_count; k++) {
+                if (s->preds[k] == block) {
+                    s->preds[k] = split;
+                    break;
+                }
+            }
+            fn->instrs[t].target[i] = split;
+        }
+    }
+}
+
+void ir_optimize(IRFunction *fn) {
+    bool changed = true;
+    while (changed) {
+        resolve_operands(fn);
+        changed = simplify_instructions(fn);
+        changed |= fold_branches(fn);
+        changed |= remove_unreachable(fn);
+        changed |= remove_dead_code(fn);
+    }
+    resolve_operands(fn);
+    split_critical_edges(fn);
+}
@@ -0,0 +1,704 @@
+#include "link_optimizer.h"
+#include "instructions.h"
+#include "debug.h"
+#include "devices.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define OPERAND_LENGTH 64
+#define LABEL_LENGTH 64
+#define MAX_ROUNDS 32
+#define MAX_FORWARDED 16        // Data page words tracked per block
+
+typedef enum {
+    STATEMENT_NONE,         // Blank, comment or label only
+    STATEMENT_ORG,
+    STATEMENT_DATA,         // .word or .quad
+    STATEMENT_INSTRUCTION
+} StatementKind;
+
+typedef struct {
+    StatementKind kind;
+    char label[LABEL_LENGTH];       // Label defined on the line, or empty
+    uint32_t opcode;
+    char operands[3][OPERAND_LENGTH];
+    int operand_count;
+    uint32_t address;
+    int target;                     // Statement a BRA, BZ or BNZ goes to, or -1
+    bool root;                      // The entry, or stored as a code address
+    bool reachable;
+    bool deleted;
+    bool changed;
+} Statement;
+
+// A data page word known to equal a register
+typedef struct {
+    uint32_t address;
+    int reg;
+} Forwarded;
+
+// What is known at a point inside a basic block
+typedef struct {
+    bool known[REGISTER_COUNT];
+    word_t value[REGISTER_COUNT];
+    int zero;                       // Zero flag: 1 set, 0 clear, -1 unknown
+    Forwarded forwarded[MAX_FORWARDED];
+    int forwarded_count;
+    int stored[MAX_FORWARDED];      // Stores not yet read, which a later store to the same word makes dead
+    int stored_count;
+} BlockState;
+
+typedef struct {
+    uint32_t address;
+    int statement;
+} AddressEntry;
+
+typedef struct {
+    Statement *statements;
+    int count;
+    AddressEntry *by_address;       // Instruction statements sorted by address
+    int instruction_count;
+    const LinkLabel *labels;
+    int label_count;
+    bool memory;                    // Data page forwarding is safe
+    bool *leader;
+    LinkOptStats *stats;
+} Optimizer;
+
+// Strip leading and trailing whitespace in place
+static char *trim(char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+// Value of a number or label; symbolic is set for labels
+static bool resolve(const Optimizer *o, const char *text, uint32_t *value, bool *symbolic) {
+    char *end;
+    long number = strtol(text, &end, 0);
+    if (end != text && *end == '\0') {
+        *value = (uint32_t)number;
+        *symbolic = false;
+        return true;
+    }
+    for (int i = 0; i < o->label_count; i++) {
+        if (strcmp(o->labels[i].name, text) == 0) {
+            *value = o->labels[i].address;
+            *symbolic = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Split a line into a statement
+static int parse_statement(char *line, Statement *s) {
+    memset(s, 0, sizeof(*s));
+    s->target = -1;
+    line[strcspn(line, ";#\r\n")] = '\0';
+    char *text = trim(line);
+    char *colon = strchr(text, ':');
+    if (colon) {
+        *colon = '\0';
+        snprintf(s->label, sizeof(s->label), "%s", trim(text));
+        text = trim(colon + 1);
+    }
+    if (*text == '\0') {
+        return 0;
+    }
+    char *operands = text + strcspn(text, " \t");
+    if (*operands) {
+        *operands++ = '\0';
+    }
+    if (text[0] == '.') {
+        s->kind = strcasecmp(text, ".org") == 0 ? STATEMENT_ORG : STATEMENT_DATA;
+        return 0;     // prepare reads data items from the line itself
+    }
+    const char *name;
+    while ((name = opcode_name(s->opcode)) != NULL && strcasecmp(name, text) != 0) {
+        s->opcode++;
+    }
+    if (name == NULL) {
+        return -1;
+    }
+    s->kind = STATEMENT_INSTRUCTION;
+    for (char *operand = strtok(operands, ","); operand; operand = strtok(NULL, ",")) {
+        operand = trim(operand);
+        if (s->operand_count == 3 || strlen(operand) >= OPERAND_LENGTH) {
+            return -1;
+        }
+        strcpy(s->operands[s->operand_count++], operand);
+    }
+    return 0;
+}
+
+static int compare_addresses(const void *a, const void *b) {
+    uint32_t x = ((const AddressEntry *)a)->address, y = ((const AddressEntry *)b)->address;
+    return x < y ? -1 : x > y;
+}
+
+// Instruction statement at an address, or -1
+static int instruction_at(const Optimizer *o, uint32_t address) {
+    int low = 0, high = o->instruction_count - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        uint32_t found = o->by_address[middle].address;
+        if (found == address) {
+            return o->by_address[middle].statement;
+        }
+        if (found < address) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
+
+static bool live(const Statement *s) {
+    return s->kind == STATEMENT_INSTRUCTION && !s->deleted;
+}
+
+// First live instruction at or after a statement, if no data or .org comes first
+static int live_at(const Optimizer *o, int i) {
+    for (; i >= 0 && i < o->count; i++) {
+        const Statement *s = &o->statements[i];
+        if (live(s)) {
+            return i;
+        }
+        if (s->kind == STATEMENT_ORG || s->kind == STATEMENT_DATA) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+static bool is_branch(uint32_t opcode) {
+    return opcode == BRA || opcode == BZ || opcode == BNZ;
+}
+
+// Whether execution can continue with the next instruction
+static bool falls_through(uint32_t opcode) {
+    return opcode != BRA && opcode != JUMP && opcode != RET && opcode != IRET && opcode != HALT;
+}
+
+// Find branch targets and the roots: the entry and code addresses in data
+static int prepare(Optimizer *o, char **lines) {
+    o->by_address = malloc((size_t)(o->count ? o->count : 1) * sizeof(AddressEntry));
+    if (!o->by_address) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+    for (int i = 0; i < o->count; i++) {
+        if (o->statements[i].kind == STATEMENT_INSTRUCTION) {
+            o->by_address[o->instruction_count++] = (AddressEntry){o->statements[i].address, i};
+        }
+    }
+    qsort(o->by_address, (size_t)o->instruction_count, sizeof(AddressEntry), compare_addresses);
+
+    int entry = instruction_at(o, CODE_START);
+    if (entry < 0) {
+        fprintf(stderr, "Warning: No instruction at 0x%X; post-link optimization skipped\n", CODE_START);
+        return -1;
+    }
+    o->statements[entry].root = true;
+    o->memory = true;
+
+    for (int i = 0; i < o->count; i++) {
+        Statement *s = &o->statements[i];
+        uint32_t value;
+        bool symbolic;
+        if (s->kind == STATEMENT_DATA) {
+            // A label stored in data that names an instruction is a code address
+            char items[256];
+            snprintf(items, sizeof(items), "%s", lines[i]);
+            items[strcspn(items, ";#\r\n")] = '\0';
+            char *list = strchr(items, ':') ? strchr(items, ':') + 1 : items;
+            list = trim(list);
+            list += strcspn(list, " \t");
+            for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+                if (resolve(o, trim(item), &value, &symbolic) && symbolic && instruction_at(o, value) >= 0) {
+                    o->statements[instruction_at(o, value)].root = true;
+                }
+            }
+        } else if (s->kind == STATEMENT_INSTRUCTION) {
+            if (s->opcode == EI || s->opcode == TIMER || s->opcode == MMUSET) {
+                o->memory = false;
+            }
+            if (!is_branch(s->opcode)) {
+                continue;
+            }
+            if (s->operand_count != 1 || !resolve(o, s->operands[0], &value, &symbolic) || !symbolic) {
+                fprintf(stderr, "Warning: Branch at 0x%X has no label target; post-link optimization skipped\n",
+                        s->address);
+                return -1;
+            }
+            s->target = instruction_at(o, value);
+            if (s->target < 0) {
+                fprintf(stderr, "Warning: Branch at 0x%X does not target an instruction; "
+                                "post-link optimization skipped\n", s->address);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Mark what the entry and stored code addresses reach, and delete the rest
+static bool remove_unreachable(Optimizer *o) {
+    int *work = malloc((size_t)(o->count ? o->count : 1) * sizeof(int));
+    if (!work) {
+        abort();
+    }
+    int pending = 0;
+    for (int i = 0; i < o->count; i++) {
+        Statement *s = &o->statements[i];
+        s->reachable = false;
+        if (s->root && live(s)) {
+            s->reachable = true;
+            work[pending++] = i;
+        }
+    }
+    while (pending > 0) {
+        const Statement *s = &o->statements[work[--pending]];
+        int next[2] = {-1, -1};
+        if (falls_through(s->opcode)) {
+            next[0] = live_at(o, work[pending] + 1);
+        }
+        if (s->target >= 0) {
+            next[1] = live_at(o, s->target);
+        }
+        for (int k = 0; k < 2; k++) {
+            if (next[k] >= 0 && !o->statements[next[k]].reachable) {
+                o->statements[next[k]].reachable = true;
+                work[pending++] = next[k];
+            }
+        }
+    }
+    free(work);
+
+    bool changed = false;
+    for (int i = 0; i < o->count; i++) {
+        Statement *s = &o->statements[i];
+        if (live(s) && !s->reachable) {
+            s->deleted = true;
+            o->stats->unreachable++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Point branches that land on a BRA (or, for BZ and BNZ, on the same
+// conditional branch, which sees the same flag) at its destination
+static bool thread_jumps(Optimizer *o) {
+    bool changed = false;
+    for (int i = 0; i < o->count; i++) {
+        Statement *s = &o->statements[i];
+        if (!live(s) || s->target < 0) {
+            continue;
+        }
+        int target = live_at(o, s->target);
+        int hop = -1;
+        for (int steps = 0; target >= 0 && steps < o->count; steps++) {
+            const Statement *t = &o->statements[target];
+            int next = t->target >= 0 ? live_at(o, t->target) : -1;
+            if ((t->opcode != BRA && t->opcode != s->opcode) || next < 0 || next == target || target == i) {
+                break;
+            }
+            hop = target;
+            target = next;
+        }
+        if (hop >= 0 && target != i) {
+            strcpy(s->operands[0], o->statements[hop].operands[0]);
+            s->target = o->statements[hop].target;
+            s->changed = true;
+            o->stats->threaded++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Delete branches whose target is the next instruction anyway
+static bool remove_jumps_to_next(Optimizer *o) {
+    bool changed = false;
+    for (int i = 0; i < o->count; i++) {
+        Statement *s = &o->statements[i];
+        int target = live(s) && s->target >= 0 ? live_at(o, s->target) : -1;
+        if (target >= 0 && target == live_at(o, i + 1)) {
+            s->deleted = true;
+            o->stats->jumps++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static int register_operand(const Statement *s, int k) {
+    return atoi(s->operands[k] + 1);
+}
+
+// Address of an [address] operand
+static bool memory_operand(const Optimizer *o, const Statement *s, int k, uint32_t *address) {
+    char text[OPERAND_LENGTH];
+    bool symbolic;
+    size_t length = strlen(s->operands[k]);
+    if (length < 2) {
+        return false;
+    }
+    memcpy(text, s->operands[k] + 1, length - 2);
+    text[length - 2] = '\0';
+    return resolve(o, trim(text), address, &symbolic);
+}
+
+static void reset_state(BlockState *state) {
+    memset(state->known, 0, sizeof(state->known));
+    state->zero = -1;
+    state->forwarded_count = 0;
+    state->stored_count = 0;
+}
+
+static void forget_memory(BlockState *state) {
+    state->forwarded_count = 0;
+    state->stored_count = 0;
+}
+
+// A register was written: drop what was known about it
+static void write_register(BlockState *state, int reg) {
+    state->known[reg] = false;
+    for (int i = 0; i < state->forwarded_count;) {
+        if (state->forwarded[i].reg == reg) {
+            state->forwarded[i] = state->forwarded[--state->forwarded_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+static bool overlaps(uint32_t a, uint32_t b) {
+    return a < b + WORD_BYTES && b < a + WORD_BYTES;
+}
+
+// Data page word, below the device windows, that forwarding may track
+static bool trackable(const Optimizer *o, uint32_t address) {
+    return o->memory && address + WORD_BYTES <= TIMER_DEVICE_BASE;
+}
+
+// Result of an ALU operation whose operands are known, as the ALU computes it
+static bool evaluate(const BlockState *state, const Statement *s, word_t *result) {
+    int a = register_operand(s, 1);
+    int b = s->operand_count > 2 ? register_operand(s, 2) : 0;
+    bool same = s->operand_count > 2 && s->operands[2][0] == 'R' && a == b;
+    switch (s->opcode) {
+        case XOR:
+        case SUB:
+            if (same) {
+                *result = 0;
+                return true;
+            }
+            break;
+        case EQ:
+        case NEQ:
+            if (same) {
+                *result = s->opcode == EQ;
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+    if (!state->known[a]) {
+        return false;
+    }
+    word_t x = state->value[a];
+    if (s->opcode == NOT) {
+        *result = ~x;
+        return true;
+    }
+    if (s->opcode == ADDI) {
+        *result = x + (word_t)(sword_t)strtol(s->operands[2], NULL, 0);
+        return true;
+    }
+    if (!state->known[b]) {
+        return false;
+    }
+    word_t y = state->value[b];
+    switch (s->opcode) {
+        case ADD: *result = x + y; return true;
+        case SUB: *result = x - y; return true;
+        case AND: *result = x & y; return true;
+        case OR: *result = x | y; return true;
+        case XOR: *result = x ^ y; return true;
+        case EQ: *result = x == y; return true;
+        case NEQ: *result = x != y; return true;
+        default: return false;
+    }
+}
+
+static void delete_statement(Statement *s) {
+    s->deleted = true;
+}
+
+static void forward_store(Optimizer *o, BlockState *state, int i) {
+    Statement *s = &o->statements[i];
+    int reg = register_operand(s, 0);
+    uint32_t address;
+    if (!memory_operand(o, s, 1, &address) || !trackable(o, address)) {
+        forget_memory(state);
+        return;
+    }
+    for (int k = 0; k < state->forwarded_count; k++) {
+        if (state->forwarded[k].address == address && state->forwarded[k].reg == reg) {
+            delete_statement(s);        // The word already holds the register
+            o->stats->stores++;
+            return;
+        }
+    }
+    for (int k = 0; k < state->stored_count;) {
+        Statement *earlier = &o->statements[state->stored[k]];
+        uint32_t earlier_address;
+        memory_operand(o, earlier, 1, &earlier_address);
+        if (earlier_address == address) {
+            delete_statement(earlier);  // Overwritten before anything read it
+            o->stats->stores++;
+        }
+        if (overlaps(earlier_address, address)) {
+            state->stored[k] = state->stored[--state->stored_count];
+        } else {
+            k++;
+        }
+    }
+    for (int k = 0; k < state->forwarded_count;) {
+        if (overlaps(state->forwarded[k].address, address)) {
+            state->forwarded[k] = state->forwarded[--state->forwarded_count];
+        } else {
+            k++;
+        }
+    }
+    if (state->forwarded_count < MAX_FORWARDED) {
+        state->forwarded[state->forwarded_count++] = (Forwarded){address, reg};
+    }
+    if (state->stored_count < MAX_FORWARDED) {
+        state->stored[state->stored_count++] = i;
+    }
+}
+
+static void forward_load(Optimizer *o, BlockState *state, Statement *s) {
+    int reg = register_operand(s, 0);
+    uint32_t address;
+    if (!memory_operand(o, s, 1, &address) || !trackable(o, address)) {
+        forget_memory(state);
+        write_register(state, reg);
+        return;
+    }
+    for (int k = 0; k < state->stored_count;) {
+        uint32_t stored_address;
+        memory_operand(o, &o->statements[state->stored[k]], 1, &stored_address);
+        if (overlaps(stored_address, address)) {
+            state->stored[k] = state->stored[--state->stored_count];
+        } else {
+            k++;
+        }
+    }
+    for (int k = 0; k < state->forwarded_count; k++) {
+        if (state->forwarded[k].address != address) {
+            continue;
+        }
+        int source = state->forwarded[k].reg;
+        o->stats->loads++;
+        if (source == reg) {
+            delete_statement(s);
+            return;
+        }
+        s->opcode = MOV;    // Neither LOAD nor MOV touches the flags
+        snprintf(s->operands[1], OPERAND_LENGTH, "R%d", source);
+        s->operand_count = 2;
+        s->changed = true;
+        bool known = state->known[source];
+        word_t value = state->value[source];
+        write_register(state, reg);
+        state->known[reg] = known;
+        state->value[reg] = value;
+        break;
+    }
+    if (s->opcode == LOAD) {
+        write_register(state, reg);
+    }
+    if (state->forwarded_count < MAX_FORWARDED) {
+        state->forwarded[state->forwarded_count++] = (Forwarded){address, reg};
+    }
+}
+
+// Forward data page words, drop dead stores and fold branches on known flags
+static bool simplify_blocks(Optimizer *o) {
+    LinkOptStats before = *o->stats;
+    memset(o->leader, 0, (size_t)o->count * sizeof(bool));
+    for (int i = 0; i < o->count; i++) {
+        const Statement *s = &o->statements[i];
+        if (live(s) && s->root) {
+            o->leader[i] = true;
+        }
+        if (live(s) && s->target >= 0 && live_at(o, s->target) >= 0) {
+            o->leader[live_at(o, s->target)] = true;
+        }
+    }
+
+    BlockState state;
+    reset_state(&state);
+    for (int i = 0; i < o->count; i++) {
+        Statement *s = &o->statements[i];
+        if (s->kind == STATEMENT_ORG || s->kind == STATEMENT_DATA || o->leader[i]) {
+            reset_state(&state);
+        }
+        if (!live(s)) {
+            continue;
+        }
+        uint32_t op = s->opcode;
+        if (op == BZ || op == BNZ) {
+            if (state.zero >= 0) {
+                if ((op == BZ) == (state.zero == 1)) {
+                    s->opcode = BRA;
+                    s->changed = true;
+                } else {
+                    delete_statement(s);
+                }
+                o->stats->branches++;
+            }
+            if (s->deleted) {
+                continue;
+            }
+        }
+        if (op == STORE) {
+            forward_store(o, &state, i);
+        } else if (op == LOAD) {
+            forward_load(o, &state, s);
+        } else if (op == MOV) {
+            int d = register_operand(s, 0), a = register_operand(s, 1);
+            if (d != a) {
+                bool known = state.known[a];
+                word_t value = state.value[a];
+                write_register(&state, d);
+                state.known[d] = known;
+                state.value[d] = value;
+            }
+        } else if (op <= LE || op == ADDI) {
+            word_t result;
+            bool known = op != DIV && op != MUL && op != SHL && op != SHR && evaluate(&state, s, &result);
+            int d = register_operand(s, 0);
+            write_register(&state, d);
+            state.known[d] = known;
+            state.value[d] = known ? result : 0;
+            state.zero = known ? result == 0 : -1;
+        } else if (op == POP) {
+            write_register(&state, register_operand(s, 0));
+        } else if (op != PUSH && op != NOP && !is_branch(op)) {
+            reset_state(&state);    // Calls, host calls, bulk memory and the rest
+        }
+        if (!falls_through(s->opcode) || op == CALL || op == JZ || op == JNZ || is_branch(s->opcode)) {
+            reset_state(&state);
+        }
+    }
+    return memcmp(&before, o->stats, sizeof(before)) != 0;
+}
+
+// Write a statement back as a source line
+static char *format_statement(const Statement *s) {
+    char *line = malloc(LABEL_LENGTH + 4 * OPERAND_LENGTH + 32);
+    if (!line) {
+        abort();
+    }
+    int length = sprintf(line, "%s%s", s->label, s->label[0] ? ":" : "");
+    if (!s->deleted) {
+        length += sprintf(line + length, "    %s", opcode_name(s->opcode));
+        for (int k = 0; k < s->operand_count; k++) {
+            length += sprintf(line + length, "%s%s", k ? ", " : " ", s->operands[k]);
+        }
+    }
+    strcpy(line + length, "\n");
+    return line;
+}
+
+static int count_live(const Optimizer *o) {
+    int count = 0;
+    for (int i = 0; i < o->count; i++) {
+        count += live(&o->statements[i]);
+    }
+    return count;
+}
+
+// Optimize a laid-out program
+int optimize_linked_program(char **lines, const uint32_t *addresses, int line_count,
+                            const LinkLabel *labels, int label_count, LinkOptStats *stats) {
+    Optimizer o = {0};
+    o.count = line_count;
+    o.labels = labels;
+    o.label_count = label_count;
+    o.stats = stats;
+    memset(stats, 0, sizeof(*stats));
+    o.statements = calloc((size_t)(line_count ? line_count : 1), sizeof(Statement));
+    o.leader = calloc((size_t)(line_count ? line_count : 1), sizeof(bool));
+    if (!o.statements || !o.leader) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(o.statements);
+        free(o.leader);
+        return -1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < line_count && status == 0; i++) {
+        char line[256];
+        snprintf(line, sizeof(line), "%s", lines[i]);
+        if (parse_statement(line, &o.statements[i]) != 0) {
+            fprintf(stderr, "Warning: Cannot analyze line %d; post-link optimization skipped\n", i + 1);
+            status = -1;
+        }
+        o.statements[i].address = addresses[i];
+    }
+    if (status == 0) {
+        status = prepare(&o, lines);
+    }
+    if (status == 0) {
+        stats->before = count_live(&o);
+        for (int round = 0; round < MAX_ROUNDS; round++) {
+            bool changed = remove_unreachable(&o);
+            changed |= thread_jumps(&o);
+            changed |= remove_jumps_to_next(&o);
+            changed |= simplify_blocks(&o);
+            if (!changed) {
+                break;
+            }
+        }
+        stats->after = count_live(&o);
+        for (int i = 0; i < line_count; i++) {
+            const Statement *s = &o.statements[i];
+            if (s->kind == STATEMENT_INSTRUCTION && (s->deleted || s->changed)) {
+                free(lines[i]);
+                lines[i] = format_statement(s);
+                status = 1;
+            }
+        }
+    }
+    free(o.statements);
+    free(o.by_address);
+    free(o.leader);
+    return status;
+}
+
+// Print what the pass removed
+void display_link_opt_stats(const LinkOptStats *stats) {
+    int removed = stats->before - stats->after;
+    printf("Post-link: %d -> %d instructions (%d removed, %.1f%%)\n", stats->before, stats->after, removed,
+           stats->before ? 100.0 * removed / stats->before : 0.0);
+    printf("  %d unreachable, %d branches threaded, %d jumps to next, %d branches folded, "
+           "%d loads and %d stores removed or forwarded\n",
+           stats->unreachable, stats->threaded, stats->jumps, stats->branches, stats->loads, stats->stores);
+}
@@ -26,10 +26,11 @@ void add_file_to_linker(Linker *linker, const char *filename) {
             symbol.address += linker->instruction_count; // Adjust relative to current instruction count
             linker->symbols[linker->symbol_count++] = symbol;
         } else {
-            // Instruction line
+            // Instruction line; blank and comment lines carry no word
             uint32_t instruction;
-            sscanf(line, "%x", &instruction);
-            linker->instructions[linker->instruction_count++] = instruction;
+            if (sscanf(line, "%x", &instruction) == 1) {
+                linker->instructions[linker->instruction_count++] = instruction;
+            }
         }
     }
     fclose(file);
@@ -76,3 +77,17 @@ void generate_binary(Linker *linker, const char *output_file) {
     fclose(file);
     printf("Binary generated: %s\n", output_file);
 }
+
+// Find the symbol covering a byte address
+const Symbol *find_symbol(const Linker *linker, uint32_t address) {
+    const Symbol *best = NULL;
+    uint32_t index = address / sizeof(uint32_t);
+
+    for (int i = 0; i < linker->symbol_count; i++) {
+        const Symbol *symbol = &linker->symbols[i];
+        if (symbol->address <= index && (best == NULL || symbol->address > best->address)) {
+            best = symbol;
+        }
+    }
+    return best;
+}
@@ -4,6 +4,26 @@
 #include "cpu.h"
 #include "alu.h"
 #include "assembler.h"
+#include "memory.h"
+#include "sampling.h"
+#include "linker.h"
+#include "profiler.h"
+#include "sample_profiler.h"
+#include "timing.h"
+#include "perf.h"
+#include "trace.h"
+#include "timetravel.h"
+#include "gdbstub.h"
+#include "breakpoints.h"
+#include "interrupts.h"
+#include "devices.h"
+#include "mmu.h"
+#include "image_assembler.h"
+#include "hostcalls.h"
+#include "aot.h"
+#include "decode_file.h"
+#include "compiler.h"
+#include "verifier.h"
 
 // Recursive Factorial in C (for comparison)
 int factorial_c(int n) {
@@ -22,7 +42,615 @@ int demonstrate_fetch_decode_execute(CPU *cpu);
 void execute_program(CPU *cpu);
 void load_program_to_memory(CPU *cpu, const char *object_file);
 
-int main() {
+#define OPTIMIZE_RUN_LIMIT 100000000ULL     // Instructions --assemble-opt runs each build for
+
+// Print command-line usage
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s                      Run the built-in demonstration\n", program);
+    fprintf(stderr, "       %s [options] <image>    Run a flat binary image\n", program);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --trace              Print every executed instruction\n");
+    fprintf(stderr, "  --detailed           Run under the cache/branch timing model\n");
+    fprintf(stderr, "  --perf               Report phase times, MIPS and the instruction mix\n");
+    fprintf(stderr, "  --softfloat          Bit-exact software floating point instead of the host FPU\n");
+    fprintf(stderr, "  --fp-check           Run FP instructions both ways and stop on a mismatch\n");
+    fprintf(stderr, "  --sample             Sampled simulation with a weighted CPI estimate\n");
+    fprintf(stderr, "  --interval N         Instructions per sampling interval\n");
+    fprintf(stderr, "  --warmup N           Detailed warmup instructions per interval\n");
+    fprintf(stderr, "  --max-k N            Maximum number of phase clusters\n");
+    fprintf(stderr, "  --max-insns N        Stop after N instructions\n");
+    fprintf(stderr, "  --validate           Also run fully detailed to check the estimate\n");
+    fprintf(stderr, "  --profile            Count instructions per PC, opcode and function\n");
+    fprintf(stderr, "  --sample-profile [US] Statistical PC profile via SIGPROF (default 1000 us)\n");
+    fprintf(stderr, "  --symbols FILE       Linker source whose symbols name functions\n");
+    fprintf(stderr, "  --folded FILE        Write folded stacks for flamegraphs\n");
+    fprintf(stderr, "  --listing FILE       Write an annotated disassembly listing\n");
+    fprintf(stderr, "  --record FILE        Record a binary execution trace\n");
+    fprintf(stderr, "  --keyframe N         Instructions between trace keyframes\n");
+    fprintf(stderr, "  --no-compress        Store trace blocks uncompressed\n");
+    fprintf(stderr, "  --timetravel         Debug with reverse execution; commands on stdin\n");
+    fprintf(stderr, "  --checkpoint N       Instructions between time-travel checkpoints\n");
+    fprintf(stderr, "  --max-checkpoints N  Checkpoints kept before older ones are thinned\n");
+    fprintf(stderr, "  --gdb PORT|unix:PATH Serve the GDB remote protocol; starts stopped\n");
+    fprintf(stderr, "  --disk FILE          Attach a block device backed by FILE\n");
+    fprintf(stderr, "  --console FILE       Write guest console output to FILE instead of stdout\n");
+    fprintf(stderr, "  --break ADDR[:COND]  Report each time ADDR is reached while COND holds\n");
+    fprintf(stderr, "  --watch ADDR,LEN[:COND] Report each write to [ADDR, ADDR+LEN) while COND holds\n");
+    fprintf(stderr, "  --native LIB         Run blocks translated into LIB by --translate natively\n");
+    fprintf(stderr, "  --decode-cache FILE  Keep the image's decoded instructions in FILE across runs\n");
+    fprintf(stderr, "  --verify             Verify the image at load and run its fault-free blocks unchecked\n");
+    fprintf(stderr, "       %s --replay FILE [--seek N]\n", program);
+    fprintf(stderr, "                       Replay a trace to its end or to instruction N\n");
+    fprintf(stderr, "       %s --assemble SOURCE IMAGE\n", program);
+    fprintf(stderr, "                       Assemble SOURCE into a flat binary image\n");
+    fprintf(stderr, "       %s --assemble-wide SOURCE IMAGE\n", program);
+    fprintf(stderr, "                       Assemble without compressed instructions\n");
+    fprintf(stderr, "       %s --assemble-opt SOURCE IMAGE\n", program);
+    fprintf(stderr, "                       Assemble with the post-link optimizer and report its savings\n");
+    fprintf(stderr, "       %s --translate IMAGE OUTPUT.c\n", program);
+    fprintf(stderr, "                       Translate IMAGE to C for a --native library\n");
+    fprintf(stderr, "       %s --compile SOURCE.c OUTPUT.s\n", program);
+    fprintf(stderr, "                       Compile a C subset to assembly for --assemble\n");
+}
+
+// Load a linker source for its symbol table
+static Linker *load_symbols(const char *symbols_file) {
+    Linker *linker = malloc(sizeof(Linker));
+    if (!linker) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return NULL;
+    }
+    init_linker(linker);
+    add_file_to_linker(linker, symbols_file);
+    return linker;
+}
+
+// Run a loaded image under the statistical profiler
+static int sample_profile_image(CPU *cpu, uint64_t max_instructions, uint32_t interval_us,
+                                const char *symbols_file) {
+    Linker *linker = NULL;
+    if (symbols_file && (linker = load_symbols(symbols_file)) == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    SampleProfiler *profiler = malloc(sizeof(SampleProfiler));
+    if (!profiler || start_sample_profiler(profiler, cpu, interval_us) != 0) {
+        free(profiler);
+        free(linker);
+        return EXIT_FAILURE;
+    }
+
+    sample_profile_cpu(profiler, cpu, max_instructions);
+    stop_sample_profiler(profiler);
+    display_sample_profile(profiler, linker);
+
+    free(profiler);
+    free(linker);
+    return EXIT_SUCCESS;
+}
+
+// Profile a loaded image and write the requested reports
+static int profile_image(CPU *cpu, uint64_t max_instructions, const char *symbols_file,
+                         const char *folded_file, const char *listing_file) {
+    Linker *linker = NULL;
+    if (symbols_file && (linker = load_symbols(symbols_file)) == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    Profiler *profiler = malloc(sizeof(Profiler));
+    if (!profiler || init_profiler(profiler, cpu, linker) != 0) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(profiler);
+        free(linker);
+        return EXIT_FAILURE;
+    }
+
+    profile_cpu(profiler, cpu, max_instructions);
+    display_profile(profiler);
+
+    int status = EXIT_SUCCESS;
+    if (folded_file) {
+        FILE *out = fopen(folded_file, "w");
+        if (out) {
+            write_folded_stacks(profiler, out);
+            fclose(out);
+        } else {
+            perror("Error opening folded stack file");
+            status = EXIT_FAILURE;
+        }
+    }
+    if (listing_file) {
+        FILE *out = fopen(listing_file, "w");
+        if (out) {
+            write_annotated_listing(profiler, cpu, out);
+            fclose(out);
+        } else {
+            perror("Error opening listing file");
+            status = EXIT_FAILURE;
+        }
+    }
+
+    free_profiler(profiler);
+    free(profiler);
+    free(linker);
+    return status;
+}
+
+// Record a loaded image's execution to a trace file
+static int record_image(CPU *cpu, uint64_t max_instructions, const char *trace_file, const TraceConfig *config) {
+    TraceWriter *writer = malloc(sizeof(TraceWriter));
+    if (!writer || start_trace_recording(writer, trace_file, config) != 0) {
+        free(writer);
+        return EXIT_FAILURE;
+    }
+
+    record_cpu(writer, cpu, max_instructions);
+    int status = stop_trace_recording(writer) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    printf("Trace: %llu instructions, %llu bytes raw, %llu bytes written\n",
+           (unsigned long long)writer->instructions, (unsigned long long)writer->raw_bytes,
+           (unsigned long long)writer->written_bytes);
+
+    free(writer);
+    return status;
+}
+
+// Run a loaded image with blocks from a translated library
+static int native_image(CPU *cpu, uint32_t image_size, uint64_t max_instructions, const char *library) {
+    NativeImage *native = malloc(sizeof(NativeImage));
+    if (!native) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    if (load_native_image(native, library, cpu, image_size) != 0) {
+        free(native);
+        return EXIT_FAILURE;
+    }
+
+    run_native(native, cpu, max_instructions);
+    display_native(native);
+
+    close_native_image(native);
+    free(native);
+    return EXIT_SUCCESS;
+}
+
+// Verify a loaded image and run its fault-free blocks without checks
+static int verified_image(CPU *cpu, uint32_t image_size, uint64_t max_instructions) {
+    VerifiedProgram *program = malloc(sizeof(VerifiedProgram));
+    if (!program) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    verify_program(program, cpu, image_size);     // Rejected code keeps full checks
+
+    run_verified(program, cpu, max_instructions);
+    display_verified(program);
+
+    free(program);
+    return EXIT_SUCCESS;
+}
+
+// Debug a loaded image with reverse execution
+static int time_travel_image(CPU *cpu, uint64_t interval, int max_checkpoints) {
+    TimeTravel tt;
+    if (init_time_travel(&tt, cpu, interval, max_checkpoints) != 0) {
+        return EXIT_FAILURE;
+    }
+    run_time_travel_console(&tt, cpu, stdin);
+    free_time_travel(&tt);
+    return EXIT_SUCCESS;
+}
+
+// Debug a loaded image from GDB over the remote serial protocol
+static int gdb_image(CPU *cpu, const char *address) {
+    GDBStub *stub = malloc(sizeof(GDBStub));
+    if (!stub || start_gdb_stub(stub, cpu, address) != 0) {
+        free(stub);
+        return EXIT_FAILURE;
+    }
+    gdb_serve(stub);
+    stop_gdb_stub(stub);
+    free(stub);
+
+    display_cpu_state(cpu);
+    return EXIT_SUCCESS;
+}
+
+// Parse a --break or --watch specification into the engine
+static int add_point_option(BreakpointEngine *engine, const char *spec, bool watch) {
+    char *end;
+    uint32_t address = (uint32_t)strtoul(spec, &end, 0);
+    uint32_t length = 0;
+    if (end == spec) {
+        fprintf(stderr, "Error: Invalid address in \"%s\"\n", spec);
+        return -1;
+    }
+    if (watch) {
+        const char *length_text = end + 1;
+        if (*end != ',' || (length = (uint32_t)strtoul(length_text, &end, 0), end == length_text)) {
+            fprintf(stderr, "Error: Expected ADDR,LEN in \"%s\"\n", spec);
+            return -1;
+        }
+    }
+    if (*end != '\0' && *end != ':') {
+        fprintf(stderr, "Error: Unexpected text in \"%s\"\n", spec);
+        return -1;
+    }
+
+    const char *condition = *end == ':' ? end + 1 : NULL;
+    return watch ? add_watchpoint(engine, address, length, condition)
+                 : add_breakpoint(engine, address, condition);
+}
+
+// Run a loaded image, reporting every breakpoint and watchpoint hit
+static int breakpoint_image(CPU *cpu, BreakpointEngine *engine, uint64_t max_instructions) {
+    uint64_t hits = 0;
+    for (;;) {
+        uint64_t remaining = max_instructions - cpu->perf_counters[PERF_INSTRUCTIONS];
+        StopReason reason = run_with_breakpoints(engine, cpu, remaining);
+        if (reason == STOP_NONE) {
+            break;
+        }
+
+        hits++;
+        if (reason == STOP_BREAKPOINT) {
+            printf("Breakpoint 0x%03X", engine->hit_address);
+        } else {
+            printf("Watchpoint 0x%03X written at PC 0x%03X", engine->hit_address, cpu->program_counter);
+        }
+        printf(" after %llu instructions:", (unsigned long long)cpu->perf_counters[PERF_INSTRUCTIONS]);
+        for (int i = 0; i < REGISTER_COUNT; i++) {
+            printf(" R%d=%" PRIdWORD, i, cpu->registers[i]);
+        }
+        printf("\n");
+    }
+    printf("%llu breakpoint and watchpoint hits\n", (unsigned long long)hits);
+    return EXIT_SUCCESS;
+}
+
+// Replay a trace to the requested instruction and display the state there
+static int replay_trace_command(const char *trace_file, bool seek, uint64_t instruction) {
+    TraceReader reader;
+    if (open_trace(&reader, trace_file) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    CPU *cpu = malloc(sizeof(CPU));
+    if (!cpu) {
+        fprintf(stderr, "Error: Out of memory\n");
+        close_trace(&reader);
+        return EXIT_FAILURE;
+    }
+    memset(cpu, 0, sizeof(CPU));
+
+    int status = EXIT_SUCCESS;
+    if (seek_trace(&reader, cpu, seek ? instruction : reader.total_instructions) == 0) {
+        printf("Replayed to instruction %llu of %llu\n", (unsigned long long)reader.instruction,
+               (unsigned long long)reader.total_instructions);
+        display_cpu_state(cpu);
+    } else {
+        status = EXIT_FAILURE;
+    }
+
+    free(cpu);
+    close_trace(&reader);
+    return status;
+}
+
+// Retired instructions of a program run to HALT with its output discarded;
+// the image is loaded from image_file, or assembled unoptimized if it is NULL
+static int count_retired(const char *source_file, const char *image_file, uint64_t *retired) {
+    CPU *cpu = malloc(sizeof(CPU));
+    DeviceSet *devices = malloc(sizeof(DeviceSet));
+    if (!cpu || !devices) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(cpu);
+        free(devices);
+        return -1;
+    }
+    reset_cpu(cpu);
+    int image_size = image_file ? load_image(cpu->memory, image_file)
+                                : assemble_to_memory(source_file, true, NULL, cpu->memory);
+    if (image_size < 0 || init_devices(devices, cpu, NULL, "/dev/null") != 0) {
+        free(devices);
+        free(cpu);
+        return -1;
+    }
+    InterruptController interrupts;
+    MMU mmu;
+    HostCalls host_calls;
+    init_interrupts(&interrupts, cpu);
+    init_mmu(&mmu, cpu);
+    int status = init_host_calls(&host_calls, cpu, (uint32_t)image_size, &devices->console);
+    for (uint64_t executed = 0; status == 0 && !cpu->halted && executed < OPTIMIZE_RUN_LIMIT; executed++) {
+        step_cpu(cpu);
+    }
+    if (status == 0 && !cpu->halted) {
+        printf("Dynamic: not measured; no HALT within %llu instructions\n", (unsigned long long)OPTIMIZE_RUN_LIMIT);
+        status = -1;
+    }
+    *retired = cpu->perf_counters[PERF_INSTRUCTIONS];
+    close_devices(devices);
+    free(devices);
+    free(cpu);
+    return status;
+}
+
+// Assemble with the post-link pass, then run the program built with and
+// without it to report the dynamic savings
+static int optimize_image_command(const char *source_file, const char *image_file) {
+    LinkOptStats stats;
+    if (assemble_image(source_file, image_file, true, &stats) != 0) {
+        return EXIT_FAILURE;
+    }
+    display_link_opt_stats(&stats);
+    uint64_t before, after;
+    if (count_retired(source_file, NULL, &before) == 0 && count_retired(source_file, image_file, &after) == 0) {
+        printf("Dynamic: %llu -> %llu instructions retired (%.1f%% fewer)\n", (unsigned long long)before,
+               (unsigned long long)after, before ? 100.0 * ((double)before - (double)after) / (double)before : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
+
+// Run a binary image according to the command-line options
+static int run_image_command(int argc, char *argv[]) {
+    const char *image = NULL;
+    bool trace = false;
+    bool detailed = false;
+    bool perf = false;
+    FPUMode fpu_mode = FPU_HOST;
+    bool sample = false;
+    bool profile = false;
+    bool sample_profile = false;
+    uint32_t sample_interval_us = SAMPLE_PROFILER_DEFAULT_US;
+    const char *symbols_file = NULL;
+    const char *folded_file = NULL;
+    const char *listing_file = NULL;
+    const char *record_file = NULL;
+    const char *replay_file = NULL;
+    bool seek = false;
+    uint64_t seek_instruction = 0;
+    const char *gdb_address = NULL;
+    const char *disk_file = NULL;
+    const char *console_file = NULL;
+    const char *native_library = NULL;
+    const char *decode_path = NULL;
+    bool verify = false;
+    bool time_travel = false;
+    bool break_run = false;
+    BreakpointEngine breakpoints;
+    init_breakpoints(&breakpoints);
+    uint64_t checkpoint_interval = TIMETRAVEL_DEFAULT_INTERVAL;
+    int max_checkpoints = TIMETRAVEL_DEFAULT_CHECKPOINTS;
+    TraceConfig trace_config;
+    init_trace_config(&trace_config);
+    SamplingConfig sampling;
+    init_sampling_config(&sampling);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "--trace") == 0) {
+            trace = true;
+        } else if (strcmp(arg, "--detailed") == 0) {
+            detailed = true;
+        } else if (strcmp(arg, "--perf") == 0) {
+            perf = true;
+        } else if (strcmp(arg, "--softfloat") == 0) {
+            fpu_mode = FPU_SOFT;
+        } else if (strcmp(arg, "--fp-check") == 0) {
+            fpu_mode = FPU_CHECK;
+        } else if (strcmp(arg, "--sample") == 0) {
+            sample = true;
+        } else if (strcmp(arg, "--profile") == 0) {
+            profile = true;
+        } else if (strcmp(arg, "--sample-profile") == 0) {
+            sample_profile = true;
+            if (has_value && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                sample_interval_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+            }
+        } else if (strcmp(arg, "--symbols") == 0 && has_value) {
+            symbols_file = argv[++i];
+        } else if (strcmp(arg, "--folded") == 0 && has_value) {
+            folded_file = argv[++i];
+        } else if (strcmp(arg, "--listing") == 0 && has_value) {
+            listing_file = argv[++i];
+        } else if (strcmp(arg, "--record") == 0 && has_value) {
+            record_file = argv[++i];
+        } else if (strcmp(arg, "--replay") == 0 && has_value) {
+            replay_file = argv[++i];
+        } else if ((strcmp(arg, "--assemble") == 0 || strcmp(arg, "--assemble-wide") == 0) && i + 2 < argc) {
+            bool compress = strcmp(arg, "--assemble") == 0;
+            return assemble_image(argv[i + 1], argv[i + 2], compress, NULL) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else if (strcmp(arg, "--assemble-opt") == 0 && i + 2 < argc) {
+            return optimize_image_command(argv[i + 1], argv[i + 2]);
+        } else if (strcmp(arg, "--translate") == 0 && i + 2 < argc) {
+            return translate_image(argv[i + 1], argv[i + 2]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else if (strcmp(arg, "--compile") == 0 && i + 2 < argc) {
+            return compile_c_file(argv[i + 1], argv[i + 2]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else if (strcmp(arg, "--native") == 0 && has_value) {
+            native_library = argv[++i];
+        } else if (strcmp(arg, "--decode-cache") == 0 && has_value) {
+            decode_path = argv[++i];
+        } else if (strcmp(arg, "--verify") == 0) {
+            verify = true;
+        } else if (strcmp(arg, "--seek") == 0 && has_value) {
+            seek = true;
+            seek_instruction = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(arg, "--keyframe") == 0 && has_value) {
+            trace_config.keyframe_interval = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(arg, "--no-compress") == 0) {
+            trace_config.compress = false;
+        } else if (strcmp(arg, "--gdb") == 0 && has_value) {
+            gdb_address = argv[++i];
+        } else if ((strcmp(arg, "--break") == 0 || strcmp(arg, "--watch") == 0) && has_value) {
+            break_run = true;
+            if (add_point_option(&breakpoints, argv[++i], arg[2] == 'w') != 0) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(arg, "--disk") == 0 && has_value) {
+            disk_file = argv[++i];
+        } else if (strcmp(arg, "--console") == 0 && has_value) {
+            console_file = argv[++i];
+        } else if (strcmp(arg, "--timetravel") == 0) {
+            time_travel = true;
+        } else if (strcmp(arg, "--checkpoint") == 0 && has_value) {
+            checkpoint_interval = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(arg, "--max-checkpoints") == 0 && has_value) {
+            max_checkpoints = atoi(argv[++i]);
+        } else if (strcmp(arg, "--validate") == 0) {
+            sampling.validate = true;
+        } else if (strcmp(arg, "--interval") == 0 && has_value) {
+            sampling.interval_length = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(arg, "--warmup") == 0 && has_value) {
+            sampling.warmup_length = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(arg, "--max-k") == 0 && has_value) {
+            sampling.max_clusters = atoi(argv[++i]);
+        } else if (strcmp(arg, "--max-insns") == 0 && has_value) {
+            sampling.max_instructions = strtoull(argv[++i], NULL, 0);
+        } else if (arg[0] != '-' && image == NULL) {
+            image = arg;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (replay_file) {
+        return replay_trace_command(replay_file, seek, seek_instruction);
+    }
+    if (image == NULL) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    HostMetrics metrics;
+    init_host_metrics(&metrics);
+    begin_phase(&metrics, "load", NULL);
+
+    CPU *cpu = malloc(sizeof(CPU));
+    if (!cpu) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    init_cpu(cpu);
+    int image_size = load_image(cpu->memory, image);
+    if (image_size < 0) {
+        free(cpu);
+        return EXIT_FAILURE;
+    }
+    cpu->trace_execution = trace;
+    cpu->fpu_mode = fpu_mode;
+
+    // Checkpoints and sampled intervals do not capture interrupt, MMU or device
+    // state, and sampling re-executes intervals, so both run without them:
+    // TIMER and MMUSET halt, and device windows are plain RAM
+    bool detached = time_travel || sample;
+    InterruptController interrupts;
+    MMU mmu;
+    DeviceSet *devices = NULL;
+    if (!detached) {
+        init_interrupts(&interrupts, cpu);
+        init_mmu(&mmu, cpu);
+        devices = malloc(sizeof(DeviceSet));
+        if (!devices || init_devices(devices, cpu, disk_file, console_file) != 0) {
+            free(devices);
+            free(cpu);
+            return EXIT_FAILURE;
+        }
+    }
+    HostCalls host_calls;
+    if (init_host_calls(&host_calls, cpu, (uint32_t)image_size, devices ? &devices->console : NULL) != 0) {
+        if (devices) {
+            close_devices(devices);
+        }
+        free(devices);
+        free(cpu);
+        return EXIT_FAILURE;
+    }
+
+    DecodeFile decode_file;
+    if (decode_path) {
+        open_decode_file(&decode_file, decode_path, cpu, (uint32_t)image_size);
+    }
+
+    begin_phase(&metrics, "execute", cpu);
+    int status = EXIT_SUCCESS;
+    if (profile) {
+        status = profile_image(cpu, sampling.max_instructions, symbols_file, folded_file, listing_file);
+    } else if (sample_profile) {
+        status = sample_profile_image(cpu, sampling.max_instructions, sample_interval_us, symbols_file);
+    } else if (gdb_address) {
+        status = gdb_image(cpu, gdb_address);
+    } else if (time_travel) {
+        status = time_travel_image(cpu, checkpoint_interval, max_checkpoints);
+    } else if (break_run) {
+        status = breakpoint_image(cpu, &breakpoints, sampling.max_instructions);
+    } else if (record_file) {
+        status = record_image(cpu, sampling.max_instructions, record_file, &trace_config);
+    } else if (sample) {
+        SamplingResult result;
+        if (run_sampled_simulation(cpu, &sampling, &result) == 0) {
+            display_sampling_result(&result);
+        } else {
+            status = EXIT_FAILURE;
+        }
+    } else if (native_library) {
+        status = native_image(cpu, (uint32_t)image_size, sampling.max_instructions, native_library);
+    } else if (verify) {
+        status = verified_image(cpu, (uint32_t)image_size, sampling.max_instructions);
+    } else if (detailed) {
+        TimingModel model;
+        init_timing_model(&model);
+        for (uint64_t executed = 0; !cpu->halted && executed < sampling.max_instructions; executed++) {
+            timing_step(&model, cpu);
+        }
+        printf("Detailed CPI: %.3f\n", timing_cpi(&model));
+    } else {
+        for (uint64_t executed = 0; !cpu->halted && executed < sampling.max_instructions; executed++) {
+            step_cpu(cpu);
+        }
+    }
+    end_phase(&metrics);
+    if (devices) {
+        flush_console(&devices->console);     // Guest output comes before the final state
+    }
+
+    if (!profile && !sample_profile && !sample && !time_travel && !gdb_address) {
+        if (!cpu->halted) {
+            printf("Instruction limit reached\n");
+            cpu->halted = true;
+        }
+        run_cpu(cpu); // Displays the final state
+    }
+    display_host_calls(&host_calls);
+    if (decode_path) {
+        if (save_decode_file(&decode_file, cpu) != 0) {
+            status = EXIT_FAILURE;
+        }
+        display_decode_file(&decode_file);
+    }
+    if (!detached) {
+        display_interrupts(&interrupts);
+        display_mmu(&mmu);
+        display_bus(&devices->bus);
+        close_devices(devices);
+        free(devices);
+    }
+    if (perf) {
+        display_host_metrics(&metrics, cpu);
+    }
+
+    free(cpu);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        return run_image_command(argc, argv);
+    }
+
     // Create a new CPU instance
     CPU cpu;
     init_cpu(&cpu);
@@ -5,10 +5,10 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <string.h>
 
 // Define memory segment constants
-#define CODE_START 0x1000
-#define CODE_END 0x2000
+#define CODE_END (MEMORY_SIZE - 1)
 
 
 // Read a 32-bit value from memory
@@ -29,6 +29,28 @@ void write_memory(uint8_t *memory, uint32_t address, uint32_t value) {
     *((uint32_t *)&memory[address]) = value; // Write 4 bytes as a single 32-bit value
 }
 
+#if WORD_SIZE != 32
+// Read a WORD_SIZE-bit value from memory
+word_t read_memory_word(const uint8_t *memory, uint32_t address) {
+    if (address > MEMORY_SIZE - WORD_BYTES) {
+        fprintf(stderr, "Error: Memory read out of bounds at address 0x%08X.\n", address);
+        exit(EXIT_FAILURE);
+    }
+    word_t value;
+    memcpy(&value, &memory[address], sizeof(value));
+    return value;
+}
+
+// Write a WORD_SIZE-bit value to memory
+void write_memory_word(uint8_t *memory, uint32_t address, word_t value) {
+    if (address > MEMORY_SIZE - WORD_BYTES) {
+        fprintf(stderr, "Error: Memory write out of bounds at address 0x%08X.\n", address);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&memory[address], &value, sizeof(value));
+}
+#endif
+
 // Load a program into the code segment
 int load_program(uint8_t *memory, const uint32_t *program, uint32_t size) {
     if (memory == NULL || program == NULL) {
@@ -47,6 +69,26 @@ int load_program(uint8_t *memory, const uint32_t *program, uint32_t size) {
     return 0; // Success
 }
 
+// Load a flat binary image at address 0
+int load_image(uint8_t *memory, const char *filename) {
+    if (memory == NULL || filename == NULL) {
+        fprintf(stderr, "Error: NULL pointer passed to load_image.\n");
+        return -1;
+    }
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open image %s\n", filename);
+        return -1;
+    }
+    size_t size = fread(memory, 1, MEMORY_SIZE, file);
+    if (fgetc(file) != EOF) {
+        fprintf(stderr, "Error: Image %s exceeds memory size.\n", filename);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    return (int)size;
+}
 
 // Display memory contents
 void display_memory(const uint8_t *memory, uint32_t start, uint32_t end, char format) {
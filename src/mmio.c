@@ -0,0 +1,96 @@
+#include "mmio.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+
+// Initialize an empty bus
+void init_bus(MMIOBus *bus) {
+    memset(bus, 0, sizeof(*bus));
+}
+
+// Register a device over whole IO pages
+int register_device(MMIOBus *bus, const char *name, uint32_t base, uint32_t size,
+                    DeviceRead read, DeviceWrite write, void *context) {
+    if (bus->attached) {
+        fprintf(stderr, "Error: Cannot register %s after the bus is attached\n", name);
+        return -1;
+    }
+    if (bus->device_count == MMIO_MAX_DEVICES) {
+        fprintf(stderr, "Error: Too many devices\n");
+        return -1;
+    }
+    if (size == 0 || base % IO_PAGE_SIZE != 0 || size % IO_PAGE_SIZE != 0 ||
+        base >= MEMORY_SIZE || size > MEMORY_SIZE - base) {
+        fprintf(stderr, "Error: Invalid range 0x%X+0x%X for %s\n", base, size, name);
+        return -1;
+    }
+    for (uint32_t page = base / IO_PAGE_SIZE; page < (base + size) / IO_PAGE_SIZE; page++) {
+        if (bus->pages[page]) {
+            fprintf(stderr, "Error: %s overlaps %s at 0x%X\n", name,
+                    bus->devices[bus->pages[page] - 1].name, page * IO_PAGE_SIZE);
+            return -1;
+        }
+    }
+
+    Device *device = &bus->devices[bus->device_count++];
+    device->name = name;
+    device->base = base;
+    device->size = size;
+    device->read = read;
+    device->write = write;
+    device->context = context;
+    device->reads = 0;
+    device->writes = 0;
+    for (uint32_t page = base / IO_PAGE_SIZE; page < (base + size) / IO_PAGE_SIZE; page++) {
+        bus->pages[page] = (uint8_t)bus->device_count;
+    }
+    return 0;
+}
+
+// Freeze the map and hand it to the CPU
+void attach_bus(MMIOBus *bus, CPU *cpu) {
+    bus->attached = true;
+    memcpy(cpu->io_pages, bus->pages, sizeof(cpu->io_pages));
+    cpu->bus = bus;
+}
+
+// Read a device register
+uint32_t mmio_read(CPU *cpu, uint32_t address) {
+    if (address >= MEMORY_SIZE) {
+        return read_memory(cpu->memory, address);   // Reports the bad address
+    }
+    Device *device = &cpu->bus->devices[cpu->io_pages[address / IO_PAGE_SIZE] - 1];
+    device->reads++;
+    return device->read ? device->read(device->context, cpu, address - device->base) : 0;
+}
+
+// Write a device register
+void mmio_write(CPU *cpu, uint32_t address, uint32_t value) {
+    if (address >= MEMORY_SIZE) {
+        write_memory(cpu->memory, address, value);  // Reports the bad address
+        return;
+    }
+    Device *device = &cpu->bus->devices[cpu->io_pages[address / IO_PAGE_SIZE] - 1];
+    device->writes++;
+    if (device->write) {
+        device->write(device->context, cpu, address - device->base, value);
+    }
+}
+
+// Display the device map
+void display_bus(const MMIOBus *bus) {
+    uint64_t accesses = 0;
+    for (int i = 0; i < bus->device_count; i++) {
+        accesses += bus->devices[i].reads + bus->devices[i].writes;
+    }
+    if (accesses == 0) {
+        return;
+    }
+
+    printf("\n=== Devices ===\n");
+    for (int i = 0; i < bus->device_count; i++) {
+        const Device *device = &bus->devices[i];
+        printf("0x%03X-0x%03X %-8s %llu reads, %llu writes\n", device->base, device->base + device->size - 1,
+               device->name, (unsigned long long)device->reads, (unsigned long long)device->writes);
+    }
+}
@@ -0,0 +1,247 @@
+#include "mmu.h"
+#include "instructions.h"
+#include "interrupts.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t access_bits[MMU_ACCESS_COUNT] = {PTE_READ, PTE_WRITE, PTE_EXECUTE};
+static const char *access_names[MMU_ACCESS_COUNT] = {"read", "write", "execute"};
+
+// Initialize an MMU with paging off and attach it to the CPU
+void init_mmu(MMU *mmu, CPU *cpu) {
+    memset(mmu, 0, sizeof(*mmu));
+    mmu->cpu = cpu;
+    flush_tlb(mmu);
+    mmu->flushes = 0;
+    cpu->mmu = mmu;
+    cpu->paging = false;
+}
+
+// Write an MMU register
+int set_mmu_register(MMU *mmu, uint32_t reg, uint32_t value) {
+    switch (reg) {
+        case MMU_REG_DIRECTORY:
+            if (value % sizeof(uint32_t) != 0 || value > MEMORY_SIZE - MMU_TABLE_ENTRIES * sizeof(uint32_t)) {
+                fprintf(stderr, "Error: Invalid page directory address 0x%X\n", value);
+                return -1;
+            }
+            mmu->registers[reg] = value;
+            mmu->cpu->paging = value != 0;
+            mmu->used |= value != 0;
+            flush_tlb(mmu);
+            return 0;
+        case MMU_REG_FAULT_HANDLER:
+            mmu->registers[reg] = value;
+            return 0;
+        default:
+            fprintf(stderr, "Error: MMU register %u is not writable\n", reg);
+            return -1;
+    }
+}
+
+// Invalidate every TLB entry
+void flush_tlb(MMU *mmu) {
+    for (int i = 0; i < MMU_TLB_SIZE; i++) {
+        for (int access = 0; access < MMU_ACCESS_COUNT; access++) {
+            mmu->tlb[i].tags[access] = MMU_NO_PAGE;
+        }
+    }
+    mmu->flushes++;
+}
+
+// Invalidate the entry of one page, if cached
+void flush_tlb_page(MMU *mmu, uint32_t address) {
+    uint32_t page = address >> MMU_PAGE_SHIFT;
+    TLBEntry *entry = &mmu->tlb[page % MMU_TLB_SIZE];
+    for (int access = 0; access < MMU_ACCESS_COUNT; access++) {
+        if (entry->tags[access] == page) {
+            entry->tags[access] = MMU_NO_PAGE;
+        }
+    }
+    mmu->flushes++;
+}
+
+// Record a fault for step_paged to deliver
+static void raise_fault(MMU *mmu, uint32_t address, uint32_t cause) {
+    mmu->registers[MMU_REG_FAULT_ADDRESS] = address;
+    mmu->registers[MMU_REG_FAULT_CAUSE] = cause;
+    mmu->fault_pending = true;
+    mmu->faults++;
+}
+
+// Walk both levels; entries that are invalid or point outside memory read as unmapped
+static uint32_t walk_tables(const CPU *cpu, uint32_t address) {
+    if (address >= MMU_VIRTUAL_SIZE) {
+        return 0;
+    }
+    uint32_t directory = cpu->mmu->registers[MMU_REG_DIRECTORY];
+    uint32_t pde = read_memory(cpu->memory, directory + (address >> (MMU_PAGE_SHIFT + MMU_TABLE_SHIFT)) * sizeof(uint32_t));
+    uint32_t table = pde & ~(uint32_t)(sizeof(uint32_t) - 1);
+    if (!(pde & PTE_VALID) || table > MEMORY_SIZE - MMU_TABLE_ENTRIES * sizeof(uint32_t)) {
+        return 0;
+    }
+
+    uint32_t index = (address >> MMU_PAGE_SHIFT) % MMU_TABLE_ENTRIES;
+    uint32_t pte = read_memory(cpu->memory, table + index * sizeof(uint32_t));
+    if ((pte & ~MMU_OFFSET_MASK) > MEMORY_SIZE - MMU_PAGE_SIZE) {
+        return 0;
+    }
+    return pte;
+}
+
+// True if any IO page lies in the frame; such frames always take the slow path
+static bool frame_has_devices(const CPU *cpu, uint32_t frame) {
+    for (uint32_t page = frame / IO_PAGE_SIZE; page < (frame + MMU_PAGE_SIZE) / IO_PAGE_SIZE; page++) {
+        if (cpu->io_pages[page]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Translate through the TLB, walking the tables and refilling on a miss
+uint32_t translate_address(CPU *cpu, uint32_t address, MMUAccess access) {
+    MMU *mmu = cpu->mmu;
+    uint32_t page = address >> MMU_PAGE_SHIFT;
+    TLBEntry *entry = &mmu->tlb[page % MMU_TLB_SIZE];
+    if (entry->tags[access] == page) {
+        mmu->hits++;
+        return entry->frame | (address & MMU_OFFSET_MASK);
+    }
+
+    mmu->misses++;
+    uint32_t pte = walk_tables(cpu, address);
+    if (!(pte & PTE_VALID)) {
+        raise_fault(mmu, address, access);
+        return MMU_FAULT;
+    }
+
+    uint32_t frame = pte & ~MMU_OFFSET_MASK;
+    if (!frame_has_devices(cpu, frame)) {
+        for (int i = 0; i < MMU_ACCESS_COUNT; i++) {
+            entry->tags[i] = (pte & access_bits[i]) ? page : MMU_NO_PAGE;
+        }
+        entry->frame = frame;
+        entry->host = cpu->memory + frame;
+    }
+    if (!(pte & access_bits[access])) {
+        raise_fault(mmu, address, access | MMU_CAUSE_PRESENT);
+        return MMU_FAULT;
+    }
+    return frame | (address & MMU_OFFSET_MASK);
+}
+
+// Translate every page of a range and check the frames follow each other
+bool translate_range(CPU *cpu, uint32_t *address, uint32_t length, MMUAccess access) {
+    if (length == 0) {
+        return true;
+    }
+    uint32_t start = *address;
+    uint32_t physical = translate_address(cpu, start, access);
+    if (physical == MMU_FAULT) {
+        return false;
+    }
+    if (length > MMU_VIRTUAL_SIZE - start) {
+        raise_fault(cpu->mmu, MMU_VIRTUAL_SIZE, access);
+        return false;
+    }
+
+    uint32_t last_page = (start + length - 1) >> MMU_PAGE_SHIFT;
+    for (uint32_t page = (start >> MMU_PAGE_SHIFT) + 1; page <= last_page; page++) {
+        uint32_t next = translate_address(cpu, page << MMU_PAGE_SHIFT, access);
+        if (next == MMU_FAULT) {
+            return false;
+        }
+        if (next != physical + ((page << MMU_PAGE_SHIFT) - start)) {
+            fprintf(stderr, "Error: Range 0x%X+%u is not physically contiguous\n", start, length);
+            cpu->halted = true;
+            return false;
+        }
+    }
+    *address = physical;
+    return true;
+}
+
+// Push the flags and the faulting PC and enter the handler
+static void enter_page_fault(CPU *cpu) {
+    MMU *mmu = cpu->mmu;
+    uint32_t address = mmu->registers[MMU_REG_FAULT_ADDRESS];
+    uint32_t cause = mmu->registers[MMU_REG_FAULT_CAUSE];
+    uint32_t handler = mmu->registers[MMU_REG_FAULT_HANDLER];
+    mmu->fault_pending = false;
+    if (handler == 0) {
+        fprintf(stderr, "Error: Page fault on %s of 0x%X at PC 0x%X with no handler\n",
+                access_names[cause & ~MMU_CAUSE_PRESENT], address, cpu->program_counter);
+        cpu->halted = true;
+        return;
+    }
+
+    cpu->stack_pointer -= WORD_BYTES;
+    store_word(cpu, cpu->stack_pointer, pack_flags(cpu));
+    cpu->stack_pointer -= WORD_BYTES;
+    store_word(cpu, cpu->stack_pointer, cpu->program_counter);
+    if (mmu->fault_pending) {
+        fprintf(stderr, "Error: Double fault on 0x%X entering the page fault handler\n",
+                mmu->registers[MMU_REG_FAULT_ADDRESS]);
+        cpu->halted = true;
+        return;
+    }
+
+    cpu->flags[FLAG_INTERRUPT] = false;
+    cpu->program_counter = handler;
+}
+
+// Execute one instruction, rolling it back if any of its accesses faults
+void step_paged(CPU *cpu) {
+    MMU *mmu = cpu->mmu;
+    sword_t registers[REGISTER_COUNT];
+    bool flags[16];
+    uint64_t perf[PERF_COUNTER_COUNT];
+    uint32_t pc = cpu->program_counter;
+    uint32_t sp = cpu->stack_pointer;
+    memcpy(registers, cpu->registers, sizeof(registers));
+    memcpy(flags, cpu->flags, sizeof(flags));
+    memcpy(perf, cpu->perf_counters, sizeof(perf));
+
+    uint32_t length;
+    uint32_t raw = fetch_translated(cpu, pc, &length);
+    if (!mmu->fault_pending) {
+        if (length == 0) {
+            fprintf(stderr, "Error: Misaligned instruction fetch at %08X.\n", pc);
+            cpu->halted = true;
+            return;
+        }
+        cpu->instruction_register = raw;
+        cpu->instruction_length = length;
+        cpu->program_counter += length;
+        execute_instruction(cpu, decode_instruction(raw));
+    }
+    if (!mmu->fault_pending || cpu->halted) {
+        return;
+    }
+
+    // Accesses are translated before anything is written, so restoring the
+    // registers undoes the whole instruction
+    cpu->program_counter = pc;
+    cpu->stack_pointer = sp;
+    memcpy(cpu->registers, registers, sizeof(registers));
+    memcpy(cpu->flags, flags, sizeof(flags));
+    memcpy(cpu->perf_counters, perf, sizeof(perf));
+    enter_page_fault(cpu);
+}
+
+// Display TLB statistics
+void display_mmu(const MMU *mmu) {
+    if (!mmu->used) {
+        return;
+    }
+
+    uint64_t lookups = mmu->hits + mmu->misses;
+    printf("\n=== MMU ===\n");
+    printf("TLB hits:    %llu (%.2f%%)\n", (unsigned long long)mmu->hits,
+           lookups ? 100.0 * (double)mmu->hits / (double)lookups : 0.0);
+    printf("TLB misses:  %llu\n", (unsigned long long)mmu->misses);
+    printf("Page faults: %llu\n", (unsigned long long)mmu->faults);
+    printf("TLB flushes: %llu\n", (unsigned long long)mmu->flushes);
+}
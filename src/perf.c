@@ -0,0 +1,92 @@
+#include "perf.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Monotonic wall clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Read a guest performance counter
+uint64_t read_perf_counter(const CPU *cpu, PerfCounter counter) {
+    if (counter < 0 || counter >= PERF_COUNTER_COUNT) {
+        return 0;
+    }
+    return cpu->perf_counters[counter];
+}
+
+// Clear all guest performance counters
+void reset_perf_counters(CPU *cpu) {
+    memset(cpu->perf_counters, 0, sizeof(cpu->perf_counters));
+}
+
+// Initialize host metrics
+void init_host_metrics(HostMetrics *metrics) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->current_phase = -1;
+}
+
+// Start timing a phase
+void begin_phase(HostMetrics *metrics, const char *name, const CPU *cpu) {
+    end_phase(metrics);
+    if (metrics->phase_count == PERF_MAX_PHASES) {
+        return;
+    }
+
+    metrics->current_phase = metrics->phase_count++;
+    metrics->phase_names[metrics->current_phase] = name;
+    metrics->phase_seconds[metrics->current_phase] = 0.0;
+    metrics->phase_start = now_seconds();
+    metrics->start_instructions = cpu ? cpu->perf_counters[PERF_INSTRUCTIONS] : UINT64_MAX;
+}
+
+// Close the open phase
+void end_phase(HostMetrics *metrics) {
+    if (metrics->current_phase < 0) {
+        return;
+    }
+
+    double elapsed = now_seconds() - metrics->phase_start;
+    metrics->phase_seconds[metrics->current_phase] = elapsed;
+    if (metrics->start_instructions != UINT64_MAX) {
+        metrics->execute_seconds += elapsed;
+    }
+    metrics->current_phase = -1;
+}
+
+// Display simulator throughput and the guest instruction mix
+void display_host_metrics(const HostMetrics *metrics, const CPU *cpu) {
+    const uint64_t *perf = cpu->perf_counters;
+    double instructions = perf[PERF_INSTRUCTIONS] ? (double)perf[PERF_INSTRUCTIONS] : 1.0;
+    double total_seconds = 0.0;
+
+    printf("\n=== Performance Report ===\n");
+    printf("Phases:\n");
+    for (int i = 0; i < metrics->phase_count; i++) {
+        printf("  %-12s %10.6f s\n", metrics->phase_names[i], metrics->phase_seconds[i]);
+        total_seconds += metrics->phase_seconds[i];
+    }
+    printf("  %-12s %10.6f s\n", "total", total_seconds);
+
+    printf("Retired instructions: %llu\n", (unsigned long long)perf[PERF_INSTRUCTIONS]);
+    if (metrics->execute_seconds > 0.0) {
+        printf("Simulator speed:      %.2f MIPS\n", perf[PERF_INSTRUCTIONS] / metrics->execute_seconds / 1e6);
+    }
+    if (perf[PERF_CYCLES] > 0) {
+        printf("Cycles:               %llu (CPI %.3f)\n", (unsigned long long)perf[PERF_CYCLES],
+               perf[PERF_CYCLES] / instructions);
+        printf("Cache misses:         %llu (%.2f per 1K instructions)\n",
+               (unsigned long long)perf[PERF_CACHE_MISSES], 1000.0 * perf[PERF_CACHE_MISSES] / instructions);
+    }
+
+    printf("Instruction mix:\n");
+    printf("  Branches:  %12llu %7.2f%%\n", (unsigned long long)perf[PERF_BRANCHES],
+           100.0 * perf[PERF_BRANCHES] / instructions);
+    printf("  Loads:     %12llu %7.2f%%\n", (unsigned long long)perf[PERF_LOADS],
+           100.0 * perf[PERF_LOADS] / instructions);
+    printf("  Stores:    %12llu %7.2f%%\n", (unsigned long long)perf[PERF_STORES],
+           100.0 * perf[PERF_STORES] / instructions);
+}
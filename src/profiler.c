@@ -0,0 +1,307 @@
+#include "profiler.h"
+#include "debug.h"
+#include "compressed.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_NODE_CAPACITY 64
+
+// Per-function totals gathered from the calling-context tree
+typedef struct {
+    int node;               // First context node of the function
+    uint64_t exclusive;
+    uint64_t inclusive;
+} FunctionProfile;
+
+// Symbol index of the function containing an address, -1 if unknown
+static int function_at(const Profiler *profiler, uint32_t address) {
+    if (profiler->symbols == NULL) {
+        return -1;
+    }
+    const Symbol *symbol = find_symbol(profiler->symbols, address);
+    return symbol ? (int)(symbol - profiler->symbols->symbols) : -1;
+}
+
+// Functions are identified by symbol, or by entry address when unnamed
+static bool same_function(const ProfileNode *a, const ProfileNode *b) {
+    if (a->function >= 0 || b->function >= 0) {
+        return a->function == b->function;
+    }
+    return a->entry == b->entry;
+}
+
+static void function_label(const Profiler *profiler, int function, uint32_t entry, char *buffer, size_t size) {
+    if (function >= 0) {
+        snprintf(buffer, size, "%s", profiler->symbols->symbols[function].name);
+    } else {
+        snprintf(buffer, size, "0x%03X", entry);
+    }
+}
+
+// Append a calling-context node, growing the array as needed
+static int add_node(Profiler *profiler, int parent, uint32_t entry) {
+    if (profiler->node_count == profiler->node_capacity) {
+        int capacity = profiler->node_capacity * 2;
+        ProfileNode *nodes = realloc(profiler->nodes, sizeof(ProfileNode) * capacity);
+        if (!nodes) {
+            return -1;
+        }
+        profiler->nodes = nodes;
+        profiler->node_capacity = capacity;
+    }
+
+    int index = profiler->node_count++;
+    ProfileNode *node = &profiler->nodes[index];
+    node->function = function_at(profiler, entry);
+    node->entry = entry;
+    node->parent = parent;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->self_count = 0;
+
+    if (parent >= 0) {
+        node->next_sibling = profiler->nodes[parent].first_child;
+        profiler->nodes[parent].first_child = index;
+    }
+    return index;
+}
+
+// CALL: descend into the child context for the target
+static void enter_function(Profiler *profiler, uint32_t target) {
+    if (profiler->depth >= PROFILER_MAX_DEPTH) {
+        profiler->overflow++;
+        return;
+    }
+
+    int child = profiler->nodes[profiler->current].first_child;
+    while (child >= 0 && profiler->nodes[child].entry != target) {
+        child = profiler->nodes[child].next_sibling;
+    }
+    if (child < 0) {
+        child = add_node(profiler, profiler->current, target);
+        if (child < 0) {
+            profiler->overflow++;
+            return;
+        }
+    }
+
+    profiler->current = child;
+    profiler->depth++;
+}
+
+// RET: return to the caller's context
+static void leave_function(Profiler *profiler) {
+    if (profiler->overflow > 0) {
+        profiler->overflow--;
+    } else if (profiler->depth > 0) {
+        profiler->current = profiler->nodes[profiler->current].parent;
+        profiler->depth--;
+    }
+}
+
+// Initialize the profiler
+int init_profiler(Profiler *profiler, const CPU *cpu, const Linker *symbols) {
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->symbols = symbols;
+    profiler->nodes = malloc(sizeof(ProfileNode) * INITIAL_NODE_CAPACITY);
+    if (!profiler->nodes) {
+        return -1;
+    }
+    profiler->node_capacity = INITIAL_NODE_CAPACITY;
+    profiler->current = add_node(profiler, -1, cpu->program_counter);
+    return 0;
+}
+
+// Release profiler memory
+void free_profiler(Profiler *profiler) {
+    free(profiler->nodes);
+    profiler->nodes = NULL;
+    profiler->node_count = 0;
+    profiler->node_capacity = 0;
+}
+
+// Run the CPU, counting every instruction
+void profile_cpu(Profiler *profiler, CPU *cpu, uint64_t max_instructions) {
+    for (uint64_t executed = 0; !cpu->halted && executed < max_instructions; executed++) {
+        uint32_t pc = cpu->program_counter;
+        uint32_t length;
+        uint32_t raw = decode_cached(cpu, pc, &length);
+        if (pc < CODE_START || length == 0) {
+            step_cpu(cpu); // Let fetch report the bounds or alignment error
+            break;
+        }
+
+        Opcode opcode = decode_instruction(raw).opcode;
+        step_cpu(cpu);
+
+        profiler->pc_counts[pc / 2]++;
+        profiler->opcode_counts[opcode & (PROFILER_OPCODES - 1)]++;
+        profiler->nodes[profiler->current].self_count++;
+        profiler->total++;
+
+        if (opcode == CALL) {
+            enter_function(profiler, cpu->program_counter);
+        } else if (opcode == RET) {
+            leave_function(profiler);
+        }
+    }
+}
+
+static int compare_inclusive(const void *a, const void *b) {
+    const FunctionProfile *fa = a, *fb = b;
+    if (fa->inclusive != fb->inclusive) {
+        return fa->inclusive < fb->inclusive ? 1 : -1;
+    }
+    return fa->exclusive < fb->exclusive ? 1 : (fa->exclusive > fb->exclusive ? -1 : 0);
+}
+
+// Display per-function and per-opcode counts
+void display_profile(const Profiler *profiler) {
+    int n = profiler->node_count;
+    uint64_t *subtree = calloc(n, sizeof(uint64_t));
+    FunctionProfile *functions = calloc(n, sizeof(FunctionProfile));
+    if (!subtree || !functions) {
+        free(subtree);
+        free(functions);
+        return;
+    }
+
+    // Children are always created after their parent
+    for (int i = n - 1; i >= 0; i--) {
+        subtree[i] += profiler->nodes[i].self_count;
+        if (profiler->nodes[i].parent >= 0) {
+            subtree[profiler->nodes[i].parent] += subtree[i];
+        }
+    }
+
+    int function_count = 0;
+    for (int i = 0; i < n; i++) {
+        const ProfileNode *node = &profiler->nodes[i];
+        int f = 0;
+        while (f < function_count && !same_function(&profiler->nodes[functions[f].node], node)) {
+            f++;
+        }
+        if (f == function_count) {
+            functions[f].node = i;
+            function_count++;
+        }
+        functions[f].exclusive += node->self_count;
+
+        // Count the subtree once, at the outermost frame of a recursive function
+        bool outermost = true;
+        for (int p = node->parent; p >= 0; p = profiler->nodes[p].parent) {
+            if (same_function(&profiler->nodes[p], node)) {
+                outermost = false;
+                break;
+            }
+        }
+        if (outermost) {
+            functions[f].inclusive += subtree[i];
+        }
+    }
+    qsort(functions, function_count, sizeof(FunctionProfile), compare_inclusive);
+
+    printf("\n=== Instruction Profile ===\n");
+    printf("Instructions executed: %llu\n", (unsigned long long)profiler->total);
+    printf("\n%-24s %14s %8s %14s %8s\n", "Function", "Inclusive", "%", "Exclusive", "%");
+    double total = profiler->total ? (double)profiler->total : 1.0;
+    for (int f = 0; f < function_count; f++) {
+        char label[64];
+        const ProfileNode *node = &profiler->nodes[functions[f].node];
+        function_label(profiler, node->function, node->entry, label, sizeof(label));
+        printf("%-24s %14llu %7.2f%% %14llu %7.2f%%\n", label,
+               (unsigned long long)functions[f].inclusive, 100.0 * functions[f].inclusive / total,
+               (unsigned long long)functions[f].exclusive, 100.0 * functions[f].exclusive / total);
+    }
+
+    printf("\n%-24s %14s %8s\n", "Opcode", "Count", "%");
+    for (int op = 0; op < PROFILER_OPCODES; op++) {
+        if (profiler->opcode_counts[op] == 0) {
+            continue;
+        }
+        const char *name = opcode_name(op);
+        char unknown[16];
+        if (name == NULL) {
+            snprintf(unknown, sizeof(unknown), "0x%02X", op);
+            name = unknown;
+        }
+        printf("%-24s %14llu %7.2f%%\n", name, (unsigned long long)profiler->opcode_counts[op],
+               100.0 * profiler->opcode_counts[op] / total);
+    }
+
+    free(subtree);
+    free(functions);
+}
+
+// Write folded stacks for flamegraph tools
+void write_folded_stacks(const Profiler *profiler, FILE *out) {
+    int path[PROFILER_MAX_DEPTH + 1];
+
+    for (int i = 0; i < profiler->node_count; i++) {
+        if (profiler->nodes[i].self_count == 0) {
+            continue;
+        }
+
+        int depth = 0;
+        for (int n = i; n >= 0 && depth <= PROFILER_MAX_DEPTH; n = profiler->nodes[n].parent) {
+            path[depth++] = n;
+        }
+        for (int d = depth - 1; d >= 0; d--) {
+            char label[64];
+            const ProfileNode *node = &profiler->nodes[path[d]];
+            function_label(profiler, node->function, node->entry, label, sizeof(label));
+            fprintf(out, "%s%s", label, d > 0 ? ";" : "");
+        }
+        fprintf(out, " %llu\n", (unsigned long long)profiler->nodes[i].self_count);
+    }
+}
+
+// List one instruction; compressed ones show their 15-bit encoding
+static void list_instruction(const Profiler *profiler, FILE *out, uint32_t address, uint32_t encoding,
+                             bool compressed, double total) {
+    if (profiler->symbols) {
+        const Symbol *symbol = find_symbol(profiler->symbols, address);
+        if (symbol && symbol->address * sizeof(uint32_t) == address) {
+            fprintf(out, "%s:\n", symbol->name);
+        }
+    }
+
+    uint64_t count = profiler->pc_counts[address / 2];
+    char word[9];
+    char text[64];
+    snprintf(word, sizeof(word), compressed ? "%04X" : "%08X", encoding);
+    disassemble_instruction(compressed ? expand_compressed(encoding) : encoding, address, text, sizeof(text));
+    if (count) {
+        fprintf(out, "%14llu %7.2f%%  0x%03X: %-8s  %s\n", (unsigned long long)count,
+                100.0 * count / total, address, word, text);
+    } else {
+        fprintf(out, "%14s %8s  0x%03X: %-8s  %s\n", "-", "", address, word, text);
+    }
+}
+
+// Write an annotated disassembly listing
+void write_annotated_listing(const Profiler *profiler, const CPU *cpu, FILE *out) {
+    // List through the last executed word and any code following it
+    uint32_t end = CODE_START;
+    for (uint32_t address = CODE_START; address <= MEMORY_SIZE - 2; address += 2) {
+        if (profiler->pc_counts[address / 2]) {
+            end = address & ~(uint32_t)3;
+        }
+    }
+    while (end + sizeof(uint32_t) <= MEMORY_SIZE - sizeof(uint32_t) &&
+           read_memory(cpu->memory, end + sizeof(uint32_t)) != 0) {
+        end += sizeof(uint32_t);
+    }
+
+    double total = profiler->total ? (double)profiler->total : 1.0;
+    fprintf(out, "%14s %8s  %-6s %-8s  %s\n", "Count", "%", "Addr", "Word", "Instruction");
+    for (uint32_t address = CODE_START; address <= end; address += sizeof(uint32_t)) {
+        uint32_t raw = read_memory(cpu->memory, address);
+        if (is_compressed_pair(raw)) {
+            list_instruction(profiler, out, address, raw & COMPRESSED_MASK, true, total);
+            list_instruction(profiler, out, address + 2, (raw >> COMPRESSED_SHIFT) & COMPRESSED_MASK, true, total);
+        } else {
+            list_instruction(profiler, out, address, raw, false, total);
+        }
+    }
+}
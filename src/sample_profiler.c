@@ -0,0 +1,263 @@
+#include "sample_profiler.h"
+#include "instructions.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#define RING_MASK (SAMPLE_PROFILER_RING_SIZE - 1)
+#define HOT_PC_COUNT 10
+
+// Per-function totals for the report
+typedef struct {
+    int symbol;         // Index into the symbol table, -1 if unnamed
+    uint32_t entry;
+    uint64_t self;
+    uint64_t total;
+} FunctionSamples;
+
+// The signal handler can only reach the profiler through a global
+static SampleProfiler *volatile active_profiler = NULL;
+static struct sigaction previous_action;
+
+// SIGPROF handler: copy PC and the innermost frames into the ring
+static void sigprof_handler(int signo) {
+    (void)signo;
+    SampleProfiler *profiler = active_profiler;
+    if (profiler == NULL) {
+        return;
+    }
+
+    unsigned head = atomic_load_explicit(&profiler->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&profiler->tail, memory_order_acquire);
+    if (head - tail >= SAMPLE_PROFILER_RING_SIZE) {
+        atomic_fetch_add_explicit(&profiler->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    PCSample *sample = &profiler->ring[head & RING_MASK];
+    uint32_t depth = profiler->depth;
+    uint32_t frames = depth < SAMPLE_PROFILER_FRAMES ? depth : SAMPLE_PROFILER_FRAMES;
+
+    sample->pc = profiler->cpu->program_counter;
+    for (uint32_t i = 0; i < frames; i++) {
+        sample->frames[i] = profiler->stack[depth - 1 - i];
+    }
+    sample->depth = frames;
+
+    atomic_store_explicit(&profiler->head, head + 1, memory_order_release);
+}
+
+// Fold buffered samples into the aggregate counters
+static void drain_samples(SampleProfiler *profiler) {
+    unsigned tail = atomic_load_explicit(&profiler->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&profiler->head, memory_order_acquire);
+
+    for (; tail != head; tail++) {
+        const PCSample *sample = &profiler->ring[tail & RING_MASK];
+
+        if (sample->pc < MEMORY_SIZE) {
+            profiler->pc_samples[sample->pc / 2]++;
+        }
+        if (sample->depth > 0 && sample->frames[0] < MEMORY_SIZE) {
+            profiler->self_samples[sample->frames[0] / 2]++;
+        }
+
+        // Count each function once per sample, even when recursive
+        for (uint32_t i = 0; i < sample->depth; i++) {
+            uint32_t entry = sample->frames[i];
+            bool seen = entry >= MEMORY_SIZE;
+            for (uint32_t j = 0; j < i && !seen; j++) {
+                seen = sample->frames[j] == entry;
+            }
+            if (!seen) {
+                profiler->total_samples_by_entry[entry / 2]++;
+            }
+        }
+        profiler->total_samples++;
+    }
+
+    atomic_store_explicit(&profiler->tail, tail, memory_order_release);
+}
+
+// Install the handler and start the timer
+int start_sample_profiler(SampleProfiler *profiler, CPU *cpu, uint32_t interval_us) {
+    if (active_profiler != NULL) {
+        fprintf(stderr, "Error: A sample profiler is already running.\n");
+        return -1;
+    }
+
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->cpu = cpu;
+    profiler->interval_us = interval_us ? interval_us : SAMPLE_PROFILER_DEFAULT_US;
+    profiler->stack[0] = cpu->program_counter; // Root frame
+    profiler->depth = 1;
+    active_profiler = profiler;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigprof_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous_action) != 0) {
+        perror("Error installing SIGPROF handler");
+        active_profiler = NULL;
+        return -1;
+    }
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = profiler->interval_us / 1000000;
+    timer.it_interval.tv_usec = profiler->interval_us % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+        perror("Error starting profiling timer");
+        sigaction(SIGPROF, &previous_action, NULL);
+        active_profiler = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Stop the timer and collect the remaining samples
+void stop_sample_profiler(SampleProfiler *profiler) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &previous_action, NULL);
+    active_profiler = NULL;
+    drain_samples(profiler);
+}
+
+// Enter a frame on the shadow stack, or count it past the top
+static void push_frame(SampleProfiler *profiler, uint32_t entry) {
+    uint32_t depth = profiler->depth;
+    if (depth < SAMPLE_PROFILER_STACK_SIZE) {
+        profiler->stack[depth] = entry;
+        atomic_signal_fence(memory_order_release);
+        profiler->depth = depth + 1;
+    } else {
+        profiler->overflow++;
+    }
+}
+
+// Leave the innermost frame, never the root
+static void pop_frame(SampleProfiler *profiler) {
+    if (profiler->overflow > 0) {
+        profiler->overflow--;
+    } else if (profiler->depth > 1) {
+        profiler->depth--;
+    }
+}
+
+// Run the CPU while maintaining the shadow call stack
+void sample_profile_cpu(SampleProfiler *profiler, CPU *cpu, uint64_t max_instructions) {
+    for (uint64_t executed = 0; !cpu->halted && executed < max_instructions; executed++) {
+        uint64_t retired = cpu->perf_counters[PERF_INSTRUCTIONS];
+        step_cpu(cpu);
+
+        if (cpu->perf_counters[PERF_INSTRUCTIONS] == retired) {
+            // Nothing was fetched: either fetch halted or an interrupt
+            // entered its handler in place of this step's instruction
+            if (!cpu->halted) {
+                push_frame(profiler, cpu->program_counter);
+            }
+        } else {
+            // The executed instruction is in the instruction register
+            Opcode opcode = (Opcode)(cpu->instruction_register >> 24);
+            if (opcode == CALL && !cpu->halted) {
+                push_frame(profiler, cpu->program_counter);
+            } else if (opcode == RET || opcode == IRET) {
+                pop_frame(profiler);
+            }
+        }
+
+        if ((executed & SAMPLE_PROFILER_DRAIN_MASK) == 0) {
+            drain_samples(profiler);
+        }
+    }
+}
+
+static int compare_self(const void *a, const void *b) {
+    const FunctionSamples *fa = a, *fb = b;
+    if (fa->self != fb->self) {
+        return fa->self < fb->self ? 1 : -1;
+    }
+    return fa->total < fb->total ? 1 : (fa->total > fb->total ? -1 : 0);
+}
+
+static void function_label(const Linker *symbols, int symbol, uint32_t entry, char *buffer, size_t size) {
+    if (symbol >= 0) {
+        snprintf(buffer, size, "%s", symbols->symbols[symbol].name);
+    } else {
+        snprintf(buffer, size, "0x%03X", entry);
+    }
+}
+
+// Display samples aggregated per symbol
+void display_sample_profile(const SampleProfiler *profiler, const Linker *symbols) {
+    FunctionSamples functions[INSTRUCTION_SLOTS];
+    int function_count = 0;
+
+    for (uint32_t slot = 0; slot < INSTRUCTION_SLOTS; slot++) {
+        if (profiler->self_samples[slot] == 0 && profiler->total_samples_by_entry[slot] == 0) {
+            continue;
+        }
+
+        uint32_t entry = slot * 2;
+        const Symbol *symbol = symbols ? find_symbol(symbols, entry) : NULL;
+        int index = symbol ? (int)(symbol - symbols->symbols) : -1;
+
+        int f = 0;
+        while (f < function_count && !(index >= 0 ? functions[f].symbol == index
+                                                  : functions[f].symbol < 0 && functions[f].entry == entry)) {
+            f++;
+        }
+        if (f == function_count) {
+            functions[f].symbol = index;
+            functions[f].entry = entry;
+            functions[f].self = 0;
+            functions[f].total = 0;
+            function_count++;
+        }
+        functions[f].self += profiler->self_samples[slot];
+        functions[f].total += profiler->total_samples_by_entry[slot];
+    }
+    qsort(functions, function_count, sizeof(FunctionSamples), compare_self);
+
+    double total = profiler->total_samples ? (double)profiler->total_samples : 1.0;
+    printf("\n=== Sampling Profile ===\n");
+    printf("Samples: %llu (every %u us of CPU time, %u dropped)\n",
+           (unsigned long long)profiler->total_samples, profiler->interval_us,
+           atomic_load(&profiler->dropped));
+    printf("\n%-24s %10s %8s %10s %8s\n", "Function", "Self", "%", "Total", "%");
+    for (int f = 0; f < function_count; f++) {
+        char label[64];
+        function_label(symbols, functions[f].symbol, functions[f].entry, label, sizeof(label));
+        printf("%-24s %10llu %7.2f%% %10llu %7.2f%%\n", label,
+               (unsigned long long)functions[f].self, 100.0 * functions[f].self / total,
+               (unsigned long long)functions[f].total, 100.0 * functions[f].total / total);
+    }
+
+    // Hottest PCs, selected without sorting the whole histogram
+    bool shown[INSTRUCTION_SLOTS] = {false};
+    printf("\nHottest PCs:\n");
+    for (int rank = 0; rank < HOT_PC_COUNT; rank++) {
+        int best = -1;
+        for (uint32_t slot = 0; slot < INSTRUCTION_SLOTS; slot++) {
+            if (!shown[slot] && profiler->pc_samples[slot] > 0 &&
+                (best < 0 || profiler->pc_samples[slot] > profiler->pc_samples[best])) {
+                best = (int)slot;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        shown[best] = true;
+
+        uint32_t address = (uint32_t)best * 2;
+        const Symbol *symbol = symbols ? find_symbol(symbols, address) : NULL;
+        printf("  0x%03X %-20s %10llu %7.2f%%\n", address, symbol ? symbol->name : "",
+               (unsigned long long)profiler->pc_samples[best], 100.0 * profiler->pc_samples[best] / total);
+    }
+}
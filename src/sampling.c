@@ -0,0 +1,507 @@
+#include "sampling.h"
+#include "timing.h"
+#include "hostcalls.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define KMEANS_MAX_ITERATIONS 100
+#define BIC_THRESHOLD 0.9       // Smallest k reaching 90% of the BIC range
+
+// One fast-forward interval: its starting checkpoint and basic-block vector
+typedef struct {
+    CPU start;
+    double bbv[SAMPLING_BBV_DIM];
+    uint64_t length;
+} Interval;
+
+// Monotonic wall clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Hash a basic-block start address into a BBV bucket
+static uint32_t bbv_bucket(uint32_t pc) {
+    uint32_t block = pc / sizeof(uint32_t);
+    return (block * 2654435761u) >> (32 - SAMPLING_BBV_BITS);
+}
+
+// Deterministic LCG so clustering is reproducible
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static double squared_distance(const double *a, const double *b) {
+    double sum = 0.0;
+    for (int d = 0; d < SAMPLING_BBV_DIM; d++) {
+        double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Merge adjacent interval pairs, doubling the interval length
+static int merge_intervals(Interval *intervals, int count) {
+    int merged = 0;
+    for (int i = 0; i < count; i += 2, merged++) {
+        if (merged != i) {
+            intervals[merged] = intervals[i];
+        }
+        if (i + 1 < count) {
+            for (int d = 0; d < SAMPLING_BBV_DIM; d++) {
+                intervals[merged].bbv[d] += intervals[i + 1].bbv[d];
+            }
+            intervals[merged].length += intervals[i + 1].length;
+        }
+    }
+    return merged;
+}
+
+// Restart a copy of the CPU from a checkpoint for re-execution. Guest memory,
+// including the heap, travels with the checkpoint; the copy gets its own quiet
+// host-call table so re-executed code neither prints again nor adds to the
+// counts of the real run
+static void resume_copy(CPU *cpu, const CPU *start, HostCalls *replay) {
+    *cpu = *start;
+    cpu->trace_execution = false;
+    if (cpu->host_calls) {
+        *replay = *cpu->host_calls;
+        replay->quiet = true;
+        cpu->host_calls = replay;
+    }
+}
+
+// Fast-forward functionally, collecting one BBV per interval
+static int fast_forward(const CPU *initial, const SamplingConfig *config, Interval *intervals,
+                        uint64_t *interval_length, uint64_t *total) {
+    CPU *cpu = malloc(sizeof(CPU));
+    if (!cpu) {
+        return -1;
+    }
+    *cpu = *initial;
+    cpu->trace_execution = false;
+
+    int count = 1;
+    Interval *current = &intervals[0];
+    memset(current, 0, sizeof(*current));
+    current->start = *cpu;
+
+    uint32_t block_start = cpu->program_counter;
+    uint64_t block_length = 0;
+    *total = 0;
+
+    while (!cpu->halted && *total < config->max_instructions) {
+        uint32_t pc = cpu->program_counter;
+        step_cpu(cpu);
+        (*total)++;
+        block_length++;
+        current->length++;
+
+        // A PC discontinuity ends the dynamic basic block
+        if (cpu->halted || cpu->program_counter != pc + cpu->instruction_length) {
+            current->bbv[bbv_bucket(block_start)] += (double)block_length;
+            block_start = cpu->program_counter;
+            block_length = 0;
+        }
+
+        if (current->length == *interval_length && !cpu->halted) {
+            // Credit the partial block to this interval
+            current->bbv[bbv_bucket(block_start)] += (double)block_length;
+            block_length = 0;
+
+            if (count == SAMPLING_MAX_INTERVALS) {
+                count = merge_intervals(intervals, count);
+                *interval_length *= 2;
+            }
+            current = &intervals[count++];
+            memset(current, 0, sizeof(*current));
+            current->start = *cpu;
+        }
+    }
+    current->bbv[bbv_bucket(block_start)] += (double)block_length;
+
+    // A merge may have left the last interval half full; drop an empty tail
+    if (current->length == 0 && count > 1) {
+        count--;
+    }
+
+    free(cpu);
+    return count;
+}
+
+// Lloyd's k-means with k-means++ seeding; returns the sum of squared errors
+static double kmeans(const double (*points)[SAMPLING_BBV_DIM], int n, int k,
+                     double (*centroids)[SAMPLING_BBV_DIM], int *assignment) {
+    uint32_t seed = 12345u;
+    double *nearest = malloc(sizeof(double) * n);
+    if (!nearest) {
+        return -1.0;
+    }
+
+    // k-means++ seeding
+    memcpy(centroids[0], points[next_random(&seed) % n], sizeof(centroids[0]));
+    for (int c = 1; c < k; c++) {
+        double total = 0.0;
+        for (int i = 0; i < n; i++) {
+            nearest[i] = INFINITY;
+            for (int j = 0; j < c; j++) {
+                double dist = squared_distance(points[i], centroids[j]);
+                if (dist < nearest[i]) {
+                    nearest[i] = dist;
+                }
+            }
+            total += nearest[i];
+        }
+        double target = total * (double)(next_random(&seed) % 1000000) / 1000000.0;
+        int chosen = n - 1;
+        for (int i = 0; i < n; i++) {
+            target -= nearest[i];
+            if (target < 0.0) {
+                chosen = i;
+                break;
+            }
+        }
+        memcpy(centroids[c], points[chosen], sizeof(centroids[c]));
+    }
+
+    for (int i = 0; i < n; i++) {
+        assignment[i] = -1;
+    }
+
+    double sse = 0.0;
+    for (int iteration = 0; iteration < KMEANS_MAX_ITERATIONS; iteration++) {
+        bool changed = false;
+
+        // Assignment step
+        sse = 0.0;
+        for (int i = 0; i < n; i++) {
+            int best = 0;
+            double best_dist = squared_distance(points[i], centroids[0]);
+            for (int c = 1; c < k; c++) {
+                double dist = squared_distance(points[i], centroids[c]);
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = c;
+                }
+            }
+            if (assignment[i] != best) {
+                assignment[i] = best;
+                changed = true;
+            }
+            nearest[i] = best_dist;
+            sse += best_dist;
+        }
+        if (!changed) {
+            break;
+        }
+
+        // Update step
+        for (int c = 0; c < k; c++) {
+            double sum[SAMPLING_BBV_DIM] = {0};
+            int members = 0;
+            for (int i = 0; i < n; i++) {
+                if (assignment[i] == c) {
+                    for (int d = 0; d < SAMPLING_BBV_DIM; d++) {
+                        sum[d] += points[i][d];
+                    }
+                    members++;
+                }
+            }
+            if (members == 0) {
+                // Re-seed an empty cluster with the worst-fitting point
+                int worst = 0;
+                for (int i = 1; i < n; i++) {
+                    if (nearest[i] > nearest[worst]) {
+                        worst = i;
+                    }
+                }
+                memcpy(centroids[c], points[worst], sizeof(centroids[c]));
+                nearest[worst] = 0.0;
+                continue;
+            }
+            for (int d = 0; d < SAMPLING_BBV_DIM; d++) {
+                centroids[c][d] = sum[d] / members;
+            }
+        }
+    }
+
+    free(nearest);
+    return sse;
+}
+
+// Bayesian Information Criterion of a clustering (spherical Gaussian model)
+static double bic_score(const int *assignment, int n, int k, double sse) {
+    const int d = SAMPLING_BBV_DIM;
+    double variance = (n > k) ? sse / ((double)d * (n - k)) : 0.0;
+    if (variance < 1e-12) {
+        variance = 1e-12;
+    }
+
+    double log_likelihood = 0.0;
+    for (int c = 0; c < k; c++) {
+        int members = 0;
+        for (int i = 0; i < n; i++) {
+            if (assignment[i] == c) {
+                members++;
+            }
+        }
+        if (members == 0) {
+            continue;
+        }
+        log_likelihood += members * log((double)members) - members * log((double)n)
+                        - members * d / 2.0 * log(2.0 * M_PI * variance)
+                        - (members - 1) * d / 2.0;
+    }
+
+    double parameters = (double)k * (d + 1);
+    return log_likelihood - parameters / 2.0 * log((double)n);
+}
+
+// Time one interval in detailed mode after warming caches and predictor
+static double measure_interval(const Interval *intervals, int index, const SamplingConfig *config,
+                               uint64_t *detailed) {
+    TimingModel model;
+    HostCalls replay;
+    CPU *cpu = malloc(sizeof(CPU));
+    if (!cpu) {
+        return 0.0;
+    }
+    init_timing_model(&model);
+
+    if (index > 0 && config->warmup_length > 0) {
+        const Interval *previous = &intervals[index - 1];
+        uint64_t warmup = config->warmup_length < previous->length ? config->warmup_length : previous->length;
+
+        resume_copy(cpu, &previous->start, &replay);
+        for (uint64_t i = 0; i < previous->length - warmup && !cpu->halted; i++) {
+            step_cpu(cpu);
+        }
+        for (uint64_t i = 0; i < warmup && !cpu->halted; i++) {
+            timing_step(&model, cpu);
+        }
+        *detailed += model.instructions;
+        reset_timing_stats(&model);
+    } else {
+        resume_copy(cpu, &intervals[index].start, &replay);
+    }
+
+    for (uint64_t i = 0; i < intervals[index].length && !cpu->halted; i++) {
+        timing_step(&model, cpu);
+    }
+    *detailed += model.instructions;
+
+    free(cpu);
+    return timing_cpi(&model);
+}
+
+// Default sampling parameters
+void init_sampling_config(SamplingConfig *config) {
+    config->interval_length = 10000;
+    config->warmup_length = 2000;
+    config->max_clusters = 8;
+    config->max_instructions = UINT64_MAX;
+    config->validate = false;
+}
+
+// Run a SimPoint-style sampled simulation
+int run_sampled_simulation(const CPU *initial, const SamplingConfig *config, SamplingResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (config->interval_length == 0 || config->max_clusters < 1) {
+        fprintf(stderr, "Error: Invalid sampling configuration.\n");
+        return -1;
+    }
+
+    Interval *intervals = malloc(sizeof(Interval) * SAMPLING_MAX_INTERVALS);
+    double (*points)[SAMPLING_BBV_DIM] = malloc(sizeof(*points) * SAMPLING_MAX_INTERVALS);
+    int *assignment = malloc(sizeof(int) * SAMPLING_MAX_INTERVALS);
+    int *best_assignment = malloc(sizeof(int) * SAMPLING_MAX_INTERVALS);
+    if (!intervals || !points || !assignment || !best_assignment) {
+        fprintf(stderr, "Error: Out of memory for sampled simulation.\n");
+        free(intervals);
+        free(points);
+        free(assignment);
+        free(best_assignment);
+        return -1;
+    }
+
+    // Phase 1: functional fast-forward
+    double start = now_seconds();
+    result->interval_length = config->interval_length;
+    int n = fast_forward(initial, config, intervals, &result->interval_length, &result->total_instructions);
+    result->fast_forward_seconds = now_seconds() - start;
+    result->interval_count = n;
+
+    if (n <= 0 || result->total_instructions == 0) {
+        fprintf(stderr, "Error: Program executed no instructions.\n");
+        free(intervals);
+        free(points);
+        free(assignment);
+        free(best_assignment);
+        return -1;
+    }
+
+    // Phase 2: normalize BBVs and cluster, choosing k by BIC
+    for (int i = 0; i < n; i++) {
+        for (int d = 0; d < SAMPLING_BBV_DIM; d++) {
+            points[i][d] = intervals[i].bbv[d] / (double)intervals[i].length;
+        }
+    }
+
+    int max_k = config->max_clusters < n ? config->max_clusters : n;
+    if (max_k > SAMPLING_MAX_CLUSTERS) {
+        max_k = SAMPLING_MAX_CLUSTERS;
+    }
+    double bic[SAMPLING_MAX_CLUSTERS + 1];
+    double centroids[SAMPLING_MAX_CLUSTERS][SAMPLING_BBV_DIM];
+    double best_bic = -INFINITY, worst_bic = INFINITY;
+    for (int k = 1; k <= max_k; k++) {
+        double sse = kmeans((const double (*)[SAMPLING_BBV_DIM])points, n, k, centroids, assignment);
+        bic[k] = bic_score(assignment, n, k, sse);
+        if (bic[k] > best_bic) best_bic = bic[k];
+        if (bic[k] < worst_bic) worst_bic = bic[k];
+    }
+    int chosen_k = 1;
+    for (int k = 1; k <= max_k; k++) {
+        if (bic[k] >= worst_bic + BIC_THRESHOLD * (best_bic - worst_bic)) {
+            chosen_k = k;
+            break;
+        }
+    }
+    kmeans((const double (*)[SAMPLING_BBV_DIM])points, n, chosen_k, centroids, best_assignment);
+
+    // Phase 3: detailed simulation of representatives
+    start = now_seconds();
+    double pooled_sum = 0.0;
+    int pooled_count = 0;
+    int clusters = 0;
+    for (int c = 0; c < chosen_k; c++) {
+        int first = -1, second = -1;
+        double first_dist = INFINITY, second_dist = INFINITY;
+        uint64_t instructions = 0;
+        int members = 0;
+
+        for (int i = 0; i < n; i++) {
+            if (best_assignment[i] != c) {
+                continue;
+            }
+            members++;
+            instructions += intervals[i].length;
+            double dist = squared_distance(points[i], centroids[c]);
+            if (dist < first_dist) {
+                second = first;
+                second_dist = first_dist;
+                first = i;
+                first_dist = dist;
+            } else if (dist < second_dist) {
+                second = i;
+                second_dist = dist;
+            }
+        }
+        if (members == 0) {
+            continue;
+        }
+
+        SamplingCluster *cluster = &result->clusters[clusters++];
+        cluster->representative = first;
+        cluster->members = members;
+        cluster->weight = (double)instructions / (double)result->total_instructions;
+        cluster->cpi = measure_interval(intervals, first, config, &result->detailed_instructions);
+        if (second >= 0) {
+            double other = measure_interval(intervals, second, config, &result->detailed_instructions);
+            cluster->cpi_stddev = fabs(cluster->cpi - other) / sqrt(2.0);
+            pooled_sum += cluster->cpi_stddev * cluster->cpi_stddev;
+            pooled_count++;
+        }
+        result->cpi += cluster->weight * cluster->cpi;
+    }
+    result->cluster_count = clusters;
+
+    // A singleton has no spread of its own. Give it the pooled variance of the
+    // clusters measured twice or, if there are none, the variance between
+    // cluster CPIs; a single interval has no bound at all.
+    double pooled = NAN;
+    if (pooled_count > 0) {
+        pooled = pooled_sum / pooled_count;
+    } else if (clusters > 1) {
+        double mean = 0.0, spread = 0.0;
+        for (int c = 0; c < clusters; c++) {
+            mean += result->clusters[c].cpi / clusters;
+        }
+        for (int c = 0; c < clusters; c++) {
+            double delta = result->clusters[c].cpi - mean;
+            spread += delta * delta;
+        }
+        pooled = spread / (clusters - 1);
+    }
+
+    double variance = 0.0;
+    for (int c = 0; c < clusters; c++) {
+        SamplingCluster *cluster = &result->clusters[c];
+        if (cluster->members == 1) {
+            cluster->cpi_stddev = sqrt(pooled);
+            cluster->pooled = true;
+        }
+        variance += cluster->weight * cluster->weight * cluster->cpi_stddev * cluster->cpi_stddev;
+    }
+    result->cpi_error = isnan(variance) ? INFINITY : 1.96 * sqrt(variance);
+    result->detailed_seconds = now_seconds() - start;
+
+    // Optional full detailed run for cross-checking the estimate
+    if (config->validate) {
+        TimingModel model;
+        HostCalls replay;
+        CPU *cpu = malloc(sizeof(CPU));
+        if (cpu) {
+            init_timing_model(&model);
+            resume_copy(cpu, initial, &replay);
+            while (!cpu->halted && model.instructions < result->total_instructions) {
+                timing_step(&model, cpu);
+            }
+            result->full_cpi = timing_cpi(&model);
+            free(cpu);
+        }
+    }
+
+    free(intervals);
+    free(points);
+    free(assignment);
+    free(best_assignment);
+    return 0;
+}
+
+// Display the sampled simulation report
+void display_sampling_result(const SamplingResult *result) {
+    printf("\n=== Sampled Simulation ===\n");
+    printf("Instructions:          %llu\n", (unsigned long long)result->total_instructions);
+    printf("Intervals:             %d x %llu instructions\n", result->interval_count,
+           (unsigned long long)result->interval_length);
+    printf("Detailed instructions: %llu (%.2f%%)\n", (unsigned long long)result->detailed_instructions,
+           100.0 * (double)result->detailed_instructions / (double)result->total_instructions);
+    printf("Clusters:              %d\n", result->cluster_count);
+    for (int c = 0; c < result->cluster_count; c++) {
+        const SamplingCluster *cluster = &result->clusters[c];
+        printf("  Cluster %d: interval %d, %d members, weight %.3f, CPI %.3f",
+               c, cluster->representative, cluster->members, cluster->weight, cluster->cpi);
+        if (isnan(cluster->cpi_stddev)) {
+            printf(" (unbounded)\n");
+        } else {
+            printf(" (+/- %.3f%s)\n", cluster->cpi_stddev, cluster->pooled ? " pooled" : "");
+        }
+    }
+    if (isinf(result->cpi_error)) {
+        printf("Estimated CPI:         %.4f (unbounded, one interval)\n", result->cpi);
+    } else {
+        printf("Estimated CPI:         %.4f +/- %.4f (95%%)\n", result->cpi, result->cpi_error);
+    }
+    if (result->full_cpi > 0.0) {
+        printf("Full detailed CPI:     %.4f (error %.2f%%)\n", result->full_cpi,
+               100.0 * fabs(result->cpi - result->full_cpi) / result->full_cpi);
+    }
+    printf("Fast-forward time:     %.3f s\n", result->fast_forward_seconds);
+    printf("Detailed time:         %.3f s\n", result->detailed_seconds);
+}
@@ -0,0 +1,463 @@
+#include "softfloat.h"
+#include "fpu.h"
+#include <stdbool.h>
+
+typedef unsigned __int128 u128;
+
+// Field widths of an IEEE-754 binary format
+typedef struct {
+    int exponent_bits;
+    int fraction_bits;
+} Format;
+
+static const Format SINGLE = {8, 23};
+static const Format DOUBLE = {11, 52};
+
+typedef enum {
+    CLASS_ZERO,
+    CLASS_FINITE,
+    CLASS_INFINITY,
+    CLASS_QUIET_NAN,
+    CLASS_SIGNALING_NAN
+} Class;
+
+// A decoded operand; finite values are significand * 2^exponent exactly
+typedef struct {
+    Class type;
+    bool sign;
+    int exponent;
+    u128 significand;
+} Unpacked;
+
+static int bias(Format format) {
+    return (1 << (format.exponent_bits - 1)) - 1;
+}
+
+static uint64_t sign_bit(Format format, bool sign) {
+    return (uint64_t)sign << (format.exponent_bits + format.fraction_bits);
+}
+
+static uint64_t pack_infinity(Format format, bool sign) {
+    return sign_bit(format, sign) | ((uint64_t)((1 << format.exponent_bits) - 1) << format.fraction_bits);
+}
+
+static uint64_t pack_zero(Format format, bool sign) {
+    return sign_bit(format, sign);
+}
+
+static uint64_t canonical_nan(Format format) {
+    return pack_infinity(format, false) | (1ULL << (format.fraction_bits - 1));
+}
+
+static bool is_nan(Unpacked x) {
+    return x.type == CLASS_QUIET_NAN || x.type == CLASS_SIGNALING_NAN;
+}
+
+static Unpacked unpack(Format format, uint64_t bits) {
+    Unpacked x = {CLASS_FINITE, false, 0, 0};
+    int max_exponent = (1 << format.exponent_bits) - 1;
+    int exponent = (int)((bits >> format.fraction_bits) & (uint64_t)max_exponent);
+    uint64_t fraction = bits & ((1ULL << format.fraction_bits) - 1);
+    x.sign = (bits >> (format.exponent_bits + format.fraction_bits)) & 1;
+
+    if (exponent == max_exponent) {
+        if (fraction == 0) {
+            x.type = CLASS_INFINITY;
+        } else {
+            x.type = (fraction >> (format.fraction_bits - 1)) & 1 ? CLASS_QUIET_NAN : CLASS_SIGNALING_NAN;
+        }
+    } else if (exponent == 0) {
+        x.type = fraction ? CLASS_FINITE : CLASS_ZERO;
+        x.significand = fraction;
+        x.exponent = 1 - bias(format) - format.fraction_bits;
+    } else {
+        x.significand = fraction | (1ULL << format.fraction_bits);
+        x.exponent = exponent - bias(format) - format.fraction_bits;
+    }
+    return x;
+}
+
+// Number of significant bits
+static int bit_length(u128 x) {
+    uint64_t high = (uint64_t)(x >> 64);
+    if (high) {
+        return 128 - __builtin_clzll(high);
+    }
+    return x ? 64 - __builtin_clzll((uint64_t)x) : 0;
+}
+
+// Shift right rounding to nearest-even; *inexact is set when bits are lost
+static u128 shift_round(u128 significand, int shift, bool *inexact) {
+    if (shift <= 0) {
+        *inexact = false;
+        return significand << -shift;
+    }
+    *inexact = significand != 0;
+    if (shift > bit_length(significand)) {
+        return 0;                                   // Below half of the last place
+    }
+    u128 quotient = significand >> shift;
+    u128 remainder = significand & (((u128)1 << shift) - 1);
+    u128 half = (u128)1 << (shift - 1);
+    *inexact = remainder != 0;
+    if (remainder > half || (remainder == half && (quotient & 1))) {
+        quotient++;
+    }
+    return quotient;
+}
+
+// Round significand * 2^exponent (nonzero; bits below any shifted-out ones
+// are folded into bit 0) to the format and encode it
+static uint64_t round_pack(Format format, bool sign, int exponent, u128 significand, uint32_t *flags) {
+    int precision = format.fraction_bits + 1;
+    int min_exponent = 1 - bias(format);
+    int top = exponent + bit_length(significand) - 1;
+    int lsb = (top > min_exponent ? top : min_exponent) - format.fraction_bits;
+
+    bool inexact;
+    u128 quotient = shift_round(significand, lsb - exponent, &inexact);
+    if (quotient >> precision) {
+        quotient >>= 1;
+        lsb++;
+    }
+
+    // Tiny after rounding: rounding to full precision stays below 2^min_exponent
+    bool tiny = false;
+    if (top < min_exponent) {
+        tiny = true;
+        if (top == min_exponent - 1) {
+            bool ignored;
+            u128 unbounded = shift_round(significand, top - format.fraction_bits - exponent, &ignored);
+            tiny = (unbounded >> precision) == 0;
+        }
+    }
+
+    uint64_t bits;
+    if (quotient >> format.fraction_bits) {
+        int biased = lsb + format.fraction_bits + bias(format);
+        if (biased >= (1 << format.exponent_bits) - 1) {
+            *flags |= FP_OVERFLOW | FP_INEXACT;
+            return pack_infinity(format, sign);
+        }
+        bits = sign_bit(format, sign) | ((uint64_t)biased << format.fraction_bits) |
+               ((uint64_t)quotient & ((1ULL << format.fraction_bits) - 1));
+    } else {
+        bits = sign_bit(format, sign) | (uint64_t)quotient;
+    }
+    if (inexact) {
+        *flags |= tiny ? FP_INEXACT | FP_UNDERFLOW : FP_INEXACT;
+    }
+    return bits;
+}
+
+// Invalid if an operand is signaling, then the canonical NaN
+static uint64_t propagate_nan(Format format, Unpacked a, Unpacked b, uint32_t *flags) {
+    if (a.type == CLASS_SIGNALING_NAN || b.type == CLASS_SIGNALING_NAN) {
+        *flags |= FP_INVALID;
+    }
+    return canonical_nan(format);
+}
+
+static uint64_t invalid(Format format, uint32_t *flags) {
+    *flags |= FP_INVALID;
+    return canonical_nan(format);
+}
+
+// Round the exact sum of two finite values. Both are placed with their
+// leading bit at bit 124 and the smaller is shifted right with a sticky bit,
+// leaving far more guard bits than any rounding needs.
+static uint64_t sum_round(Format format, Unpacked x, Unpacked y, uint32_t *flags) {
+    if (y.significand == 0) {
+        return round_pack(format, x.sign, x.exponent, x.significand, flags);
+    }
+    if (x.significand == 0) {
+        return round_pack(format, y.sign, y.exponent, y.significand, flags);
+    }
+    int shift_x = 125 - bit_length(x.significand);
+    int shift_y = 125 - bit_length(y.significand);
+    x.significand <<= shift_x;
+    x.exponent -= shift_x;
+    y.significand <<= shift_y;
+    y.exponent -= shift_y;
+    if (y.exponent > x.exponent) {
+        Unpacked swap = x;
+        x = y;
+        y = swap;
+    }
+
+    int distance = x.exponent - y.exponent;
+    u128 aligned = 1;
+    if (distance < 126) {
+        aligned = y.significand >> distance;
+        if (distance && (y.significand & (((u128)1 << distance) - 1))) {
+            aligned |= 1;
+        }
+    }
+
+    bool sign = x.sign;
+    u128 sum;
+    if (x.sign == y.sign) {
+        sum = x.significand + aligned;
+    } else if (x.significand >= aligned) {
+        sum = x.significand - aligned;
+    } else {
+        sum = aligned - x.significand;
+        sign = y.sign;
+    }
+    if (sum == 0) {
+        return pack_zero(format, false);        // Exact cancellation is +0 when rounding to nearest
+    }
+    return round_pack(format, sign, x.exponent, sum, flags);
+}
+
+static uint64_t add(Format format, uint64_t a_bits, uint64_t b_bits, bool subtract, uint32_t *flags) {
+    Unpacked a = unpack(format, a_bits), b = unpack(format, b_bits);
+    if (is_nan(a) || is_nan(b)) {
+        return propagate_nan(format, a, b, flags);
+    }
+    b.sign ^= subtract;
+    if (a.type == CLASS_INFINITY || b.type == CLASS_INFINITY) {
+        if (a.type == CLASS_INFINITY && b.type == CLASS_INFINITY && a.sign != b.sign) {
+            return invalid(format, flags);
+        }
+        return pack_infinity(format, a.type == CLASS_INFINITY ? a.sign : b.sign);
+    }
+    if (a.type == CLASS_ZERO && b.type == CLASS_ZERO) {
+        return pack_zero(format, a.sign && b.sign);
+    }
+    return sum_round(format, a, b, flags);
+}
+
+static uint64_t multiply(Format format, uint64_t a_bits, uint64_t b_bits, uint32_t *flags) {
+    Unpacked a = unpack(format, a_bits), b = unpack(format, b_bits);
+    if (is_nan(a) || is_nan(b)) {
+        return propagate_nan(format, a, b, flags);
+    }
+    bool sign = a.sign != b.sign;
+    if (a.type == CLASS_INFINITY || b.type == CLASS_INFINITY) {
+        if (a.type == CLASS_ZERO || b.type == CLASS_ZERO) {
+            return invalid(format, flags);
+        }
+        return pack_infinity(format, sign);
+    }
+    if (a.type == CLASS_ZERO || b.type == CLASS_ZERO) {
+        return pack_zero(format, sign);
+    }
+    return round_pack(format, sign, a.exponent + b.exponent, a.significand * b.significand, flags);
+}
+
+static uint64_t divide(Format format, uint64_t a_bits, uint64_t b_bits, uint32_t *flags) {
+    Unpacked a = unpack(format, a_bits), b = unpack(format, b_bits);
+    if (is_nan(a) || is_nan(b)) {
+        return propagate_nan(format, a, b, flags);
+    }
+    bool sign = a.sign != b.sign;
+    if (a.type == CLASS_INFINITY) {
+        return b.type == CLASS_INFINITY ? invalid(format, flags) : pack_infinity(format, sign);
+    }
+    if (b.type == CLASS_INFINITY) {
+        return pack_zero(format, sign);
+    }
+    if (b.type == CLASS_ZERO) {
+        if (a.type == CLASS_ZERO) {
+            return invalid(format, flags);
+        }
+        *flags |= FP_DIVIDE_BY_ZERO;
+        return pack_infinity(format, sign);
+    }
+    if (a.type == CLASS_ZERO) {
+        return pack_zero(format, sign);
+    }
+
+    // A 126-bit dividend over a significand of at most 53 bits leaves 70+ quotient bits
+    int shift = 126 - bit_length(a.significand);
+    u128 dividend = a.significand << shift;
+    u128 quotient = dividend / b.significand;
+    if (dividend % b.significand) {
+        quotient |= 1;
+    }
+    return round_pack(format, sign, a.exponent - shift - b.exponent, quotient, flags);
+}
+
+// Integer square root, flagging a nonzero remainder
+static u128 integer_sqrt(u128 value, bool *exact) {
+    u128 root = 0;
+    u128 bit = (u128)1 << 126;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    *exact = value == 0;
+    return root;
+}
+
+static uint64_t square_root(Format format, uint64_t a_bits, uint32_t *flags) {
+    Unpacked a = unpack(format, a_bits);
+    if (is_nan(a)) {
+        return propagate_nan(format, a, a, flags);
+    }
+    if (a.type == CLASS_ZERO) {
+        return pack_zero(format, a.sign);
+    }
+    if (a.sign) {
+        return invalid(format, flags);
+    }
+    if (a.type == CLASS_INFINITY) {
+        return pack_infinity(format, false);
+    }
+
+    // Scale to an even exponent and about 124 bits so the root has 62
+    int shift = 124 - bit_length(a.significand);
+    if ((a.exponent - shift) & 1) {
+        shift++;
+    }
+    bool exact;
+    u128 root = integer_sqrt(a.significand << shift, &exact);
+    if (!exact) {
+        root |= 1;
+    }
+    return round_pack(format, false, (a.exponent - shift) / 2, root, flags);
+}
+
+// a * b + c with a single rounding
+static uint64_t fused_multiply_add(Format format, uint64_t a_bits, uint64_t b_bits, uint64_t c_bits,
+                                   uint32_t *flags) {
+    Unpacked a = unpack(format, a_bits), b = unpack(format, b_bits), c = unpack(format, c_bits);
+    bool infinity_times_zero = (a.type == CLASS_INFINITY && b.type == CLASS_ZERO) ||
+                               (a.type == CLASS_ZERO && b.type == CLASS_INFINITY);
+    if (is_nan(a) || is_nan(b) || is_nan(c)) {
+        // Like x86 FMA, infinity * 0 + quiet NaN is not invalid
+        if (c.type == CLASS_SIGNALING_NAN) {
+            *flags |= FP_INVALID;
+        }
+        return propagate_nan(format, a, b, flags);
+    }
+    if (infinity_times_zero) {
+        return invalid(format, flags);
+    }
+
+    Unpacked product = {CLASS_FINITE, a.sign != b.sign, a.exponent + b.exponent, a.significand * b.significand};
+    if (a.type == CLASS_INFINITY || b.type == CLASS_INFINITY) {
+        if (c.type == CLASS_INFINITY && c.sign != product.sign) {
+            return invalid(format, flags);
+        }
+        return pack_infinity(format, product.sign);
+    }
+    if (c.type == CLASS_INFINITY) {
+        return pack_infinity(format, c.sign);
+    }
+    if (a.type == CLASS_ZERO || b.type == CLASS_ZERO) {
+        if (c.type == CLASS_ZERO) {
+            return pack_zero(format, product.sign && c.sign);
+        }
+        product.significand = 0;
+    }
+    return sum_round(format, product, c, flags);
+}
+
+// -1, 0 or 1 for less, equal or greater; 2 when unordered
+static int compare(Format format, uint64_t a_bits, uint64_t b_bits, uint32_t *flags) {
+    Unpacked a = unpack(format, a_bits), b = unpack(format, b_bits);
+    if (is_nan(a) || is_nan(b)) {
+        propagate_nan(format, a, b, flags);
+        return 2;
+    }
+    if (a.type == CLASS_ZERO && b.type == CLASS_ZERO) {
+        return 0;
+    }
+    uint64_t magnitude = ~sign_bit(format, true) & ((sign_bit(format, true) << 1) - 1);
+    int64_t x = (int64_t)(a_bits & magnitude), y = (int64_t)(b_bits & magnitude);
+    x = a.sign ? -x : x;
+    y = b.sign ? -y : y;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t from_int32(Format format, int32_t value, uint32_t *flags) {
+    if (value == 0) {
+        return pack_zero(format, false);
+    }
+    uint64_t magnitude = value < 0 ? -(uint64_t)(int64_t)value : (uint64_t)value;
+    return round_pack(format, value < 0, 0, magnitude, flags);
+}
+
+// Truncate toward zero; NaN and out-of-range values saturate and are invalid
+static int32_t to_int32(Format format, uint64_t bits, uint32_t *flags) {
+    Unpacked a = unpack(format, bits);
+    if (is_nan(a) || a.type == CLASS_INFINITY) {
+        *flags |= FP_INVALID;
+        return is_nan(a) || !a.sign ? INT32_MAX : INT32_MIN;
+    }
+    if (a.type == CLASS_ZERO) {
+        return 0;
+    }
+    u128 magnitude;
+    bool fraction = false;
+    if (a.exponent >= 0) {
+        magnitude = a.exponent > 40 ? (u128)1 << 41 : a.significand << a.exponent;
+    } else if (a.exponent > -64) {
+        magnitude = a.significand >> -a.exponent;
+        fraction = (a.significand & (((u128)1 << -a.exponent) - 1)) != 0;
+    } else {
+        magnitude = 0;
+        fraction = true;
+    }
+    if (magnitude > (a.sign ? (u128)1 << 31 : (u128)INT32_MAX)) {
+        *flags |= FP_INVALID;
+        return a.sign ? INT32_MIN : INT32_MAX;
+    }
+    if (fraction) {
+        *flags |= FP_INEXACT;
+    }
+    return a.sign ? (int32_t)-(int64_t)magnitude : (int32_t)magnitude;
+}
+
+static uint64_t convert(Format from, Format to, uint64_t bits, uint32_t *flags) {
+    Unpacked a = unpack(from, bits);
+    switch (a.type) {
+        case CLASS_QUIET_NAN:
+        case CLASS_SIGNALING_NAN:
+            return propagate_nan(to, a, a, flags);
+        case CLASS_INFINITY:
+            return pack_infinity(to, a.sign);
+        case CLASS_ZERO:
+            return pack_zero(to, a.sign);
+        default:
+            return round_pack(to, a.sign, a.exponent, a.significand, flags);
+    }
+}
+
+// Execute an FPU operation in software
+uint64_t softfloat_execute(Opcode opcode, uint64_t a, uint64_t b, uint64_t c, uint32_t *flags) {
+    uint64_t low_a = (uint32_t)a, low_b = (uint32_t)b, low_c = (uint32_t)c;
+    switch (opcode) {
+        case FADDS: return add(SINGLE, low_a, low_b, false, flags);
+        case FSUBS: return add(SINGLE, low_a, low_b, true, flags);
+        case FMULS: return multiply(SINGLE, low_a, low_b, flags);
+        case FDIVS: return divide(SINGLE, low_a, low_b, flags);
+        case FSQRTS: return square_root(SINGLE, low_a, flags);
+        case FMADDS: return fused_multiply_add(SINGLE, low_a, low_b, low_c, flags);
+        case FCMPS: return (uint64_t)(int64_t)compare(SINGLE, low_a, low_b, flags);
+        case FADDD: return add(DOUBLE, a, b, false, flags);
+        case FSUBD: return add(DOUBLE, a, b, true, flags);
+        case FMULD: return multiply(DOUBLE, a, b, flags);
+        case FDIVD: return divide(DOUBLE, a, b, flags);
+        case FSQRTD: return square_root(DOUBLE, a, flags);
+        case FMADDD: return fused_multiply_add(DOUBLE, a, b, c, flags);
+        case FCMPD: return (uint64_t)(int64_t)compare(DOUBLE, a, b, flags);
+        case FCVTSW: return from_int32(SINGLE, (int32_t)a, flags);
+        case FCVTDW: return from_int32(DOUBLE, (int32_t)a, flags);
+        case FCVTWS: return (uint64_t)(int64_t)to_int32(SINGLE, low_a, flags);
+        case FCVTWD: return (uint64_t)(int64_t)to_int32(DOUBLE, a, flags);
+        case FCVTSD: return convert(DOUBLE, SINGLE, a, flags);
+        case FCVTDS: return convert(SINGLE, DOUBLE, low_a, flags);
+        default: return 0;
+    }
+}
@@ -0,0 +1,484 @@
+#include "timetravel.h"
+#include "memory.h"
+#include "fpu.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ALL_PAGES ((uint32_t)(((uint64_t)1 << TIMETRAVEL_PAGE_COUNT) - 1))
+
+// What a backward scan looks for
+typedef enum {
+    QUERY_BREAKPOINT,       // PC equal to one of the breakpoints
+    QUERY_REGISTER,         // Register value changed
+    QUERY_MEMORY            // Memory word changed
+} QueryKind;
+
+typedef struct {
+    QueryKind kind;
+    const uint32_t *breakpoints;
+    int count;
+    uint32_t target;        // Register number or word address
+} Query;
+
+// Pages covered by a byte range
+static uint32_t page_span(uint32_t address, uint32_t size) {
+    uint32_t first = address / TIMETRAVEL_PAGE_SIZE;
+    uint32_t last = (address + size - 1) / TIMETRAVEL_PAGE_SIZE;
+    uint32_t mask = 0;
+    for (uint32_t page = first; page <= last && page < TIMETRAVEL_PAGE_COUNT; page++) {
+        mask |= 1u << page;
+    }
+    return mask;
+}
+
+static uint32_t pc_page(uint32_t pc) {
+    return pc < MEMORY_SIZE ? 1u << (pc / TIMETRAVEL_PAGE_SIZE) : 0;
+}
+
+static void save_state(CheckpointState *state, CPU *cpu) {
+    memcpy(state->registers, cpu->registers, sizeof(state->registers));
+    memcpy(state->vectors, cpu->vectors, sizeof(state->vectors));
+    memcpy(state->fp_registers, cpu->fp_registers, sizeof(state->fp_registers));
+    state->fp_flags = fpu_flags(cpu);
+    state->program_counter = cpu->program_counter;
+    state->stack_pointer = cpu->stack_pointer;
+    state->instruction_register = cpu->instruction_register;
+    state->instruction_length = cpu->instruction_length;
+    memcpy(state->flags, cpu->flags, sizeof(state->flags));
+    state->halted = cpu->halted;
+    memcpy(state->perf_counters, cpu->perf_counters, sizeof(state->perf_counters));
+}
+
+// Rebuild the CPU at checkpoint `index` from its state and the newest copy of each page
+static void restore_checkpoint(const TimeTravel *tt, int index, CPU *cpu) {
+    const CheckpointState *state = &tt->checkpoints[index].state;
+    memcpy(cpu->registers, state->registers, sizeof(cpu->registers));
+    memcpy(cpu->vectors, state->vectors, sizeof(cpu->vectors));
+    memcpy(cpu->fp_registers, state->fp_registers, sizeof(cpu->fp_registers));
+    fpu_set_flags(cpu, state->fp_flags);
+    cpu->program_counter = state->program_counter;
+    cpu->stack_pointer = state->stack_pointer;
+    cpu->instruction_register = state->instruction_register;
+    cpu->instruction_length = state->instruction_length;
+    memcpy(cpu->flags, state->flags, sizeof(cpu->flags));
+    cpu->halted = state->halted;
+    memcpy(cpu->perf_counters, state->perf_counters, sizeof(cpu->perf_counters));
+
+    uint32_t restored = 0;
+    for (int i = index; i >= 0 && restored != ALL_PAGES; i--) {
+        const Checkpoint *checkpoint = &tt->checkpoints[i];
+        uint32_t pages = checkpoint->written_pages & ~restored;
+        for (int page = 0; pages; page++, pages >>= 1) {
+            // Unchanged pages keep their decoded instructions
+            uint8_t *target = cpu->memory + page * TIMETRAVEL_PAGE_SIZE;
+            if ((pages & 1) && memcmp(target, checkpoint->pages[page], TIMETRAVEL_PAGE_SIZE) != 0) {
+                memcpy(target, checkpoint->pages[page], TIMETRAVEL_PAGE_SIZE);
+                invalidate_decoded(cpu, (uint32_t)(page * TIMETRAVEL_PAGE_SIZE), TIMETRAVEL_PAGE_SIZE);
+            }
+        }
+        restored |= checkpoint->written_pages;
+    }
+}
+
+static void free_checkpoint(Checkpoint *checkpoint) {
+    for (int page = 0; page < TIMETRAVEL_PAGE_COUNT; page++) {
+        free(checkpoint->pages[page]);
+    }
+}
+
+// Remove one interior checkpoint so that spacing grows with age.
+// Its pages and summaries fold into the next checkpoint.
+static void thin_checkpoints(TimeTravel *tt) {
+    int victim = 1;
+    double best = -1.0;
+    for (int i = 1; i < tt->count - 1; i++) {
+        double gap = (double)(tt->checkpoints[i + 1].instruction - tt->checkpoints[i - 1].instruction);
+        double age = (double)(tt->head - tt->checkpoints[i + 1].instruction + tt->interval);
+        if (best < 0.0 || gap / age < best) {
+            best = gap / age;
+            victim = i;
+        }
+    }
+
+    Checkpoint *removed = &tt->checkpoints[victim];
+    Checkpoint *next = &tt->checkpoints[victim + 1];
+    for (int page = 0; page < TIMETRAVEL_PAGE_COUNT; page++) {
+        if (removed->pages[page] && !next->pages[page]) {
+            next->pages[page] = removed->pages[page];
+        } else {
+            free(removed->pages[page]);
+        }
+    }
+    next->written_pages |= removed->written_pages;
+    next->executed_pages |= removed->executed_pages;
+    next->changed_registers |= removed->changed_registers;
+
+    memmove(removed, next, (tt->count - victim - 1) * sizeof(Checkpoint));
+    tt->count--;
+}
+
+// Checkpoint the head, storing the pages written since the last checkpoint
+static int take_checkpoint(TimeTravel *tt, CPU *cpu, uint32_t written_pages) {
+    if (tt->count == tt->max_checkpoints) {
+        thin_checkpoints(tt);
+    }
+
+    Checkpoint *checkpoint = &tt->checkpoints[tt->count];
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->instruction = tt->head;
+    save_state(&checkpoint->state, cpu);
+    for (int page = 0; page < TIMETRAVEL_PAGE_COUNT; page++) {
+        if (!(written_pages & (1u << page))) {
+            continue;
+        }
+        checkpoint->pages[page] = malloc(TIMETRAVEL_PAGE_SIZE);
+        if (!checkpoint->pages[page]) {
+            free_checkpoint(checkpoint);
+            fprintf(stderr, "Error: Out of memory for checkpoints\n");
+            return -1;
+        }
+        memcpy(checkpoint->pages[page], cpu->memory + page * TIMETRAVEL_PAGE_SIZE, TIMETRAVEL_PAGE_SIZE);
+    }
+    checkpoint->written_pages = written_pages;
+    checkpoint->executed_pages = tt->executed_pages;
+    checkpoint->changed_registers = tt->changed_registers;
+    tt->count++;
+
+    tt->written_pages = 0;
+    tt->executed_pages = 0;
+    tt->changed_registers = 0;
+    return 0;
+}
+
+// Initialize reverse execution with a full checkpoint of the current state
+int init_time_travel(TimeTravel *tt, CPU *cpu, uint64_t interval, int max_checkpoints) {
+    memset(tt, 0, sizeof(*tt));
+    tt->interval = interval ? interval : TIMETRAVEL_DEFAULT_INTERVAL;
+    tt->max_checkpoints = max_checkpoints >= 3 ? max_checkpoints : 3;
+    tt->checkpoints = malloc(tt->max_checkpoints * sizeof(Checkpoint));
+    tt->scratch = malloc(sizeof(CPU));
+    if (!tt->checkpoints || !tt->scratch) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free_time_travel(tt);
+        return -1;
+    }
+
+    *tt->scratch = *cpu;
+    tt->scratch->trace_execution = false;
+    if (take_checkpoint(tt, cpu, ALL_PAGES) != 0) {
+        free_time_travel(tt);
+        return -1;
+    }
+    return 0;
+}
+
+// Free all checkpoints
+void free_time_travel(TimeTravel *tt) {
+    for (int i = 0; i < tt->count; i++) {
+        free_checkpoint(&tt->checkpoints[i]);
+    }
+    free(tt->checkpoints);
+    free(tt->scratch);
+    memset(tt, 0, sizeof(*tt));
+}
+
+// Execute one instruction forward
+void time_travel_step(TimeTravel *tt, CPU *cpu) {
+    if (cpu->halted) {
+        return;
+    }
+    if (tt->position < tt->head) {
+        step_cpu(cpu);      // Re-execution reproduces the recorded run
+        tt->position++;
+        return;
+    }
+
+    if (tt->head - tt->checkpoints[tt->count - 1].instruction >= tt->interval) {
+        take_checkpoint(tt, cpu, tt->written_pages);
+    }
+
+    sword_t registers[REGISTER_COUNT];
+    memcpy(registers, cpu->registers, sizeof(registers));
+    tt->executed_pages |= pc_page(cpu->program_counter);
+
+    step_cpu(cpu);
+
+    if (cpu->store_size) {
+        tt->written_pages |= page_span(cpu->store_address, cpu->store_size);
+    }
+    uint8_t changed = 0;
+    for (int i = 0; i < REGISTER_COUNT; i++) {
+        changed |= (uint8_t)((cpu->registers[i] != registers[i]) << i);
+    }
+    tt->changed_registers |= changed;
+    tt->position++;
+    tt->head++;
+}
+
+// Last checkpoint at or before an instruction
+static int find_checkpoint(const TimeTravel *tt, uint64_t instruction) {
+    int low = 0, high = tt->count - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (tt->checkpoints[mid].instruction <= instruction) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// Move the CPU to a position
+int seek_instruction(TimeTravel *tt, CPU *cpu, uint64_t instruction) {
+    uint64_t start = instruction < tt->head ? instruction : tt->head;
+    int index = find_checkpoint(tt, start);
+
+    // Restore unless the CPU is already between the checkpoint and the target
+    if (tt->position > instruction || tt->position < tt->checkpoints[index].instruction) {
+        restore_checkpoint(tt, index, cpu);
+        tt->position = tt->checkpoints[index].instruction;
+    }
+
+    uint64_t from = tt->position;
+    while (tt->position < instruction && !cpu->halted) {
+        time_travel_step(tt, cpu);
+    }
+    tt->reexecuted += tt->position - from;
+    return tt->position == instruction ? 0 : -1;
+}
+
+// Step back one instruction
+int reverse_step(TimeTravel *tt, CPU *cpu) {
+    if (tt->position == 0) {
+        return -1;
+    }
+    return seek_instruction(tt, cpu, tt->position - 1);
+}
+
+// Whether an interval with these summaries can contain a hit
+static bool interval_may_match(const Query *query, uint32_t written_pages, uint32_t executed_pages,
+                               uint8_t changed_registers) {
+    switch (query->kind) {
+        case QUERY_BREAKPOINT:
+            for (int i = 0; i < query->count; i++) {
+                if (executed_pages & pc_page(query->breakpoints[i])) {
+                    return true;
+                }
+            }
+            return false;
+        case QUERY_REGISTER:
+            return changed_registers & (1u << query->target);
+        case QUERY_MEMORY:
+            return written_pages & page_span(query->target, sizeof(uint32_t));
+    }
+    return false;
+}
+
+// Re-execute [start, end) from checkpoint `index` on the scratch CPU; returns the last hit or -1
+static int64_t scan_interval(TimeTravel *tt, const Query *query, int index, uint64_t end, uint32_t *hit_pc) {
+    CPU *cpu = tt->scratch;
+    int64_t hit = -1;
+    uint32_t word = 0;
+
+    restore_checkpoint(tt, index, cpu);
+    if (query->kind == QUERY_MEMORY) {
+        word = read_memory(cpu->memory, query->target);
+    }
+
+    for (uint64_t i = tt->checkpoints[index].instruction; i < end && !cpu->halted; i++) {
+        uint32_t pc = cpu->program_counter;
+        sword_t value = query->kind == QUERY_REGISTER ? cpu->registers[query->target] : 0;
+
+        if (query->kind == QUERY_BREAKPOINT) {
+            for (int b = 0; b < query->count; b++) {
+                if (pc == query->breakpoints[b]) {
+                    hit = (int64_t)i;
+                    *hit_pc = pc;
+                }
+            }
+        }
+
+        step_cpu(cpu);
+        tt->reexecuted++;
+
+        if (query->kind == QUERY_REGISTER && cpu->registers[query->target] != value) {
+            hit = (int64_t)i;
+            *hit_pc = pc;
+        } else if (query->kind == QUERY_MEMORY && cpu->store_size &&
+                   cpu->store_address < query->target + sizeof(uint32_t) &&
+                   query->target < cpu->store_address + cpu->store_size) {
+            uint32_t current = read_memory(cpu->memory, query->target);
+            if (current != word) {
+                word = current;
+                hit = (int64_t)i;
+                *hit_pc = pc;
+            }
+        }
+    }
+    return hit;
+}
+
+// Find the last instruction before the current position matching a query
+static int64_t scan_backward(TimeTravel *tt, const Query *query, uint32_t *hit_pc) {
+    if (tt->position == 0) {
+        return -1;
+    }
+
+    for (int index = find_checkpoint(tt, tt->position - 1); index >= 0; index--) {
+        uint64_t end = tt->position;
+        bool may_match;
+        if (index + 1 < tt->count) {
+            const Checkpoint *next = &tt->checkpoints[index + 1];
+            if (next->instruction < end) {
+                end = next->instruction;
+            }
+            may_match = interval_may_match(query, next->written_pages, next->executed_pages,
+                                           next->changed_registers);
+        } else {
+            may_match = interval_may_match(query, tt->written_pages, tt->executed_pages,
+                                           tt->changed_registers);
+        }
+
+        if (may_match) {
+            int64_t hit = scan_interval(tt, query, index, end, hit_pc);
+            if (hit >= 0) {
+                return hit;
+            }
+        }
+    }
+    return -1;
+}
+
+// Run backward to the previous breakpoint
+int reverse_continue(TimeTravel *tt, CPU *cpu, const uint32_t *breakpoints, int count) {
+    Query query = {QUERY_BREAKPOINT, breakpoints, count, 0};
+    uint32_t pc;
+    int64_t hit = scan_backward(tt, &query, &pc);
+
+    seek_instruction(tt, cpu, hit >= 0 ? (uint64_t)hit : 0);
+    return hit >= 0 ? 0 : 1;
+}
+
+// Last change of a register
+int64_t last_register_change(TimeTravel *tt, int reg, uint32_t *pc) {
+    uint32_t hit_pc = 0;
+    if (reg < 0 || reg >= REGISTER_COUNT) {
+        return -1;
+    }
+    Query query = {QUERY_REGISTER, NULL, 0, (uint32_t)reg};
+    int64_t hit = scan_backward(tt, &query, &hit_pc);
+    if (pc) {
+        *pc = hit_pc;
+    }
+    return hit;
+}
+
+// Last change of a memory word
+int64_t last_memory_change(TimeTravel *tt, uint32_t address, uint32_t *pc) {
+    uint32_t hit_pc = 0;
+    if (address > MEMORY_SIZE - sizeof(uint32_t)) {
+        return -1;
+    }
+    Query query = {QUERY_MEMORY, NULL, 0, address};
+    int64_t hit = scan_backward(tt, &query, &hit_pc);
+    if (pc) {
+        *pc = hit_pc;
+    }
+    return hit;
+}
+
+// Print the position and registers
+static void display_position(const TimeTravel *tt, const CPU *cpu) {
+    printf("Instruction %llu, PC 0x%08X, SP 0x%08X%s\n", (unsigned long long)tt->position,
+           cpu->program_counter, cpu->stack_pointer, cpu->halted ? " (halted)" : "");
+}
+
+static bool is_breakpoint(const uint32_t *breakpoints, int count, uint32_t pc) {
+    for (int i = 0; i < count; i++) {
+        if (breakpoints[i] == pc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Interactive time-travel command loop
+void run_time_travel_console(TimeTravel *tt, CPU *cpu, FILE *in) {
+    uint32_t breakpoints[TIMETRAVEL_MAX_BREAKPOINTS];
+    int breakpoint_count = 0;
+    char line[256];
+
+    display_position(tt, cpu);
+    printf("(tt) ");
+    fflush(stdout);
+    while (fgets(line, sizeof(line), in)) {
+        char command[32] = "";
+        char argument[64] = "";
+        sscanf(line, "%31s %63s", command, argument);
+        uint64_t count = argument[0] ? strtoull(argument, NULL, 0) : 1;
+
+        if (strcmp(command, "step") == 0 || strcmp(command, "s") == 0) {
+            for (uint64_t i = 0; i < count && !cpu->halted; i++) {
+                time_travel_step(tt, cpu);
+            }
+            display_position(tt, cpu);
+        } else if (strcmp(command, "rstep") == 0 || strcmp(command, "rs") == 0) {
+            uint64_t target = count < tt->position ? tt->position - count : 0;
+            seek_instruction(tt, cpu, target);
+            display_position(tt, cpu);
+        } else if (strcmp(command, "continue") == 0 || strcmp(command, "c") == 0) {
+            do {
+                time_travel_step(tt, cpu);
+            } while (!cpu->halted && !is_breakpoint(breakpoints, breakpoint_count, cpu->program_counter));
+            display_position(tt, cpu);
+        } else if (strcmp(command, "rcontinue") == 0 || strcmp(command, "rc") == 0) {
+            if (reverse_continue(tt, cpu, breakpoints, breakpoint_count) != 0) {
+                printf("No earlier breakpoint hit; at the start of the run\n");
+            }
+            display_position(tt, cpu);
+        } else if ((strcmp(command, "break") == 0 || strcmp(command, "b") == 0) && argument[0]) {
+            if (breakpoint_count < TIMETRAVEL_MAX_BREAKPOINTS) {
+                breakpoints[breakpoint_count++] = (uint32_t)strtoul(argument, NULL, 0);
+            } else {
+                printf("Too many breakpoints\n");
+            }
+        } else if (strcmp(command, "goto") == 0 && argument[0]) {
+            if (seek_instruction(tt, cpu, count) != 0) {
+                printf("Program halted before instruction %llu\n", (unsigned long long)count);
+            }
+            display_position(tt, cpu);
+        } else if (strcmp(command, "last") == 0 && argument[0]) {
+            uint32_t pc = 0;
+            int64_t hit = (argument[0] == 'r' || argument[0] == 'R')
+                              ? last_register_change(tt, atoi(argument + 1), &pc)
+                              : last_memory_change(tt, (uint32_t)strtoul(argument, NULL, 0), &pc);
+            if (hit >= 0) {
+                printf("%s last changed by instruction %lld at PC 0x%08X\n", argument, (long long)hit, pc);
+            } else {
+                printf("%s has not changed since the start of the run\n", argument);
+            }
+        } else if (strcmp(command, "regs") == 0) {
+            display_cpu_state(cpu);
+        } else if (strcmp(command, "info") == 0) {
+            printf("Position %llu, head %llu, %d checkpoints, %llu instructions re-executed\n",
+                   (unsigned long long)tt->position, (unsigned long long)tt->head, tt->count,
+                   (unsigned long long)tt->reexecuted);
+            if (tt->count > 1) {
+                const Checkpoint *checkpoints = tt->checkpoints;
+                printf("Checkpoint spacing: %llu instructions oldest, %llu newest\n",
+                       (unsigned long long)(checkpoints[1].instruction - checkpoints[0].instruction),
+                       (unsigned long long)(checkpoints[tt->count - 1].instruction -
+                                            checkpoints[tt->count - 2].instruction));
+            }
+        } else if (strcmp(command, "quit") == 0 || strcmp(command, "q") == 0) {
+            break;
+        } else if (command[0]) {
+            printf("Commands: step [N], rstep [N], continue, rcontinue, break ADDR, goto N, "
+                   "last rN|ADDR, regs, info, quit\n");
+        }
+        printf("(tt) ");
+        fflush(stdout);
+    }
+    printf("\n");
+}
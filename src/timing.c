@@ -0,0 +1,160 @@
+#include "timing.h"
+#include "instructions.h"
+#include <string.h>
+
+// Look up an address in a cache, filling the line on a miss
+static bool cache_access(CacheModel *cache, uint32_t address) {
+    uint32_t line = address / CACHE_LINE_SIZE;
+    uint32_t index = line % CACHE_LINES;
+
+    cache->accesses++;
+    if (cache->valid[index] && cache->tags[index] == line) {
+        return true;
+    }
+
+    cache->misses++;
+    cache->valid[index] = true;
+    cache->tags[index] = line;
+    return false;
+}
+
+// Predict a conditional branch and train the counter with the outcome
+static bool predict_branch(BranchPredictor *predictor, uint32_t pc, bool taken) {
+    uint8_t *counter = &predictor->counters[(pc / sizeof(uint32_t)) % PREDICTOR_ENTRIES];
+    bool predicted_taken = *counter >= 2;
+
+    if (taken && *counter < 3) {
+        (*counter)++;
+    } else if (!taken && *counter > 0) {
+        (*counter)--;
+    }
+
+    predictor->predictions++;
+    if (predicted_taken != taken) {
+        predictor->mispredictions++;
+        return false;
+    }
+    return true;
+}
+
+// Initialize the timing model
+void init_timing_model(TimingModel *model) {
+    memset(model, 0, sizeof(*model));
+    memset(model->predictor.counters, 1, sizeof(model->predictor.counters));
+}
+
+// Reset statistics, keeping warmed state
+void reset_timing_stats(TimingModel *model) {
+    model->icache.accesses = 0;
+    model->icache.misses = 0;
+    model->dcache.accesses = 0;
+    model->dcache.misses = 0;
+    model->predictor.predictions = 0;
+    model->predictor.mispredictions = 0;
+    model->cycles = 0;
+    model->instructions = 0;
+}
+
+// Execute one instruction and account its cycles
+void timing_step(TimingModel *model, CPU *cpu) {
+    if (cpu->halted) {
+        return;
+    }
+
+    if (cpu->paging) {
+        step_cpu(cpu); // The PC is virtual, so the model cannot decode at it
+        return;
+    }
+
+    uint32_t pc = cpu->program_counter;
+    uint32_t length;
+    uint32_t raw = decode_cached(cpu, pc, &length);
+    if (length == 0) {
+        step_cpu(cpu); // Let fetch report the bounds or alignment error
+        return;
+    }
+
+    Instruction instruction = decode_instruction(raw);
+    uint32_t sp = cpu->stack_pointer;
+    uint64_t retired = cpu->perf_counters[PERF_INSTRUCTIONS];
+
+    step_cpu(cpu);
+    if (cpu->perf_counters[PERF_INSTRUCTIONS] == retired) {
+        return;     // An interrupt was entered instead, or fetch halted
+    }
+
+    uint64_t cycles = 1;
+    uint64_t misses = 0;
+
+    // Fetch
+    if (!cache_access(&model->icache, pc)) {
+        cycles += CACHE_MISS_PENALTY;
+        misses++;
+    }
+
+    // Execute and memory stages
+    switch (instruction.opcode) {
+        case MUL:
+            cycles += MUL_LATENCY - 1;
+            break;
+        case DIV:
+            cycles += DIV_LATENCY - 1;
+            break;
+        case LOAD:
+        case STORE:
+            if (!cache_access(&model->dcache, instruction.operands[1])) {
+                cycles += CACHE_MISS_PENALTY;
+                misses++;
+            }
+            break;
+        case PUSH:
+        case CALL:
+            if (!cache_access(&model->dcache, sp - WORD_BYTES)) {
+                cycles += CACHE_MISS_PENALTY;
+                misses++;
+            }
+            break;
+        case POP:
+        case RET:
+            if (!cache_access(&model->dcache, sp)) {
+                cycles += CACHE_MISS_PENALTY;
+                misses++;
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Control flow
+    switch (instruction.opcode) {
+        case JZ:
+        case JNZ:
+        case BZ:
+        case BNZ:
+            if (!predict_branch(&model->predictor, pc, cpu->program_counter != pc + length)) {
+                cycles += MISPREDICT_PENALTY;
+            }
+            break;
+        case JUMP:
+        case BRA:
+        case CALL:
+        case RET:
+            cycles += TAKEN_JUMP_PENALTY;
+            break;
+        default:
+            break;
+    }
+
+    model->cycles += cycles;
+    model->instructions++;
+    cpu->perf_counters[PERF_CYCLES] += cycles;
+    cpu->perf_counters[PERF_CACHE_MISSES] += misses;
+}
+
+// Cycles per instruction since the last reset
+double timing_cpi(const TimingModel *model) {
+    if (model->instructions == 0) {
+        return 0.0;
+    }
+    return (double)model->cycles / (double)model->instructions;
+}
@@ -0,0 +1,807 @@
+#include "trace.h"
+#include "memory.h"
+#include "instructions.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC "CPUTRACE"
+#define TRACE_VERSION 1
+// The header's version word also carries the recording engine's word size in
+// its upper half; the 32-bit engine leaves it 0, so its traces are unchanged
+#define TRACE_FORMAT (TRACE_VERSION | (WORD_SIZE == 32 ? 0 : WORD_SIZE << 16))
+#define TRACE_HEADER_SIZE 16
+#define TRACE_BLOCK_HEADER_SIZE 24
+#define TRACE_BLOCK_COMPRESSED 0x1
+#define TRACE_FLAG_COUNT 16
+
+// Keyframe: registers, PC, SP, IR, flags, halted, integer mode, memory
+#define TRACE_KEYFRAME_SIZE (REGISTER_COUNT * WORD_BYTES + 12 + 2 + 2 + MEMORY_SIZE)
+
+// Upper bound of a delta record without its memory bytes
+#define WORD_VARINT_SIZE ((WORD_SIZE + 6) / 7)
+#define TRACE_MAX_RECORD (1 + 5 + 1 + REGISTER_COUNT * WORD_VARINT_SIZE + 5 + 2 + 5 + 5)
+
+// LZ block compression: LZ4-style sequences of literals and 64K-window matches
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 0xFFFF
+
+static void put_u32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static void put_word(uint8_t *out, word_t value) {
+    for (int i = 0; i < WORD_BYTES; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static word_t get_word(const uint8_t *in) {
+    word_t value = 0;
+    for (int i = 0; i < WORD_BYTES; i++) {
+        value |= (word_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+// Varints are 64-bit so one encoding serves both word sizes; values that fit
+// in 32 bits encode exactly as they would at 32 bits
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static uint8_t *put_varint(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// Read a varint, failing at the end of the buffer
+static bool get_varint(const uint8_t **in, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 70; shift += 7) {
+        if (*in >= end) {
+            return false;
+        }
+        uint8_t byte = *(*in)++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t pack_flags(const bool *flags) {
+    uint16_t packed = 0;
+    for (int i = 0; i < TRACE_FLAG_COUNT; i++) {
+        packed |= (uint16_t)(flags[i] ? 1 : 0) << i;
+    }
+    return packed;
+}
+
+static void unpack_flags(bool *flags, uint16_t packed) {
+    for (int i = 0; i < TRACE_FLAG_COUNT; i++) {
+        flags[i] = (packed >> i) & 1;
+    }
+}
+
+static size_t lz_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+static uint32_t lz_hash(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t *lz_put_length(uint8_t *out, size_t length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+// Emit one sequence; a match length of 0 marks the final literal run
+static uint8_t *lz_put_sequence(uint8_t *out, const uint8_t *literals, size_t literal_length,
+                                size_t offset, size_t match_length) {
+    uint8_t *token = out++;
+    size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+
+    *token = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4 | (match_code < 15 ? match_code : 15));
+    if (literal_length >= 15) {
+        out = lz_put_length(out, literal_length - 15);
+    }
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (match_length) {
+        *out++ = (uint8_t)offset;
+        *out++ = (uint8_t)(offset >> 8);
+        if (match_code >= 15) {
+            out = lz_put_length(out, match_code - 15);
+        }
+    }
+    return out;
+}
+
+// Compress into dst (lz_bound(size) bytes); returns the compressed size
+static size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    const uint8_t *ip = src, *anchor = src, *end = src + size;
+    uint8_t *out = dst;
+
+    memset(table, 0, sizeof(table));
+    while (ip + LZ_MIN_MATCH <= end) {
+        uint32_t hash = lz_hash(ip);
+        const uint8_t *ref = src + table[hash];
+        table[hash] = (uint32_t)(ip - src);
+
+        if (ref < ip && ip - ref <= LZ_MAX_OFFSET && memcmp(ref, ip, LZ_MIN_MATCH) == 0) {
+            size_t length = LZ_MIN_MATCH;
+            while (ip + length < end && ref[length] == ip[length]) {
+                length++;
+            }
+            out = lz_put_sequence(out, anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+        } else {
+            ip++;
+        }
+    }
+    out = lz_put_sequence(out, anchor, end - anchor, 0, 0);
+    return out - dst;
+}
+
+// Read an extended length after a saturated token nibble
+static bool lz_get_length(const uint8_t **in, const uint8_t *end, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*in >= end) {
+            return false;
+        }
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Decompress exactly raw_size bytes; false on malformed input
+static bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t raw_size) {
+    const uint8_t *in = src, *end = src + size;
+    uint8_t *out = dst, *out_end = dst + raw_size;
+
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !lz_get_length(&in, end, &literal_length)) {
+            return false;
+        }
+        if (literal_length > (size_t)(end - in) || literal_length > (size_t)(out_end - out)) {
+            return false;
+        }
+        memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | (size_t)in[1] << 8;
+        size_t match_length = token & 0xF;
+        in += 2;
+        if (match_length == 15 && !lz_get_length(&in, end, &match_length)) {
+            return false;
+        }
+        match_length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(out - dst) || match_length > (size_t)(out_end - out)) {
+            return false;
+        }
+
+        const uint8_t *ref = out - offset;
+        while (match_length--) {
+            *out++ = *ref++;    // Byte copy: matches may overlap their output
+        }
+    }
+    return out == out_end;
+}
+
+// Grow a block so that `extra` more bytes fit
+static bool reserve_block(TraceBlock *block, size_t extra) {
+    if (block->size + extra <= block->capacity) {
+        return true;
+    }
+    size_t capacity = block->capacity ? block->capacity : 64 * 1024;
+    while (capacity < block->size + extra) {
+        capacity *= 2;
+    }
+    uint8_t *data = realloc(block->data, capacity);
+    if (!data) {
+        return false;
+    }
+    block->data = data;
+    block->capacity = capacity;
+    return true;
+}
+
+// Address after the instruction at pc, from memory before it executes; the
+// writer and the reader agree on it, so PC deltas are only stored for jumps
+static uint32_t fall_through(CPU *cpu, uint32_t pc) {
+    uint32_t length;
+    decode_cached(cpu, pc, &length);
+    return pc + (length ? length : sizeof(uint32_t));
+}
+
+// Append the full architectural state
+static void put_keyframe(TraceBlock *block, const CPU *cpu) {
+    uint8_t *out = block->data + block->size;
+
+    for (int i = 0; i < REGISTER_COUNT; i++, out += WORD_BYTES) {
+        put_word(out, (word_t)cpu->registers[i]);
+    }
+    put_u32(out, cpu->program_counter);
+    put_u32(out + 4, cpu->stack_pointer);
+    put_u32(out + 8, cpu->instruction_register);
+    out += 12;
+    uint16_t flags = pack_flags(cpu->flags);
+    *out++ = (uint8_t)flags;
+    *out++ = (uint8_t)(flags >> 8);
+    *out++ = cpu->halted;
+    *out++ = (uint8_t)cpu->integer_mode;
+    memcpy(out, cpu->memory, MEMORY_SIZE);
+
+    block->size += TRACE_KEYFRAME_SIZE;
+}
+
+// Restore the architectural state from a keyframe
+static void get_keyframe(const uint8_t *in, CPU *cpu) {
+    for (int i = 0; i < REGISTER_COUNT; i++, in += WORD_BYTES) {
+        cpu->registers[i] = (sword_t)get_word(in);
+    }
+    cpu->program_counter = get_u32(in);
+    cpu->stack_pointer = get_u32(in + 4);
+    cpu->instruction_register = get_u32(in + 8);
+    in += 12;
+    unpack_flags(cpu->flags, (uint16_t)(in[0] | in[1] << 8));
+    cpu->halted = in[2] != 0;
+    cpu->integer_mode = in[3] ? MODE_UNSIGNED : MODE_SIGNED;
+    memcpy(cpu->memory, in + 4, MEMORY_SIZE);
+    flush_decode_cache(cpu);
+}
+
+// Compress (optionally) and write one block; runs on the writer thread
+static bool write_block(TraceWriter *writer, const TraceBlock *block, uint8_t **scratch, size_t *scratch_size) {
+    const uint8_t *payload = block->data;
+    size_t stored_size = block->size;
+    uint32_t flags = 0;
+
+    if (writer->config.compress) {
+        size_t bound = lz_bound(block->size);
+        if (bound > *scratch_size) {
+            uint8_t *grown = realloc(*scratch, bound);
+            if (!grown) {
+                return false;
+            }
+            *scratch = grown;
+            *scratch_size = bound;
+        }
+        size_t compressed = lz_compress(block->data, block->size, *scratch);
+        if (compressed < block->size) {
+            payload = *scratch;
+            stored_size = compressed;
+            flags = TRACE_BLOCK_COMPRESSED;
+        }
+    }
+
+    uint8_t header[TRACE_BLOCK_HEADER_SIZE];
+    put_u32(header, (uint32_t)block->first_instruction);
+    put_u32(header + 4, (uint32_t)(block->first_instruction >> 32));
+    put_u32(header + 8, block->instructions);
+    put_u32(header + 12, (uint32_t)block->size);
+    put_u32(header + 16, (uint32_t)stored_size);
+    put_u32(header + 20, flags);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) ||
+        fwrite(payload, 1, stored_size, writer->file) != stored_size) {
+        return false;
+    }
+
+    writer->raw_bytes += block->size;
+    writer->written_bytes += sizeof(header) + stored_size;
+    return true;
+}
+
+// Background writer: drains whichever block the run loop hands over
+static void *trace_writer_thread(void *arg) {
+    TraceWriter *writer = arg;
+    uint8_t *scratch = NULL;
+    size_t scratch_size = 0;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->pending_block < 0 && !writer->stopping) {
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+        if (writer->pending_block < 0) {
+            break;
+        }
+
+        const TraceBlock *block = &writer->blocks[writer->pending_block];
+        pthread_mutex_unlock(&writer->lock);
+        bool written = write_block(writer, block, &scratch, &scratch_size);
+        pthread_mutex_lock(&writer->lock);
+
+        if (!written) {
+            writer->failed = true;
+        }
+        writer->pending_block = -1;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    free(scratch);
+    return NULL;
+}
+
+// Hand the active block to the writer and switch to the other buffer
+static void flush_block(TraceWriter *writer) {
+    pthread_mutex_lock(&writer->lock);
+    while (writer->pending_block >= 0) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    writer->pending_block = writer->active;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+
+    writer->active ^= 1;
+    writer->blocks[writer->active].size = 0;
+    writer->blocks[writer->active].instructions = 0;
+}
+
+// Initialize the recording options
+void init_trace_config(TraceConfig *config) {
+    config->keyframe_interval = TRACE_DEFAULT_KEYFRAME_INTERVAL;
+    config->compress = true;
+}
+
+// Create the trace file and start the writer thread
+int start_trace_recording(TraceWriter *writer, const char *filename, const TraceConfig *config) {
+    memset(writer, 0, sizeof(*writer));
+    writer->config = *config;
+    writer->pending_block = -1;
+    if (writer->config.keyframe_interval == 0) {
+        writer->config.keyframe_interval = TRACE_DEFAULT_KEYFRAME_INTERVAL;
+    }
+
+    writer->file = fopen(filename, "wb");
+    if (!writer->file) {
+        fprintf(stderr, "Error: Cannot create trace %s\n", filename);
+        return -1;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, 8);
+    put_u32(header + 8, TRACE_FORMAT);
+    put_u32(header + 12, writer->config.keyframe_interval);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        fprintf(stderr, "Error: Cannot write trace %s\n", filename);
+        fclose(writer->file);
+        return -1;
+    }
+    writer->written_bytes = sizeof(header);
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    if (pthread_create(&writer->thread, NULL, trace_writer_thread, writer) != 0) {
+        fprintf(stderr, "Error: Cannot start trace writer thread\n");
+        pthread_cond_destroy(&writer->cond);
+        pthread_mutex_destroy(&writer->lock);
+        fclose(writer->file);
+        return -1;
+    }
+    return 0;
+}
+
+// Execute one instruction and append its delta record
+void trace_step(TraceWriter *writer, CPU *cpu) {
+    if (cpu->halted) {
+        return;
+    }
+    if (writer->failed) {
+        step_cpu(cpu);
+        return;
+    }
+
+    TraceBlock *block = &writer->blocks[writer->active];
+    if (block->instructions == writer->config.keyframe_interval) {
+        flush_block(writer);
+        block = &writer->blocks[writer->active];
+    }
+    if (block->instructions == 0) {
+        if (!reserve_block(block, TRACE_KEYFRAME_SIZE)) {
+            fprintf(stderr, "Error: Out of memory for the trace\n");
+            writer->failed = true;
+            step_cpu(cpu);
+            return;
+        }
+        block->first_instruction = writer->instructions;
+        put_keyframe(block, cpu);
+    }
+
+    sword_t registers[REGISTER_COUNT];
+    bool flags[TRACE_FLAG_COUNT];
+    uint32_t next = fall_through(cpu, cpu->program_counter);
+    uint32_t sp = cpu->stack_pointer;
+    memcpy(registers, cpu->registers, sizeof(registers));
+    memcpy(flags, cpu->flags, sizeof(flags));
+
+    step_cpu(cpu);
+
+    if (!reserve_block(block, TRACE_MAX_RECORD + cpu->store_size)) {
+        fprintf(stderr, "Error: Out of memory for the trace\n");
+        writer->failed = true;
+        return;
+    }
+    uint8_t *mask = block->data + block->size;
+    uint8_t *out = mask + 1;
+    *mask = 0;
+
+    if (cpu->program_counter != next) {
+        *mask |= TRACE_DELTA_PC;
+        out = put_varint(out, zigzag((int32_t)(cpu->program_counter - next)));
+    }
+
+    uint8_t changed = 0;
+    for (int i = 0; i < REGISTER_COUNT; i++) {
+        if (cpu->registers[i] != registers[i]) {
+            changed |= 1u << i;
+        }
+    }
+    if (changed) {
+        *mask |= TRACE_DELTA_REGISTERS;
+        *out++ = changed;
+        for (int i = 0; i < REGISTER_COUNT; i++) {
+            if (changed & (1u << i)) {
+                out = put_varint(out, zigzag((sword_t)((word_t)cpu->registers[i] - (word_t)registers[i])));
+            }
+        }
+    }
+
+    if (cpu->stack_pointer != sp) {
+        *mask |= TRACE_DELTA_SP;
+        out = put_varint(out, zigzag((int32_t)(cpu->stack_pointer - sp)));
+    }
+
+    if (memcmp(cpu->flags, flags, sizeof(flags)) != 0) {
+        uint16_t packed = pack_flags(cpu->flags);
+        *mask |= TRACE_DELTA_FLAGS;
+        *out++ = (uint8_t)packed;
+        *out++ = (uint8_t)(packed >> 8);
+    }
+
+    if (cpu->store_size) {
+        *mask |= TRACE_DELTA_MEMORY;
+        out = put_varint(out, cpu->store_address);
+        out = put_varint(out, cpu->store_size);
+        memcpy(out, cpu->memory + cpu->store_address, cpu->store_size);
+        out += cpu->store_size;
+    }
+
+    if (cpu->halted) {
+        *mask |= TRACE_DELTA_HALTED;
+    }
+
+    block->size = out - block->data;
+    block->instructions++;
+    writer->instructions++;
+}
+
+// Run the CPU while recording every instruction
+void record_cpu(TraceWriter *writer, CPU *cpu, uint64_t max_instructions) {
+    for (uint64_t executed = 0; !cpu->halted && executed < max_instructions; executed++) {
+        trace_step(writer, cpu);
+    }
+}
+
+// Flush the last block and stop the writer
+int stop_trace_recording(TraceWriter *writer) {
+    if (writer->blocks[writer->active].instructions > 0) {
+        flush_block(writer);
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = true;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->lock);
+
+    bool failed = writer->failed;
+    if (fclose(writer->file) != 0) {
+        failed = true;
+    }
+    free(writer->blocks[0].data);
+    free(writer->blocks[1].data);
+    memset(writer->blocks, 0, sizeof(writer->blocks));
+
+    if (failed) {
+        fprintf(stderr, "Error: Trace recording failed; the trace is incomplete\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Open a trace and index its block headers
+int open_trace(TraceReader *reader, const char *filename) {
+    memset(reader, 0, sizeof(*reader));
+    reader->current_block = -1;
+
+    reader->file = fopen(filename, "rb");
+    if (!reader->file) {
+        fprintf(stderr, "Error: Cannot open trace %s\n", filename);
+        return -1;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header) ||
+        memcmp(header, TRACE_MAGIC, 8) != 0 || (get_u32(header + 8) & 0xFFFF) != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s is not a trace file\n", filename);
+        close_trace(reader);
+        return -1;
+    }
+    if (get_u32(header + 8) != TRACE_FORMAT) {
+        uint32_t bits = get_u32(header + 8) >> 16;
+        fprintf(stderr, "Error: %s was recorded by the %u-bit engine\n", filename, bits ? bits : 32);
+        close_trace(reader);
+        return -1;
+    }
+    reader->keyframe_interval = get_u32(header + 12);
+
+    fseek(reader->file, 0, SEEK_END);
+    long file_size = ftell(reader->file);
+    fseek(reader->file, TRACE_HEADER_SIZE, SEEK_SET);
+
+    int capacity = 0;
+    uint8_t block_header[TRACE_BLOCK_HEADER_SIZE];
+    while (fread(block_header, 1, sizeof(block_header), reader->file) == sizeof(block_header)) {
+        TraceBlockIndex entry;
+        entry.offset = ftell(reader->file);
+        entry.first_instruction = get_u32(block_header) | (uint64_t)get_u32(block_header + 4) << 32;
+        entry.instructions = get_u32(block_header + 8);
+        entry.raw_size = get_u32(block_header + 12);
+        entry.stored_size = get_u32(block_header + 16);
+        entry.flags = get_u32(block_header + 20);
+
+        if (entry.raw_size < TRACE_KEYFRAME_SIZE || entry.stored_size > entry.raw_size ||
+            entry.offset + (long)entry.stored_size > file_size ||
+            entry.first_instruction != reader->total_instructions) {
+            fprintf(stderr, "Warning: Trace %s is truncated after instruction %llu\n", filename,
+                    (unsigned long long)reader->total_instructions);
+            break;
+        }
+
+        if (reader->block_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            TraceBlockIndex *blocks = realloc(reader->blocks, capacity * sizeof(TraceBlockIndex));
+            if (!blocks) {
+                fprintf(stderr, "Error: Out of memory\n");
+                close_trace(reader);
+                return -1;
+            }
+            reader->blocks = blocks;
+        }
+        reader->blocks[reader->block_count++] = entry;
+        reader->total_instructions += entry.instructions;
+        fseek(reader->file, entry.stored_size, SEEK_CUR);
+    }
+
+    if (reader->block_count == 0) {
+        fprintf(stderr, "Error: Trace %s has no instructions\n", filename);
+        close_trace(reader);
+        return -1;
+    }
+    return 0;
+}
+
+// Read and decompress one block into the reader's buffer
+static int load_block(TraceReader *reader, int index) {
+    if (index < 0 || index >= reader->block_count) {
+        return -1;
+    }
+    if (index == reader->current_block) {
+        return 0;
+    }
+
+    const TraceBlockIndex *entry = &reader->blocks[index];
+    uint8_t *data = realloc(reader->data, entry->raw_size);
+    uint8_t *stored = entry->flags & TRACE_BLOCK_COMPRESSED ? malloc(entry->stored_size) : NULL;
+    if (!data || (entry->flags & TRACE_BLOCK_COMPRESSED && !stored)) {
+        free(stored);
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+    reader->data = data;
+    reader->current_block = -1;
+
+    bool valid = fseek(reader->file, entry->offset, SEEK_SET) == 0;
+    if (valid && stored) {
+        valid = fread(stored, 1, entry->stored_size, reader->file) == entry->stored_size &&
+                lz_decompress(stored, entry->stored_size, data, entry->raw_size);
+    } else if (valid) {
+        valid = fread(data, 1, entry->raw_size, reader->file) == entry->raw_size;
+    }
+    free(stored);
+    if (!valid) {
+        fprintf(stderr, "Error: Corrupt trace block at instruction %llu\n",
+                (unsigned long long)entry->first_instruction);
+        return -1;
+    }
+
+    reader->current_block = index;
+    reader->size = entry->raw_size;
+    return 0;
+}
+
+// Restore the current block's keyframe
+static void apply_keyframe(TraceReader *reader, CPU *cpu) {
+    get_keyframe(reader->data, cpu);
+    reader->position = TRACE_KEYFRAME_SIZE;
+    reader->instruction = reader->blocks[reader->current_block].first_instruction;
+}
+
+// Position the CPU before the given instruction
+int seek_trace(TraceReader *reader, CPU *cpu, uint64_t instruction) {
+    if (instruction > reader->total_instructions) {
+        fprintf(stderr, "Error: Trace has only %llu instructions\n",
+                (unsigned long long)reader->total_instructions);
+        return -1;
+    }
+
+    // Last block whose keyframe is at or before the target
+    int low = 0, high = reader->block_count - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (reader->blocks[mid].first_instruction <= instruction) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    if (load_block(reader, low) != 0) {
+        return -1;
+    }
+    apply_keyframe(reader, cpu);
+    while (reader->instruction < instruction) {
+        if (replay_step(reader, cpu) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Apply one delta record to the CPU; false if it runs past the buffer
+static bool apply_record(const uint8_t **cursor, const uint8_t *end, CPU *cpu) {
+    const uint8_t *in = *cursor;
+    uint8_t mask = *in++;
+    uint64_t value;
+
+    // The fetch read the instruction before this record's memory write
+    uint32_t pc = cpu->program_counter;
+    uint32_t length;
+    uint32_t instruction = decode_cached(cpu, pc, &length);
+    if (pc >= CODE_START && length) {
+        cpu->instruction_register = instruction;
+        cpu->instruction_length = length;
+    }
+
+    cpu->program_counter = fall_through(cpu, pc);
+    if (mask & TRACE_DELTA_PC) {
+        if (!get_varint(&in, end, &value)) {
+            return false;
+        }
+        cpu->program_counter += (uint32_t)unzigzag(value);
+    }
+
+    if (mask & TRACE_DELTA_REGISTERS) {
+        if (in >= end) {
+            return false;
+        }
+        uint8_t changed = *in++;
+        for (int i = 0; i < REGISTER_COUNT; i++) {
+            if (changed & (1u << i)) {
+                if (!get_varint(&in, end, &value)) {
+                    return false;
+                }
+                cpu->registers[i] = (sword_t)((word_t)cpu->registers[i] + (word_t)unzigzag(value));
+            }
+        }
+    }
+
+    if (mask & TRACE_DELTA_SP) {
+        if (!get_varint(&in, end, &value)) {
+            return false;
+        }
+        cpu->stack_pointer += (uint32_t)unzigzag(value);
+    }
+
+    if (mask & TRACE_DELTA_FLAGS) {
+        if (end - in < 2) {
+            return false;
+        }
+        unpack_flags(cpu->flags, (uint16_t)(in[0] | in[1] << 8));
+        in += 2;
+    }
+
+    if (mask & TRACE_DELTA_MEMORY) {
+        uint64_t address, size;
+        if (!get_varint(&in, end, &address) || !get_varint(&in, end, &size) ||
+            address > MEMORY_SIZE || size > MEMORY_SIZE - address || size > (size_t)(end - in)) {
+            return false;
+        }
+        memcpy(cpu->memory + address, in, size);
+        invalidate_decoded(cpu, (uint32_t)address, (uint32_t)size);
+        in += size;
+    }
+
+    cpu->halted = (mask & TRACE_DELTA_HALTED) != 0;
+    *cursor = in;
+    return true;
+}
+
+// Apply the next delta record
+int replay_step(TraceReader *reader, CPU *cpu) {
+    if (reader->current_block < 0) {
+        return -1;
+    }
+    if (reader->instruction >= reader->total_instructions) {
+        return 1;
+    }
+    if (reader->position >= reader->size) {
+        if (load_block(reader, reader->current_block + 1) != 0) {
+            return -1;
+        }
+        apply_keyframe(reader, cpu);
+    }
+
+    const uint8_t *in = reader->data + reader->position;
+    if (!apply_record(&in, reader->data + reader->size, cpu)) {
+        fprintf(stderr, "Error: Corrupt trace record at instruction %llu\n",
+                (unsigned long long)reader->instruction);
+        return -1;
+    }
+    reader->position = in - reader->data;
+    reader->instruction++;
+    return 0;
+}
+
+// Close the trace
+void close_trace(TraceReader *reader) {
+    if (reader->file) {
+        fclose(reader->file);
+    }
+    free(reader->blocks);
+    free(reader->data);
+    memset(reader, 0, sizeof(*reader));
+    reader->current_block = -1;
+}
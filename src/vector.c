@@ -0,0 +1,105 @@
+#include "vector.h"
+
+#if defined(__SSE2__) && !defined(VECTOR_SCALAR)
+#define VECTOR_SSE2
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#endif
+
+#ifdef VECTOR_SSE2
+
+// Low 32 bits of each lane product
+static __m128i multiply_lanes(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    // SSE2 only multiplies lanes 0 and 2; do the odd lanes shifted down and interleave
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+// Two-operand lane-wise operation
+void vector_binary(Opcode opcode, int32_t *dst, const int32_t *a, const int32_t *b) {
+    __m128i x = _mm_loadu_si128((const __m128i *)a);
+    __m128i y = _mm_loadu_si128((const __m128i *)b);
+    __m128i result;
+    switch (opcode) {
+        case VADD: result = _mm_add_epi32(x, y); break;
+        case VSUB: result = _mm_sub_epi32(x, y); break;
+        case VMUL: result = multiply_lanes(x, y); break;
+        case VAND: result = _mm_and_si128(x, y); break;
+        case VOR: result = _mm_or_si128(x, y); break;
+        case VXOR: result = _mm_xor_si128(x, y); break;
+        case VCMPEQ: result = _mm_cmpeq_epi32(x, y); break;
+        case VCMPGT: result = _mm_cmpgt_epi32(x, y); break;
+        default: return;
+    }
+    _mm_storeu_si128((__m128i *)dst, result);
+}
+
+// Broadcast a scalar
+void vector_splat(int32_t *dst, int32_t value) {
+    _mm_storeu_si128((__m128i *)dst, _mm_set1_epi32(value));
+}
+
+// Horizontal sum: add the swapped halves, then the swapped pairs
+int32_t vector_reduce(const int32_t *a) {
+    __m128i x = _mm_loadu_si128((const __m128i *)a);
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+
+#else
+
+// Two-operand lane-wise operation; unsigned arithmetic gives defined wraparound
+void vector_binary(Opcode opcode, int32_t *dst, const int32_t *a, const int32_t *b) {
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        uint32_t x = (uint32_t)a[i], y = (uint32_t)b[i];
+        switch (opcode) {
+            case VADD: dst[i] = (int32_t)(x + y); break;
+            case VSUB: dst[i] = (int32_t)(x - y); break;
+            case VMUL: dst[i] = (int32_t)(x * y); break;
+            case VAND: dst[i] = (int32_t)(x & y); break;
+            case VOR: dst[i] = (int32_t)(x | y); break;
+            case VXOR: dst[i] = (int32_t)(x ^ y); break;
+            case VCMPEQ: dst[i] = x == y ? -1 : 0; break;
+            case VCMPGT: dst[i] = a[i] > b[i] ? -1 : 0; break;
+            default: return;
+        }
+    }
+}
+
+// Broadcast a scalar
+void vector_splat(int32_t *dst, int32_t value) {
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        dst[i] = value;
+    }
+}
+
+// Horizontal sum
+int32_t vector_reduce(const int32_t *a) {
+    uint32_t sum = 0;
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        sum += (uint32_t)a[i];
+    }
+    return (int32_t)sum;
+}
+
+#endif
+
+// Permute lanes; _mm_shuffle_epi32 needs a compile-time selector, so this stays scalar
+void vector_shuffle(int32_t *dst, const int32_t *a, uint8_t selector) {
+    int32_t lanes[VECTOR_LANES];
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        lanes[i] = a[(selector >> (2 * i)) & 3];
+    }
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        dst[i] = lanes[i];
+    }
+}
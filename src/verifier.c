@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <string.h>
+#include "verifier.h"
+#include "instructions.h"
+#include "memory.h"
+#include "debug.h"
+#include "vector.h"
+
+// Whether an address can hold a verified instruction of the image
+static bool in_code(uint32_t address, uint32_t image_size) {
+    return address >= CODE_START && address < image_size && address <= MEMORY_SIZE - 2 && address % 2 == 0;
+}
+
+// Whether a word access at a direct address touches only RAM
+static bool ram_word(const CPU *cpu, uint32_t address) {
+    uint32_t last = address + WORD_BYTES - 1;
+    return last < MEMORY_SIZE && !cpu->io_pages[address / IO_PAGE_SIZE] && !cpu->io_pages[last / IO_PAGE_SIZE];
+}
+
+// Whether opcode_operands declares 'R' for every field the executor indexes
+// reg[] with; register validation below relies on it
+static bool operand_kinds_consistent(void) {
+    bool consistent = true;
+    for (uint32_t opcode = 0; opcode <= NOP; opcode++) {
+        const char *kinds = opcode_operands(opcode);
+        uint32_t fields = register_fields((Opcode)opcode);
+        for (int i = 0; i < 3; i++) {
+            if ((fields >> i & 1) && (i >= (int)strlen(kinds) || kinds[i] != 'R')) {
+                fprintf(stderr, "Error: %s uses operand %d as a register, but its operand kinds are \"%s\"\n",
+                        opcode_name(opcode), i + 1, kinds);
+                consistent = false;
+            }
+        }
+    }
+    return consistent;
+}
+
+// Check one reachable instruction; on failure describe why in reason
+static bool check_instruction(CPU *cpu, uint32_t raw, uint32_t address, uint32_t length, uint32_t image_size,
+                              char *reason, size_t size) {
+    if (length == 0) {
+        snprintf(reason, size, "not on an instruction boundary");
+        return false;
+    }
+    Instruction instruction = decode_instruction(raw);
+    if (opcode_name(instruction.opcode) == NULL) {
+        snprintf(reason, size, "undefined opcode 0x%02X", instruction.opcode);
+        return false;
+    }
+
+    const char *kinds = opcode_operands(instruction.opcode);
+    for (int i = 0; kinds[i]; i++) {
+        uint32_t operand = instruction.operands[i];
+        if ((kinds[i] == 'R' && operand >= REGISTER_COUNT) || (kinds[i] == 'V' && operand >= VECTOR_REGISTER_COUNT) ||
+            (kinds[i] == 'F' && operand >= FP_REGISTER_COUNT)) {
+            snprintf(reason, size, "invalid register %c%u", kinds[i], operand);
+            return false;
+        }
+        if (kinds[i] == 'L') {
+            uint32_t target = address + (uint32_t)branch_offset(instruction);
+            uint32_t target_length = 0;
+            if (in_code(target, image_size)) {
+                decode_cached(cpu, target, &target_length);
+            }
+            if (target_length == 0) {
+                snprintf(reason, size, "branch to 0x%X, which is not an instruction of the image", target);
+                return false;
+            }
+        }
+    }
+    if (instruction.opcode == RDPERF && (instruction.operands[1] >= PERF_COUNTER_COUNT || instruction.operands[2] > 1)) {
+        snprintf(reason, size, "invalid performance counter %u.%u", instruction.operands[1], instruction.operands[2]);
+        return false;
+    }
+    return true;
+}
+
+// Whether an accepted instruction can run with no check at all: it cannot
+// fault, halt other than by HALT, write code, or change interrupt, paging
+// or device state
+static bool cannot_fault(const CPU *cpu, Instruction instruction) {
+    switch (instruction.opcode) {
+        case ADD: case SUB: case MUL: case AND: case OR: case XOR: case NOT: case SHL: case SHR:
+        case EQ: case NEQ: case GT: case LT: case GE: case LE:
+        case CLZ: case CTZ: case POPCNT: case ROL: case ROR: case BEXT: case BINS: case BREV: case BSWAP:
+        case MOV: case ADDI: case NOP: case RDPERF: case FPFLAGS:
+        case VSPLAT: case VADD: case VSUB: case VMUL: case VAND: case VOR: case VXOR:
+        case VCMPEQ: case VCMPGT: case VSHUF: case VREDUCE:
+        case BRA: case BZ: case BNZ: case JUMP: case JZ: case JNZ: case HALT:
+            return true;
+        case LOAD:
+            return ram_word(cpu, instruction.operands[1]);
+        case STORE:
+            return ram_word(cpu, instruction.operands[1]) && instruction.operands[1] + WORD_BYTES <= CODE_START;
+        default:
+            return false;
+    }
+}
+
+// Whether an instruction ends a block
+static bool ends_block(Opcode opcode) {
+    return opcode == BRA || opcode == BZ || opcode == BNZ || opcode == JUMP || opcode == JZ || opcode == JNZ ||
+           opcode == HALT;
+}
+
+// Walk the code reachable from pending addresses. queued marks every slot
+// ever pending, so each instruction is accepted or rejected once. Only
+// rejections of code reachable from the entry are reported; addresses
+// found in data may be data themselves
+static void walk(VerifiedProgram *program, CPU *cpu, uint32_t image_size, uint32_t *pending, int count, bool *queued,
+                 bool report) {
+    while (count > 0) {
+        uint32_t address = pending[--count];
+        uint32_t length;
+        uint32_t raw = decode_cached(cpu, address, &length);
+        char reason[96];
+        if (!check_instruction(cpu, raw, address, length, image_size, reason, sizeof(reason))) {
+            if (report) {
+                fprintf(stderr, "Warning: Verifier rejected the instruction at 0x%03X: %s\n", address, reason);
+                program->rejected++;
+            }
+            continue;
+        }
+        program->code[address / 2] = raw;
+        program->lengths[address / 2] = (uint8_t)length;
+        program->verified++;
+        program->code_start = address < program->code_start ? address : program->code_start;
+        program->code_end = address + length > program->code_end ? address + length : program->code_end;
+
+        // CALL, JZ and JNZ continue here once their indirect target returns or is not taken
+        Instruction instruction = decode_instruction(raw);
+        uint32_t successors[2];
+        int successor_count = 0;
+        if (instruction.opcode == BRA || instruction.opcode == BZ || instruction.opcode == BNZ) {
+            successors[successor_count++] = address + (uint32_t)branch_offset(instruction);
+        }
+        if (instruction.opcode != BRA && instruction.opcode != JUMP && instruction.opcode != RET &&
+            instruction.opcode != IRET && instruction.opcode != HALT) {
+            successors[successor_count++] = address + length;
+        }
+        for (int i = 0; i < successor_count; i++) {
+            if (in_code(successors[i], image_size) && !queued[successors[i] / 2]) {
+                queued[successors[i] / 2] = true;
+                pending[count++] = successors[i];
+            }
+        }
+    }
+}
+
+// Verify the image and mark its fault-free blocks
+int verify_program(VerifiedProgram *program, CPU *cpu, uint32_t image_size) {
+    memset(program, 0, sizeof(*program));
+    program->code_start = MEMORY_SIZE;
+    if (!operand_kinds_consistent()) {
+        return -1;      // Nothing verified: every instruction keeps full checks
+    }
+
+    uint32_t pending[INSTRUCTION_SLOTS];
+    bool queued[INSTRUCTION_SLOTS];
+    memset(queued, 0, sizeof(queued));
+    int count = 0;
+    if (in_code(CODE_START, image_size)) {
+        queued[CODE_START / 2] = true;
+        pending[count++] = CODE_START;
+    }
+
+    // Code addresses held in data words are entered indirectly; look for
+    // new ones in words outside verified code until none are left
+    for (bool entry = true; count > 0; entry = false) {
+        walk(program, cpu, image_size, pending, count, queued, entry);
+        count = 0;
+        for (uint32_t address = 0; address + sizeof(uint32_t) <= image_size; address += sizeof(uint32_t)) {
+            uint32_t value = read_memory(cpu->memory, address);
+            if (program->lengths[address / 2] == 0 && program->lengths[address / 2 + 1] == 0 &&
+                in_code(value, image_size) && !queued[value / 2]) {
+                queued[value / 2] = true;
+                pending[count++] = value;
+            }
+        }
+    }
+
+    // Block lengths, from the end so each instruction extends its
+    // successor's block; continued marks instructions inside a longer block
+    bool continued[INSTRUCTION_SLOTS];
+    memset(continued, 0, sizeof(continued));
+    for (uint32_t slot = INSTRUCTION_SLOTS; slot-- > 0;) {
+        if (program->lengths[slot] == 0) {
+            continue;
+        }
+        Instruction instruction = decode_instruction(program->code[slot]);
+        if (!cannot_fault(cpu, instruction)) {
+            continue;
+        }
+        uint32_t next = slot + program->lengths[slot] / 2;
+        uint32_t following = 0;
+        program->block_ends[slot] = (uint16_t)next;
+        if (!ends_block(instruction.opcode) && next < INSTRUCTION_SLOTS && program->blocks[next]) {
+            following = program->blocks[next];
+            program->block_ends[slot] = program->block_ends[next];
+            continued[next] = true;
+        }
+        program->blocks[slot] = (uint16_t)(following < VERIFY_MAX_BLOCK ? following + 1 : VERIFY_MAX_BLOCK);
+        program->fault_free++;
+    }
+    for (uint32_t slot = 0; slot < INSTRUCTION_SLOTS; slot++) {
+        if (program->blocks[slot] && !continued[slot]) {
+            program->block_count++;
+        }
+    }
+    return program->rejected ? -1 : 0;
+}
+
+// Drop the block entries whose instructions overlap a written range
+static void invalidate_verified(VerifiedProgram *program, uint32_t address, uint32_t size) {
+    if (address >= program->code_end || address + size <= program->code_start) {
+        return;
+    }
+    uint32_t first = (address & ~(uint32_t)3) / 2;
+    uint32_t last = (address + size - 1) / 2 < INSTRUCTION_SLOTS ? (address + size - 1) / 2 : INSTRUCTION_SLOTS - 1;
+
+    // A block reaching the range starts at most VERIFY_MAX_BLOCK instructions before it
+    uint32_t slot = first > 2 * VERIFY_MAX_BLOCK ? first - 2 * VERIFY_MAX_BLOCK : 0;
+    for (; slot <= last; slot++) {
+        if (program->blocks[slot] && program->block_ends[slot] > first) {
+            program->blocks[slot] = 0;
+            program->invalidated++;
+        }
+        if (slot >= first) {
+            program->lengths[slot] = 0;
+        }
+    }
+}
+
+// Execute one instruction of a fault-free block. The verifier proved direct
+// LOAD/STORE addresses are RAM and vector operands in range, and blocks only
+// run unpaged, so those access memory and vector registers directly; the
+// rest cannot fault and go through execute_verified
+static inline void execute_unchecked(CPU *cpu, Instruction instruction) {
+    uint64_t *perf = cpu->perf_counters;
+    uint32_t *op = instruction.operands;
+    int32_t (*vectors)[VECTOR_LANES] = cpu->vectors;
+    switch (instruction.opcode) {
+        case LOAD: {
+            word_t value;
+            memcpy(&value, cpu->memory + op[1], sizeof(value));
+            cpu->registers[op[0]] = (sword_t)value;
+            perf[PERF_LOADS]++;
+            break;
+        }
+        case STORE: {
+            word_t value = (word_t)cpu->registers[op[0]];
+            memcpy(cpu->memory + op[1], &value, sizeof(value));
+            record_store(cpu, op[1], sizeof(value));
+            perf[PERF_STORES]++;
+            break;
+        }
+        case VSPLAT:
+            vector_splat(vectors[op[0]], (int32_t)cpu->registers[op[1]]);
+            break;
+        case VADD: case VSUB: case VMUL: case VAND: case VOR: case VXOR: case VCMPEQ: case VCMPGT:
+            vector_binary(instruction.opcode, vectors[op[0]], vectors[op[1]], vectors[op[2]]);
+            break;
+        case VSHUF:
+            vector_shuffle(vectors[op[0]], vectors[op[1]], (uint8_t)op[2]);
+            break;
+        case VREDUCE:
+            cpu->registers[op[0]] = (sword_t)vector_reduce(vectors[op[1]]);
+            break;
+        default:
+            execute_verified(cpu, instruction);
+            return;     // Counted by execute_verified
+    }
+    perf[PERF_INSTRUCTIONS]++;
+}
+
+// Run count instructions of a fault-free block from pre-decoded words
+static void run_block(const VerifiedProgram *program, CPU *cpu, uint32_t slot, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t raw = program->code[slot];
+        uint32_t length = program->lengths[slot];
+        cpu->instruction_register = raw;
+        cpu->instruction_length = length;
+        cpu->program_counter += length;
+        execute_unchecked(cpu, decode_instruction(raw));
+        slot += length / 2;
+    }
+}
+
+// Run fault-free blocks unchecked and everything else through step_cpu
+void run_verified(VerifiedProgram *program, CPU *cpu, uint64_t max_instructions) {
+    uint64_t *perf = cpu->perf_counters;
+    uint64_t executed = 0;
+    while (!cpu->halted && executed < max_instructions) {
+        uint32_t pc = cpu->program_counter;
+        uint32_t slot = pc / 2;
+        uint32_t count = pc % 2 == 0 && slot < INSTRUCTION_SLOTS ? program->blocks[slot] : 0;
+
+        // As in run_native, a block only runs if no interrupt can become due inside it
+        if (count && !cpu->paging && !cpu->trace_execution && perf[PERF_INSTRUCTIONS] + count <= cpu->next_event &&
+            executed + count <= max_instructions) {
+            cpu->store_size = 0;
+            run_block(program, cpu, slot, count);
+            executed += count;
+            program->unchecked_instructions += count;
+            program->blocks_run++;
+        } else {
+            step_cpu(cpu);
+            executed++;
+            program->checked_instructions++;
+        }
+        if (cpu->store_size) {
+            invalidate_verified(program, cpu->store_address, cpu->store_size);
+        }
+    }
+}
+
+// Print the verifier's results and the unchecked share of the run
+void display_verified(const VerifiedProgram *program) {
+    uint64_t total = program->unchecked_instructions + program->checked_instructions;
+    printf("Verified: %u instructions (%u rejected), %u fault-free in %u blocks\n", program->verified,
+           program->rejected, program->fault_free, program->block_count);
+    printf("Verified run: %llu blocks run, %llu instructions unchecked (%.1f%%), %llu checked, %u blocks invalidated\n",
+           (unsigned long long)program->blocks_run, (unsigned long long)program->unchecked_instructions,
+           total ? 100.0 * (double)program->unchecked_instructions / (double)total : 0.0,
+           (unsigned long long)program->checked_instructions, program->invalidated);
+}